@@ -0,0 +1,83 @@
+#include "AIScheduler.h"
+#include <algorithm>
+
+AIScheduler::AIScheduler(const AISchedulerSettings& settings)
+	: settings(settings)
+{
+}
+
+void AIScheduler::Resize(unsigned int itemCount)
+{
+	accumulated.resize(itemCount, 0.0f);
+	waited.resize(itemCount, 0);
+	intervals.resize(itemCount, 1);
+}
+
+void AIScheduler::Schedule(const float* distances, const unsigned char* flags, float deltaTime)
+{
+	frame++;
+	dueItems.clear();
+	dueDeltaTimes.clear();
+	candidates.clear();
+	deferredCount = 0;
+
+	for (unsigned int item = 0; item < accumulated.size(); ++item)
+	{
+		accumulated[item] += deltaTime;
+		waited[item]++;
+
+		unsigned int interval = Interval(distances[item], flags ? flags[item] : 0);
+		intervals[item] = interval;
+		if (interval == 1 || waited[item] >= interval * 2)
+			dueItems.push_back(item);
+		else if ((frame + item) % interval == 0 || waited[item] > interval)
+			candidates.push_back(item);
+	}
+
+	// over the budget, the items furthest behind their interval go first
+	if (settings.frameBudgetMs > 0.0 && itemMs > 0.0)
+	{
+		double left = settings.frameBudgetMs / itemMs - dueItems.size();
+		size_t allowed = left > 0.0 ? (std::min)((size_t)left, candidates.size()) : 0;
+		if (allowed < candidates.size())
+		{
+			std::nth_element(candidates.begin(), candidates.begin() + allowed, candidates.end(), [&](unsigned int a, unsigned int b)
+			{
+				return (unsigned long long)waited[a] * intervals[b] > (unsigned long long)waited[b] * intervals[a];
+			});
+			deferredCount = (unsigned int)(candidates.size() - allowed);
+			candidates.resize(allowed);
+		}
+	}
+	dueItems.insert(dueItems.end(), candidates.begin(), candidates.end());
+
+	for (unsigned int item : dueItems)
+	{
+		dueDeltaTimes.push_back(accumulated[item]);
+		accumulated[item] = 0.0f;
+		waited[item] = 0;
+	}
+}
+
+void AIScheduler::ReportUpdateMs(double ms)
+{
+	if (dueItems.empty())
+		return;
+
+	double measured = ms / dueItems.size();
+	itemMs = itemMs > 0.0 ? itemMs * 0.9 + measured * 0.1 : measured;
+}
+
+unsigned int AIScheduler::Interval(float distance, unsigned char flags) const
+{
+	if ((flags & AI_SCHEDULE_URGENT) || distance < settings.fullRateDistance)
+		return 1;
+
+	unsigned int interval = 2;
+	for (float d = distance - settings.fullRateDistance - settings.doublingDistance; d >= 0.0f && interval < settings.maxInterval; d -= settings.doublingDistance)
+		interval *= 2;
+
+	if (flags & AI_SCHEDULE_VISIBLE)
+		interval /= 2;
+	return (std::min)(interval, (std::max)(settings.maxInterval, 1u));
+}
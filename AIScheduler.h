@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include "SimpleAI.h"
+
+// Flags per item for AIScheduler::Schedule()
+#define AI_SCHEDULE_VISIBLE 0x01	// on screen, updated twice as often as its distance asks for
+#define AI_SCHEDULE_URGENT 0x02	// e.g. attacking, updated every frame
+
+struct AISchedulerSettings
+{
+	// Items this close to the player update every frame
+	float fullRateDistance = AI_SIGHT_RANGE_LIT * 2.0f;
+
+	// Past fullRateDistance the frames between updates double every this far, up to maxInterval
+	float doublingDistance = 15.0f;
+	unsigned int maxInterval = 8;
+
+	// Time the updates of items below full rate may take per frame, 0 for no limit. Items behind twice their interval ignore it
+	double frameBudgetMs = 0.0;
+};
+
+/**
+ * Level of detail for AI updates: picks which items (ghosts, or AISystem
+ * batches of four agents) update this frame.
+ *
+ * Every item gets an interval in frames from its distance to the player
+ * and its flags. Items update on the frames of their interval offset by
+ * their index, so items of the same interval spread evenly over the
+ * frames. Skipped frames aren't lost, every item accumulates the time
+ * since its last update and gets all of it as its next time step.
+ *
+ * With a budget, the items below full rate only take what's left of it
+ * after the full rate items, at the cost per item measured over the last
+ * frames (ReportUpdateMs()). Items cut off stay due and go first the next
+ * frame, the ones furthest behind their interval first. No item is put
+ * off past twice its interval, whatever the budget.
+ */
+class AIScheduler
+{
+public:
+	explicit AIScheduler(const AISchedulerSettings& settings = AISchedulerSettings());
+	~AIScheduler() = default;
+
+	// New items start on the frames of their interval, existing ones keep their time
+	void Resize(unsigned int itemCount);
+
+	// Adds deltaTime to every item and picks the due ones. One distance per item, flags (AI_SCHEDULE_*) are optional
+	void Schedule(const float* distances, const unsigned char* flags, float deltaTime);
+
+	// Time the last due items took to update, for the budget's cost estimate
+	void ReportUpdateMs(double ms);
+
+	// Items to update this frame, in no particular order, and the time step each has to catch up on
+	inline const std::vector<unsigned int>& GetDueItems() const { return dueItems; }
+	inline const std::vector<float>& GetDueDeltaTimes() const { return dueDeltaTimes; }
+
+	// Frames between updates the item got in the last Schedule()
+	inline unsigned int GetInterval(unsigned int item) const { return intervals[item]; }
+
+	inline unsigned int GetItemCount() const { return (unsigned int)accumulated.size(); }
+	inline unsigned int GetDeferredCount() const { return deferredCount; }	// due but over the budget in the last Schedule()
+	inline double GetItemMs() const { return itemMs; }
+	inline const AISchedulerSettings& GetSettings() const { return settings; }
+
+private:
+	unsigned int Interval(float distance, unsigned char flags) const;
+
+	AISchedulerSettings settings;
+	unsigned int frame = 0;
+
+	// per item
+	std::vector<float> accumulated;
+	std::vector<unsigned int> waited;	// frames since the last update
+	std::vector<unsigned int> intervals;
+
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> dueItems;
+	std::vector<float> dueDeltaTimes;
+	unsigned int deferredCount = 0;
+
+	// smoothed cost of one item's update, 0 until reported
+	double itemMs = 0.0;
+};
@@ -0,0 +1,227 @@
+#include "AIStateMachine.h"
+#include <cstdlib>
+#include <sstream>
+
+#define AI_CONDITION_MASK ((1u << AI_CONDITION_BITS) - 1)
+
+AIStateMachine AIStateMachine::MakeDefault()
+{
+	AIStateMachine machine;
+	unsigned int patrol = machine.AddState("patrol", AI_Behaviour::PATROL);
+	unsigned int attack = machine.AddState("attack", AI_Behaviour::CHASE);
+	machine.AddTransition(patrol, attack, AI_CONDITION_SEES_PLAYER);
+	machine.AddTransition(patrol, attack, AI_CONDITION_ALERTED);
+	machine.AddTransition(attack, patrol, 0, AI_CONDITION_SEES_PLAYER | AI_CONDITION_ALERTED);
+	machine.Compile();
+	return machine;
+}
+
+void AIStateMachine::Clear()
+{
+	names.clear();
+	behaviours.clear();
+	timeouts.clear();
+	transitions.clear();
+	table.clear();
+	error.clear();
+}
+
+unsigned int AIStateMachine::AddState(const char* name, AI_Behaviour behaviour, float timeout)
+{
+	names.push_back(name);
+	behaviours.push_back(behaviour);
+	timeouts.push_back(timeout);
+	return (unsigned int)names.size() - 1;
+}
+
+void AIStateMachine::AddTransition(unsigned int from, unsigned int to, unsigned int required, unsigned int forbidden)
+{
+	Transition transition = { from, to, required & AI_CONDITION_MASK, forbidden & AI_CONDITION_MASK };
+	transitions.push_back(transition);
+}
+
+unsigned int AIStateMachine::FindState(const std::string& name) const
+{
+	for (unsigned int state = 0; state < names.size(); ++state)
+	{
+		if (names[state] == name)
+			return state;
+	}
+	return AI_MAX_STATES;
+}
+
+// --------------------------------------------------------
+// Every state and condition combination tried against the
+// transitions in order, once. Agents only ever read the
+// result
+// --------------------------------------------------------
+bool AIStateMachine::Compile()
+{
+	table.clear();
+	error.clear();
+	if (names.empty() || names.size() > AI_MAX_STATES)
+	{
+		error = names.empty() ? "State machine has no states" : "State machine has more than 256 states";
+		return false;
+	}
+
+	for (const Transition& transition : transitions)
+	{
+		if ((transition.from != AI_ANY_STATE && transition.from >= names.size()) || transition.to >= names.size())
+		{
+			error = "Transition to or from a state that doesn't exist";
+			return false;
+		}
+	}
+
+	std::vector<unsigned char> next(names.size() << AI_CONDITION_BITS);
+	for (unsigned int state = 0; state < names.size(); ++state)
+	{
+		for (unsigned int conditions = 0; conditions <= AI_CONDITION_MASK; ++conditions)
+		{
+			unsigned int to = state;
+			for (const Transition& transition : transitions)
+			{
+				if ((transition.from == state || transition.from == AI_ANY_STATE)
+					&& (conditions & transition.required) == transition.required && (conditions & transition.forbidden) == 0)
+				{
+					to = transition.to;
+					break;
+				}
+			}
+			next[(state << AI_CONDITION_BITS) | conditions] = (unsigned char)to;
+		}
+	}
+
+	table.swap(next);
+	return true;
+}
+
+void AIStateMachine::Step(const unsigned char* conditions, unsigned char* states, unsigned int count) const
+{
+	const unsigned char* next = table.data();
+	for (unsigned int i = 0; i < count; ++i)
+		states[i] = next[((unsigned int)states[i] << AI_CONDITION_BITS) | (conditions[i] & AI_CONDITION_MASK)];
+}
+
+// --------------------------------------------------------
+// Statements one line at a time. States can be named by
+// transitions before the line that declares them
+// --------------------------------------------------------
+bool AIStateMachine::Parse(const char* text)
+{
+	Clear();
+
+	struct NamedTransition
+	{
+		std::string from, to;
+		unsigned int required, forbidden;
+		unsigned int line;
+	};
+	std::vector<NamedTransition> named;
+
+	std::istringstream lines(text ? text : "");
+	std::string line;
+	unsigned int lineNumber = 0;
+	while (std::getline(lines, line))
+	{
+		++lineNumber;
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.erase(comment);
+
+		std::istringstream words(line);
+		std::string keyword;
+		if (!(words >> keyword))
+			continue;
+
+		if (keyword == "state")
+		{
+			std::string name, behaviourName;
+			std::string timeoutText;
+			float timeout = 0.0f;
+			if (!(words >> name >> behaviourName))
+			{
+				error = "Line " + std::to_string(lineNumber) + ": state needs a name and a behaviour";
+				return false;
+			}
+			char* end = nullptr;
+			if (words >> timeoutText)
+				timeout = strtof(timeoutText.c_str(), &end);
+			if (end && (*end || timeout < 0.0f))
+			{
+				error = "Line " + std::to_string(lineNumber) + ": state '" + name + "' has a timeout that isn't a number";
+				return false;
+			}
+
+			AI_Behaviour behaviour;
+			if (behaviourName == "hold")
+				behaviour = AI_Behaviour::HOLD;
+			else if (behaviourName == "patrol")
+				behaviour = AI_Behaviour::PATROL;
+			else if (behaviourName == "chase")
+				behaviour = AI_Behaviour::CHASE;
+			else
+			{
+				error = "Line " + std::to_string(lineNumber) + ": unknown behaviour '" + behaviourName + "'";
+				return false;
+			}
+
+			if (FindState(name) != AI_MAX_STATES)
+			{
+				error = "Line " + std::to_string(lineNumber) + ": state '" + name + "' declared twice";
+				return false;
+			}
+			AddState(name.c_str(), behaviour, timeout);
+		}
+		else if (keyword == "on")
+		{
+			NamedTransition transition = { "", "", 0, 0, lineNumber };
+			if (!(words >> transition.from >> transition.to))
+			{
+				error = "Line " + std::to_string(lineNumber) + ": transition needs a state to go from and one to go to";
+				return false;
+			}
+
+			std::string condition;
+			while (words >> condition)
+			{
+				bool clear = condition[0] == '!';
+				std::string conditionName = clear ? condition.substr(1) : condition;
+				unsigned int bit;
+				if (conditionName == "sees")
+					bit = AI_CONDITION_SEES_PLAYER;
+				else if (conditionName == "alerted")
+					bit = AI_CONDITION_ALERTED;
+				else if (conditionName == "timeout")
+					bit = AI_CONDITION_TIMED_OUT;
+				else
+				{
+					error = "Line " + std::to_string(lineNumber) + ": unknown condition '" + condition + "'";
+					return false;
+				}
+				(clear ? transition.forbidden : transition.required) |= bit;
+			}
+			named.push_back(transition);
+		}
+		else
+		{
+			error = "Line " + std::to_string(lineNumber) + ": expected 'state' or 'on', not '" + keyword + "'";
+			return false;
+		}
+	}
+
+	for (const NamedTransition& transition : named)
+	{
+		unsigned int from = transition.from == "*" ? AI_ANY_STATE : FindState(transition.from);
+		unsigned int to = FindState(transition.to);
+		if (from == AI_MAX_STATES || to == AI_MAX_STATES)
+		{
+			error = "Line " + std::to_string(transition.line) + ": no state '" + (from == AI_MAX_STATES ? transition.from : transition.to) + "'";
+			return false;
+		}
+		AddTransition(from, to, transition.required, transition.forbidden);
+	}
+
+	return Compile();
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// What an agent's transitions test, one bit each
+#define AI_CONDITION_SEES_PLAYER 0x01	// in range, and in sight with occluders
+#define AI_CONDITION_ALERTED 0x02		// called by an agent that saw the player
+#define AI_CONDITION_TIMED_OUT 0x04		// in its state for the state's timeout or longer
+#define AI_CONDITION_BITS 3
+
+// States are a byte per agent
+#define AI_MAX_STATES 256
+
+// Transition from any state, for AddTransition()
+#define AI_ANY_STATE 0xffffffff
+
+// What agents do while in a state, the batched movement only knows these
+enum class AI_Behaviour : unsigned char
+{
+	HOLD,	// stand still
+	PATROL,	// walk the route
+	CHASE	// go for the player
+};
+
+/**
+ * Agent behaviour as data: states, each with a behaviour and a timeout,
+ * and transitions between them on conditions. Every transition names
+ * the conditions that must be set and the ones that must be clear, the
+ * first one added that matches an agent's conditions is taken, and with
+ * none the agent stays. State 0 is where agents start.
+ *
+ * Compile() flattens the transitions into one table indexed by state and
+ * condition bits, so the next state of any agent is a byte load however
+ * many transitions there are, and a whole array of agents steps with no
+ * branching per state and nothing virtual. New behaviours are new
+ * definitions, not new classes.
+ *
+ * Definitions also come from text with Parse(), one statement per line:
+ *
+ *   state <name> <hold|patrol|chase> [timeout in seconds]
+ *   on <from|*> <to> [sees|alerted|timeout|!sees|!alerted|!timeout ...]
+ *
+ * '#' starts a comment.
+ */
+class AIStateMachine
+{
+public:
+	AIStateMachine() = default;
+	~AIStateMachine() = default;
+
+	// SimpleAI's: patrol until the player is seen or an alert comes in, attack while either lasts. Compiled
+	static AIStateMachine MakeDefault();
+
+	void Clear();
+
+	// Returns the state's index. A timeout of 0 never sets AI_CONDITION_TIMED_OUT
+	unsigned int AddState(const char* name, AI_Behaviour behaviour, float timeout = 0.0f);
+
+	// required and forbidden are AI_CONDITION_ bits. from may be AI_ANY_STATE
+	void AddTransition(unsigned int from, unsigned int to, unsigned int required, unsigned int forbidden = 0);
+
+	// Replaces the definition with the text's and compiles it. Returns false and fills GetError() on failure
+	bool Parse(const char* text);
+
+	// Builds the table. Returns false and fills GetError() if there are no states or a transition names a missing one
+	bool Compile();
+
+	inline unsigned int Next(unsigned int state, unsigned int conditions) const { return table[(state << AI_CONDITION_BITS) | conditions]; }
+
+	// Every agent's next state from its AI_CONDITION_ bits, in place
+	void Step(const unsigned char* conditions, unsigned char* states, unsigned int count) const;
+
+	// AI_CONDITION_BITS wide, for Step()
+	inline const unsigned char* GetTable() const { return table.data(); }
+
+	inline bool IsCompiled() const { return !table.empty(); }
+	inline unsigned int GetStateCount() const { return (unsigned int)names.size(); }
+	inline unsigned int GetTransitionCount() const { return (unsigned int)transitions.size(); }
+	inline const std::string& GetName(unsigned int state) const { return names[state]; }
+	inline AI_Behaviour GetBehaviour(unsigned int state) const { return behaviours[state]; }
+	inline float GetTimeout(unsigned int state) const { return timeouts[state]; }
+	inline const std::string& GetError() const { return error; }
+
+	// AI_MAX_STATES if there's no such state
+	unsigned int FindState(const std::string& name) const;
+
+private:
+	struct Transition
+	{
+		unsigned int from, to;
+		unsigned int required, forbidden;
+	};
+
+	std::vector<std::string> names;
+	std::vector<AI_Behaviour> behaviours;
+	std::vector<float> timeouts;
+	std::vector<Transition> transitions;
+
+	// next state per state << AI_CONDITION_BITS | conditions
+	std::vector<unsigned char> table;
+	std::string error;
+};
@@ -0,0 +1,353 @@
+#include "AISystem.h"
+#include "AIStateMachine.h"
+#include "CrowdAvoidance.h"
+#include "FlowField.h"
+#include "NavMesh.h"
+#include "TriangleBVH.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Headless AI stress test: AISystem alone over a generated
+// level, no window, no device and nothing from DXCore, so
+// it builds wherever DirectXMath does (see CMakeLists.txt).
+//
+//   AIStress [-agents N] [-ticks M] [-seed S] [-runs R]
+//            [-level metres] [-alerts] [-avoid] [-walls]
+//            [-navmesh] [-machine file]
+//
+// Prints ticks per second, where the ticks spent their
+// time and a checksum of every agent at the end. Runs of
+// the same binary with the same settings have to end with
+// the same checksum, more than one run checks it
+// --------------------------------------------------------
+
+using namespace DirectX;
+
+// Scenario defaults
+#define STRESS_AGENTS 100000
+#define STRESS_TICKS 600
+#define STRESS_DELTA_TIME (1.0f / 60.0f)
+#define STRESS_AGENTS_PER_ROUTE 50
+#define STRESS_ROUTE_LENGTH 5
+#define STRESS_METRES_PER_AGENT 1.25f	// level side per square root of the agent count
+#define STRESS_WALL_SPACING 8.0f		// one pillar per this many metres squared, with -walls
+
+namespace
+{
+	struct StressSettings
+	{
+		unsigned int agentCount = STRESS_AGENTS;
+		unsigned int ticks = STRESS_TICKS;
+		unsigned int seed = 1;
+		unsigned int runs = 1;
+		float levelSize = 0.0f;	// 0 sizes it to the agents
+		bool alerts = false;
+		bool avoidance = false;
+		bool walls = false;
+		bool navMesh = false;
+		std::string machineFile;
+	};
+
+	struct StressResult
+	{
+		double setupMs = 0.0;
+		std::vector<double> tickMs;
+		AISystemTimings phases;	// summed over the ticks
+		size_t stateChanges = 0;
+		unsigned int attacking = 0;
+		unsigned long long checksum = 0;
+	};
+
+	// Same generator as the benchmarks, the scenario only depends on the seed
+	float RandomFloat(unsigned int& seed)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (float)(seed >> 8) / 16777216.0f;
+	}
+
+	double MsSince(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// FNV-1a over raw bytes
+	void Hash(unsigned long long& hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; ++i)
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+
+	// The player circles the level once every 628 ticks, in and out of the light
+	void PlayerAt(unsigned int tick, float levelSize, XMFLOAT3& position, float& visibility)
+	{
+		float angle = tick * 0.01f;
+		position = XMFLOAT3(cosf(angle) * levelSize * 0.3f, 1.0f, sinf(angle) * levelSize * 0.3f);
+		visibility = 0.5f + 0.5f * sinf(tick * 0.05f);
+	}
+
+	// Five faces wound outward, the bottom one is never seen
+	void AddPillar(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax, TriangleBVH& occluders, NavMesh* navMesh)
+	{
+		XMFLOAT3 corners[8];
+		for (int i = 0; i < 8; ++i)
+			corners[i] = XMFLOAT3(i & 1 ? boundsMax.x : boundsMin.x, i & 2 ? boundsMax.y : boundsMin.y, i & 4 ? boundsMax.z : boundsMin.z);
+
+		static const int faces[5][4] = { { 2, 6, 7, 3 }, { 0, 2, 6, 4 }, { 1, 5, 7, 3 }, { 0, 4, 5, 1 }, { 4, 6, 7, 5 } };
+		for (const int* face : faces)
+		{
+			occluders.AddTriangle(corners[face[0]], corners[face[1]], corners[face[2]]);
+			occluders.AddTriangle(corners[face[0]], corners[face[2]], corners[face[3]]);
+			if (navMesh)
+			{
+				navMesh->AddTriangle(corners[face[0]], corners[face[1]], corners[face[2]]);
+				navMesh->AddTriangle(corners[face[0]], corners[face[2]], corners[face[3]]);
+			}
+		}
+	}
+
+	// Every agent's position, yaw, state and route point
+	unsigned long long Checksum(const AISystem& system)
+	{
+		unsigned long long hash = 14695981039346656037ull;
+		for (unsigned int agent = 0; agent < system.GetAgentCount(); ++agent)
+		{
+			XMFLOAT3 position = system.GetPosition(agent);
+			float yaw = system.GetYaw(agent);
+			unsigned int state = system.GetMachineState(agent);
+			unsigned int point = system.GetActiveRoute(agent);
+			Hash(hash, &position, sizeof(position));
+			Hash(hash, &yaw, sizeof(yaw));
+			Hash(hash, &state, sizeof(state));
+			Hash(hash, &point, sizeof(point));
+		}
+		return hash;
+	}
+
+	// --------------------------------------------------------
+	// One whole run: the level and agents from the seed, then
+	// every tick timed on its own
+	// --------------------------------------------------------
+	void RunScenario(const StressSettings& settings, const AIStateMachine& machine, StressResult& result)
+	{
+		auto setupStart = std::chrono::high_resolution_clock::now();
+		unsigned int seed = settings.seed;
+		float levelSize = settings.levelSize;
+
+		// 2 m square routes at the ghosts' height, agents start next to theirs
+		unsigned int routeCount = (std::max)(1u, settings.agentCount / STRESS_AGENTS_PER_ROUTE);
+		std::vector<XMFLOAT3> routePoints(routeCount * STRESS_ROUTE_LENGTH);
+		for (unsigned int r = 0; r < routeCount; ++r)
+		{
+			float x = RandomFloat(seed) * levelSize - levelSize * 0.5f;
+			float z = RandomFloat(seed) * levelSize - levelSize * 0.5f;
+			for (unsigned int p = 0; p < STRESS_ROUTE_LENGTH; ++p)
+				routePoints[r * STRESS_ROUTE_LENGTH + p] = XMFLOAT3(x + 2.0f * ((p + 1) / 2 % 2), 1.5f, z + 2.0f * (p / 2 % 2));
+		}
+
+		TriangleBVH occluders;
+		NavMesh navMesh;
+		FlowField* flowField = nullptr;
+		if (settings.navMesh)
+		{
+			float half = levelSize * 0.5f + 4.0f;
+			navMesh.AddTriangle(XMFLOAT3(-half, 0, -half), XMFLOAT3(-half, 0, half), XMFLOAT3(half, 0, half));
+			navMesh.AddTriangle(XMFLOAT3(-half, 0, -half), XMFLOAT3(half, 0, half), XMFLOAT3(half, 0, -half));
+		}
+		if (settings.walls)
+		{
+			unsigned int pillarCount = (unsigned int)(levelSize * levelSize / (STRESS_WALL_SPACING * STRESS_WALL_SPACING));
+			for (unsigned int i = 0; i < pillarCount; ++i)
+			{
+				float x = RandomFloat(seed) * levelSize - levelSize * 0.5f;
+				float z = RandomFloat(seed) * levelSize - levelSize * 0.5f;
+				AddPillar(XMFLOAT3(x, 0.0f, z), XMFLOAT3(x + 1.0f, 3.0f, z + 1.0f), occluders, settings.navMesh ? &navMesh : nullptr);
+			}
+			occluders.Build();
+		}
+
+		AISystem system;
+		system.SetStateMachine(machine);
+		if (settings.alerts)
+			system.SetAlertRange(AI_ALERT_RANGE);
+		CrowdAvoidanceSettings avoidanceSettings;
+		if (settings.avoidance)
+			system.SetAvoidance(&avoidanceSettings);
+		if (settings.walls)
+			system.SetOccluders(&occluders);
+		if (settings.navMesh)
+		{
+			NavMeshSettings navSettings;
+			navSettings.cellSize = 0.5f;
+			navMesh.Build(navSettings);
+			flowField = new FlowField(navMesh, FlowFieldSettings());
+			system.SetNavMesh(&navMesh);
+			system.SetFlowField(flowField);
+		}
+
+		for (unsigned int r = 0; r < routeCount; ++r)
+			system.AddRoute(&routePoints[r * STRESS_ROUTE_LENGTH], STRESS_ROUTE_LENGTH);
+		for (unsigned int i = 0; i < settings.agentCount; ++i)
+		{
+			unsigned int route = (unsigned int)(RandomFloat(seed) * routeCount);
+			const XMFLOAT3& first = routePoints[route * STRESS_ROUTE_LENGTH];
+			system.AddAgent(XMFLOAT3(first.x + RandomFloat(seed) * 6.0f - 3.0f, 0.5f, first.z + RandomFloat(seed) * 6.0f - 3.0f), route);
+		}
+		result.setupMs = MsSince(setupStart);
+
+		result.tickMs.resize(settings.ticks);
+		for (unsigned int tick = 0; tick < settings.ticks; ++tick)
+		{
+			XMFLOAT3 player;
+			float visibility;
+			PlayerAt(tick, levelSize, player, visibility);
+
+			auto tickStart = std::chrono::high_resolution_clock::now();
+			if (flowField)
+				flowField->SetTarget(player);
+			system.Update(player, visibility, STRESS_DELTA_TIME);
+			result.tickMs[tick] = MsSince(tickStart);
+
+			const AISystemTimings& phases = system.GetTimings();
+			result.phases.alertMs += phases.alertMs;
+			result.phases.sightMs += phases.sightMs;
+			result.phases.stateMs += phases.stateMs;
+			result.phases.steerMs += phases.steerMs;
+			result.phases.moveMs += phases.moveMs;
+			result.phases.avoidMs += phases.avoidMs;
+			result.stateChanges += system.GetStateChanges().size();
+		}
+
+		for (unsigned int agent = 0; agent < system.GetAgentCount(); ++agent)
+			result.attacking += system.GetState(agent) == AI_State::ATTACK_PLAYER;
+		result.checksum = Checksum(system);
+
+		// the system keeps pointers to the field
+		system.SetFlowField(nullptr);
+		delete flowField;
+	}
+
+	double Percentile(std::vector<double> samples, float percentile)
+	{
+		size_t rank = (size_t)(percentile * (samples.size() - 1));
+		std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+		return samples[rank];
+	}
+
+	void PrintUsage()
+	{
+		printf("AIStress [-agents N] [-ticks M] [-seed S] [-runs R] [-level metres] [-alerts] [-avoid] [-walls] [-navmesh] [-machine file]\n");
+		printf("  -agents   agents to update, default %u\n", STRESS_AGENTS);
+		printf("  -ticks    updates per run at 60 Hz, default %u\n", STRESS_TICKS);
+		printf("  -seed     level, routes and starts, default 1\n");
+		printf("  -runs     whole runs, their checksums have to match, default 1\n");
+		printf("  -level    side of the square level, default %.2f m per square root of the agents\n", STRESS_METRES_PER_AGENT);
+		printf("  -alerts   agents that see the player call the others\n");
+		printf("  -avoid    crowd avoidance between the agents\n");
+		printf("  -walls    pillars hiding the player, traced for line of sight\n");
+		printf("  -navmesh  paths around the pillars, one search per patrolling agent and tick, a flow field for the others\n");
+		printf("  -machine  state machine definition to run instead of patrol and attack, see AIStateMachine.h\n");
+	}
+
+	// False on anything it doesn't understand
+	bool ParseArguments(int argc, char** argv, StressSettings& settings)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string argument = argv[i];
+			bool hasValue = i + 1 < argc;
+			if (argument == "-alerts")
+				settings.alerts = true;
+			else if (argument == "-avoid")
+				settings.avoidance = true;
+			else if (argument == "-walls")
+				settings.walls = true;
+			else if (argument == "-navmesh")
+				settings.navMesh = true;
+			else if (argument == "-agents" && hasValue)
+				settings.agentCount = (unsigned int)strtoul(argv[++i], nullptr, 10);
+			else if (argument == "-ticks" && hasValue)
+				settings.ticks = (unsigned int)strtoul(argv[++i], nullptr, 10);
+			else if (argument == "-seed" && hasValue)
+				settings.seed = (unsigned int)strtoul(argv[++i], nullptr, 10);
+			else if (argument == "-runs" && hasValue)
+				settings.runs = (unsigned int)strtoul(argv[++i], nullptr, 10);
+			else if (argument == "-level" && hasValue)
+				settings.levelSize = strtof(argv[++i], nullptr);
+			else if (argument == "-machine" && hasValue)
+				settings.machineFile = argv[++i];
+			else
+				return false;
+		}
+		return settings.agentCount > 0 && settings.ticks > 0 && settings.runs > 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	StressSettings settings;
+	if (!ParseArguments(argc, argv, settings))
+	{
+		PrintUsage();
+		return 2;
+	}
+	if (settings.levelSize <= 0.0f)
+		settings.levelSize = (std::max)(40.0f, sqrtf((float)settings.agentCount) * STRESS_METRES_PER_AGENT);
+
+	AIStateMachine machine = AIStateMachine::MakeDefault();
+	if (!settings.machineFile.empty())
+	{
+		std::ifstream file(settings.machineFile);
+		std::stringstream text;
+		text << file.rdbuf();
+		if (!file || !machine.Parse(text.str().c_str()))
+		{
+			printf("Can't use state machine %s: %s\n", settings.machineFile.c_str(), file ? machine.GetError().c_str() : "can't read the file");
+			return 2;
+		}
+	}
+
+	printf("AIStress: %u agents, %u ticks, seed %u, %.0f m level, %u states, alerts %s, avoidance %s, walls %s, navmesh %s\n",
+		settings.agentCount, settings.ticks, settings.seed, settings.levelSize, machine.GetStateCount(),
+		settings.alerts ? "on" : "off", settings.avoidance ? "on" : "off", settings.walls ? "on" : "off", settings.navMesh ? "on" : "off");
+
+	int exitCode = 0;
+	unsigned long long firstChecksum = 0;
+	for (unsigned int run = 0; run < settings.runs; ++run)
+	{
+		StressResult result;
+		RunScenario(settings, machine, result);
+
+		double totalMs = 0.0;
+		for (double ms : result.tickMs)
+			totalMs += ms;
+		double meanMs = totalMs / settings.ticks;
+		double ticks = (double)settings.ticks;
+
+		printf("run %u: %.3f ms/tick (p50 %.3f, p99 %.3f, max %.3f), %.1f ticks/s, %.1f M agent updates/s, setup %.1f ms\n",
+			run + 1, meanMs, Percentile(result.tickMs, 0.5f), Percentile(result.tickMs, 0.99f), Percentile(result.tickMs, 1.0f),
+			1000.0 / meanMs, settings.agentCount / meanMs / 1000.0, result.setupMs);
+		printf("  ms/tick: alerts %.3f, sight %.3f, states %.3f, steering %.3f, movement %.3f, avoidance %.3f\n",
+			result.phases.alertMs / ticks, result.phases.sightMs / ticks, result.phases.stateMs / ticks,
+			result.phases.steerMs / ticks, result.phases.moveMs / ticks, result.phases.avoidMs / ticks);
+		printf("  %zu state changes, %u attacking at the end, checksum %016llx\n", result.stateChanges, result.attacking, result.checksum);
+
+		if (run == 0)
+			firstChecksum = result.checksum;
+		else if (result.checksum != firstChecksum)
+		{
+			printf("  checksum differs from run 1, the update isn't deterministic\n");
+			exitCode = 1;
+		}
+	}
+
+	return exitCode;
+}
@@ -0,0 +1,541 @@
+#include "AISystem.h"
+#include "NavMesh.h"
+#include "NavHierarchy.h"
+#include "FlowField.h"
+#include "PathRequestService.h"
+#include "TriangleBVH.h"
+#include "CrowdAvoidance.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+using namespace DirectX;
+
+// Conditions no update has, agents that just entered their state look theirs up
+#define AI_NO_CONDITIONS 0xffffffff
+
+namespace
+{
+	// ms since the time point, which moves on to now
+	double Lap(std::chrono::high_resolution_clock::time_point& since)
+	{
+		auto now = std::chrono::high_resolution_clock::now();
+		double ms = std::chrono::duration<double, std::milli>(now - since).count();
+		since = now;
+		return ms;
+	}
+}
+
+AISystem::~AISystem()
+{
+	SetPathService(nullptr);
+	delete navQuery;
+	delete hierarchyQuery;
+	delete avoidance;
+}
+
+void AISystem::SetNavMesh(const NavMesh* navMesh)
+{
+	delete navQuery;
+	navQuery = navMesh ? new NavMeshQuery(*navMesh) : nullptr;
+}
+
+void AISystem::SetNavHierarchy(const NavHierarchy* hierarchy)
+{
+	delete hierarchyQuery;
+	hierarchyQuery = hierarchy ? new NavHierarchyQuery(*hierarchy) : nullptr;
+}
+
+void AISystem::SetPathService(PathRequestService* service)
+{
+	for (PathFollower& follower : pathFollowers)
+		follower.Reset(pathService);
+	pathService = service;
+}
+
+void AISystem::SetAvoidance(const CrowdAvoidanceSettings* settings)
+{
+	delete avoidance;
+	avoidance = settings ? new CrowdAvoidance(*settings) : nullptr;
+}
+
+void AISystem::SetStateMachine(const AIStateMachine& machine)
+{
+	stateMachine = machine;
+	for (unsigned int agent = 0; agent < states.size(); ++agent)
+	{
+		states[agent] = 0;
+		EnterState(agent);
+	}
+}
+
+// The state's behaviour masks and timeout, from no time in it
+void AISystem::EnterState(unsigned int agent)
+{
+	AI_Behaviour behaviour = stateMachine.GetBehaviour(states[agent]);
+	float timeout = stateMachine.GetTimeout(states[agent]);
+	attacking[agent] = behaviour == AI_Behaviour::CHASE ? 0xffffffff : 0;
+	holding[agent] = behaviour == AI_Behaviour::HOLD ? 0xffffffff : 0;
+	stateTimes[agent] = 0.0f;
+	stateConditions[agent] = AI_NO_CONDITIONS;
+	stateTimeouts[agent] = timeout > 0.0f ? timeout : FLT_MAX;
+}
+
+void AISystem::Clear()
+{
+	// the tickets out go with their agents
+	SetPathService(pathService);
+	agentCount = 0;
+	positionX.clear(); positionY.clear(); positionZ.clear();
+	waypointX.clear(); waypointY.clear(); waypointZ.clear();
+	yaw.clear();
+	speed.clear();
+	steerX.clear(); steerY.clear(); steerZ.clear();
+	velocityX.clear(); velocityZ.clear();
+	preferredX.clear(); preferredZ.clear();
+	avoidX.clear(); avoidZ.clear();
+	agentDeltaTimes.clear();
+	states.clear();
+	stateTimes.clear();
+	stateTimeouts.clear();
+	stateConditions.clear();
+	attacking.clear();
+	holding.clear();
+	spotted.clear();
+	alerted.clear();
+	inSight.clear();
+	route.clear();
+	activeRoute.clear();
+	routePoints.clear();
+	routeFirst.clear();
+	routeCount.clear();
+	stateChanges.clear();
+	pathFollowers.clear();
+}
+
+unsigned int AISystem::AddRoute(const XMFLOAT3* points, unsigned int pointCount)
+{
+	routeFirst.push_back((unsigned int)routePoints.size());
+	routeCount.push_back(pointCount);
+	routePoints.insert(routePoints.end(), points, points + pointCount);
+	return (unsigned int)routeFirst.size() - 1;
+}
+
+unsigned int AISystem::AddAgent(const XMFLOAT3& position, unsigned int agentRoute, float agentSpeed)
+{
+	// the new agent takes the first padding slot, a full array grows by another batch
+	unsigned int agent = agentCount++;
+	if (agent == positionX.size())
+	{
+		size_t padded = positionX.size() + AI_BATCH_SIZE;
+		positionX.resize(padded, 0.0f); positionY.resize(padded, 0.0f); positionZ.resize(padded, 0.0f);
+		waypointX.resize(padded, 0.0f); waypointY.resize(padded, 0.0f); waypointZ.resize(padded, 0.0f);
+		yaw.resize(padded, 0.0f);
+		speed.resize(padded, 0.0f);
+		steerX.resize(padded, 0.0f); steerY.resize(padded, 0.0f); steerZ.resize(padded, 0.0f);
+		velocityX.resize(padded, 0.0f); velocityZ.resize(padded, 0.0f);
+		preferredX.resize(padded, 0.0f); preferredZ.resize(padded, 0.0f);
+		avoidX.resize(padded, 0.0f); avoidZ.resize(padded, 0.0f);
+		agentDeltaTimes.resize(padded, 0.0f);
+		states.resize(padded, 0);
+		stateTimes.resize(padded, 0.0f);
+		stateTimeouts.resize(padded, FLT_MAX);
+		stateConditions.resize(padded, AI_NO_CONDITIONS);
+		attacking.resize(padded, 0);
+		holding.resize(padded, 0);
+		spotted.resize(padded, 0);
+		alerted.resize(padded, 0);
+		inSight.resize(padded, 0);
+		route.resize(padded, 0);
+		activeRoute.resize(padded, 0);
+		pathFollowers.resize(padded);
+	}
+
+	positionX[agent] = position.x;
+	positionY[agent] = position.y;
+	positionZ[agent] = position.z;
+	yaw[agent] = 0.0f;
+	speed[agent] = agentSpeed;
+	velocityX[agent] = 0.0f;
+	velocityZ[agent] = 0.0f;
+	states[agent] = 0;
+	EnterState(agent);
+	spotted[agent] = 0;
+	alerted[agent] = 0;
+	inSight[agent] = 0;
+	route[agent] = agentRoute;
+	activeRoute[agent] = 0;
+	pathFollowers[agent].Reset(nullptr);
+
+	const XMFLOAT3& waypoint = routePoints[routeFirst[agentRoute]];
+	waypointX[agent] = waypoint.x;
+	waypointY[agent] = waypoint.y;
+	waypointZ[agent] = waypoint.z;
+	return agent;
+}
+
+void AISystem::SetPosition(unsigned int agent, const XMFLOAT3& position)
+{
+	positionX[agent] = position.x;
+	positionY[agent] = position.y;
+	positionZ[agent] = position.z;
+}
+
+void AISystem::Update(const XMFLOAT3& playerPosition, float playerVisibility, float deltaTime)
+{
+	unsigned int batchCount = GetBatchCount();
+	if (allBatches.size() != batchCount)
+	{
+		allBatches.resize(batchCount);
+		for (unsigned int batch = 0; batch < batchCount; ++batch)
+			allBatches[batch] = batch;
+	}
+	allDeltaTimes.assign(batchCount, deltaTime);
+
+	UpdateBatches(playerPosition, playerVisibility, allBatches.data(), allDeltaTimes.data(), batchCount);
+}
+
+// --------------------------------------------------------
+// The state machine's transitions, then the patrol/chase
+// movement for four agents per step. Lanes only take a
+// scalar path when they reach a patrol point
+// --------------------------------------------------------
+void AISystem::UpdateBatches(const XMFLOAT3& playerPosition, float playerVisibility, const unsigned int* batches, const float* deltaTimes, unsigned int batchCount)
+{
+	stateChanges.clear();
+
+	// Ghosts can see farther the more the player is lit
+	float range = AI_SIGHT_RANGE_DARK + (AI_SIGHT_RANGE_LIT - AI_SIGHT_RANGE_DARK) * playerVisibility;
+	const XMVECTOR reachedSq = XMVectorReplicate(AI_WAYPOINT_REACHED_SQ);
+	const XMVECTOR spin = XMVectorReplicate(AI_SPIN_PER_UPDATE);
+	const XMVECTOR playerX = XMVectorReplicate(playerPosition.x);
+	const XMVECTOR playerY = XMVectorReplicate(playerPosition.y);
+	const XMVECTOR playerZ = XMVectorReplicate(playerPosition.z);
+	const XMVECTOR zero = XMVectorZero();
+
+	timings = AISystemTimings();
+	auto phase = std::chrono::high_resolution_clock::now();
+
+	AlertNeighbours();
+	timings.alertMs = Lap(phase);
+	if (occluders)
+	{
+		TestLineOfSight(playerPosition, range, batches, batchCount);
+		timings.sightMs = Lap(phase);
+	}
+
+	UpdateStates(playerPosition, range, batches, deltaTimes, batchCount);
+	timings.stateMs = Lap(phase);
+
+	bool steering = navQuery || hierarchyQuery || flowField || pathService;
+	if (steering)
+	{
+		SteerAlongPaths(playerPosition, batches, batchCount);
+		timings.steerMs = Lap(phase);
+	}
+
+	for (unsigned int b = 0; b < batchCount; ++b)
+	{
+		unsigned int first = batches[b] * AI_BATCH_SIZE;
+		const XMVECTOR step = XMVectorReplicate(deltaTimes[b]);
+		XMVECTOR x = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&positionX[first]));
+		XMVECTOR y = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&positionY[first]));
+		XMVECTOR z = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&positionZ[first]));
+
+		XMVECTOR toPlayerX = XMVectorSubtract(playerX, x);
+		XMVECTOR toPlayerY = XMVectorSubtract(playerY, y);
+		XMVECTOR toPlayerZ = XMVectorSubtract(playerZ, z);
+		XMVECTOR attack = XMLoadInt4(&attacking[first]);
+		XMVECTOR hold = XMLoadInt4(&holding[first]);
+
+		// patrolling lanes close enough to their point stand still this update and move on to the next point
+		XMVECTOR toPointX = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&waypointX[first])), x);
+		XMVECTOR toPointY = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&waypointY[first])), y);
+		XMVECTOR toPointZ = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&waypointZ[first])), z);
+		XMVECTOR pointDistSq = XMVectorAdd(XMVectorAdd(XMVectorMultiply(toPointX, toPointX), XMVectorMultiply(toPointY, toPointY)), XMVectorMultiply(toPointZ, toPointZ));
+		XMVECTOR reached = XMVectorAndCInt(XMVectorLessOrEqual(pointDistSq, reachedSq), XMVectorOrInt(attack, hold));
+
+		// AIMoveTowards(): normalized 3D direction, only XZ applied. A zero direction doesn't move
+		XMVECTOR dirX = XMVectorSelect(toPointX, toPlayerX, attack);
+		XMVECTOR dirY = XMVectorSelect(toPointY, toPlayerY, attack);
+		XMVECTOR dirZ = XMVectorSelect(toPointZ, toPlayerZ, attack);
+		if (steering)
+		{
+			dirX = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&steerX[first])), x);
+			dirY = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&steerY[first])), y);
+			dirZ = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&steerZ[first])), z);
+		}
+		XMVECTOR lengthSq = XMVectorAdd(XMVectorAdd(XMVectorMultiply(dirX, dirX), XMVectorMultiply(dirY, dirY)), XMVectorMultiply(dirZ, dirZ));
+		XMVECTOR moving = XMVectorAndCInt(XMVectorGreater(lengthSq, zero), XMVectorOrInt(reached, hold));
+		XMVECTOR length = XMVectorSqrt(lengthSq);
+		XMVECTOR distance = XMVectorMultiply(step, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&speed[first])));
+
+		// distance over length per unit of direction, selected so lanes standing on their target don't get 0 / 0
+		if (avoidance)
+		{
+			// only the velocity for now, AvoidAndMove() moves the agents
+			XMVECTOR velocityScale = XMVectorSelect(zero, XMVectorDivide(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&speed[first])), length), moving);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&preferredX[first]), XMVectorMultiply(dirX, velocityScale));
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&preferredZ[first]), XMVectorMultiply(dirZ, velocityScale));
+		}
+		else
+		{
+			XMVECTOR scale = XMVectorSelect(zero, XMVectorDivide(distance, length), moving);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&positionX[first]), XMVectorAdd(x, XMVectorMultiply(dirX, scale)));
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&positionZ[first]), XMVectorAdd(z, XMVectorMultiply(dirZ, scale)));
+		}
+
+		// SimpleAI spins whenever it calls AIMoveTowards(), only a lane on its patrol point (or holding) doesn't
+		XMVECTOR spinning = XMVectorAndCInt(XMVectorTrueInt(), XMVectorOrInt(reached, hold));
+		XMVECTOR angle = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&yaw[first]));
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&yaw[first]), XMVectorAdd(angle, XMVectorSelect(zero, spin, spinning)));
+
+		// rare per lane work, padding lanes past agentCount are skipped
+		unsigned int lanes = (std::min)((unsigned int)AI_BATCH_SIZE, agentCount - first);
+		if (!XMVector4EqualInt(reached, zero))
+		{
+			uint32_t laneMask[AI_BATCH_SIZE];
+			XMStoreInt4(laneMask, reached);
+			for (unsigned int lane = 0; lane < lanes; ++lane)
+			{
+				if (laneMask[lane])
+					AdvanceRoute(first + lane);
+			}
+		}
+	}
+
+	timings.moveMs = Lap(phase);
+
+	if (avoidance)
+	{
+		AvoidAndMove(batches, deltaTimes, batchCount);
+		timings.avoidMs = Lap(phase);
+	}
+}
+
+// --------------------------------------------------------
+// Every agent is avoided where it stands with the velocity
+// it moved with, only the updated ones pick new velocities
+// --------------------------------------------------------
+void AISystem::AvoidAndMove(const unsigned int* batches, const float* deltaTimes, unsigned int batchCount)
+{
+	movingAgents.clear();
+	for (unsigned int b = 0; b < batchCount; ++b)
+	{
+		unsigned int last = (std::min)(batches[b] * AI_BATCH_SIZE + AI_BATCH_SIZE, agentCount);
+		for (unsigned int agent = batches[b] * AI_BATCH_SIZE; agent < last; ++agent)
+		{
+			movingAgents.push_back(agent);
+			agentDeltaTimes[agent] = deltaTimes[b];
+		}
+	}
+
+	avoidance->SetAgents(positionX.data(), positionY.data(), positionZ.data(), velocityX.data(), velocityZ.data(), agentCount);
+	avoidance->Solve(movingAgents.data(), (unsigned int)movingAgents.size(), preferredX.data(), preferredZ.data(), speed.data(),
+		agentDeltaTimes.data(), avoidX.data(), avoidZ.data());
+
+	for (unsigned int agent : movingAgents)
+	{
+		velocityX[agent] = avoidX[agent];
+		velocityZ[agent] = avoidZ[agent];
+		positionX[agent] += velocityX[agent] * agentDeltaTimes[agent];
+		positionZ[agent] += velocityZ[agent] * agentDeltaTimes[agent];
+	}
+}
+
+// --------------------------------------------------------
+// The target of the agent's new state, then the next
+// floor of the flow field or the first corner of the path
+// to it (from the service, else the hierarchy if there is
+// one), at the agent's own height so it moves at full
+// speed. Straight at the target when neither has a step.
+// Holding agents need no path
+// --------------------------------------------------------
+void AISystem::SteerAlongPaths(const XMFLOAT3& playerPosition, const unsigned int* batches, unsigned int batchCount)
+{
+	for (unsigned int b = 0; b < batchCount; ++b)
+	{
+		unsigned int last = (std::min)(batches[b] * AI_BATCH_SIZE + AI_BATCH_SIZE, agentCount);
+		for (unsigned int agent = batches[b] * AI_BATCH_SIZE; agent < last; ++agent)
+		{
+			XMFLOAT3 position = GetPosition(agent);
+			if (holding[agent])
+			{
+				steerX[agent] = position.x;
+				steerY[agent] = position.y;
+				steerZ[agent] = position.z;
+				continue;
+			}
+
+			bool attack = attacking[agent] != 0;
+			XMFLOAT3 target = attack ? playerPosition : XMFLOAT3(waypointX[agent], waypointY[agent], waypointZ[agent]);
+			XMFLOAT3 steer;
+			if (attack && flowField && flowField->GetSteerTarget(position, steer))
+				target = steer;
+			else if (pathService)
+			{
+				if (pathFollowers[agent].NextCorner(*pathService, position, target, AI_CORNER_REACHED_SQ, AI_WAYPOINT_REACHED_SQ, steer))
+					target = XMFLOAT3(steer.x, position.y, steer.z);
+			}
+			else
+			{
+				bool found = hierarchyQuery ? hierarchyQuery->FindPath(position, target, path) : navQuery && navQuery->FindPath(position, target, path);
+				if (found && path.size() > 2)
+					target = XMFLOAT3(path[1].x, position.y, path[1].z);
+			}
+
+			steerX[agent] = target.x;
+			steerY[agent] = target.y;
+			steerZ[agent] = target.z;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Sighting by squared distance and line of sight like
+// SimpleAI::UpdateState(), and the condition bits for four
+// lanes at once: lane masks have every bit set, so a mask
+// and a condition bit is the bit. A lane that stayed in
+// its state with the same conditions last update stays
+// again, the table is only looked up for batches whose
+// conditions changed
+// --------------------------------------------------------
+void AISystem::UpdateStates(const XMFLOAT3& playerPosition, float range, const unsigned int* batches, const float* deltaTimes, unsigned int batchCount)
+{
+	const unsigned char* next = stateMachine.GetTable();
+	const XMVECTOR seesBit = XMVectorReplicateInt(AI_CONDITION_SEES_PLAYER);
+	const XMVECTOR alertedBit = XMVectorReplicateInt(AI_CONDITION_ALERTED);
+	const XMVECTOR timedOutBit = XMVectorReplicateInt(AI_CONDITION_TIMED_OUT);
+	const XMVECTOR rangeSq = XMVectorReplicate(range * range);
+	const XMVECTOR playerX = XMVectorReplicate(playerPosition.x);
+	const XMVECTOR playerY = XMVectorReplicate(playerPosition.y);
+	const XMVECTOR playerZ = XMVectorReplicate(playerPosition.z);
+
+	for (unsigned int b = 0; b < batchCount; ++b)
+	{
+		unsigned int first = batches[b] * AI_BATCH_SIZE;
+		XMVECTOR toPlayerX = XMVectorSubtract(playerX, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&positionX[first])));
+		XMVECTOR toPlayerY = XMVectorSubtract(playerY, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&positionY[first])));
+		XMVECTOR toPlayerZ = XMVectorSubtract(playerZ, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&positionZ[first])));
+		XMVECTOR playerDistSq = XMVectorAdd(XMVectorAdd(XMVectorMultiply(toPlayerX, toPlayerX), XMVectorMultiply(toPlayerY, toPlayerY)), XMVectorMultiply(toPlayerZ, toPlayerZ));
+		XMVECTOR sees = XMVectorLess(playerDistSq, rangeSq);
+		if (occluders)
+			sees = XMVectorAndInt(sees, XMLoadInt4(&inSight[first]));
+		XMStoreInt4(&spotted[first], sees);
+
+		XMVECTOR time = XMVectorAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&stateTimes[first])), XMVectorReplicate(deltaTimes[b]));
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&stateTimes[first]), time);
+		XMVECTOR timedOut = XMVectorGreaterOrEqual(time, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&stateTimeouts[first])));
+		XMVECTOR conditions = XMVectorOrInt(XMVectorOrInt(XMVectorAndInt(sees, seesBit), XMVectorAndInt(XMLoadInt4(&alerted[first]), alertedBit)),
+			XMVectorAndInt(timedOut, timedOutBit));
+		XMVECTOR lastConditions = XMLoadInt4(&stateConditions[first]);
+		if (XMVector4EqualInt(conditions, lastConditions))
+			continue;
+		XMStoreInt4(&stateConditions[first], conditions);
+
+		uint32_t laneConditions[AI_BATCH_SIZE];
+		XMStoreInt4(laneConditions, conditions);
+
+		// padding lanes step too, with nothing recorded
+		unsigned int lanes = (std::min)((unsigned int)AI_BATCH_SIZE, agentCount - first);
+		for (unsigned int lane = 0; lane < AI_BATCH_SIZE; ++lane)
+		{
+			unsigned int agent = first + lane;
+			unsigned int state = states[agent];
+			unsigned int nextState = next[(state << AI_CONDITION_BITS) | laneConditions[lane]];
+			if (nextState == state)
+				continue;
+
+			states[agent] = (unsigned char)nextState;
+			EnterState(agent);
+			if (lane < lanes)
+				stateChanges.push_back(agent);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Alerts come from last update's sightings, so an alert
+// ends as soon as no agent sees the player anymore
+// --------------------------------------------------------
+void AISystem::AlertNeighbours()
+{
+	std::fill(alerted.begin(), alerted.end(), 0u);
+	if (alertRange <= 0.0f)
+		return;
+
+	agentHash.Build(positionX.data(), positionY.data(), positionZ.data(), agentCount);
+
+	for (unsigned int agent = 0; agent < agentCount; ++agent)
+	{
+		if (!spotted[agent])
+			continue;
+
+		agentHash.Query(GetPosition(agent), alertRange, neighbours);
+		for (unsigned int neighbour : neighbours)
+			alerted[neighbour] = 0xffffffff;
+	}
+}
+
+// --------------------------------------------------------
+// Same range test as the batch, then one segment from each
+// agent in range to the player, all traced in packets
+// --------------------------------------------------------
+void AISystem::TestLineOfSight(const XMFLOAT3& playerPosition, float range, const unsigned int* batches, unsigned int batchCount)
+{
+	sightFrom.clear();
+	sightTo.clear();
+	sightAgents.clear();
+	for (unsigned int b = 0; b < batchCount; ++b)
+	{
+		unsigned int last = (std::min)(batches[b] * AI_BATCH_SIZE + AI_BATCH_SIZE, agentCount);
+		for (unsigned int agent = batches[b] * AI_BATCH_SIZE; agent < last; ++agent)
+		{
+			inSight[agent] = 0;
+			float toPlayerX = playerPosition.x - positionX[agent];
+			float toPlayerY = playerPosition.y - positionY[agent];
+			float toPlayerZ = playerPosition.z - positionZ[agent];
+			if (toPlayerX * toPlayerX + toPlayerY * toPlayerY + toPlayerZ * toPlayerZ >= range * range)
+				continue;
+
+			sightFrom.push_back(XMFLOAT3(positionX[agent], positionY[agent] + AI_EYE_HEIGHT, positionZ[agent]));
+			sightTo.push_back(playerPosition);
+			sightAgents.push_back(agent);
+		}
+	}
+
+	sightBlocked.resize(sightAgents.size());
+	occluders->SegmentsOccluded(sightFrom.data(), sightTo.data(), (unsigned int)sightAgents.size(), sightBlocked.data());
+	for (size_t i = 0; i < sightAgents.size(); ++i)
+		inSight[sightAgents[i]] = sightBlocked[i] ? 0 : 0xffffffff;
+}
+
+void AISystem::GetBatchDistances(const XMFLOAT3& point, std::vector<float>& distances) const
+{
+	distances.resize(GetBatchCount());
+	for (unsigned int batch = 0; batch < distances.size(); ++batch)
+	{
+		float closestSq = FLT_MAX;
+		for (unsigned int agent = batch * AI_BATCH_SIZE; agent < (std::min)(batch * AI_BATCH_SIZE + AI_BATCH_SIZE, agentCount); ++agent)
+		{
+			float x = positionX[agent] - point.x;
+			float y = positionY[agent] - point.y;
+			float z = positionZ[agent] - point.z;
+			closestSq = (std::min)(closestSq, x * x + y * y + z * z);
+		}
+		distances[batch] = sqrtf(closestSq);
+	}
+}
+
+// Same wrap as SimpleAI::ExecutePatrolPath(), the last point goes back to the first
+void AISystem::AdvanceRoute(unsigned int agent)
+{
+	unsigned int count = routeCount[route[agent]];
+	activeRoute[agent] = activeRoute[agent] + 1 >= count ? 0 : activeRoute[agent] + 1;
+
+	const XMFLOAT3& waypoint = routePoints[routeFirst[route[agent]] + activeRoute[agent]];
+	waypointX[agent] = waypoint.x;
+	waypointY[agent] = waypoint.y;
+	waypointZ[agent] = waypoint.z;
+}
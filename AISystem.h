@@ -0,0 +1,232 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "SimpleAI.h"
+#include "AgentSpatialHash.h"
+#include "AIStateMachine.h"
+#include "PathRequestService.h"
+
+// How far an agent that sees the player calls the others, with SetAlertRange()
+#define AI_ALERT_RANGE 8.0f
+
+// Agents per batch, one XMVECTOR lane each. Batch b is agents AI_BATCH_SIZE * b to AI_BATCH_SIZE * b + AI_BATCH_SIZE - 1.
+// Fixed: the batch is loaded and stored as a single XMVECTOR, this names the width rather than choosing it
+#define AI_BATCH_SIZE 4
+static_assert(AI_BATCH_SIZE == 4, "one XMVECTOR of agents");
+
+class NavMesh;
+class NavMeshQuery;
+class NavHierarchy;
+class NavHierarchyQuery;
+class FlowField;
+class TriangleBVH;
+class CrowdAvoidance;
+struct CrowdAvoidanceSettings;
+
+// Where the last Update() spent its time, in ms
+struct AISystemTimings
+{
+	double alertMs = 0.0;	// agent hash and alert calls
+	double sightMs = 0.0;	// line of sight packets
+	double stateMs = 0.0;	// sightings and the state machine
+	double steerMs = 0.0;	// paths and flow field steps
+	double moveMs = 0.0;	// the batched movement
+	double avoidMs = 0.0;	// crowd avoidance and its moves
+};
+
+/**
+ * Every ghost's SimpleAI logic in one place, for many agents at once.
+ *
+ * Agents live in SoA arrays (position, yaw, speed, attack mask, route
+ * and the waypoint they walk to) padded to a multiple of four, and
+ * Update() runs the distance tests, the state transitions and the
+ * movement four agents per step with DirectXMath vectors. Routes are
+ * point lists shared by any number of agents. The behaviour matches
+ * SimpleAI::Update(): same sight ranges, same waypoint test, movement in
+ * XZ along the normalized 3D direction, the same spin while moving.
+ *
+ * Transitions come from an AIStateMachine, SimpleAI's patrol and attack
+ * unless SetStateMachine() gives another: every agent's conditions are
+ * looked up in its compiled table, and its new state's behaviour sets
+ * the lane masks the movement selects with. Agents holding don't move.
+ *
+ * Nothing here knows about entities, the caller copies positions back to
+ * transforms and reacts to GetStateChanges() (e.g. the ghost tints).
+ *
+ * With a navmesh every agent first looks for a path to its target and
+ * walks toward the path's first corner instead of straight at the target,
+ * one A* query per agent and update. Attacking agents take their next
+ * step from the player's flow field instead when there is one. With a
+ * NavHierarchy of the same navmesh the paths come from it instead, long
+ * paths across many rooms only cost a search over the rooms' portals.
+ * With a PathRequestService the searches leave the update altogether:
+ * every agent keeps one path and one ticket out at a time, walks the
+ * corners of the path it has and only asks again once its target is off
+ * that path's end, with the same PathFollower as SimpleAI.
+ *
+ * With occluders, agents in range only see the player if nothing is in
+ * the way. Their eye to player segments are traced in packets of four
+ * agents, neighbouring agents of a batch look along nearly the same line.
+ *
+ * With an alert range, agents that saw the player last update call every
+ * agent in range to attack along with them. Every Update() then rebuilds
+ * a spatial hash of the agents for the neighbour queries.
+ *
+ * With avoidance, the velocity the batch wants for every updated agent
+ * goes through a CrowdAvoidance pass against all the agents before it's
+ * applied, so ghosts on the same route or chasing the player together
+ * walk around each other instead of through. Agents left out of an
+ * update are avoided with the velocity they last moved with.
+ */
+class AISystem
+{
+public:
+	AISystem() = default;
+	~AISystem();
+
+	void Clear();
+
+	// Agents walk around walls along its paths, null goes back to straight lines
+	void SetNavMesh(const NavMesh* navMesh);
+
+	// Paths through rooms and portals instead of over every floor of the navmesh, null for flat A*
+	void SetNavHierarchy(const NavHierarchy* hierarchy);
+
+	// Paths come from the service a frame or more after asking instead of searching in Update(). Its Update() is the
+	// caller's, once per frame before this one's. Null cancels every ticket out and searches inline again
+	void SetPathService(PathRequestService* service);
+
+	// Field toward the player for the attacking agents, kept up to date by the caller. Null to search paths for them too
+	inline void SetFlowField(const FlowField* field) { flowField = field; }
+
+	// The player is only seen if no triangle is in the way, null sees through everything
+	inline void SetOccluders(const TriangleBVH* bvh) { occluders = bvh; }
+
+	// Agents that spot the player alert the others this close, 0 (the default) turns alerts off
+	inline void SetAlertRange(float range) { alertRange = range; }
+
+	// Agents steer clear of each other with these settings, null (the default) lets them overlap
+	void SetAvoidance(const CrowdAvoidanceSettings* settings);
+
+	// Compiled. Every agent starts over in the machine's state 0. AIStateMachine::MakeDefault() until set
+	void SetStateMachine(const AIStateMachine& machine);
+	inline const AIStateMachine& GetStateMachine() const { return stateMachine; }
+
+	// Returns the route's index for AddAgent()
+	unsigned int AddRoute(const DirectX::XMFLOAT3* points, unsigned int pointCount);
+
+	// Returns the agent's index. Agents start in the state machine's state 0, patrols walk toward the route's first point
+	unsigned int AddAgent(const DirectX::XMFLOAT3& position, unsigned int route, float speed = AI_GHOST_SPEED);
+
+	// playerVisibility goes from 0 in the dark to 1 fully lit, like SimpleAI::Update()
+	void Update(const DirectX::XMFLOAT3& playerPosition, float playerVisibility, float deltaTime);
+
+	// Same as Update() for some batches of AI_BATCH_SIZE agents only, each with its own time step
+	void UpdateBatches(const DirectX::XMFLOAT3& playerPosition, float playerVisibility, const unsigned int* batches, const float* deltaTimes, unsigned int batchCount);
+
+	// Distance from the point to each batch's closest agent, for an AIScheduler
+	void GetBatchDistances(const DirectX::XMFLOAT3& point, std::vector<float>& distances) const;
+
+	// Agents that changed state in the last Update(), in agent order
+	inline const std::vector<unsigned int>& GetStateChanges() const { return stateChanges; }
+
+	inline const AISystemTimings& GetTimings() const { return timings; }
+
+	inline unsigned int GetAgentCount() const { return agentCount; }
+	inline unsigned int GetBatchCount() const { return (agentCount + AI_BATCH_SIZE - 1) / AI_BATCH_SIZE; }
+	inline unsigned int GetBatch(unsigned int agent) const { return agent / AI_BATCH_SIZE; }
+	inline DirectX::XMFLOAT3 GetPosition(unsigned int agent) const { return DirectX::XMFLOAT3(positionX[agent], positionY[agent], positionZ[agent]); }
+	inline float GetYaw(unsigned int agent) const { return yaw[agent]; }
+	inline DirectX::XMFLOAT2 GetVelocity(unsigned int agent) const { return DirectX::XMFLOAT2(velocityX[agent], velocityZ[agent]); }	// XZ, with avoidance only
+	inline AI_State GetState(unsigned int agent) const { return attacking[agent] ? AI_State::ATTACK_PLAYER : holding[agent] ? AI_State::DEFAULT : AI_State::PATROL_PATH; }	// by behaviour
+	inline unsigned int GetMachineState(unsigned int agent) const { return states[agent]; }
+	inline float GetStateTime(unsigned int agent) const { return stateTimes[agent]; }
+	inline unsigned int GetActiveRoute(unsigned int agent) const { return activeRoute[agent]; }
+
+	// Agents closer than radius to the point, where they stood at the start of the last Update(). Needs alerts on
+	inline void GetNeighbours(const DirectX::XMFLOAT3& point, float radius, std::vector<unsigned int>& result) const { agentHash.Query(point, radius, result); }
+
+	void SetPosition(unsigned int agent, const DirectX::XMFLOAT3& position);
+	inline void SetYaw(unsigned int agent, float agentYaw) { yaw[agent] = agentYaw; }
+
+private:
+	void AdvanceRoute(unsigned int agent);
+	void EnterState(unsigned int agent);
+
+	// Sets alerted for every agent near one that spotted the player
+	void AlertNeighbours();
+
+	// Sets spotted, steps the batches' agents through the state machine and sets the behaviour masks
+	void UpdateStates(const DirectX::XMFLOAT3& playerPosition, float range, const unsigned int* batches, const float* deltaTimes, unsigned int batchCount);
+
+	// Sets inSight for the batches' agents in range that nothing hides the player from
+	void TestLineOfSight(const DirectX::XMFLOAT3& playerPosition, float range, const unsigned int* batches, unsigned int batchCount);
+
+	// Fills the steer arrays with the first path corner toward each agent's target
+	void SteerAlongPaths(const DirectX::XMFLOAT3& playerPosition, const unsigned int* batches, unsigned int batchCount);
+
+
+	// Turns the batches' preferred velocities into avoiding ones and moves the agents with them
+	void AvoidAndMove(const unsigned int* batches, const float* deltaTimes, unsigned int batchCount);
+
+	unsigned int agentCount = 0;
+
+	// per agent, padded to a multiple of four with agents that never move
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> waypointX, waypointY, waypointZ;	// the route point being walked to
+	std::vector<float> yaw;
+	std::vector<float> speed;
+	std::vector<unsigned char> states;	// in the state machine
+	std::vector<float> stateTimes;	// seconds since the agent entered its state
+	std::vector<float> stateTimeouts;	// of the state, FLT_MAX without one
+	std::vector<unsigned int> stateConditions;	// AI_CONDITION_ bits as of the last lookup
+	std::vector<unsigned int> attacking;	// all bits set while the state chases, a lane mask
+	std::vector<unsigned int> holding;	// lane mask, the state holds
+	std::vector<unsigned int> spotted;	// lane mask, saw the player themselves
+	std::vector<unsigned int> alerted;	// lane mask, called by an agent that saw the player
+	std::vector<unsigned int> inSight;	// lane mask, nothing between the agent's eye and the player
+	std::vector<unsigned int> route;
+	std::vector<unsigned int> activeRoute;	// point index within the route
+
+	// route points, first point and count per route
+	std::vector<DirectX::XMFLOAT3> routePoints;
+	std::vector<unsigned int> routeFirst;
+	std::vector<unsigned int> routeCount;
+
+	AIStateMachine stateMachine = AIStateMachine::MakeDefault();
+	std::vector<unsigned int> stateChanges;
+	AISystemTimings timings;
+
+	AgentSpatialHash agentHash;
+	float alertRange = 0.0f;
+	std::vector<unsigned int> neighbours;
+
+	const TriangleBVH* occluders = nullptr;
+	std::vector<DirectX::XMFLOAT3> sightFrom, sightTo;
+	std::vector<unsigned int> sightAgents;
+	std::vector<unsigned char> sightBlocked;
+
+	// preferred velocities in, avoiding velocities out, for the agents of the updated batches
+	CrowdAvoidance* avoidance = nullptr;
+	std::vector<float> velocityX, velocityZ;	// per agent, what it moved with last
+	std::vector<float> preferredX, preferredZ;
+	std::vector<float> avoidX, avoidZ;
+	std::vector<float> agentDeltaTimes;
+	std::vector<unsigned int> movingAgents;
+
+	// every batch with the same step, for Update()
+	std::vector<unsigned int> allBatches;
+	std::vector<float> allDeltaTimes;
+
+	// where agents walk to this update when there's a navmesh
+	NavMeshQuery* navQuery = nullptr;
+	NavHierarchyQuery* hierarchyQuery = nullptr;
+	const FlowField* flowField = nullptr;
+	std::vector<float> steerX, steerY, steerZ;
+	std::vector<DirectX::XMFLOAT3> path;
+
+	// per agent with a service
+	PathRequestService* pathService = nullptr;
+	std::vector<PathFollower> pathFollowers;
+};
@@ -0,0 +1,117 @@
+#include "AgentSpatialHash.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace DirectX;
+
+AgentSpatialHash::AgentSpatialHash(float cellSize)
+	: cellSize(cellSize), inverseCellSize(1.0f / cellSize)
+{
+}
+
+// --------------------------------------------------------
+// Counting sort by bucket: count, prefix sum, then scatter
+// the agents and their positions into bucket order
+// --------------------------------------------------------
+void AgentSpatialHash::Build(const float* x, const float* y, const float* z, unsigned int agentCount)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// about a bucket per agent
+	cellsPerAxis = AGENT_HASH_MIN_CELLS_PER_AXIS;
+	while (cellsPerAxis * cellsPerAxis < agentCount)
+		cellsPerAxis *= 2;
+	cellMask = cellsPerAxis - 1;
+
+	bucketStarts.assign(cellsPerAxis * cellsPerAxis + 1, 0);
+	agentBuckets.resize(agentCount);
+	for (unsigned int i = 0; i < agentCount; ++i)
+	{
+		unsigned int cellX = (unsigned int)(int)floorf(x[i] * inverseCellSize) & cellMask;
+		unsigned int cellZ = (unsigned int)(int)floorf(z[i] * inverseCellSize) & cellMask;
+		agentBuckets[i] = cellZ * cellsPerAxis + cellX;
+		bucketStarts[agentBuckets[i] + 1]++;
+	}
+
+	for (unsigned int bucket = 0; bucket + 1 < bucketStarts.size(); ++bucket)
+		bucketStarts[bucket + 1] += bucketStarts[bucket];
+
+	sortedAgents.resize(agentCount);
+	sortedPositions.resize(agentCount);
+	std::vector<unsigned int> fill(bucketStarts.begin(), bucketStarts.end() - 1);
+	for (unsigned int i = 0; i < agentCount; ++i)
+	{
+		unsigned int slot = fill[agentBuckets[i]]++;
+		sortedAgents[slot] = i;
+		sortedPositions[slot] = XMFLOAT3(x[i], y[i], z[i]);
+	}
+
+	buildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void AgentSpatialHash::Query(const XMFLOAT3& point, float radius, std::vector<unsigned int>& result) const
+{
+	result.clear();
+
+	float radiusSq = radius * radius;
+	VisitBuckets(point, radius, [&](unsigned int first, unsigned int last)
+	{
+		for (unsigned int i = first; i < last; ++i)
+		{
+			const XMFLOAT3& position = sortedPositions[i];
+			float dx = position.x - point.x;
+			float dy = position.y - point.y;
+			float dz = position.z - point.z;
+			if (dx * dx + dy * dy + dz * dz < radiusSq)
+				result.push_back(sortedAgents[i]);
+		}
+	});
+}
+
+unsigned int AgentSpatialHash::Count(const XMFLOAT3& point, float radius) const
+{
+	unsigned int count = 0;
+	float radiusSq = radius * radius;
+	VisitBuckets(point, radius, [&](unsigned int first, unsigned int last)
+	{
+		for (unsigned int i = first; i < last; ++i)
+		{
+			const XMFLOAT3& position = sortedPositions[i];
+			float dx = position.x - point.x;
+			float dy = position.y - point.y;
+			float dz = position.z - point.z;
+			count += dx * dx + dy * dy + dz * dz < radiusSq;
+		}
+	});
+	return count;
+}
+
+// --------------------------------------------------------
+// Every cell the radius' square touches, row by row. A row
+// is one run of buckets unless it wraps around the table,
+// and a square wider than the table visits each bucket once
+// --------------------------------------------------------
+template<typename Visit>
+void AgentSpatialHash::VisitBuckets(const XMFLOAT3& point, float radius, Visit visit) const
+{
+	if (sortedAgents.empty())
+		return;
+
+	int minX = (int)floorf((point.x - radius) * inverseCellSize);
+	int maxX = (int)floorf((point.x + radius) * inverseCellSize);
+	int minZ = (int)floorf((point.z - radius) * inverseCellSize);
+	int maxZ = (int)floorf((point.z + radius) * inverseCellSize);
+	unsigned int columns = (std::min)((unsigned int)(maxX - minX + 1), cellsPerAxis);
+	unsigned int rows = (std::min)((unsigned int)(maxZ - minZ + 1), cellsPerAxis);
+
+	unsigned int firstColumn = (unsigned int)minX & cellMask;
+	unsigned int wrapped = firstColumn + columns > cellsPerAxis ? firstColumn + columns - cellsPerAxis : 0;
+	for (unsigned int row = 0; row < rows; ++row)
+	{
+		unsigned int rowStart = (((unsigned int)minZ + row) & cellMask) * cellsPerAxis;
+		visit(bucketStarts[rowStart + firstColumn], bucketStarts[rowStart + firstColumn + columns - wrapped]);
+		if (wrapped)
+			visit(bucketStarts[rowStart], bucketStarts[rowStart + wrapped]);
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// Default edge length of a cell, about the range agents look around them
+#define AGENT_HASH_CELL_SIZE 4.0f
+
+// Fewest cells per axis of the table, it grows with the agent count
+#define AGENT_HASH_MIN_CELLS_PER_AXIS 16
+
+/**
+ * Agents bucketed by the XZ cell they stand in, for "who is near this
+ * point" queries without testing every agent.
+ *
+ * Space is unbounded: cell (x, z) goes to bucket (x mod n, z mod n) of an
+ * n by n table, n a power of two sized to the agent count, so cells closer
+ * than n apart never share a bucket and a row of cells is a row of
+ * buckets. Build() sorts the agents by bucket with a counting sort, every
+ * bucket's agents and their positions are then contiguous. Meant to be
+ * rebuilt whenever the agents move, e.g. once per frame.
+ *
+ * Queries test the real 3D distance, agents of other cells aliased into
+ * the same bucket are simply missed by that test.
+ */
+class AgentSpatialHash
+{
+public:
+	AgentSpatialHash(float cellSize = AGENT_HASH_CELL_SIZE);
+	~AgentSpatialHash() = default;
+
+	// Positions as separate x, y, z arrays (e.g. AISystem's), agent i at x[i], y[i], z[i]
+	void Build(const float* x, const float* y, const float* z, unsigned int agentCount);
+
+	// Clears the result and fills it with every agent closer than radius to the point, in bucket order
+	void Query(const DirectX::XMFLOAT3& point, float radius, std::vector<unsigned int>& result) const;
+
+	// Same test as Query(), only the number of agents found
+	unsigned int Count(const DirectX::XMFLOAT3& point, float radius) const;
+
+	inline unsigned int GetAgentCount() const { return (unsigned int)sortedAgents.size(); }
+	inline unsigned int GetCellsPerAxis() const { return cellsPerAxis; }
+	inline float GetCellSize() const { return cellSize; }
+	inline double GetBuildMs() const { return buildMs; }
+
+private:
+	// Calls visit(first, last) for every run of sorted agents the query's cells cover
+	template<typename Visit>
+	void VisitBuckets(const DirectX::XMFLOAT3& point, float radius, Visit visit) const;
+
+	float cellSize;
+	float inverseCellSize;
+	unsigned int cellsPerAxis = 0;	// power of two
+	unsigned int cellMask = 0;
+
+	// Agents of bucket b are sortedAgents[bucketStarts[b] .. bucketStarts[b + 1]), positions alongside
+	std::vector<unsigned int> bucketStarts;
+	std::vector<unsigned int> sortedAgents;
+	std::vector<DirectX::XMFLOAT3> sortedPositions;
+
+	// per agent, kept between builds
+	std::vector<unsigned int> agentBuckets;
+
+	double buildMs = 0;
+};
@@ -0,0 +1,174 @@
+#include "BenchmarkUtils.h"
+#include "ObjLoader.h"
+#include "Transform.h"
+#include "Vertex.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace Benchmarks
+{
+	void AddBenchmarkQuad(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, DirectX::XMFLOAT3 corner, DirectX::XMFLOAT3 edgeU, DirectX::XMFLOAT3 edgeV, unsigned int stepsU, unsigned int stepsV)
+	{
+		using namespace DirectX;
+
+		XMVECTOR normal = XMVector3Normalize(XMVector3Cross(XMLoadFloat3(&edgeU), XMLoadFloat3(&edgeV)));
+		auto point = [&](unsigned int u, unsigned int v)
+		{
+			Vertex vertex = {};
+			vertex.Position = XMFLOAT3(
+				corner.x + edgeU.x * u / stepsU + edgeV.x * v / stepsV,
+				corner.y + edgeU.y * u / stepsU + edgeV.y * v / stepsV,
+				corner.z + edgeU.z * u / stepsU + edgeV.z * v / stepsV);
+			XMStoreFloat3(&vertex.Normal, normal);
+			return vertex;
+		};
+
+		for (unsigned int v = 0; v < stepsV; ++v)
+		{
+			for (unsigned int u = 0; u < stepsU; ++u)
+			{
+				Vertex quad[6] = { point(u, v), point(u + 1, v), point(u + 1, v + 1), point(u, v), point(u + 1, v + 1), point(u, v + 1) };
+				for (const Vertex& vertex : quad)
+				{
+					indices.push_back((unsigned int)vertices.size());
+					vertices.push_back(vertex);
+				}
+			}
+		}
+	}
+
+	float BruteForceRayDistance(const std::vector<DirectX::XMFLOAT3>& corners, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction)
+	{
+		using namespace DirectX;
+
+		float closest = FLT_MAX;
+		XMVECTOR o = XMLoadFloat3(&origin);
+		XMVECTOR d = XMLoadFloat3(&direction);
+		for (size_t i = 0; i + 2 < corners.size(); i += 3)
+		{
+			XMVECTOR v0 = XMLoadFloat3(&corners[i]);
+			XMVECTOR e1 = XMLoadFloat3(&corners[i + 1]) - v0;
+			XMVECTOR e2 = XMLoadFloat3(&corners[i + 2]) - v0;
+			XMVECTOR p = XMVector3Cross(d, e2);
+			float determinant = XMVectorGetX(XMVector3Dot(e1, p));
+			if (fabsf(determinant) < 1e-12f)
+				continue;
+
+			XMVECTOR t = o - v0;
+			float u = XMVectorGetX(XMVector3Dot(t, p)) / determinant;
+			XMVECTOR q = XMVector3Cross(t, e1);
+			float v = XMVectorGetX(XMVector3Dot(d, q)) / determinant;
+			float distance = XMVectorGetX(XMVector3Dot(e2, q)) / determinant;
+			if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && distance > 0.0f)
+				closest = (std::min)(closest, distance);
+		}
+		return closest;
+	}
+
+	bool LoadShippedLevel(std::vector<DirectX::XMFLOAT3>& corners)
+	{
+		using namespace DirectX;
+
+		struct Piece
+		{
+			const char* model;
+			XMFLOAT3 position;
+			float yaw;
+		};
+		const Piece pieces[] =
+		{
+			{ "Models/Rooms/BeginRoom.obj", XMFLOAT3(0, 0, 0), 0 },
+			{ "Models/Rooms/MainRoom.obj", XMFLOAT3(0, 0, -10), 0 },
+			{ "Models/RoomAssets/Arch.obj", XMFLOAT3(0, 0, -24), 35.5f },
+			{ "Models/RoomAssets/Doorway.obj", XMFLOAT3(8, .5f, -27), 0 },
+			{ "Models/RoomAssets/Prism.obj", XMFLOAT3(-9, .5f, -22), 0 },
+			{ "Models/RoomAssets/Pipe.obj", XMFLOAT3(-6, .5f, -34), 0 },
+		};
+		const char* assetFolders[] = { "Assets/", "../../Assets/" };
+
+		corners.clear();
+		for (const Piece& piece : pieces)
+		{
+			std::vector<Vertex> vertices;
+			std::vector<unsigned int> indices;
+			bool loaded = false;
+			for (const char* folder : assetFolders)
+			{
+				if ((loaded = LoadObj((std::string(folder) + piece.model).c_str(), vertices, indices)))
+					break;
+			}
+			if (!loaded)
+				return false;
+
+			Transform transform;
+			transform.SetPosition(piece.position.x, piece.position.y, piece.position.z);
+			transform.SetRotation(0, piece.yaw, 0);
+			XMFLOAT4X4 worldMatrix = transform.GetWorldMatrix();
+			XMMATRIX world = XMLoadFloat4x4(&worldMatrix);
+			for (unsigned int index : indices)
+			{
+				XMFLOAT3 corner;
+				XMStoreFloat3(&corner, XMVector3TransformCoord(XMLoadFloat3(&vertices[index].Position), world));
+				corners.push_back(corner);
+			}
+		}
+		return true;
+	}
+
+	void AddBenchmarkBox(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, DirectX::XMFLOAT3 boxMin, DirectX::XMFLOAT3 boxMax)
+	{
+		using namespace DirectX;
+
+		XMFLOAT3 size(boxMax.x - boxMin.x, boxMax.y - boxMin.y, boxMax.z - boxMin.z);
+		AddBenchmarkQuad(vertices, indices, boxMin, XMFLOAT3(size.x, 0, 0), XMFLOAT3(0, size.y, 0), 1, 1);
+		AddBenchmarkQuad(vertices, indices, XMFLOAT3(boxMin.x, boxMin.y, boxMax.z), XMFLOAT3(0, size.y, 0), XMFLOAT3(size.x, 0, 0), 1, 1);
+		AddBenchmarkQuad(vertices, indices, boxMin, XMFLOAT3(0, size.y, 0), XMFLOAT3(0, 0, size.z), 1, 1);
+		AddBenchmarkQuad(vertices, indices, XMFLOAT3(boxMax.x, boxMin.y, boxMin.z), XMFLOAT3(0, 0, size.z), XMFLOAT3(0, size.y, 0), 1, 1);
+		AddBenchmarkQuad(vertices, indices, XMFLOAT3(boxMin.x, boxMax.y, boxMin.z), XMFLOAT3(0, 0, size.z), XMFLOAT3(size.x, 0, 0), 1, 1);
+	}
+
+	void MakeBenchmarkLevel(unsigned int roomsPerSide, float roomSize, std::vector<DirectX::XMFLOAT3>& corners)
+	{
+		using namespace DirectX;
+
+		const float wallHeight = 3.0f;
+		const float wallHalfThickness = 0.1f;
+		const float doorWidth = 2.0f;
+		float levelSize = roomsPerSide * roomSize;
+		unsigned int seed = 777;
+
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		AddBenchmarkQuad(vertices, indices, XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, levelSize), XMFLOAT3(levelSize, 0, 0), roomsPerSide, roomsPerSide);
+
+		// line i runs along z at x = i * roomSize (alongZ), or along x at z = i * roomSize
+		for (int alongZ = 0; alongZ < 2; ++alongZ)
+		{
+			for (unsigned int line = 0; line <= roomsPerSide; ++line)
+			{
+				float across = line * roomSize;
+				for (unsigned int room = 0; room < roomsPerSide; ++room)
+				{
+					float from = room * roomSize, to = from + roomSize;
+					bool outer = line == 0 || line == roomsPerSide;
+					float door = from + 1.0f + RandomFloat(seed) * (roomSize - 2.0f - doorWidth);
+					float pieces[2][2] = { { from, outer ? to : door }, { door + doorWidth, to } };
+					for (int p = 0; p < (outer ? 1 : 2); ++p)
+					{
+						if (alongZ)
+							AddBenchmarkBox(vertices, indices, XMFLOAT3(across - wallHalfThickness, 0, pieces[p][0]), XMFLOAT3(across + wallHalfThickness, wallHeight, pieces[p][1]));
+						else
+							AddBenchmarkBox(vertices, indices, XMFLOAT3(pieces[p][0], 0, across - wallHalfThickness), XMFLOAT3(pieces[p][1], wallHeight, across + wallHalfThickness));
+					}
+				}
+			}
+		}
+
+		corners.clear();
+		for (unsigned int index : indices)
+			corners.push_back(vertices[index].Position);
+	}
+}
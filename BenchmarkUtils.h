@@ -0,0 +1,101 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "Vertex.h"
+
+/**
+ * What the benchmark files share: timing, checks, deterministic random
+ * numbers and the levels several subsystems are measured in. Each
+ * Benchmarks<Subsystem>.cpp holds the runs of one subsystem, all of them
+ * registered by name in Benchmarks.cpp.
+ */
+namespace Benchmarks
+{
+	// Wall clock milliseconds since construction
+	class BenchmarkTimer
+	{
+	public:
+		BenchmarkTimer() : start(std::chrono::high_resolution_clock::now()) {}
+
+		double ElapsedMs() const
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+
+	private:
+		std::chrono::high_resolution_clock::time_point start;
+	};
+
+	inline unsigned int WorkerCount()
+	{
+		unsigned int workers = std::thread::hardware_concurrency();
+		return workers == 0 ? 1 : workers;
+	}
+
+	inline bool Check(bool condition, const char* message)
+	{
+		if (!condition)
+			printf("    FAILED: %s\n", message);
+		return condition;
+	}
+
+	// Deterministic [0, 1) so runs are comparable
+	inline float RandomFloat(unsigned int& seed)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (float)(seed >> 8) / 16777216.0f;
+	}
+
+	// Quad split into a grid, every triangle with its own vertices like the OBJ loader makes them
+	void AddBenchmarkQuad(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, DirectX::XMFLOAT3 corner, DirectX::XMFLOAT3 edgeU, DirectX::XMFLOAT3 edgeV, unsigned int stepsU, unsigned int stepsV);
+
+	// Side faces and top of a box
+	void AddBenchmarkBox(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, DirectX::XMFLOAT3 boxMin, DirectX::XMFLOAT3 boxMax);
+
+	// roomsPerSide^2 square rooms on one floor, 3 m walls with a 2 m doorway at a random spot of every wall between two rooms
+	void MakeBenchmarkLevel(unsigned int roomsPerSide, float roomSize, std::vector<DirectX::XMFLOAT3>& corners);
+
+	// The room pieces where Game::BeginPlay() puts them, three corners per triangle.
+	// False if the models aren't found from the working directory
+	bool LoadShippedLevel(std::vector<DirectX::XMFLOAT3>& corners);
+
+	// Closest hit over every triangle, for checking the BVH
+	float BruteForceRayDistance(const std::vector<DirectX::XMFLOAT3>& corners, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction);
+
+	// BenchmarksRender.cpp
+	bool RunSubmissionBenchmark();
+	bool RunRenderGraphBenchmark();
+	bool RunOcclusionBenchmark();
+
+	// BenchmarksLighting.cpp
+	bool RunClusterBenchmark();
+	bool RunObjectLightBenchmark();
+	bool RunLightIndexBenchmark();
+	bool RunExposureBenchmark();
+	bool RunLightUploadBenchmark();
+	bool RunLightmapBenchmark();
+	bool RunProbeBenchmark();
+	bool RunInfluenceBenchmark();
+
+	// BenchmarksAI.cpp
+	bool RunAISystemBenchmark();
+	bool RunStateMachineBenchmark();
+	bool RunAgentHashBenchmark();
+	bool RunAISchedulerBenchmark();
+	bool RunLineOfSightBenchmark();
+	bool RunCrowdBenchmark();
+
+	// BenchmarksNavigation.cpp
+	bool RunNavMeshBenchmark();
+	bool RunNavHierarchyBenchmark();
+	bool RunFlowFieldBenchmark();
+	bool RunPathServiceBenchmark();
+
+	// BenchmarksInput.cpp
+	bool RunInputBenchmark();
+	bool RunInputThreadBenchmark();
+}
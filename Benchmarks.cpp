@@ -0,0 +1,84 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtils.h"
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using namespace Benchmarks;
+
+	typedef bool (*BenchmarkFunction)();
+
+	struct Benchmark
+	{
+		const char* name;
+		const char* description;
+		BenchmarkFunction run;
+	};
+
+	const Benchmark benchmarks[] =
+	{
+		{ "submission", "Opaque draw list submission through the headless backend", RunSubmissionBenchmark },
+		{ "rendergraph", "Frame graph culling, ordering, aliasing and validation without a device", RunRenderGraphBenchmark },
+		{ "occlusion", "Software depth rasterization and HiZ box tests", RunOcclusionBenchmark },
+		{ "clusters", "Clustered point/spot light assignment", RunClusterBenchmark },
+		{ "objectlights", "Per object top lights selection", RunObjectLightBenchmark },
+		{ "lightindex", "Point queries against a light grid", RunLightIndexBenchmark },
+		{ "exposure", "Stealth light exposure at many points", RunExposureBenchmark },
+		{ "lightupload", "Dirty light range uploads", RunLightUploadBenchmark },
+		{ "lightmap", "Static lightmap bake and BVH rays", RunLightmapBenchmark },
+		{ "probes", "Irradiance probe bake and lookups", RunProbeBenchmark },
+		{ "aisystem", "Batched ghost AI against per ghost SimpleAI updates", RunAISystemBenchmark },
+		{ "statemachine", "Compiled state machine tables against a virtual Update subclass per behaviour", RunStateMachineBenchmark },
+		{ "navmesh", "Navmesh build and A* path queries", RunNavMeshBenchmark },
+		{ "flowfield", "Flow field chasers against per agent A*", RunFlowFieldBenchmark },
+		{ "agenthash", "Agent spatial hash rebuilds and neighbour queries", RunAgentHashBenchmark },
+		{ "aischeduler", "AI level of detail scheduling against updating every ghost", RunAISchedulerBenchmark },
+		{ "lineofsight", "Line of sight segments against the room BVH, single and in packets", RunLineOfSightBenchmark },
+		{ "crowd", "ORCA crowd avoidance steps for crossing ghost flows", RunCrowdBenchmark },
+		{ "hpa", "Room/portal hierarchical paths against flat A* on a large level", RunNavHierarchyBenchmark },
+		{ "pathservice", "Threaded, cached path requests for patrolling ghosts", RunPathServiceBenchmark },
+		{ "influence", "Light exposure map bake, moving light updates and samples against light queries", RunInfluenceBenchmark },
+		{ "input", "Compiled chord masks against per binding key state checks", RunInputBenchmark },
+		{ "inputthread", "Input thread event queue throughput and event to frame latency", RunInputThreadBenchmark },
+	};
+}
+
+int Benchmarks::Run(const char* arguments)
+{
+	std::vector<std::string> selected;
+	std::istringstream stream(arguments ? arguments : "");
+	std::string name;
+	while (stream >> name)
+		selected.push_back(name);
+
+	int exitCode = 0;
+	size_t matched = 0;
+	for (const Benchmark& benchmark : benchmarks)
+	{
+		bool run = selected.empty();
+		for (const std::string& s : selected)
+			run |= s == benchmark.name;
+		if (!run)
+			continue;
+
+		matched++;
+		printf("[%s] %s\n", benchmark.name, benchmark.description);
+		bool passed = benchmark.run();
+		printf("[%s] %s\n\n", benchmark.name, passed ? "passed" : "FAILED");
+		if (!passed)
+			exitCode = 1;
+	}
+
+	if (matched < selected.size())
+	{
+		printf("Unknown benchmark name. Available:\n");
+		for (const Benchmark& benchmark : benchmarks)
+			printf("    %s\n", benchmark.name);
+		return 2;
+	}
+
+	return exitCode;
+}
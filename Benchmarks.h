@@ -0,0 +1,15 @@
+#pragma once
+
+/**
+ * Headless benchmarks and regression checks, run with
+ *   SmorcEngine.exe -bench [name ...]
+ * No window or D3D device is created, so each benchmark drives one
+ * subsystem on synthetic or loaded data, not Game's frame loop. Without
+ * names every benchmark runs. The benchmarks of each subsystem are in
+ * Benchmarks<Subsystem>.cpp, with what they share in BenchmarkUtils.h.
+ */
+namespace Benchmarks
+{
+	// Returns the process exit code: 0 if every selected benchmark passed its checks
+	int Run(const char* arguments);
+}
@@ -0,0 +1,1053 @@
+#include "BenchmarkUtils.h"
+#include "TriangleBVH.h"
+#include "AISystem.h"
+#include "AIStateMachine.h"
+#include "NavMesh.h"
+#include "AgentSpatialHash.h"
+#include "AIScheduler.h"
+#include "CrowdAvoidance.h"
+#include "SimpleAI.h"
+#include "Transform.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace Benchmarks
+{
+	// ----------------------------------------------------
+	// Ghost AI
+	// ----------------------------------------------------
+
+	// SimpleAI::Update() on bare transforms, without the entity and the tint
+	class ReferenceGhost
+	{
+	public:
+		ReferenceGhost(Transform* pPlayer, Transform* const* path, unsigned int pathLength, Transform* pSelf)
+			: player(pPlayer), targetPath(path), maxRouteCount(pathLength - 1), self(pSelf) {}
+		virtual ~ReferenceGhost() = default;
+
+		virtual void Update(float playerVisibility, float deltaTime)
+		{
+			float range = AI_SIGHT_RANGE_DARK + (AI_SIGHT_RANGE_LIT - AI_SIGHT_RANGE_DARK) * playerVisibility;
+			state = self->DistanceSquaredTo(player->GetPosition()) < range * range ? AI_State::ATTACK_PLAYER : AI_State::PATROL_PATH;
+
+			if (state == AI_State::ATTACK_PLAYER)
+			{
+				MoveTowards(player, deltaTime);
+			}
+			else if (self->DistanceSquaredTo(targetPath[activeRoute]->GetPosition()) > AI_WAYPOINT_REACHED_SQ)
+			{
+				MoveTowards(targetPath[activeRoute], deltaTime);
+			}
+			else
+			{
+				activeRoute = activeRoute >= maxRouteCount ? 0 : activeRoute + 1;
+			}
+		}
+
+		AI_State state = AI_State::PATROL_PATH;
+		unsigned int activeRoute = 0;
+
+	protected:
+		void MoveTowards(Transform* target, float deltaTime)
+		{
+			using namespace DirectX;
+
+			XMFLOAT3 targetPos = target->GetPosition();
+			XMFLOAT3 ghostPos = self->GetPosition();
+			XMVECTOR dir = XMVector3Normalize(XMVectorSubtract(XMLoadFloat3(&targetPos), XMLoadFloat3(&ghostPos)));
+			dir *= deltaTime * AI_GHOST_SPEED;
+
+			XMFLOAT3 move;
+			XMStoreFloat3(&move, dir);
+			self->MoveAbsolute(move.x, 0, move.z);
+			self->Rotate(0.f, AI_SPIN_PER_UPDATE, 0.f);
+		}
+
+		Transform* player;
+		Transform* const* targetPath;
+		unsigned int maxRouteCount;
+		Transform* self;
+	};
+
+	// ----------------------------------------------------
+	// Patrolling ghosts over a big level with the player
+	// walking through them, one transform and virtual
+	// Update() per ghost like Game does against AISystem.
+	// Both have to end up with the same ghosts.
+	// ----------------------------------------------------
+	bool RunAISystemBenchmark()
+	{
+		using namespace DirectX;
+
+		const unsigned int agentCount = 100000;
+		const unsigned int routeCount = 2000;
+		const unsigned int routeLength = 5;
+		const float levelSize = 400.0f;
+		const int ticks = 300;
+		const float deltaTime = 1.0f / 60.0f;
+		bool passed = true;
+
+		// 2 m square routes at the ghosts' height, ghosts start next to their route
+		unsigned int seed = 4242;
+		std::vector<XMFLOAT3> routePoints(routeCount * routeLength);
+		for (unsigned int r = 0; r < routeCount; ++r)
+		{
+			float x = RandomFloat(seed) * levelSize - levelSize * 0.5f;
+			float z = RandomFloat(seed) * levelSize - levelSize * 0.5f;
+			for (unsigned int p = 0; p < routeLength; ++p)
+				routePoints[r * routeLength + p] = XMFLOAT3(x + 2.0f * ((p + 1) / 2 % 2), 1.5f, z + 2.0f * (p / 2 % 2));
+		}
+
+		std::vector<XMFLOAT3> starts(agentCount);
+		std::vector<unsigned int> agentRoutes(agentCount);
+		for (unsigned int i = 0; i < agentCount; ++i)
+		{
+			agentRoutes[i] = (unsigned int)(RandomFloat(seed) * routeCount);
+			const XMFLOAT3& first = routePoints[agentRoutes[i] * routeLength];
+			starts[i] = XMFLOAT3(first.x + RandomFloat(seed) * 6.0f - 3.0f, 0.5f, first.z + RandomFloat(seed) * 6.0f - 3.0f);
+		}
+
+		// the player circles the level in and out of the light
+		auto playerAt = [&](int tick, XMFLOAT3& position, float& visibility)
+		{
+			float angle = tick * 0.01f;
+			position = XMFLOAT3(cosf(angle) * levelSize * 0.3f, 1.0f, sinf(angle) * levelSize * 0.3f);
+			visibility = 0.5f + 0.5f * sinf(tick * 0.05f);
+		};
+
+		// reference, heap transforms like the entities
+		std::vector<Transform*> routeTransforms(routePoints.size());
+		for (size_t i = 0; i < routePoints.size(); ++i)
+		{
+			routeTransforms[i] = new Transform();
+			routeTransforms[i]->SetPosition(routePoints[i].x, routePoints[i].y, routePoints[i].z);
+		}
+		Transform* playerTransform = new Transform();
+		std::vector<Transform*> ghostTransforms(agentCount);
+		std::vector<ReferenceGhost*> ghosts(agentCount);
+		for (unsigned int i = 0; i < agentCount; ++i)
+		{
+			ghostTransforms[i] = new Transform();
+			ghostTransforms[i]->SetPosition(starts[i].x, starts[i].y, starts[i].z);
+			ghosts[i] = new ReferenceGhost(playerTransform, &routeTransforms[agentRoutes[i] * routeLength], routeLength, ghostTransforms[i]);
+		}
+
+		size_t referenceChanges = 0;
+		BenchmarkTimer referenceTimer;
+		for (int tick = 0; tick < ticks; ++tick)
+		{
+			XMFLOAT3 position;
+			float visibility;
+			playerAt(tick, position, visibility);
+			playerTransform->SetPosition(position.x, position.y, position.z);
+			for (ReferenceGhost* ghost : ghosts)
+			{
+				AI_State before = ghost->state;
+				ghost->Update(visibility, deltaTime);
+				referenceChanges += ghost->state != before;
+			}
+		}
+		double referenceMs = referenceTimer.ElapsedMs() / ticks;
+
+		AISystem system;
+		for (unsigned int r = 0; r < routeCount; ++r)
+			system.AddRoute(&routePoints[r * routeLength], routeLength);
+		for (unsigned int i = 0; i < agentCount; ++i)
+			system.AddAgent(starts[i], agentRoutes[i]);
+
+		size_t batchedChanges = 0;
+		BenchmarkTimer batchedTimer;
+		for (int tick = 0; tick < ticks; ++tick)
+		{
+			XMFLOAT3 position;
+			float visibility;
+			playerAt(tick, position, visibility);
+			system.Update(position, visibility, deltaTime);
+			batchedChanges += system.GetStateChanges().size();
+		}
+		double batchedMs = batchedTimer.ElapsedMs() / ticks;
+
+		// float differences between the two paths may flip a threshold test, a few ghosts are allowed to drift
+		unsigned int diverged = 0, attacking = 0;
+		float yawError = 0.0f;
+		for (unsigned int i = 0; i < agentCount; ++i)
+		{
+			XMFLOAT3 reference = ghostTransforms[i]->GetPosition();
+			XMFLOAT3 batched = system.GetPosition(i);
+			bool same = fabsf(reference.x - batched.x) <= 1e-3f && fabsf(reference.y - batched.y) <= 1e-3f && fabsf(reference.z - batched.z) <= 1e-3f
+				&& ghosts[i]->state == system.GetState(i) && ghosts[i]->activeRoute == system.GetActiveRoute(i);
+			diverged += !same;
+			attacking += system.GetState(i) == AI_State::ATTACK_PLAYER;
+			yawError = (std::max)(yawError, fabsf(ghostTransforms[i]->GetPitchYawRoll().y - system.GetYaw(i)));
+		}
+
+		printf("    %u ghosts, %d ticks: virtual Update %.3f ms/tick, AISystem %.3f ms/tick, %.2fx (%.1f ns per ghost)\n",
+			agentCount, ticks, referenceMs, batchedMs, referenceMs / batchedMs, batchedMs * 1e6 / agentCount);
+		printf("    %u attacking at the end, %zu state changes (reference %zu), %u diverged, max yaw error %g\n",
+			attacking, batchedChanges, referenceChanges, diverged, yawError);
+		passed &= Check(attacking > 0 && batchedChanges > 0, "player never spotted, the scenario doesn't test attacks");
+		passed &= Check(diverged <= agentCount / 1000, "batched ghosts don't match SimpleAI");
+		passed &= Check(yawError <= 1e-3f, "batched spin doesn't match SimpleAI");
+
+		for (unsigned int i = 0; i < agentCount; ++i)
+		{
+			delete ghosts[i];
+			delete ghostTransforms[i];
+		}
+		for (Transform* transform : routeTransforms)
+			delete transform;
+		delete playerTransform;
+
+		return passed;
+	}
+
+	// Patrol, chase, then search where the player was lost before going back: a new behaviour the SimpleAI way, a subclass
+	class ReferenceSearchGhost : public ReferenceGhost
+	{
+	public:
+		ReferenceSearchGhost(Transform* pPlayer, Transform* const* path, unsigned int pathLength, Transform* pSelf, float searchTimeout)
+			: ReferenceGhost(pPlayer, path, pathLength, pSelf), searchTimeout(searchTimeout) {}
+
+		void Update(float playerVisibility, float deltaTime) override
+		{
+			float range = AI_SIGHT_RANGE_DARK + (AI_SIGHT_RANGE_LIT - AI_SIGHT_RANGE_DARK) * playerVisibility;
+			bool sees = self->DistanceSquaredTo(player->GetPosition()) < range * range;
+
+			stateTime += deltaTime;
+			Mode before = mode;
+			switch (mode)
+			{
+			case Mode::PATROL:
+				mode = sees ? Mode::CHASE : Mode::PATROL;
+				break;
+			case Mode::CHASE:
+				mode = sees ? Mode::CHASE : Mode::SEARCH;
+				break;
+			case Mode::SEARCH:
+				mode = sees ? Mode::CHASE : stateTime >= searchTimeout ? Mode::PATROL : Mode::SEARCH;
+				break;
+			}
+			if (mode != before)
+				stateTime = 0.0f;
+
+			if (mode == Mode::CHASE)
+			{
+				state = AI_State::ATTACK_PLAYER;
+				MoveTowards(player, deltaTime);
+			}
+			else if (mode == Mode::SEARCH)
+			{
+				state = AI_State::DEFAULT;
+			}
+			else
+			{
+				state = AI_State::PATROL_PATH;
+				if (self->DistanceSquaredTo(targetPath[activeRoute]->GetPosition()) > AI_WAYPOINT_REACHED_SQ)
+					MoveTowards(targetPath[activeRoute], deltaTime);
+				else
+					activeRoute = activeRoute >= maxRouteCount ? 0 : activeRoute + 1;
+			}
+		}
+
+		// in the order of the machine's states
+		enum class Mode : unsigned char { PATROL, CHASE, SEARCH };
+		Mode mode = Mode::PATROL;
+
+	private:
+		float searchTimeout;
+		float stateTime = 0.0f;
+	};
+
+	// ----------------------------------------------------
+	// The search behaviour above as a state machine
+	// definition: table steps alone, then AISystem running
+	// it against one virtual ghost per agent, the ghosts
+	// of RunAISystemBenchmark() with the player passing
+	// by. Both have to end up with the same ghosts
+	// ----------------------------------------------------
+	bool RunStateMachineBenchmark()
+	{
+		using namespace DirectX;
+
+		const unsigned int agentCount = 100000;
+		const unsigned int routeCount = 2000;
+		const unsigned int routeLength = 5;
+		const float levelSize = 400.0f;
+		const int ticks = 300;
+		const float deltaTime = 1.0f / 60.0f;
+		const float searchTimeout = 1.0f;
+		bool passed = true;
+
+		const char* definition =
+			"# the first state is where ghosts start\n"
+			"state patrol patrol\n"
+			"state chase chase\n"
+			"state search hold 1.0\n"
+			"on * chase sees\n"
+			"on patrol chase alerted\n"
+			"on chase search !sees !alerted\n"
+			"on search patrol timeout\n";
+		AIStateMachine machine;
+		passed &= Check(machine.Parse(definition), "search state machine doesn't parse");
+		if (!passed)
+		{
+			printf("    %s\n", machine.GetError().c_str());
+			return false;
+		}
+
+		AIStateMachine broken;
+		passed &= Check(!broken.Parse("state patrol patrol\non patrol chase sees\n") && !broken.GetError().empty(), "transition to a missing state parses");
+		passed &= Check(!broken.Parse("state patrol walk\n"), "unknown behaviour parses");
+
+		// every state and condition against the rules as written
+		unsigned int patrol = machine.FindState("patrol"), chase = machine.FindState("chase"), search = machine.FindState("search");
+		bool tableMatches = true;
+		for (unsigned int conditions = 0; conditions < (1u << AI_CONDITION_BITS); ++conditions)
+		{
+			bool sees = (conditions & AI_CONDITION_SEES_PLAYER) != 0;
+			bool alerted = (conditions & AI_CONDITION_ALERTED) != 0;
+			bool timedOut = (conditions & AI_CONDITION_TIMED_OUT) != 0;
+			tableMatches &= machine.Next(patrol, conditions) == (sees || alerted ? chase : patrol);
+			tableMatches &= machine.Next(chase, conditions) == (sees || alerted ? chase : search);
+			tableMatches &= machine.Next(search, conditions) == (sees ? chase : timedOut ? patrol : search);
+		}
+		passed &= Check(tableMatches, "compiled table doesn't follow the transitions");
+
+		// table steps alone, random conditions
+		{
+			const int steps = 100;
+			unsigned int seed = 99;
+			std::vector<unsigned char> conditions(agentCount * 4);
+			for (unsigned char& c : conditions)
+				c = (unsigned char)(RandomFloat(seed) * (1u << AI_CONDITION_BITS));
+			std::vector<unsigned char> states(agentCount, 0), expected(agentCount, 0);
+
+			BenchmarkTimer stepTimer;
+			for (int s = 0; s < steps; ++s)
+				machine.Step(&conditions[(s % 4) * agentCount], states.data(), agentCount);
+			double stepMs = stepTimer.ElapsedMs() / steps;
+
+			for (int s = 0; s < steps; ++s)
+			{
+				for (unsigned int i = 0; i < agentCount; ++i)
+					expected[i] = (unsigned char)machine.Next(expected[i], conditions[(s % 4) * agentCount + i]);
+			}
+			printf("    %u states, %u transitions, table of %u bytes: %u agents stepped in %.3f ms (%.2f ns per agent)\n",
+				machine.GetStateCount(), machine.GetTransitionCount(), machine.GetStateCount() << AI_CONDITION_BITS, agentCount, stepMs, stepMs * 1e6 / agentCount);
+			passed &= Check(states == expected, "batched steps don't match single lookups");
+		}
+
+		// same routes and starts as RunAISystemBenchmark()
+		unsigned int seed = 4242;
+		std::vector<XMFLOAT3> routePoints(routeCount * routeLength);
+		for (unsigned int r = 0; r < routeCount; ++r)
+		{
+			float x = RandomFloat(seed) * levelSize - levelSize * 0.5f;
+			float z = RandomFloat(seed) * levelSize - levelSize * 0.5f;
+			for (unsigned int p = 0; p < routeLength; ++p)
+				routePoints[r * routeLength + p] = XMFLOAT3(x + 2.0f * ((p + 1) / 2 % 2), 1.5f, z + 2.0f * (p / 2 % 2));
+		}
+
+		std::vector<XMFLOAT3> starts(agentCount);
+		std::vector<unsigned int> agentRoutes(agentCount);
+		for (unsigned int i = 0; i < agentCount; ++i)
+		{
+			agentRoutes[i] = (unsigned int)(RandomFloat(seed) * routeCount);
+			const XMFLOAT3& first = routePoints[agentRoutes[i] * routeLength];
+			starts[i] = XMFLOAT3(first.x + RandomFloat(seed) * 6.0f - 3.0f, 0.5f, first.z + RandomFloat(seed) * 6.0f - 3.0f);
+		}
+
+		auto playerAt = [&](int tick, XMFLOAT3& position, float& visibility)
+		{
+			float angle = tick * 0.01f;
+			position = XMFLOAT3(cosf(angle) * levelSize * 0.3f, 1.0f, sinf(angle) * levelSize * 0.3f);
+			visibility = 0.5f + 0.5f * sinf(tick * 0.05f);
+		};
+
+		std::vector<Transform*> routeTransforms(routePoints.size());
+		for (size_t i = 0; i < routePoints.size(); ++i)
+		{
+			routeTransforms[i] = new Transform();
+			routeTransforms[i]->SetPosition(routePoints[i].x, routePoints[i].y, routePoints[i].z);
+		}
+		Transform* playerTransform = new Transform();
+		std::vector<Transform*> ghostTransforms(agentCount);
+		std::vector<ReferenceGhost*> ghosts(agentCount);
+		for (unsigned int i = 0; i < agentCount; ++i)
+		{
+			ghostTransforms[i] = new Transform();
+			ghostTransforms[i]->SetPosition(starts[i].x, starts[i].y, starts[i].z);
+			ghosts[i] = new ReferenceSearchGhost(playerTransform, &routeTransforms[agentRoutes[i] * routeLength], routeLength, ghostTransforms[i], searchTimeout);
+		}
+
+		BenchmarkTimer referenceTimer;
+		for (int tick = 0; tick < ticks; ++tick)
+		{
+			XMFLOAT3 position;
+			float visibility;
+			playerAt(tick, position, visibility);
+			playerTransform->SetPosition(position.x, position.y, position.z);
+			for (ReferenceGhost* ghost : ghosts)
+				ghost->Update(visibility, deltaTime);
+		}
+		double referenceMs = referenceTimer.ElapsedMs() / ticks;
+
+		AISystem system;
+		system.SetStateMachine(machine);
+		for (unsigned int r = 0; r < routeCount; ++r)
+			system.AddRoute(&routePoints[r * routeLength], routeLength);
+		for (unsigned int i = 0; i < agentCount; ++i)
+			system.AddAgent(starts[i], agentRoutes[i]);
+
+		// searches ending in patrols only happen through the timeout
+		size_t changes = 0, searchesGivenUp = 0;
+		std::vector<unsigned char> before(agentCount);
+		double batchedMs = 0.0;
+		for (int tick = 0; tick < ticks; ++tick)
+		{
+			XMFLOAT3 position;
+			float visibility;
+			playerAt(tick, position, visibility);
+			for (unsigned int i = 0; i < agentCount; ++i)
+				before[i] = (unsigned char)system.GetMachineState(i);
+
+			BenchmarkTimer batchedTimer;
+			system.Update(position, visibility, deltaTime);
+			batchedMs += batchedTimer.ElapsedMs();
+
+			changes += system.GetStateChanges().size();
+			for (unsigned int agent : system.GetStateChanges())
+				searchesGivenUp += before[agent] == search && system.GetMachineState(agent) == patrol;
+		}
+		batchedMs /= ticks;
+
+		unsigned int diverged = 0, searching = 0;
+		for (unsigned int i = 0; i < agentCount; ++i)
+		{
+			ReferenceSearchGhost* ghost = static_cast<ReferenceSearchGhost*>(ghosts[i]);
+			XMFLOAT3 reference = ghostTransforms[i]->GetPosition();
+			XMFLOAT3 batched = system.GetPosition(i);
+			bool same = fabsf(reference.x - batched.x) <= 1e-3f && fabsf(reference.y - batched.y) <= 1e-3f && fabsf(reference.z - batched.z) <= 1e-3f
+				&& (unsigned int)ghost->mode == system.GetMachineState(i) && ghost->state == system.GetState(i) && ghost->activeRoute == system.GetActiveRoute(i);
+			diverged += !same;
+			searching += system.GetMachineState(i) == search;
+		}
+
+		printf("    %u ghosts, %d ticks: virtual subclass Update %.3f ms/tick, AISystem with the table %.3f ms/tick, %.2fx (%.1f ns per ghost)\n",
+			agentCount, ticks, referenceMs, batchedMs, referenceMs / batchedMs, batchedMs * 1e6 / agentCount);
+		printf("    %zu state changes, %zu searches timed out, %u searching at the end, %u diverged\n", changes, searchesGivenUp, searching, diverged);
+		passed &= Check(searchesGivenUp > 0, "no search timed out, the scenario doesn't test timeouts");
+		passed &= Check(diverged <= agentCount / 1000, "state machine ghosts don't match the virtual ones");
+
+		for (unsigned int i = 0; i < agentCount; ++i)
+		{
+			delete ghosts[i];
+			delete ghostTransforms[i];
+		}
+		for (Transform* transform : routeTransforms)
+			delete transform;
+		delete playerTransform;
+
+		return passed;
+	}
+
+
+	// ----------------------------------------------------
+	// Agents spread at the same density over ever bigger
+	// areas: hash rebuilds, one neighbour query per agent,
+	// checked against testing every agent. Then alerts in
+	// an AISystem full of standing ghosts
+	// ----------------------------------------------------
+	bool RunAgentHashBenchmark()
+	{
+		using namespace DirectX;
+
+		const unsigned int agentCounts[] = { 10000, 100000, 1000000 };
+		const float areaPerAgent = 16.0f;
+		const float radius = AI_ALERT_RANGE * 0.5f;
+		const int builds = 5;
+		bool passed = true;
+
+		for (unsigned int agentCount : agentCounts)
+		{
+			float side = sqrtf(agentCount * areaPerAgent);
+			unsigned int seed = 31337;
+			std::vector<float> x(agentCount), y(agentCount), z(agentCount);
+			for (unsigned int i = 0; i < agentCount; ++i)
+			{
+				x[i] = (RandomFloat(seed) - 0.5f) * side;
+				y[i] = 0.5f + RandomFloat(seed);
+				z[i] = (RandomFloat(seed) - 0.5f) * side;
+			}
+
+			AgentSpatialHash hash;
+			double buildMs = 0.0;
+			for (int b = 0; b < builds; ++b)
+			{
+				hash.Build(x.data(), y.data(), z.data(), agentCount);
+				buildMs += hash.GetBuildMs();
+			}
+
+			BenchmarkTimer queryTimer;
+			unsigned long long found = 0;
+			for (unsigned int i = 0; i < agentCount; ++i)
+				found += hash.Count(XMFLOAT3(x[i], y[i], z[i]), radius);
+			double queryMs = queryTimer.ElapsedMs();
+
+			// the same queries for a few agents, against every agent
+			const unsigned int checks = 100;
+			unsigned int mismatches = 0;
+			std::vector<unsigned int> result, expected;
+			BenchmarkTimer bruteTimer;
+			for (unsigned int c = 0; c < checks; ++c)
+			{
+				unsigned int agent = (unsigned int)(RandomFloat(seed) * agentCount) % agentCount;
+				expected.clear();
+				for (unsigned int i = 0; i < agentCount; ++i)
+				{
+					float dx = x[i] - x[agent], dy = y[i] - y[agent], dz = z[i] - z[agent];
+					if (dx * dx + dy * dy + dz * dz < radius * radius)
+						expected.push_back(i);
+				}
+
+				hash.Query(XMFLOAT3(x[agent], y[agent], z[agent]), radius, result);
+				std::sort(result.begin(), result.end());
+				mismatches += result != expected;
+			}
+			double bruteMs = bruteTimer.ElapsedMs() / checks * agentCount;
+
+			printf("    %7u agents, %u x %u buckets: rebuild %.2f ms, %.1f M queries/s (%.1f neighbours each), all pairs would take %.0f ms\n",
+				agentCount, hash.GetCellsPerAxis(), hash.GetCellsPerAxis(), buildMs / builds,
+				agentCount / (queryMs * 1000.0), (double)found / agentCount, bruteMs);
+			passed &= Check(mismatches == 0, "neighbours differ from testing every agent");
+		}
+
+		// ghosts standing on their single point route, the player in the middle
+		const unsigned int ghostCount = 100000;
+		float side = sqrtf(ghostCount * areaPerAgent);
+		unsigned int seed = 7;
+		AISystem aiSystem;
+		for (unsigned int i = 0; i < ghostCount; ++i)
+		{
+			XMFLOAT3 position((RandomFloat(seed) - 0.5f) * side, 1.5f, (RandomFloat(seed) - 0.5f) * side);
+			aiSystem.AddAgent(position, aiSystem.AddRoute(&position, 1));
+		}
+
+		XMFLOAT3 player(0, 1.5f, 0);
+		aiSystem.Update(player, 1.0f, 0.0f);
+		BenchmarkTimer quietTimer;
+		aiSystem.Update(player, 1.0f, 0.0f);
+		double quietMs = quietTimer.ElapsedMs();
+		aiSystem.SetAlertRange(AI_ALERT_RANGE);
+		aiSystem.Update(player, 1.0f, 0.0f);
+		BenchmarkTimer alertTimer;
+		aiSystem.Update(player, 1.0f, 0.0f);
+		double alertMs = alertTimer.ElapsedMs();
+
+		unsigned int seeing = 0, attacking = 0, wrongAlerts = 0;
+		std::vector<unsigned int> near;
+		for (unsigned int agent = 0; agent < ghostCount; ++agent)
+		{
+			XMFLOAT3 position = aiSystem.GetPosition(agent);
+			float distSq = position.x * position.x + position.z * position.z;
+			seeing += distSq < AI_SIGHT_RANGE_LIT * AI_SIGHT_RANGE_LIT;
+			attacking += aiSystem.GetState(agent) == AI_State::ATTACK_PLAYER;
+			float reach = AI_SIGHT_RANGE_LIT + AI_ALERT_RANGE;
+			bool shouldAttack = distSq < AI_SIGHT_RANGE_LIT * AI_SIGHT_RANGE_LIT;
+			if (!shouldAttack && distSq < reach * reach)
+			{
+				aiSystem.GetNeighbours(position, AI_ALERT_RANGE, near);
+				for (unsigned int other : near)
+				{
+					XMFLOAT3 otherPosition = aiSystem.GetPosition(other);
+					shouldAttack |= otherPosition.x * otherPosition.x + otherPosition.z * otherPosition.z < AI_SIGHT_RANGE_LIT * AI_SIGHT_RANGE_LIT;
+				}
+			}
+			wrongAlerts += shouldAttack != (aiSystem.GetState(agent) == AI_State::ATTACK_PLAYER);
+		}
+		printf("    AISystem, %u ghosts: update %.2f ms, %.2f ms with alerts. %u see the player, %u attack, %u wrong\n",
+			ghostCount, quietMs, alertMs, seeing, attacking, wrongAlerts);
+		passed &= Check(attacking > seeing, "nobody was alerted");
+		passed &= Check(wrongAlerts == 0, "alerts don't match the ghosts in range");
+
+		return passed;
+	}
+
+	// ----------------------------------------------------
+	// 50k patrolling agents in the synthetic level with the
+	// player walking among them, steering along navmesh
+	// paths: every batch every frame, then scheduled by
+	// distance, then scheduled within a frame budget. The
+	// agents have to cover about the same ground each way.
+	// The same without the navmesh, where the SIMD update
+	// alone is about as cheap as scheduling it
+	// ----------------------------------------------------
+	bool RunAISchedulerBenchmark()
+	{
+		using namespace DirectX;
+
+		const unsigned int agentCount = 50000;
+		const unsigned int routeCount = 5000;
+		const float levelSize = 200.0f;
+		const int ticks = 120;
+		const float deltaTime = 1.0f / 60.0f;
+		bool passed = true;
+
+		std::vector<XMFLOAT3> corners;
+		MakeBenchmarkLevel(20, levelSize / 20.0f, corners);
+		NavMesh navMesh;
+		for (size_t i = 0; i + 2 < corners.size(); i += 3)
+			navMesh.AddTriangle(corners[i], corners[i + 1], corners[i + 2]);
+		navMesh.Build(NavMeshSettings());
+
+		struct Run
+		{
+			const char* label;
+			bool navMesh;
+			bool scheduled;
+			double budgetMs;
+			double aiMs = 0.0, worstMs = 0.0;
+			double updates = 0.0, distance = 0.0;
+			unsigned int longestWait = 0, deferred = 0;
+			float timeLost = 0.0f;
+		};
+		Run runs[] =
+		{
+			{ "navmesh, every frame", true, false, 0.0 },
+			{ "navmesh, scheduled", true, true, 0.0 },
+			{ "navmesh, 8 ms budget", true, true, 8.0 },
+			{ "straight, every frame", false, false, 0.0 },
+			{ "straight, scheduled", false, true, 0.0 },
+		};
+
+		// 3 m square routes inside the rooms, groups of 10 agents start next to theirs so batches stay together
+		unsigned int seed = 2024;
+		std::vector<XMFLOAT3> routePoints(routeCount * 4);
+		for (unsigned int r = 0; r < routeCount; ++r)
+		{
+			float x = floorf(RandomFloat(seed) * 20.0f) * levelSize / 20.0f + 2.0f + RandomFloat(seed) * 3.0f;
+			float z = floorf(RandomFloat(seed) * 20.0f) * levelSize / 20.0f + 2.0f + RandomFloat(seed) * 3.0f;
+			for (unsigned int p = 0; p < 4; ++p)
+				routePoints[r * 4 + p] = XMFLOAT3(x + 3.0f * ((p + 1) / 2 % 2), 1.5f, z + 3.0f * (p / 2 % 2));
+		}
+		std::vector<XMFLOAT3> starts(agentCount);
+		std::vector<unsigned int> agentRoutes(agentCount);
+		for (unsigned int i = 0; i < agentCount; ++i)
+		{
+			agentRoutes[i] = i * routeCount / agentCount;
+			const XMFLOAT3& first = routePoints[agentRoutes[i] * 4];
+			starts[i] = XMFLOAT3(first.x + RandomFloat(seed) * 2.0f - 1.0f, 0.5f, first.z + RandomFloat(seed) * 2.0f - 1.0f);
+		}
+
+		for (Run& run : runs)
+		{
+			AISystem aiSystem;
+			for (unsigned int r = 0; r < routeCount; ++r)
+				aiSystem.AddRoute(&routePoints[r * 4], 4);
+			for (unsigned int i = 0; i < agentCount; ++i)
+				aiSystem.AddAgent(starts[i], agentRoutes[i]);
+			aiSystem.SetNavMesh(run.navMesh ? &navMesh : nullptr);
+
+			AISchedulerSettings settings;
+			settings.frameBudgetMs = run.budgetMs;
+			AIScheduler scheduler(settings);
+			scheduler.Resize(aiSystem.GetBatchCount());
+			std::vector<float> distances;
+			std::vector<unsigned char> flags;
+			std::vector<unsigned int> waits(aiSystem.GetBatchCount(), 0);
+			std::vector<float> delivered(aiSystem.GetBatchCount(), 0.0f);
+
+			for (int tick = 0; tick < ticks; ++tick)
+			{
+				// the player walks a lap around the middle of the level, the ghosts can't see far in the dark
+				float angle = tick * 0.02f;
+				XMFLOAT3 player(levelSize * 0.5f + cosf(angle) * levelSize * 0.2f, 1.5f, levelSize * 0.5f + sinf(angle) * levelSize * 0.2f);
+
+				BenchmarkTimer frameTimer;
+				if (run.scheduled)
+				{
+					// what Game::Update() does before updating the AI
+					aiSystem.GetBatchDistances(player, distances);
+					flags.assign(aiSystem.GetBatchCount(), 0);
+					for (unsigned int i = 0; i < agentCount; ++i)
+						flags[aiSystem.GetBatch(i)] |= aiSystem.GetState(i) == AI_State::ATTACK_PLAYER ? AI_SCHEDULE_URGENT : 0;
+					scheduler.Schedule(distances.data(), flags.data(), deltaTime);
+
+					BenchmarkTimer updateTimer;
+					const std::vector<unsigned int>& due = scheduler.GetDueItems();
+					aiSystem.UpdateBatches(player, 0.0f, due.data(), scheduler.GetDueDeltaTimes().data(), (unsigned int)due.size());
+					scheduler.ReportUpdateMs(updateTimer.ElapsedMs());
+				}
+				else
+				{
+					aiSystem.Update(player, 0.0f, deltaTime);
+				}
+				double frameMs = frameTimer.ElapsedMs();
+				run.aiMs += frameMs;
+				run.worstMs = (std::max)(run.worstMs, frameMs);
+
+				// bookkeeping, outside the timing
+				if (!run.scheduled)
+				{
+					run.updates += aiSystem.GetBatchCount();
+					run.longestWait = 1;
+					continue;
+				}
+				run.updates += scheduler.GetDueItems().size();
+				run.deferred += scheduler.GetDeferredCount();
+				for (unsigned int& wait : waits)
+					wait++;
+				for (size_t i = 0; i < scheduler.GetDueItems().size(); ++i)
+				{
+					unsigned int batch = scheduler.GetDueItems()[i];
+					run.longestWait = (std::max)(run.longestWait, waits[batch]);
+					waits[batch] = 0;
+					delivered[batch] += scheduler.GetDueDeltaTimes()[i];
+				}
+			}
+
+			for (unsigned int i = 0; i < agentCount; ++i)
+			{
+				XMFLOAT3 position = aiSystem.GetPosition(i);
+				run.distance += XMVectorGetX(XMVector3Length(XMLoadFloat3(&position) - XMLoadFloat3(&starts[i])));
+			}
+
+			// whatever a batch didn't get yet is exactly the frames since its last update
+			for (unsigned int batch = 0; run.scheduled && batch < waits.size(); ++batch)
+				run.timeLost = (std::max)(run.timeLost, fabsf(ticks * deltaTime - delivered[batch] - waits[batch] * deltaTime));
+
+			printf("    %-21s %7.2f ms per frame (worst %7.2f), %5.0f of %u batches per frame, longest wait %2u frames, %u deferred\n",
+				run.label, run.aiMs / ticks, run.worstMs, run.updates / ticks, aiSystem.GetBatchCount(), run.longestWait, run.deferred);
+		}
+
+		const Run& full = runs[0];
+		const Run& scheduled = runs[1];
+		const Run& budget = runs[2];
+		printf("    %u agents on the navmesh: scheduled %.1fx less AI time per frame covering %.1f%% of the ground, %.2f ms per frame within the budget\n",
+			agentCount, full.aiMs / scheduled.aiMs, scheduled.distance / full.distance * 100.0, budget.aiMs / ticks);
+
+		for (const Run& run : runs)
+			passed &= Check(run.timeLost < 1e-3f, "skipped time wasn't handed back");
+		passed &= Check(scheduled.longestWait <= AISchedulerSettings().maxInterval, "a batch waited longer than its interval");
+		passed &= Check(budget.longestWait <= AISchedulerSettings().maxInterval * 2, "the budget put a batch off too long");
+		passed &= Check(fabs(scheduled.distance / full.distance - 1.0) < 0.05 && fabs(runs[4].distance / runs[3].distance - 1.0) < 0.05, "scheduled agents don't move like the others");
+		passed &= Check(scheduled.aiMs < full.aiMs * 0.5, "scheduling didn't save time");
+
+		return passed;
+	}
+
+	// ----------------------------------------------------
+	// Line of sight segments through the shipped rooms and
+	// through the synthetic level with every triangle cut
+	// into 64: groups of ghosts looking at the player from
+	// within sight range, and random segments. One segment
+	// per query, then all of them at once in packets. Both
+	// have to agree, and with testing every triangle
+	// ----------------------------------------------------
+	bool RunLineOfSightBenchmark()
+	{
+		using namespace DirectX;
+
+		const unsigned int playerCount = 64;
+		const unsigned int ghostsPerPlayer = 1024;
+		const float eyeHeight = 1.5f;
+		bool passed = true;
+
+		std::vector<XMFLOAT3> shipped, synthetic;
+		bool hasShipped = LoadShippedLevel(shipped);
+		if (!hasShipped)
+			printf("    shipped rooms not found, skipped\n");
+
+		// each pass cuts every triangle into 4 at its edge midpoints
+		MakeBenchmarkLevel(20, 10.0f, synthetic);
+		for (int pass = 0; pass < 3; ++pass)
+		{
+			std::vector<XMFLOAT3> cut;
+			cut.reserve(synthetic.size() * 4);
+			for (size_t i = 0; i + 2 < synthetic.size(); i += 3)
+			{
+				XMVECTOR a = XMLoadFloat3(&synthetic[i]), b = XMLoadFloat3(&synthetic[i + 1]), c = XMLoadFloat3(&synthetic[i + 2]);
+				XMVECTOR ab = (a + b) * 0.5f, bc = (b + c) * 0.5f, ca = (c + a) * 0.5f;
+				XMVECTOR pieces[12] = { a, ab, ca, ab, b, bc, ca, bc, c, ab, bc, ca };
+				for (XMVECTOR corner : pieces)
+				{
+					XMFLOAT3 stored;
+					XMStoreFloat3(&stored, corner);
+					cut.push_back(stored);
+				}
+			}
+			synthetic.swap(cut);
+		}
+
+		struct Scene
+		{
+			const char* label;
+			const std::vector<XMFLOAT3>* corners;
+			float floorY;
+			unsigned int bruteChecks;
+		};
+		std::vector<Scene> scenes;
+		if (hasShipped)
+			scenes.push_back({ "shipped rooms", &shipped, 0.5f, 2000 });
+		scenes.push_back({ "synthetic level", &synthetic, 0.0f, 100 });
+
+		for (const Scene& scene : scenes)
+		{
+			const std::vector<XMFLOAT3>& corners = *scene.corners;
+			TriangleBVH bvh;
+			XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX), boundsMax = XMVectorReplicate(-FLT_MAX);
+			for (size_t i = 0; i + 2 < corners.size(); i += 3)
+			{
+				bvh.AddTriangle(corners[i], corners[i + 1], corners[i + 2]);
+				for (int k = 0; k < 3; ++k)
+				{
+					boundsMin = XMVectorMin(boundsMin, XMLoadFloat3(&corners[i + k]));
+					boundsMax = XMVectorMax(boundsMax, XMLoadFloat3(&corners[i + k]));
+				}
+			}
+			BenchmarkTimer buildTimer;
+			bvh.Build();
+			double buildMs = buildTimer.ElapsedMs();
+			printf("    %s: %u triangles, %u nodes, built in %.1f ms\n", scene.label, bvh.GetTriangleCount(), bvh.GetNodeCount(), buildMs);
+
+			XMFLOAT3 low, high;
+			XMStoreFloat3(&low, boundsMin);
+			XMStoreFloat3(&high, boundsMax);
+			float eyeY = scene.floorY + eyeHeight;
+			unsigned int seed = 5150;
+
+			// groups of four ghosts within a meter of each other, all within sight of the player
+			const char* setNames[] = { "ghosts to player", "random" };
+			for (int set = 0; set < 2; ++set)
+			{
+				std::vector<XMFLOAT3> from, to;
+				for (unsigned int p = 0; p < playerCount; ++p)
+				{
+					XMFLOAT3 player(low.x + RandomFloat(seed) * (high.x - low.x), eyeY, low.z + RandomFloat(seed) * (high.z - low.z));
+					for (unsigned int g = 0; g < ghostsPerPlayer; g += 4)
+					{
+						float angle = RandomFloat(seed) * XM_2PI;
+						float distance = RandomFloat(seed) * AI_SIGHT_RANGE_LIT;
+						XMFLOAT3 group(player.x + cosf(angle) * distance, eyeY, player.z + sinf(angle) * distance);
+						for (unsigned int k = 0; k < 4; ++k)
+						{
+							XMFLOAT3 ghost(group.x + RandomFloat(seed) - 0.5f, eyeY, group.z + RandomFloat(seed) - 0.5f);
+							if (set == 0)
+							{
+								from.push_back(ghost);
+								to.push_back(player);
+							}
+							else
+							{
+								angle = RandomFloat(seed) * XM_2PI;
+								distance = RandomFloat(seed) * AI_SIGHT_RANGE_LIT;
+								from.push_back(XMFLOAT3(low.x + RandomFloat(seed) * (high.x - low.x), scene.floorY + RandomFloat(seed) * 3.0f, low.z + RandomFloat(seed) * (high.z - low.z)));
+								to.push_back(XMFLOAT3(from.back().x + cosf(angle) * distance, scene.floorY + RandomFloat(seed) * 3.0f, from.back().z + sinf(angle) * distance));
+							}
+						}
+					}
+				}
+				unsigned int count = (unsigned int)from.size();
+
+				std::vector<unsigned char> single(count);
+				BenchmarkTimer singleTimer;
+				for (unsigned int i = 0; i < count; ++i)
+					single[i] = bvh.SegmentOccluded(from[i], to[i]);
+				double singleMs = singleTimer.ElapsedMs();
+
+				std::vector<unsigned char> packed(count);
+				BenchmarkTimer packetTimer;
+				bvh.SegmentsOccluded(from.data(), to.data(), count, packed.data());
+				double packetMs = packetTimer.ElapsedMs();
+
+				unsigned int blocked = 0, differ = 0, wrong = 0;
+				for (unsigned int i = 0; i < count; ++i)
+				{
+					blocked += single[i];
+					differ += single[i] != packed[i];
+				}
+				for (unsigned int c = 0; c < scene.bruteChecks; ++c)
+				{
+					unsigned int i = (unsigned int)(RandomFloat(seed) * count) % count;
+					XMVECTOR offset = XMLoadFloat3(&to[i]) - XMLoadFloat3(&from[i]);
+					float length = XMVectorGetX(XMVector3Length(offset));
+					XMFLOAT3 direction;
+					XMStoreFloat3(&direction, offset / length);
+					float hit = BruteForceRayDistance(corners, from[i], direction);
+					float end = length * TRIANGLE_BVH_SEGMENT_END;
+					wrong += fabsf(hit - end) > 1e-3f && (hit < end) != (single[i] != 0);
+				}
+
+				printf("      %-16s %u segments, %4.1f%% blocked: %6.2f M/s one by one, %6.2f M/s in packets, %u differ, %u of %u wrong\n",
+					setNames[set], count, 100.0 * blocked / count, count / (singleMs * 1000.0), count / (packetMs * 1000.0), differ, wrong, scene.bruteChecks);
+				passed &= Check(differ == 0, "packets and single segments disagree");
+				passed &= Check(wrong == 0, "occlusion differs from testing every triangle");
+			}
+
+			// standing ghosts around the player, only the ones with a clear view may attack
+			const unsigned int ghostCount = 10000;
+			XMFLOAT3 player((low.x + high.x) * 0.5f, eyeY, (low.z + high.z) * 0.5f);
+			AISystem aiSystem;
+			for (unsigned int i = 0; i < ghostCount; ++i)
+			{
+				float angle = RandomFloat(seed) * XM_2PI;
+				float distance = RandomFloat(seed) * AI_SIGHT_RANGE_LIT * 1.5f;
+				XMFLOAT3 position(player.x + cosf(angle) * distance, scene.floorY, player.z + sinf(angle) * distance);
+				aiSystem.AddAgent(position, aiSystem.AddRoute(&position, 1));
+			}
+			BenchmarkTimer blindTimer;
+			aiSystem.Update(player, 1.0f, 0.0f);
+			double blindMs = blindTimer.ElapsedMs();
+			unsigned int inRange = 0;
+			for (unsigned int i = 0; i < ghostCount; ++i)
+				inRange += aiSystem.GetState(i) == AI_State::ATTACK_PLAYER;
+
+			aiSystem.SetOccluders(&bvh);
+			BenchmarkTimer sightTimer;
+			aiSystem.Update(player, 1.0f, 0.0f);
+			double sightMs = sightTimer.ElapsedMs();
+			unsigned int seeing = 0, wrongStates = 0;
+			for (unsigned int i = 0; i < ghostCount; ++i)
+			{
+				XMFLOAT3 position = aiSystem.GetPosition(i);
+				XMFLOAT3 eye(position.x, position.y + AI_EYE_HEIGHT, position.z);
+				float distSq = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&position) - XMLoadFloat3(&player)));
+				bool sees = distSq < AI_SIGHT_RANGE_LIT * AI_SIGHT_RANGE_LIT && !bvh.SegmentOccluded(eye, player);
+				bool attacking = aiSystem.GetState(i) == AI_State::ATTACK_PLAYER;
+				seeing += attacking;
+				wrongStates += sees != attacking;
+			}
+			printf("      AISystem, %u ghosts: %u in range, %u with line of sight, update %.2f ms, %.2f ms with line of sight, %u wrong\n",
+				ghostCount, inRange, seeing, blindMs, sightMs, wrongStates);
+			passed &= Check(wrongStates == 0, "ghosts attack without line of sight");
+			passed &= Check(seeing < inRange, "nothing blocked the ghosts' view");
+		}
+
+		return passed;
+	}
+
+	// ----------------------------------------------------
+	// Crowd avoidance
+	// ----------------------------------------------------
+
+	// Pairs of agents whose discs of the radius overlap
+	unsigned int CountOverlaps(const AISystem& aiSystem, float radius)
+	{
+		using namespace DirectX;
+
+		unsigned int agentCount = aiSystem.GetAgentCount();
+		std::vector<float> x(agentCount), y(agentCount), z(agentCount);
+		for (unsigned int i = 0; i < agentCount; ++i)
+		{
+			XMFLOAT3 position = aiSystem.GetPosition(i);
+			x[i] = position.x;
+			y[i] = position.y;
+			z[i] = position.z;
+		}
+
+		AgentSpatialHash hash;
+		hash.Build(x.data(), y.data(), z.data(), agentCount);
+		unsigned int overlaps = 0;
+		std::vector<unsigned int> near;
+		for (unsigned int i = 0; i < agentCount; ++i)
+		{
+			hash.Query(XMFLOAT3(x[i], y[i], z[i]), radius * 2.0f, near);
+			for (unsigned int j : near)
+				overlaps += j > i;
+		}
+		return overlaps;
+	}
+
+	// Two opposite flows mixed over a square, every agent walking 10 m along X and back
+	void MakeCrossingCrowd(AISystem& aiSystem, unsigned int agentCount, float areaPerAgent)
+	{
+		using namespace DirectX;
+
+		float side = sqrtf(agentCount * areaPerAgent);
+		unsigned int seed = 4242;
+		for (unsigned int i = 0; i < agentCount; ++i)
+		{
+			XMFLOAT3 points[2];
+			points[0] = XMFLOAT3((RandomFloat(seed) - 0.5f) * side, 1.5f, (RandomFloat(seed) - 0.5f) * side);
+			points[1] = XMFLOAT3(points[0].x + (i % 2 ? 10.0f : -10.0f), points[0].y, points[0].z);
+			aiSystem.AddAgent(points[0], aiSystem.AddRoute(points, 2));
+		}
+	}
+
+	bool RunCrowdBenchmark()
+	{
+		using namespace DirectX;
+
+		const unsigned int agentCounts[] = { 1000, 10000, 50000 };
+		const float areaPerAgent = 6.0f;
+		const float deltaTime = 1.0f / 30.0f;
+		const int steps = 90;
+		const XMFLOAT3 player(0.0f, -1000.0f, 0.0f);	// nobody sees it, all patrol
+		bool passed = true;
+
+		CrowdAvoidanceSettings settings;
+		printf("    radius %.1f, horizon %.1f s, %u neighbours, %u workers, %d steps of %.0f ms\n",
+			settings.radius, settings.timeHorizon, settings.maxNeighbours, CrowdAvoidance(settings).GetWorkerCount(), steps, deltaTime * 1000.0f);
+
+		for (unsigned int agentCount : agentCounts)
+		{
+			AISystem overlapping;
+			MakeCrossingCrowd(overlapping, agentCount, areaPerAgent);
+			BenchmarkTimer plainTimer;
+			for (int step = 0; step < steps; ++step)
+				overlapping.Update(player, 0.0f, deltaTime);
+			double plainMs = plainTimer.ElapsedMs() / steps;
+
+			AISystem avoiding;
+			avoiding.SetAvoidance(&settings);
+			MakeCrossingCrowd(avoiding, agentCount, areaPerAgent);
+			BenchmarkTimer avoidTimer;
+			for (int step = 0; step < steps; ++step)
+				avoiding.Update(player, 0.0f, deltaTime);
+			double avoidMs = avoidTimer.ElapsedMs() / steps;
+
+			// how fast they still go on average, avoiding shouldn't bring the crowd to a stop
+			double speedSum = 0.0;
+			for (unsigned int i = 0; i < agentCount; ++i)
+			{
+				XMFLOAT2 velocity = avoiding.GetVelocity(i);
+				speedSum += sqrtf(velocity.x * velocity.x + velocity.y * velocity.y);
+			}
+
+			unsigned int before = CountOverlaps(overlapping, settings.radius);
+			unsigned int after = CountOverlaps(avoiding, settings.radius);
+			printf("    %5u agents: %8.1f steps/s avoiding (%.2f ms), %8.1f steps/s without (%.2f ms), overlapping pairs %u -> %u, mean speed %.2f of %.2f\n",
+				agentCount, 1000.0 / avoidMs, avoidMs, 1000.0 / plainMs, plainMs, before, after, speedSum / agentCount, AI_GHOST_SPEED);
+			passed &= Check(after * 10 < before, "avoidance left more than a tenth of the overlaps");
+			passed &= Check(speedSum / agentCount > AI_GHOST_SPEED * 0.5, "the crowd got stuck");
+		}
+
+		// one worker and many must come to the exact same positions
+		CrowdAvoidanceSettings single = settings, many = settings;
+		single.workerCount = 1;
+		many.workerCount = 7;
+		AISystem a, b;
+		a.SetAvoidance(&single);
+		b.SetAvoidance(&many);
+		MakeCrossingCrowd(a, 10000, areaPerAgent);
+		MakeCrossingCrowd(b, 10000, areaPerAgent);
+		unsigned int differ = 0;
+		for (int step = 0; step < 30; ++step)
+		{
+			a.Update(player, 0.0f, deltaTime);
+			b.Update(player, 0.0f, deltaTime);
+		}
+		for (unsigned int i = 0; i < a.GetAgentCount(); ++i)
+		{
+			XMFLOAT3 pa = a.GetPosition(i), pb = b.GetPosition(i);
+			differ += memcmp(&pa, &pb, sizeof(XMFLOAT3)) != 0;
+		}
+		printf("    1 against 7 workers, 10000 agents after 30 steps: %u positions differ\n", differ);
+		passed &= Check(differ == 0, "results depend on the number of workers");
+
+		return passed;
+	}
+}
@@ -0,0 +1,241 @@
+#include "BenchmarkUtils.h"
+#include "InputBinding.h"
+#include "InputThread.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Benchmarks
+{
+	// ----------------------------------------------------
+	// Input
+	// ----------------------------------------------------
+
+	// InputSystem::GetKeyboardKeyState() the way it read the byte arrays
+	Input::KeyState ReferenceKeyState(const unsigned char* current, const unsigned char* previous, unsigned int keyCode)
+	{
+		if (previous[keyCode])
+			return current[keyCode] ? Input::KeyState::StillPressed : Input::KeyState::JustReleased;
+		return current[keyCode] ? Input::KeyState::JustPressed : Input::KeyState::StillReleased;
+	}
+
+	// ----------------------------------------------------
+	// Hundreds of one to three key chords over a keyboard
+	// where a few keys change every frame. The reference
+	// is the old UpdateKeymaps(): every binding of every
+	// chord checked into a rebuilt active map
+	// ----------------------------------------------------
+	bool RunInputBenchmark()
+	{
+		const unsigned int commandCount = 512;
+		const unsigned int frames = 20000;
+		const unsigned int keysHeld = 24;
+		bool passed = true;
+
+		// chords over 64 keys only, so some of them get fulfilled
+		unsigned int seed = 777;
+		std::vector<Input::Chord*> chords(commandCount);
+		for (unsigned int command = 0; command < commandCount; ++command)
+		{
+			std::vector<Input::Binding> bindings;
+			unsigned int bindingCount = 1 + (unsigned int)(RandomFloat(seed) * 3);
+			for (unsigned int i = 0; i < bindingCount; ++i)
+			{
+				unsigned int key = 32 + (unsigned int)(RandomFloat(seed) * 64);
+				Input::KeyState state = i + 1 < bindingCount ? Input::KeyState::StillPressed : (Input::KeyState)(unsigned int)(RandomFloat(seed) * 4);
+				bindings.push_back(Input::Binding(key, state));
+			}
+			chords[command] = new Input::Chord(L"Command " + std::to_wstring(command), bindings);
+		}
+
+		std::unordered_map<unsigned int, Input::Chord*> keyMap;
+		Input::ChordTable table;
+		unsigned int impossible = 0;
+		for (unsigned int command = 0; command < commandCount; ++command)
+		{
+			keyMap[command] = chords[command];
+			impossible += !table.Add(command, *chords[command]);
+		}
+		size_t bindingCount = 0;
+		for (Input::Chord* chord : chords)
+			bindingCount += chord->GetChord().size();
+
+		// a key held goes up and another goes down every frame
+		std::vector<unsigned char> keyFrames((frames + 1) * 256, 0);
+		std::vector<unsigned int> held;
+		for (unsigned int i = 0; i < keysHeld; ++i)
+			held.push_back(32 + (unsigned int)(RandomFloat(seed) * 64));
+		for (unsigned int frame = 0; frame <= frames; ++frame)
+		{
+			held[(unsigned int)(RandomFloat(seed) * keysHeld)] = 32 + (unsigned int)(RandomFloat(seed) * 64);
+			for (unsigned int key : held)
+				keyFrames[frame * 256 + key] = 0x80;
+		}
+
+		std::vector<Input::KeyMask> masks(frames + 1);
+		BenchmarkTimer packTimer;
+		for (unsigned int frame = 0; frame <= frames; ++frame)
+			masks[frame].FromBytes(&keyFrames[frame * 256]);
+		double packNs = packTimer.ElapsedMs() * 1e6 / (frames + 1);
+
+		// reference, the commands matched every frame kept for the comparison
+		std::unordered_map<unsigned int, Input::Chord*> activeKeyMap;
+		std::vector<uint64_t> referenceActive((size_t)frames * (commandCount / 64), 0);
+		BenchmarkTimer referenceTimer;
+		for (unsigned int frame = 1; frame <= frames; ++frame)
+		{
+			const unsigned char* current = &keyFrames[frame * 256];
+			const unsigned char* previous = &keyFrames[(frame - 1) * 256];
+			activeKeyMap.clear();
+			for (auto key : keyMap)
+			{
+				bool activeKey = true;
+				for (const Input::Binding& binding : key.second->GetChord())
+				{
+					if (ReferenceKeyState(current, previous, binding.GetKeyCode()) != binding.GetKeyState())
+					{
+						activeKey = false;
+						break;
+					}
+				}
+				if (activeKey)
+					activeKeyMap.insert(std::pair<unsigned int, Input::Chord*>(key.first, key.second));
+			}
+
+			uint64_t* active = &referenceActive[(size_t)(frame - 1) * (commandCount / 64)];
+			for (auto key : activeKeyMap)
+				active[key.first >> 6] |= 1ull << (key.first & 63);
+		}
+		double referenceNs = referenceTimer.ElapsedMs() * 1e6 / frames;
+
+		std::vector<uint64_t> tableActive((size_t)frames * (commandCount / 64), 0);
+		std::vector<uint64_t> active;
+		BenchmarkTimer tableTimer;
+		for (unsigned int frame = 1; frame <= frames; ++frame)
+		{
+			table.Match(masks[frame], masks[frame - 1], active);
+			std::copy(active.begin(), active.end(), tableActive.begin() + (size_t)(frame - 1) * (commandCount / 64));
+		}
+		double tableNs = tableTimer.ElapsedMs() * 1e6 / frames;
+
+		size_t fulfilled = 0;
+		for (uint64_t word : tableActive)
+		{
+			for (; word; word &= word - 1)
+				++fulfilled;
+		}
+
+		printf("    %u chords with %zu bindings (%u impossible), %u frames: per binding checks %.0f ns/frame, compiled masks %.0f ns/frame, %.1fx\n",
+			commandCount, bindingCount, impossible, frames, referenceNs, tableNs, referenceNs / tableNs);
+		printf("    key bytes to masks %.0f ns/frame, %.2f chords fulfilled per frame\n", packNs, (double)fulfilled / frames);
+		passed &= Check(fulfilled > 0, "no chord is ever fulfilled, the scenario doesn't test matches");
+		passed &= Check(tableActive == referenceActive, "compiled chords don't match the per binding checks");
+
+		for (Input::Chord* chord : chords)
+			delete chord;
+
+		return passed;
+	}
+
+	// ----------------------------------------------------
+	// The SPSC queue between two threads, every event
+	// checked to come out once and in order, then a
+	// synthetic source at a few thousand events a second
+	// consumed by a 60 Hz frame loop. Taps are also
+	// checked against the frame times to count how many a
+	// once per frame poll of the keys would have missed
+	// ----------------------------------------------------
+	bool RunInputThreadBenchmark()
+	{
+		const unsigned int queueEvents = 2000000;
+		const float eventsPerSecond = 4000.0f;
+		const unsigned int frames = 120;
+		const double frameMs = 1000.0 / 60.0;
+		bool passed = true;
+
+		Input::InputEventQueue queue(1024);
+		unsigned int outOfOrder = 0;
+		BenchmarkTimer queueTimer;
+		std::thread producer([&queue, queueEvents]()
+		{
+			for (unsigned int i = 0; i < queueEvents; ++i)
+			{
+				Input::InputEvent event = { Input::InputEventType::MouseMove, 0, (int32_t)i, 0, 0 };
+				while (!queue.Push(event))
+					std::this_thread::yield();
+			}
+		});
+		Input::InputEvent event;
+		for (unsigned int i = 0; i < queueEvents; ++i)
+		{
+			while (!queue.Pop(event))
+				std::this_thread::yield();
+			outOfOrder += event.dx != (int32_t)i;
+		}
+		producer.join();
+		double queueMs = queueTimer.ElapsedMs();
+		passed &= Check(outOfOrder == 0, "events came out of the queue out of order");
+		passed &= Check(!queue.Pop(event), "the queue has events left after all were consumed");
+
+		Input::SyntheticInputSource source(eventsPerSecond, 4242);
+		Input::InputThread inputThread(&source);
+		std::vector<Input::InputEvent> events;
+		std::vector<uint64_t> frameTimes;
+		std::vector<std::pair<uint64_t, uint64_t>> taps;
+		std::vector<uint64_t> downTimes(256, 0);
+		uint64_t previousTimestamp = 0;
+		unsigned int unordered = 0;
+		auto consume = [&]()
+		{
+			inputThread.Consume(events);
+			for (const Input::InputEvent& consumed : events)
+			{
+				unordered += consumed.timestamp < previousTimestamp;
+				previousTimestamp = consumed.timestamp;
+				if (consumed.type == Input::InputEventType::KeyDown)
+					downTimes[consumed.keyCode] = consumed.timestamp;
+				else if (consumed.type == Input::InputEventType::KeyUp)
+					taps.push_back(std::make_pair(downTimes[consumed.keyCode], consumed.timestamp));
+			}
+		};
+
+		inputThread.Start();
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+		for (unsigned int frame = 0; frame < frames; ++frame)
+		{
+			frameStart += std::chrono::microseconds((long long)(frameMs * 1000.0));
+			std::this_thread::sleep_until(frameStart);
+			frameTimes.push_back(Input::InputClockNow());
+			consume();
+		}
+		double p50 = inputThread.GetLatencyMs(0.5f);
+		double p99 = inputThread.GetLatencyMs(0.99f);
+		double worst = inputThread.GetLatencyMs(1.0f);
+		inputThread.Stop();
+		consume();
+
+		// a poll once a frame sees a tap only if a frame starts while the key is down
+		unsigned int missed = 0;
+		for (const std::pair<uint64_t, uint64_t>& tap : taps)
+		{
+			std::vector<uint64_t>::const_iterator next = std::lower_bound(frameTimes.begin(), frameTimes.end(), tap.first);
+			missed += next == frameTimes.end() || *next >= tap.second;
+		}
+
+		printf("    queue: %u events between two threads in %.1f ms, %.1f M events/s\n", queueEvents, queueMs, queueEvents / (queueMs * 1000.0));
+		printf("    thread: %llu events over %u frames at 60 Hz, %llu dropped, event to frame p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+			(unsigned long long)inputThread.GetConsumedCount(), frames, (unsigned long long)inputThread.GetDroppedCount(), p50, p99, worst);
+		printf("    %zu key taps, %u of them shorter than the gap between frames (a per frame poll misses them), all seen through the queue\n",
+			taps.size(), missed);
+		passed &= Check(inputThread.GetConsumedCount() == source.GetEmittedCount(), "events were emitted that were never consumed");
+		passed &= Check(inputThread.GetDroppedCount() == 0, "the queue dropped events at 60 Hz");
+		passed &= Check(unordered == 0, "events were consumed out of order");
+		passed &= Check(!taps.empty() && missed > 0, "no tap falls between frames, the scenario doesn't test short taps");
+		passed &= Check(p50 < frameMs, "half the events waited longer than a frame");
+
+		return passed;
+	}
+}
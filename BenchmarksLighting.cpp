@@ -0,0 +1,1214 @@
+#include "BenchmarkUtils.h"
+#include "HeadlessRenderContext.h"
+#include "LightClusters.h"
+#include "ObjectLightSelector.h"
+#include "LightSpatialIndex.h"
+#include "LightExposure.h"
+#include "LightInfluenceMap.h"
+#include "LightUploader.h"
+#include "LightmapBaker.h"
+#include "IrradianceProbes.h"
+#include "TriangleBVH.h"
+#include "Vertex.h"
+#include "Lights.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <ppl.h>
+#include <vector>
+
+namespace Benchmarks
+{
+	// ----------------------------------------------------
+	// Clustered light assignment
+	// ----------------------------------------------------
+
+	// Point and spot lights scattered through the view, ranges similar to the level's lights
+	std::vector<Light> MakeBenchmarkLights(unsigned int count, unsigned int seed)
+	{
+		using namespace DirectX;
+
+		std::vector<Light> lights(count);
+		for (Light& light : lights)
+		{
+			light = {};
+			light.color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+			light.intensity = 1.0f;
+			light.position = XMFLOAT3(RandomFloat(seed) * 80.0f - 40.0f, RandomFloat(seed) * 40.0f - 20.0f, RandomFloat(seed) * 90.0f);
+			light.range = 1.0f + RandomFloat(seed) * 4.0f;
+			light.type = RandomFloat(seed) < 0.5f ? LIGHT_TYPE_POINT : LIGHT_TYPE_SPOT;
+			if (light.type == LIGHT_TYPE_SPOT)
+			{
+				XMVECTOR direction = XMVectorSet(RandomFloat(seed) - 0.5f, RandomFloat(seed) - 0.5f, RandomFloat(seed) - 0.5f, 0.0f);
+				XMStoreFloat3(&light.direction, XMVector3Normalize(XMVectorAdd(direction, XMVectorSet(0.0f, 0.0f, 0.001f, 0.0f))));
+				light.spotFalloff = 2.0f + RandomFloat(seed) * 38.0f;
+			}
+		}
+		return lights;
+	}
+
+	// Same test the shaders apply: does the light add anything at this point
+	bool LightReaches(const Light& light, const DirectX::XMFLOAT3& point)
+	{
+		using namespace DirectX;
+
+		if (light.type == LIGHT_TYPE_DIR || light.type == LIGHT_TYPE_AMBIENT)
+			return true;
+
+		XMVECTOR toPoint = XMVectorSubtract(XMLoadFloat3(&point), XMLoadFloat3(&light.position));
+		float distance = XMVectorGetX(XMVector3Length(toPoint));
+		if (distance >= light.range)
+			return false;
+
+		if (light.type != LIGHT_TYPE_SPOT || distance == 0.0f)
+			return true;
+
+		float cosAngle = XMVectorGetX(XMVector3Dot(XMVectorScale(toPoint, 1.0f / distance), XMLoadFloat3(&light.direction)));
+		return cosAngle > 0.0f && powf(cosAngle, light.spotFalloff) > LIGHT_SPOT_CUTOFF;
+	}
+
+	// ----------------------------------------------------
+	// Assigns thousands of point and spot lights to the
+	// cluster grid. Checks random pixels against a brute
+	// force loop (every light reaching the pixel has to be
+	// in its cluster), then times the assignment.
+	// ----------------------------------------------------
+	bool RunClusterBenchmark()
+	{
+		using namespace DirectX;
+
+		const unsigned int screenWidth = 1280;
+		const unsigned int screenHeight = 720;
+		const unsigned int lightCounts[] = { 1024, 4096, 8192 };
+		const int frames = 50;
+		const int samples = 20000;
+
+		XMFLOAT4X4 view, proj, inverseView;
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(0.0f, 1.7f, -5.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+		XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(XM_PIDIV4, (float)screenWidth / screenHeight, 0.01f, 100.0f));
+		XMStoreFloat4x4(&inverseView, XMMatrixInverse(nullptr, XMLoadFloat4x4(&view)));
+
+		LightClusters clusters;
+		clusters.SetProjection(proj, screenWidth, screenHeight);
+
+		bool passed = true;
+		for (unsigned int lightCount : lightCounts)
+		{
+			std::vector<Light> lights = MakeBenchmarkLights(lightCount, 4242 + lightCount);
+
+			// one light everything sees, like the level's ambient light
+			lights[0].type = LIGHT_TYPE_AMBIENT;
+
+			clusters.Assign(lights.data(), lightCount, view);
+
+			unsigned int seed = 99;
+			unsigned int missing = 0;
+			unsigned long long reachingLights = 0;
+			unsigned long long clusterLights = 0;
+			for (int i = 0; i < samples; ++i)
+			{
+				// random pixel at a random depth, back to world space
+				float pixelX = RandomFloat(seed) * screenWidth;
+				float pixelY = RandomFloat(seed) * screenHeight;
+				float depth = 0.05f + RandomFloat(seed) * 95.0f;
+				float ndcX = pixelX / screenWidth * 2.0f - 1.0f;
+				float ndcY = 1.0f - pixelY / screenHeight * 2.0f;
+				XMVECTOR viewPoint = XMVectorSet(ndcX * depth / proj._11, ndcY * depth / proj._22, depth, 1.0f);
+				XMFLOAT3 point;
+				XMStoreFloat3(&point, XMVector3TransformCoord(viewPoint, XMLoadFloat4x4(&inverseView)));
+
+				const LightClusterRange& range = clusters.GetRanges()[clusters.FindCluster(pixelX, pixelY, depth)];
+				const unsigned int* list = clusters.GetIndices().data() + range.offset;
+				clusterLights += range.count;
+
+				for (unsigned int l = 0; l < lightCount; ++l)
+				{
+					if (!LightReaches(lights[l], point))
+						continue;
+
+					reachingLights++;
+					bool found = false;
+					for (unsigned int c = 0; c < range.count && !found; ++c)
+						found = list[c] == l;
+					missing += found ? 0 : 1;
+				}
+			}
+
+			BenchmarkTimer timer;
+			for (int frame = 0; frame < frames; ++frame)
+				clusters.Assign(lights.data(), lightCount, view);
+			double assignMs = timer.ElapsedMs() / frames;
+
+			printf("    %5u lights  assign %8.3f ms  %7zu indices  lights per pixel: all %u, clustered %.2f, reaching %.2f\n",
+				lightCount, assignMs, clusters.GetIndices().size(), lightCount,
+				(double)clusterLights / samples, (double)reachingLights / samples);
+
+			passed &= Check(missing == 0, "a light reaching a pixel is missing from its cluster");
+			passed &= Check(clusters.GetOverflowCount() == 0, "a cluster ran out of space");
+		}
+
+		return passed;
+	}
+
+	// ----------------------------------------------------
+	// Per object light selection
+	// ----------------------------------------------------
+
+	// Scalar version of ObjectLightSelector's scoring for a world space box
+	float ReferenceLightScore(const Light& light, const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax)
+	{
+		using namespace DirectX;
+
+		if (light.type == LIGHT_TYPE_DIR || light.type == LIGHT_TYPE_AMBIENT)
+			return FLT_MAX;
+
+		float closest[3] = {
+			(std::max)(boxMin.x, (std::min)(light.position.x, boxMax.x)),
+			(std::max)(boxMin.y, (std::min)(light.position.y, boxMax.y)),
+			(std::max)(boxMin.z, (std::min)(light.position.z, boxMax.z)) };
+		float dx = closest[0] - light.position.x;
+		float dy = closest[1] - light.position.y;
+		float dz = closest[2] - light.position.z;
+		float attenuation = (std::max)(0.0f, 1.0f - (dx * dx + dy * dy + dz * dz) / (light.range * light.range));
+		float luminance = light.color.x * 0.299f + light.color.y * 0.587f + light.color.z * 0.114f;
+		float score = attenuation * attenuation * light.intensity * luminance;
+
+		if (light.type == LIGHT_TYPE_SPOT && score > 0.0f)
+		{
+			XMVECTOR center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&boxMin), XMLoadFloat3(&boxMax)), 0.5f);
+			float radius = XMVectorGetX(XMVector3Length(XMVectorScale(XMVectorSubtract(XMLoadFloat3(&boxMax), XMLoadFloat3(&boxMin)), 0.5f)));
+			XMVECTOR toCenter = XMVectorSubtract(center, XMLoadFloat3(&light.position));
+			float alongAxis = XMVectorGetX(XMVector3Dot(toCenter, XMLoadFloat3(&light.direction)));
+			float offAxis = sqrtf((std::max)(0.0f, XMVectorGetX(XMVector3LengthSq(toCenter)) - alongAxis * alongAxis));
+			float cosAngle = SpotCutoffCos(light);
+			float sinAngle = sqrtf(1.0f - cosAngle * cosAngle);
+			if (cosAngle * offAxis - alongAxis * sinAngle > radius || alongAxis < -radius)
+				score = 0.0f;
+		}
+		return score;
+	}
+
+	// ----------------------------------------------------
+	// Picks the strongest lights for thousands of objects
+	// at growing scene light counts. Checks a few objects
+	// against a brute force sort, times the selection and
+	// estimates the pixel shader cost of each mode.
+	// ----------------------------------------------------
+	bool RunObjectLightBenchmark()
+	{
+		using namespace DirectX;
+
+		const unsigned int lightCounts[] = { 16, 64, 256, 1024, 4096 };
+		const size_t objectCount = 2048;
+		const int frames = 20;
+		const double pixels = 1280.0 * 720.0;
+
+		// unit cubes spread through the same volume as the lights
+		std::vector<XMFLOAT4X4> worlds(objectCount);
+		unsigned int seed = 31337;
+		for (XMFLOAT4X4& world : worlds)
+		{
+			float scale = 0.5f + RandomFloat(seed) * 2.0f;
+			XMMATRIX matrix = XMMatrixMultiply(XMMatrixScaling(scale, scale, scale), XMMatrixRotationY(RandomFloat(seed) * XM_2PI));
+			matrix = XMMatrixMultiply(matrix, XMMatrixTranslation(RandomFloat(seed) * 80.0f - 40.0f, RandomFloat(seed) * 40.0f - 20.0f, RandomFloat(seed) * 90.0f));
+			XMStoreFloat4x4(&world, matrix);
+		}
+		XMFLOAT3 boundsMin(-0.5f, -0.5f, -0.5f);
+		XMFLOAT3 boundsMax(0.5f, 0.5f, 0.5f);
+
+		std::vector<ObjectLights> selections(objectCount);
+		std::vector<unsigned int> reaching(objectCount);
+		ObjectLightSelector selector;
+
+		bool passed = true;
+		for (unsigned int lightCount : lightCounts)
+		{
+			std::vector<Light> lights = MakeBenchmarkLights(lightCount, 777 + lightCount);
+			lights[0].type = LIGHT_TYPE_AMBIENT;
+
+			BenchmarkTimer timer;
+			for (int frame = 0; frame < frames; ++frame)
+			{
+				selector.BeginFrame(lights.data(), lightCount);
+				Concurrency::parallel_for(size_t(0), objectCount, [&](size_t i)
+				{
+					reaching[i] = selector.Select(boundsMin, boundsMax, worlds[i], selections[i]);
+				});
+			}
+			double selectMs = timer.ElapsedMs() / frames;
+
+			// brute force: score everything, sort, compare the top of the list
+			unsigned int mismatches = 0;
+			for (size_t i = 0; i < objectCount; i += 97)
+			{
+				XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+				XMVECTOR worldMin = XMVectorReplicate(FLT_MAX);
+				XMVECTOR worldMax = XMVectorReplicate(-FLT_MAX);
+				for (int corner = 0; corner < 8; ++corner)
+				{
+					XMVECTOR point = XMVector3TransformCoord(XMVectorSet((corner & 1) ? 0.5f : -0.5f, (corner & 2) ? 0.5f : -0.5f, (corner & 4) ? 0.5f : -0.5f, 1.0f), world);
+					worldMin = XMVectorMin(worldMin, point);
+					worldMax = XMVectorMax(worldMax, point);
+				}
+				XMFLOAT3 boxMin, boxMax;
+				XMStoreFloat3(&boxMin, worldMin);
+				XMStoreFloat3(&boxMax, worldMax);
+
+				std::vector<std::pair<float, unsigned int>> scored;
+				for (unsigned int l = 0; l < lightCount; ++l)
+				{
+					float score = ReferenceLightScore(lights[l], boxMin, boxMax);
+					if (score > 0.0f)
+						scored.push_back(std::make_pair(score, l));
+				}
+				std::stable_sort(scored.begin(), scored.end(), [](const std::pair<float, unsigned int>& a, const std::pair<float, unsigned int>& b) { return a.first > b.first; });
+
+				size_t expected = (std::min)(scored.size(), (size_t)MAX_OBJECT_LIGHTS);
+				bool same = selections[i].count == expected && reaching[i] == scored.size();
+				for (size_t k = 0; k < expected && same; ++k)
+					same = memcmp(&selections[i].lights[k], &lights[scored[k].second], sizeof(Light)) == 0;
+				mismatches += same ? 0 : 1;
+			}
+
+			double selected = 0;
+			double reached = 0;
+			size_t truncated = 0;
+			for (size_t i = 0; i < objectCount; ++i)
+			{
+				selected += selections[i].count;
+				reached += reaching[i];
+				truncated += reaching[i] > MAX_OBJECT_LIGHTS ? 1 : 0;
+			}
+			selected /= objectCount;
+			reached /= objectCount;
+
+			// every pixel of a 720p frame evaluating either the whole list or its object's selection
+			printf("    %5u lights  select %8.3f ms (%6.3f us/object)  lights per object: reaching %6.2f, selected %.2f, truncated %4.1f%%\n",
+				lightCount, selectMs, selectMs * 1000.0 / objectCount, reached, selected, 100.0 * truncated / objectCount);
+			printf("                  est. light evaluations per 720p frame: all %7.1fM, per object %5.1fM\n",
+				pixels * lightCount / 1e6, pixels * selected / 1e6);
+
+			passed &= Check(mismatches == 0, "selection differs from the brute force top list");
+		}
+
+		return passed;
+	}
+
+	// ----------------------------------------------------
+	// Gameplay "which lights reach this point" queries over
+	// 10k lights. Checks every query against a brute force
+	// loop, then times the grid build, the queries and two
+	// lights moving per frame like the ghosts do.
+	// ----------------------------------------------------
+	bool RunLightIndexBenchmark()
+	{
+		using namespace DirectX;
+
+		const unsigned int lightCount = 10000;
+		const size_t queryCount = 100000;
+		const size_t bruteForceCount = 2000;
+		const int frames = 20;
+
+		std::vector<Light> lights = MakeBenchmarkLights(lightCount, 4242);
+		lights[0].type = LIGHT_TYPE_AMBIENT;
+		lights[1].type = LIGHT_TYPE_DIR;
+
+		std::vector<XMFLOAT3> points(queryCount);
+		unsigned int seed = 9001;
+		for (XMFLOAT3& point : points)
+			point = XMFLOAT3(RandomFloat(seed) * 80.0f - 40.0f, RandomFloat(seed) * 40.0f - 20.0f, RandomFloat(seed) * 90.0f);
+
+		LightSpatialIndex index;
+		BenchmarkTimer buildTimer;
+		for (int frame = 0; frame < frames; ++frame)
+			index.Build(lights.data(), lightCount);
+		double buildMs = buildTimer.ElapsedMs() / frames;
+
+		// the grid has to match brute force exactly, directional and ambient lights excluded
+		std::vector<unsigned int> found;
+		std::vector<unsigned int> expected;
+		unsigned int mismatches = 0;
+		auto verify = [&](size_t first, size_t count)
+		{
+			for (size_t i = first; i < first + count; ++i)
+			{
+				index.Query(points[i], found);
+				expected.clear();
+				for (unsigned int l = 0; l < lightCount; ++l)
+				{
+					if ((lights[l].type == LIGHT_TYPE_POINT || lights[l].type == LIGHT_TYPE_SPOT) && LightReaches(lights[l], points[i]))
+						expected.push_back(l);
+				}
+				std::sort(found.begin(), found.end());
+				mismatches += found == expected ? 0 : 1;
+			}
+		};
+		verify(0, queryCount / 10);
+
+		size_t hits = 0;
+		BenchmarkTimer queryTimer;
+		for (const XMFLOAT3& point : points)
+		{
+			index.Query(point, found);
+			hits += found.size();
+		}
+		double queryMs = queryTimer.ElapsedMs();
+
+		BenchmarkTimer parallelTimer;
+		const size_t chunkCount = 64;
+		Concurrency::parallel_for(size_t(0), chunkCount, [&](size_t chunk)
+		{
+			std::vector<unsigned int> result;
+			for (size_t i = chunk * queryCount / chunkCount; i < (chunk + 1) * queryCount / chunkCount; ++i)
+				index.Query(points[i], result);
+		});
+		double parallelMs = parallelTimer.ElapsedMs();
+
+		BenchmarkTimer bruteTimer;
+		size_t bruteHits = 0;
+		for (size_t i = 0; i < bruteForceCount; ++i)
+		{
+			for (unsigned int l = 0; l < lightCount; ++l)
+				bruteHits += LightReaches(lights[l], points[i]) ? 1 : 0;
+		}
+		double bruteMs = bruteTimer.ElapsedMs() * queryCount / bruteForceCount;
+
+		// two lights wandering around, queried after every move
+		BenchmarkTimer moveTimer;
+		for (int frame = 0; frame < frames * 10; ++frame)
+		{
+			for (unsigned int l = 2; l < 4; ++l)
+			{
+				lights[l].position.x += RandomFloat(seed) - 0.5f;
+				lights[l].position.z += RandomFloat(seed) - 0.5f;
+				index.UpdateLight(l, lights[l]);
+			}
+			index.Query(lights[2].position, found);
+		}
+		double moveMs = moveTimer.ElapsedMs() / (frames * 10);
+		verify(0, bruteForceCount);
+
+		printf("    %u lights, %u cells, %u grid builds\n", index.GetLightCount(), index.GetCellCount(), index.GetBuildCount());
+		printf("    build %8.3f ms   %zu queries: grid %8.3f ms (%.3f us/query), parallel %8.3f ms, brute force (est.) %9.1f ms\n",
+			buildMs, queryCount, queryMs, queryMs * 1000.0 / queryCount, parallelMs, bruteMs);
+		printf("    %.2f lights per query   2 moving lights update+query %.4f ms/frame\n", (double)hits / queryCount, moveMs);
+
+		bool passed = Check(mismatches == 0, "grid query differs from brute force");
+		passed &= Check(bruteHits > 0, "brute force found no lights");
+		return passed;
+	}
+
+	// Scalar version of LightExposure's falloff, straight from ShaderIncludes.hlsli
+	float ReferenceExposure(const Light* lights, unsigned int lightCount, const DirectX::XMFLOAT3& point)
+	{
+		float exposure = 0.0f;
+		for (unsigned int l = 0; l < lightCount; ++l)
+		{
+			const Light& light = lights[l];
+			if ((light.type != LIGHT_TYPE_POINT && light.type != LIGHT_TYPE_SPOT) || light.range <= 0.0f)
+				continue;
+
+			float x = point.x - light.position.x;
+			float y = point.y - light.position.y;
+			float z = point.z - light.position.z;
+			float distSq = x * x + y * y + z * z;
+			float attenuation = (std::max)(0.0f, 1.0f - distSq / (light.range * light.range));
+			float penumbra = 1.0f;
+			if (light.type == LIGHT_TYPE_SPOT)
+			{
+				float distance = sqrtf(distSq);
+				float cosAngle = distance > 0.0f ? (x * light.direction.x + y * light.direction.y + z * light.direction.z) / distance : 0.0f;
+				penumbra = powf((std::min)((std::max)(cosAngle, 0.0f), 1.0f), light.spotFalloff);
+			}
+			float luminance = light.color.x * 0.299f + light.color.y * 0.587f + light.color.z * 0.114f;
+			exposure += attenuation * attenuation * penumbra * light.intensity * luminance;
+		}
+		return exposure;
+	}
+
+	// ----------------------------------------------------
+	// Stealth exposure at thousands of points per frame: a
+	// sample grid over the floor of the light volume and
+	// the same amount of scattered points. Checks against
+	// a scalar loop, then times the batched SIMD kernel and
+	// grid query + candidate evaluation per point.
+	// ----------------------------------------------------
+	bool RunExposureBenchmark()
+	{
+		using namespace DirectX;
+
+		const unsigned int lightCounts[] = { 256, 1024, 4096 };
+		const size_t gridSize = 64;
+		const size_t pointCount = gridSize * gridSize;
+		const int frames = 20;
+
+		std::vector<XMFLOAT3> gridPoints(pointCount);
+		std::vector<XMFLOAT3> scatteredPoints(pointCount);
+		unsigned int seed = 555;
+		for (size_t i = 0; i < pointCount; ++i)
+		{
+			gridPoints[i] = XMFLOAT3((i % gridSize) * 80.0f / gridSize - 40.0f, -5.0f, (i / gridSize) * 90.0f / gridSize);
+			scatteredPoints[i] = XMFLOAT3(RandomFloat(seed) * 80.0f - 40.0f, RandomFloat(seed) * 40.0f - 20.0f, RandomFloat(seed) * 90.0f);
+		}
+
+		std::vector<float> exposures(pointCount);
+		LightExposure exposure;
+		LightSpatialIndex index;
+		std::vector<unsigned int> candidates;
+
+		bool passed = true;
+		for (unsigned int lightCount : lightCounts)
+		{
+			std::vector<Light> lights = MakeBenchmarkLights(lightCount, 99 + lightCount);
+			lights[0].type = LIGHT_TYPE_AMBIENT;
+			exposure.SetLights(lights.data(), lightCount);
+			index.Build(lights.data(), lightCount);
+
+			const std::vector<XMFLOAT3>* pointSets[] = { &gridPoints, &scatteredPoints };
+			const char* setNames[] = { "grid", "scattered" };
+			for (int set = 0; set < 2; ++set)
+			{
+				const std::vector<XMFLOAT3>& points = *pointSets[set];
+
+				BenchmarkTimer batchTimer;
+				for (int frame = 0; frame < frames; ++frame)
+					exposure.Evaluate(points.data(), pointCount, exposures.data());
+				double batchMs = batchTimer.ElapsedMs() / frames;
+
+				// lights past the spot cutoff are left out of the candidates, so those sums can be a bit lower
+				unsigned int mismatches = 0;
+				unsigned int candidateMismatches = 0;
+				for (size_t i = 0; i < pointCount; ++i)
+				{
+					float reference = ReferenceExposure(lights.data(), lightCount, points[i]);
+					mismatches += fabsf(exposures[i] - reference) <= 1e-3f + reference * 1e-3f ? 0 : 1;
+
+					index.Query(points[i], candidates);
+					float candidate = exposure.Evaluate(points[i], candidates.data(), (unsigned int)candidates.size());
+					candidateMismatches += fabsf(candidate - reference) <= 1e-2f + reference * 1e-2f ? 0 : 1;
+				}
+
+				BenchmarkTimer referenceTimer;
+				float sum = 0.0f;
+				for (size_t i = 0; i < pointCount; ++i)
+					sum += ReferenceExposure(lights.data(), lightCount, points[i]);
+				double referenceMs = referenceTimer.ElapsedMs();
+
+				BenchmarkTimer candidateTimer;
+				for (int frame = 0; frame < frames; ++frame)
+				{
+					for (size_t i = 0; i < pointCount; ++i)
+					{
+						index.Query(points[i], candidates);
+						exposures[i] = exposure.Evaluate(points[i], candidates.data(), (unsigned int)candidates.size());
+					}
+				}
+				double candidateMs = candidateTimer.ElapsedMs() / frames;
+
+				printf("    %5u lights %-9s %zu points: batch %7.3f ms  index+candidates %7.3f ms  scalar %8.3f ms  mean exposure %.3f\n",
+					lightCount, setNames[set], pointCount, batchMs, candidateMs, referenceMs, sum / pointCount);
+
+				passed &= Check(mismatches == 0, "batched exposure differs from the scalar loop");
+				passed &= Check(candidateMismatches == 0, "candidate exposure differs from the scalar loop");
+			}
+		}
+
+		return passed;
+	}
+
+	// ----------------------------------------------------
+	// Scene light uploads with two lights moving every frame
+	// and the odd other light changing. Applies the recorded
+	// uploads to a shadow copy to check the GPU side always
+	// matches, and compares the bytes against the old full
+	// light array copy into both pixel shaders.
+	// ----------------------------------------------------
+	bool RunLightUploadBenchmark()
+	{
+		const unsigned int lightCount = 128;	// MAX_LIGHTS_IN_SCENE
+		const int frames = 1000;
+
+		std::vector<Light> lights = MakeBenchmarkLights(lightCount, 2024);
+		std::vector<Light> gpuLights(lightCount);
+		LightUploader uploader(lightCount);
+		HeadlessRenderContext context;
+		ID3D11Buffer* buffer = (ID3D11Buffer*)&gpuLights;
+
+		uploader.MarkDirty(0, lightCount);
+
+		unsigned int seed = 17;
+		unsigned long long bytes = 0;
+		unsigned int ranges = 0;
+		unsigned int mismatchedFrames = 0;
+		double uploadMs = 0;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			// the ghost lights, plus now and then some other light
+			for (unsigned int l = 0; l < 2; ++l)
+			{
+				lights[l].position.x += RandomFloat(seed) - 0.5f;
+				uploader.MarkDirty(l);
+			}
+			if (frame % 10 == 0)
+			{
+				unsigned int l = 2 + (unsigned int)(RandomFloat(seed) * (lightCount - 2));
+				lights[l].intensity = RandomFloat(seed);
+				uploader.MarkDirty(l);
+			}
+
+			context.Reset();
+			BenchmarkTimer timer;
+			bytes += uploader.Upload(&context, buffer, lights.data());
+			uploadMs += timer.ElapsedMs();
+			ranges += uploader.GetLastRangeCount();
+
+			for (const RenderCommand& command : context.GetCommands())
+			{
+				if (command.type == RenderCommandType::UpdateBufferRange)
+					memcpy((unsigned char*)gpuLights.data() + command.slot, context.GetUploadData(command), command.count);
+			}
+			mismatchedFrames += memcmp(gpuLights.data(), lights.data(), sizeof(Light) * lightCount) == 0 ? 0 : 1;
+		}
+
+		// before, the whole array went into both lit pixel shaders every frame
+		unsigned long long fullBytes = 2ull * sizeof(Light) * lightCount * frames;
+		printf("    %u lights, %d frames: %.1f bytes/frame in %.2f ranges/frame (%.4f ms), full copies %.1f bytes/frame\n",
+			lightCount, frames, (double)bytes / frames, (double)ranges / frames, uploadMs / frames, (double)fullBytes / frames);
+
+		bool passed = Check(mismatchedFrames == 0, "GPU light copy out of sync");
+		passed &= Check(bytes < fullBytes / 10, "partial uploads didn't save anything");
+		return passed;
+	}
+
+	// ----------------------------------------------------
+	// Lightmap baking
+	// ----------------------------------------------------
+
+	// 24 x 4 x 24 room facing inwards with six pillars, lit by a grid of baked point lights and an ambient light
+	struct BenchmarkRoom
+	{
+		std::vector<Vertex> roomVertices, pillarVertices;
+		std::vector<unsigned int> roomIndices, pillarIndices;
+		std::vector<LightmapInstance> instances;
+		std::vector<Light> lights;
+		std::vector<DirectX::XMFLOAT3> corners;	// world space, three per triangle
+	};
+
+	void MakeBenchmarkRoom(BenchmarkRoom& room)
+	{
+		using namespace DirectX;
+
+		AddBenchmarkQuad(room.roomVertices, room.roomIndices, XMFLOAT3(-12, 0, -12), XMFLOAT3(0, 0, 24), XMFLOAT3(24, 0, 0), 12, 12);
+		AddBenchmarkQuad(room.roomVertices, room.roomIndices, XMFLOAT3(-12, 4, -12), XMFLOAT3(24, 0, 0), XMFLOAT3(0, 0, 24), 12, 12);
+		AddBenchmarkQuad(room.roomVertices, room.roomIndices, XMFLOAT3(-12, 0, -12), XMFLOAT3(24, 0, 0), XMFLOAT3(0, 4, 0), 12, 4);
+		AddBenchmarkQuad(room.roomVertices, room.roomIndices, XMFLOAT3(12, 0, 12), XMFLOAT3(-24, 0, 0), XMFLOAT3(0, 4, 0), 12, 4);
+		AddBenchmarkQuad(room.roomVertices, room.roomIndices, XMFLOAT3(-12, 0, 12), XMFLOAT3(0, 0, -24), XMFLOAT3(0, 4, 0), 12, 4);
+		AddBenchmarkQuad(room.roomVertices, room.roomIndices, XMFLOAT3(12, 0, -12), XMFLOAT3(0, 0, 24), XMFLOAT3(0, 4, 0), 12, 4);
+
+		// 1 x 4 x 1, facing outwards
+		AddBenchmarkQuad(room.pillarVertices, room.pillarIndices, XMFLOAT3(-0.5f, 0, -0.5f), XMFLOAT3(0, 4, 0), XMFLOAT3(1, 0, 0), 4, 1);
+		AddBenchmarkQuad(room.pillarVertices, room.pillarIndices, XMFLOAT3(0.5f, 0, 0.5f), XMFLOAT3(0, 4, 0), XMFLOAT3(-1, 0, 0), 4, 1);
+		AddBenchmarkQuad(room.pillarVertices, room.pillarIndices, XMFLOAT3(-0.5f, 0, 0.5f), XMFLOAT3(0, 4, 0), XMFLOAT3(0, 0, -1), 4, 1);
+		AddBenchmarkQuad(room.pillarVertices, room.pillarIndices, XMFLOAT3(0.5f, 0, -0.5f), XMFLOAT3(0, 4, 0), XMFLOAT3(0, 0, 1), 4, 1);
+
+		LightmapInstance walls = { room.roomVertices.data(), (unsigned int)room.roomVertices.size(), room.roomIndices.data(), (unsigned int)room.roomIndices.size() };
+		XMStoreFloat4x4(&walls.world, XMMatrixIdentity());
+		walls.albedo = XMFLOAT3(0.6f, 0.6f, 0.6f);
+		room.instances.push_back(walls);
+		for (int i = 0; i < 6; ++i)
+		{
+			LightmapInstance pillar = { room.pillarVertices.data(), (unsigned int)room.pillarVertices.size(), room.pillarIndices.data(), (unsigned int)room.pillarIndices.size() };
+			XMStoreFloat4x4(&pillar.world, XMMatrixRotationY(i * 0.4f) * XMMatrixTranslation((i % 3) * 8.0f - 8.0f, 0, (i / 3) * 10.0f - 5.0f));
+			pillar.albedo = XMFLOAT3(0.8f, 0.3f + i * 0.1f, 0.3f);
+			room.instances.push_back(pillar);
+		}
+
+		room.lights.assign(10, Light());
+		for (unsigned int i = 0; i < 9; ++i)
+		{
+			room.lights[i].type = LIGHT_TYPE_POINT;
+			room.lights[i].color = XMFLOAT3(1.0f, 0.9f, 0.8f);
+			room.lights[i].intensity = 1.5f;
+			room.lights[i].range = 9.0f;
+			room.lights[i].position = XMFLOAT3((i % 3) * 8.0f - 8.0f + 2.0f, 3.0f, (i / 3) * 8.0f - 8.0f);
+			room.lights[i].baked = 1;
+		}
+		room.lights[9].type = LIGHT_TYPE_AMBIENT;
+		room.lights[9].color = XMFLOAT3(1, 1, 1);
+		room.lights[9].intensity = 0.1f;
+		room.lights[9].baked = 1;
+
+		for (const LightmapInstance& instance : room.instances)
+		{
+			XMMATRIX world = XMLoadFloat4x4(&instance.world);
+			for (unsigned int i = 0; i < instance.indexCount; ++i)
+			{
+				XMFLOAT3 corner;
+				XMStoreFloat3(&corner, XMVector3TransformCoord(XMLoadFloat3(&instance.vertices[instance.indices[i]].Position), world));
+				room.corners.push_back(corner);
+			}
+		}
+	}
+
+	// Atlas texel over a point of a flat, y up instance with an identity world matrix, and the surface point at that texel's center
+	bool FindLightmapTexel(const LightmapBaker& baker, unsigned int instance, const std::vector<Vertex>& vertices, const DirectX::XMFLOAT3& point, unsigned int& texel, DirectX::XMFLOAT3& texelPoint)
+	{
+		using namespace DirectX;
+
+		const std::vector<XMFLOAT2>& uvs = baker.GetLightmapUVs(instance);
+		const float size = (float)baker.GetAtlasSize();
+		for (size_t corner = 0; corner + 2 < vertices.size(); corner += 3)
+		{
+			const XMFLOAT3* p[3] = { &vertices[corner].Position, &vertices[corner + 1].Position, &vertices[corner + 2].Position };
+			float area = (p[1]->x - p[0]->x) * (p[2]->z - p[0]->z) - (p[2]->x - p[0]->x) * (p[1]->z - p[0]->z);
+			float w1 = ((point.x - p[0]->x) * (p[2]->z - p[0]->z) - (p[2]->x - p[0]->x) * (point.z - p[0]->z)) / area;
+			float w2 = ((p[1]->x - p[0]->x) * (point.z - p[0]->z) - (point.x - p[0]->x) * (p[1]->z - p[0]->z)) / area;
+			if (w1 < 0.0f || w2 < 0.0f || w1 + w2 > 1.0f)
+				continue;
+
+			// into the atlas, then back from the texel center
+			const XMFLOAT2* uv = &uvs[corner];
+			float u = (1.0f - w1 - w2) * uv[0].x + w1 * uv[1].x + w2 * uv[2].x;
+			float v = (1.0f - w1 - w2) * uv[0].y + w1 * uv[1].y + w2 * uv[2].y;
+			unsigned int x = (unsigned int)(u * size), y = (unsigned int)(v * size);
+			texel = y * baker.GetAtlasSize() + x;
+
+			float cu = (x + 0.5f) / size, cv = (y + 0.5f) / size;
+			float uvArea = (uv[1].x - uv[0].x) * (uv[2].y - uv[0].y) - (uv[2].x - uv[0].x) * (uv[1].y - uv[0].y);
+			float c1 = ((cu - uv[0].x) * (uv[2].y - uv[0].y) - (uv[2].x - uv[0].x) * (cv - uv[0].y)) / uvArea;
+			float c2 = ((uv[1].x - uv[0].x) * (cv - uv[0].y) - (cu - uv[0].x) * (uv[1].y - uv[0].y)) / uvArea;
+			texelPoint = XMFLOAT3(
+				(1.0f - c1 - c2) * p[0]->x + c1 * p[1]->x + c2 * p[2]->x,
+				(1.0f - c1 - c2) * p[0]->y + c1 * p[1]->y + c2 * p[2]->y,
+				(1.0f - c1 - c2) * p[0]->z + c1 * p[1]->z + c2 * p[2]->z);
+			return true;
+		}
+		return false;
+	}
+
+	// ----------------------------------------------------
+	// Bakes a closed room with pillars at every worker count
+	// up to the core count and checks the results are the
+	// same. Also checks the BVH against a brute force ray
+	// cast, and on a lone floor under one point light that a
+	// texel matches the shader's falloff and a blocker
+	// shadows the floor under it.
+	// ----------------------------------------------------
+	bool RunLightmapBenchmark()
+	{
+		using namespace DirectX;
+
+		BenchmarkRoom room;
+		MakeBenchmarkRoom(room);
+		const std::vector<LightmapInstance>& instances = room.instances;
+		const std::vector<Light>& lights = room.lights;
+		const std::vector<XMFLOAT3>& corners = room.corners;
+
+		bool passed = true;
+
+		// BVH closest hits against every triangle
+		{
+			TriangleBVH bvh;
+			for (size_t i = 0; i < corners.size(); i += 3)
+				bvh.AddTriangle(corners[i], corners[i + 1], corners[i + 2]);
+
+			BenchmarkTimer buildTimer;
+			bvh.Build();
+			double buildMs = buildTimer.ElapsedMs();
+
+			const unsigned int rayCount = 2000;
+			unsigned int seed = 8080;
+			unsigned int mismatches = 0;
+			double bvhMs = 0, bruteMs = 0;
+			for (unsigned int r = 0; r < rayCount; ++r)
+			{
+				XMFLOAT3 origin(RandomFloat(seed) * 22.0f - 11.0f, RandomFloat(seed) * 3.6f + 0.2f, RandomFloat(seed) * 22.0f - 11.0f);
+				XMFLOAT3 direction;
+				XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSet(RandomFloat(seed) - 0.5f, RandomFloat(seed) - 0.5f, RandomFloat(seed) - 0.5f, 0)));
+
+				BenchmarkTimer bvhTimer;
+				RayHit hit;
+				float distance = bvh.Intersect(origin, direction, FLT_MAX, hit) ? hit.distance : FLT_MAX;
+				bvhMs += bvhTimer.ElapsedMs();
+
+				BenchmarkTimer bruteTimer;
+				float reference = BruteForceRayDistance(corners, origin, direction);
+				bruteMs += bruteTimer.ElapsedMs();
+
+				mismatches += fabsf(distance - reference) <= 1e-3f ? 0 : 1;
+			}
+
+			printf("    BVH over %u triangles, %u nodes, built in %.2f ms: %u rays %.3f ms, brute force %.3f ms\n",
+				bvh.GetTriangleCount(), bvh.GetNodeCount(), buildMs, rayCount, bvhMs, bruteMs);
+			passed &= Check(mismatches == 0, "BVH closest hit differs from the brute force one");
+		}
+
+		// the same bake at every worker count, at least two of them so there's something to compare
+		const unsigned int maxWorkers = (std::max)(WorkerCount(), 2u);
+		std::vector<XMFLOAT4> firstTexels;
+		double firstMs = 0;
+		for (unsigned int workers = 1; ; workers *= 2)
+		{
+			workers = (std::min)(workers, maxWorkers);
+
+			LightmapBaker baker;
+			for (const LightmapInstance& instance : instances)
+				baker.AddInstance(instance);
+
+			LightmapSettings settings;
+			settings.workerCount = workers;
+			BenchmarkTimer timer;
+			bool baked = baker.Bake(lights.data(), (unsigned int)lights.size(), settings);
+			double ms = timer.ElapsedMs();
+			if (!Check(baked, "room didn't fit the atlas"))
+				return false;
+
+			if (firstTexels.empty())
+			{
+				firstTexels = baker.GetTexels();
+				firstMs = ms;
+			}
+
+			printf("    %2u workers: %8.1f ms (charts %.1f, direct %.1f, bounce %.1f), %.2fx, %u texels at %.1f per unit\n",
+				workers, ms, baker.GetChartMs(), baker.GetDirectMs(), baker.GetBounceMs(), firstMs / ms, baker.GetCoveredTexelCount(), baker.GetTexelsPerUnit());
+			passed &= Check(memcmp(baker.GetTexels().data(), firstTexels.data(), firstTexels.size() * sizeof(XMFLOAT4)) == 0, "lightmap depends on the worker count");
+
+			if (workers == maxWorkers)
+				break;
+		}
+
+		// one point light over a floor with a blocker next to it
+		{
+			std::vector<Vertex> floorVertices, blockerVertices;
+			std::vector<unsigned int> floorIndices, blockerIndices;
+			AddBenchmarkQuad(floorVertices, floorIndices, XMFLOAT3(-5, 0, -5), XMFLOAT3(0, 0, 10), XMFLOAT3(10, 0, 0), 1, 1);
+			AddBenchmarkQuad(blockerVertices, blockerIndices, XMFLOAT3(1, 1, -0.5f), XMFLOAT3(1, 0, 0), XMFLOAT3(0, 0, 1), 1, 1);
+
+			LightmapBaker baker;
+			LightmapInstance floor = { floorVertices.data(), (unsigned int)floorVertices.size(), floorIndices.data(), (unsigned int)floorIndices.size() };
+			XMStoreFloat4x4(&floor.world, XMMatrixIdentity());
+			floor.albedo = XMFLOAT3(0.5f, 0.5f, 0.5f);
+			LightmapInstance blocker = floor;
+			blocker.vertices = blockerVertices.data();
+			blocker.indices = blockerIndices.data();
+			baker.AddInstance(floor);
+			baker.AddInstance(blocker);
+
+			Light light = {};
+			light.type = LIGHT_TYPE_POINT;
+			light.color = XMFLOAT3(1, 1, 1);
+			light.intensity = 2.0f;
+			light.range = 6.0f;
+			light.position = XMFLOAT3(0, 2, 0);
+			light.baked = 1;
+
+			LightmapSettings settings;
+			settings.atlasSize = 256;
+			settings.bounceRays = 0;
+			passed &= Check(baker.Bake(&light, 1, settings), "floor didn't fit the atlas");
+
+			unsigned int litTexel = 0, shadowedTexel = 0;
+			XMFLOAT3 litPoint, shadowedPoint;
+			bool found = FindLightmapTexel(baker, 0, floorVertices, XMFLOAT3(-3, 0, 0), litTexel, litPoint);
+			found &= FindLightmapTexel(baker, 0, floorVertices, XMFLOAT3(3, 0, 0), shadowedTexel, shadowedPoint);
+			passed &= Check(found, "floor point outside its triangles");
+
+			if (found)
+			{
+				// Diffuse() * Attenuate() * intensity from ShaderIncludes.hlsli
+				XMVECTOR toLight = XMLoadFloat3(&light.position) - XMLoadFloat3(&litPoint);
+				float distance = XMVectorGetX(XMVector3Length(toLight));
+				float attenuation = (std::max)(0.0f, 1.0f - distance * distance / (light.range * light.range));
+				float expected = (std::max)(0.0f, XMVectorGetY(toLight) / distance) * attenuation * attenuation * light.intensity;
+
+				float lit = baker.GetTexels()[litTexel].x;
+				float shadowed = baker.GetTexels()[shadowedTexel].x;
+				printf("    floor texel %.4f (expected %.4f), in the blocker's shadow %.4f\n", lit, expected, shadowed);
+				passed &= Check(fabsf(lit - expected) <= 1e-3f, "lit texel doesn't match the shader's falloff");
+				passed &= Check(shadowed < lit * 0.1f, "blocker doesn't shadow the floor");
+			}
+		}
+
+		return passed;
+	}
+
+	// ----------------------------------------------------
+	// Irradiance probes over the lightmap benchmark's room
+	// at a few spacings and worker counts, then per entity
+	// lookups against evaluating every light with a shadow
+	// ray, which is what a moving object needs without
+	// them. Checks the bake doesn't depend on the worker
+	// count, a probe's SH against the light it saw, the
+	// trilinear blend, and that a blocker shadows a probe.
+	// ----------------------------------------------------
+	bool RunProbeBenchmark()
+	{
+		using namespace DirectX;
+
+		BenchmarkRoom room;
+		MakeBenchmarkRoom(room);
+		TriangleBVH bvh;
+		for (size_t i = 0; i < room.corners.size(); i += 3)
+			bvh.AddTriangle(room.corners[i], room.corners[i + 1], room.corners[i + 2]);
+		bvh.Build();
+
+		const XMFLOAT3 roomMin(-12, 0, -12), roomMax(12, 4, 12);
+		const unsigned int maxWorkers = (std::max)(WorkerCount(), 2u);
+		bool passed = true;
+
+		IrradianceProbes probes;
+		const float spacings[] = { 2.0f, 1.0f, 0.5f };
+		for (float spacing : spacings)
+		{
+			std::vector<IrradianceSH> first;
+			double firstMs = 0;
+			for (unsigned int workers = 1; ; workers *= 2)
+			{
+				workers = (std::min)(workers, maxWorkers);
+
+				IrradianceProbeSettings settings;
+				settings.spacing = spacing;
+				settings.workerCount = workers;
+				probes.Bake(roomMin, roomMax, room.lights.data(), (unsigned int)room.lights.size(), bvh, settings);
+
+				std::vector<IrradianceSH> baked;
+				for (unsigned int z = 0; z < probes.GetCountZ(); ++z)
+					for (unsigned int y = 0; y < probes.GetCountY(); ++y)
+						for (unsigned int x = 0; x < probes.GetCountX(); ++x)
+							baked.push_back(probes.GetProbe(x, y, z));
+				if (first.empty())
+				{
+					first = baked;
+					firstMs = probes.GetBakeMs();
+				}
+
+				printf("    spacing %.1f, %5u probes, %2u workers: %8.2f ms, %.2fx\n",
+					spacing, probes.GetProbeCount(), workers, probes.GetBakeMs(), firstMs / probes.GetBakeMs());
+				passed &= Check(memcmp(baked.data(), first.data(), first.size() * sizeof(IrradianceSH)) == 0, "probes depend on the worker count");
+
+				if (workers == maxWorkers)
+					break;
+			}
+		}
+
+		// lookups at the last spacing, against the light loop with shadow rays
+		{
+			const unsigned int pointCount = 4096;
+			const int frames = 50;
+			std::vector<XMFLOAT3> points(pointCount);
+			std::vector<XMFLOAT3> normals(pointCount);
+			unsigned int seed = 31337;
+			for (unsigned int i = 0; i < pointCount; ++i)
+			{
+				points[i] = XMFLOAT3(RandomFloat(seed) * 22.0f - 11.0f, RandomFloat(seed) * 3.0f + 0.5f, RandomFloat(seed) * 22.0f - 11.0f);
+				XMStoreFloat3(&normals[i], XMVector3Normalize(XMVectorSet(RandomFloat(seed) - 0.5f, RandomFloat(seed) - 0.5f, RandomFloat(seed) - 0.5f, 0)));
+			}
+
+			float probeSum = 0.0f;
+			IrradianceSH sh;
+			BenchmarkTimer probeTimer;
+			for (int frame = 0; frame < frames; ++frame)
+			{
+				for (unsigned int i = 0; i < pointCount; ++i)
+				{
+					probes.Sample(points[i], sh);
+					probeSum += IrradianceProbes::Evaluate(sh, normals[i]).x;
+				}
+			}
+			double probeMs = probeTimer.ElapsedMs() / frames;
+
+			float loopSum = 0.0f;
+			BenchmarkTimer loopTimer;
+			for (unsigned int i = 0; i < pointCount; ++i)
+			{
+				for (const Light& light : room.lights)
+				{
+					if (light.type == LIGHT_TYPE_AMBIENT)
+					{
+						loopSum += light.intensity * light.color.x;
+						continue;
+					}
+
+					XMVECTOR offset = XMLoadFloat3(&light.position) - XMLoadFloat3(&points[i]);
+					float distance = XMVectorGetX(XMVector3Length(offset));
+					if (distance >= light.range)
+						continue;
+
+					XMFLOAT3 toLight;
+					XMStoreFloat3(&toLight, XMVectorScale(offset, 1.0f / distance));
+					float attenuation = 1.0f - distance * distance / (light.range * light.range);
+					float diffuse = (std::max)(0.0f, XMVectorGetX(XMVector3Dot(XMLoadFloat3(&normals[i]), XMLoadFloat3(&toLight))));
+					if (diffuse > 0.0f && !bvh.Occluded(points[i], toLight, distance))
+						loopSum += diffuse * attenuation * attenuation * light.intensity * light.color.x;
+				}
+			}
+			double loopMs = loopTimer.ElapsedMs();
+
+			printf("    %u lookups: probes %.3f ms (%.1f ns each), light loop with shadow rays %.3f ms, mean red %.3f vs %.3f\n",
+				pointCount, probeMs, probeMs * 1e6 / pointCount, loopMs, probeSum / (pointCount * frames), loopSum / pointCount);
+		}
+
+		// one point light over a blocker, a probe right under it
+		{
+			std::vector<Vertex> blockerVertices;
+			std::vector<unsigned int> blockerIndices;
+			AddBenchmarkQuad(blockerVertices, blockerIndices, XMFLOAT3(-0.5f, 1, -0.5f), XMFLOAT3(1, 0, 0), XMFLOAT3(0, 0, 1), 1, 1);
+			TriangleBVH blocker;
+			for (size_t i = 0; i < blockerVertices.size(); i += 3)
+				blocker.AddTriangle(blockerVertices[i].Position, blockerVertices[i + 1].Position, blockerVertices[i + 2].Position);
+			blocker.Build();
+
+			Light light = {};
+			light.type = LIGHT_TYPE_POINT;
+			light.color = XMFLOAT3(1, 1, 1);
+			light.intensity = 2.0f;
+			light.range = 6.0f;
+			light.position = XMFLOAT3(0, 2, 0);
+			light.baked = 1;
+
+			IrradianceProbeSettings settings;
+			IrradianceProbes single;
+			single.Bake(XMFLOAT3(-3, 0, -3), XMFLOAT3(3, 0, 3), &light, 1, blocker, settings);
+
+			// probe at (2, 0, 0), in the open
+			XMFLOAT3 open(2, 0, 0);
+			XMVECTOR offset = XMLoadFloat3(&light.position) - XMLoadFloat3(&open);
+			float distance = XMVectorGetX(XMVector3Length(offset));
+			float attenuation = 1.0f - distance * distance / (light.range * light.range);
+			float expected = attenuation * attenuation * light.intensity;
+
+			IrradianceSH sh;
+			single.Sample(open, sh);
+			XMFLOAT3 toLight, awayFromLight;
+			XMStoreFloat3(&toLight, XMVector3Normalize(offset));
+			XMStoreFloat3(&awayFromLight, XMVectorNegate(XMVector3Normalize(offset)));
+			float facing = IrradianceProbes::Evaluate(sh, toLight).x;
+			float away = IrradianceProbes::Evaluate(sh, awayFromLight).x;
+
+			// L2 of the clamped cosine overshoots by 1/16 facing the light and rings by 1/16 away from it
+			passed &= Check(fabsf(facing - expected * 1.0625f) <= 1e-3f, "probe facing the light doesn't match its falloff");
+			passed &= Check(fabsf(away - expected * 0.0625f) <= 1e-3f, "probe away from the light doesn't match its falloff");
+
+			IrradianceSH under;
+			single.Sample(XMFLOAT3(0, 0, 0), under);
+			float shadowed = IrradianceProbes::Evaluate(under, XMFLOAT3(0, 1, 0)).x;
+			printf("    probe facing the light %.4f (expected %.4f), away %.4f, under the blocker %.4f\n", facing, expected * 1.0625f, away, shadowed);
+			passed &= Check(shadowed == 0.0f, "blocker doesn't shadow the probe");
+
+			// halfway between two probes is the mean of both
+			IrradianceSH left, right, middle;
+			single.Sample(XMFLOAT3(1, 0, 0), left);
+			single.Sample(XMFLOAT3(2, 0, 0), right);
+			single.Sample(XMFLOAT3(1.5f, 0, 0), middle);
+			bool blended = true;
+			for (int c = 0; c < IRRADIANCE_SH_COEFFICIENTS; ++c)
+				blended &= fabsf(middle.coefficients[c].x - 0.5f * (left.coefficients[c].x + right.coefficients[c].x)) <= 1e-5f;
+			passed &= Check(blended, "sample between probes isn't their trilinear blend");
+		}
+
+		return passed;
+	}
+
+
+	// ----------------------------------------------------
+	// Exposure map over 8 x 8 rooms with a baked light in
+	// each and four ghost like spot lights moving through,
+	// against querying the lights at every point
+	// ----------------------------------------------------
+	bool RunInfluenceBenchmark()
+	{
+		using namespace DirectX;
+
+		const unsigned int roomsPerSide = 8;
+		const float roomSize = 10.0f;
+		const unsigned int movingCount = 4;
+		const int frames = 300;
+		const float deltaTime = 1.0f / 60.0f;
+		bool passed = true;
+
+		std::vector<XMFLOAT3> corners;
+		MakeBenchmarkLevel(roomsPerSide, roomSize, corners);
+		TriangleBVH bvh;
+		for (size_t i = 0; i + 2 < corners.size(); i += 3)
+			bvh.AddTriangle(corners[i], corners[i + 1], corners[i + 2]);
+		bvh.Build();
+
+		// the moving ones first, like the ghost lights. The map goes from the floor to head height
+		std::vector<Light> lights(movingCount);
+		for (unsigned int i = 0; i < movingCount; ++i)
+		{
+			lights[i].color = XMFLOAT3(1.0f, 0.2f, 0.2f);
+			lights[i].type = LIGHT_TYPE_SPOT;
+			lights[i].direction = XMFLOAT3(0.0f, 0.0f, -1.0f);
+			lights[i].range = 15.0f;
+			lights[i].intensity = 5.0f;
+			lights[i].spotFalloff = 25.0f;
+		}
+		unsigned int seed = 808;
+		for (unsigned int z = 0; z < roomsPerSide; ++z)
+		{
+			for (unsigned int x = 0; x < roomsPerSide; ++x)
+			{
+				Light light = {};
+				light.color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+				light.type = LIGHT_TYPE_POINT;
+				light.range = 3.0f + RandomFloat(seed) * 3.0f;
+				light.intensity = 1.0f + RandomFloat(seed);
+				light.position = XMFLOAT3((x + 0.2f + RandomFloat(seed) * 0.6f) * roomSize, 2.5f, (z + 0.2f + RandomFloat(seed) * 0.6f) * roomSize);
+				light.baked = 1;
+				lights.push_back(light);
+			}
+		}
+		Light ambient = {};
+		ambient.type = LIGHT_TYPE_AMBIENT;
+		ambient.intensity = 0.1f;
+		lights.push_back(ambient);
+		const unsigned int lightCount = (unsigned int)lights.size();
+
+		// the moving lights circle around the level at ghost height, pointing where they go
+		auto moveLights = [&](float time)
+		{
+			for (unsigned int i = 0; i < movingCount; ++i)
+			{
+				float angle = time * 0.1f + i * XM_2PI / movingCount;
+				float radius = roomsPerSide * roomSize * (0.2f + 0.06f * i);
+				lights[i].position = XMFLOAT3(40.0f + radius * cosf(angle), 1.5f, 40.0f + radius * sinf(angle));
+				lights[i].direction = XMFLOAT3(-sinf(angle), 0.0f, cosf(angle));
+			}
+		};
+		moveLights(0.0f);
+
+		XMFLOAT3 boundsMin(0.0f, 0.0f, 0.0f);
+		XMFLOAT3 boundsMax(roomsPerSide * roomSize, 2.5f, roomsPerSide * roomSize);
+		LightInfluenceMap unshadowed;
+		unshadowed.Bake(boundsMin, boundsMax, lights.data(), lightCount, nullptr, LightInfluenceSettings());
+		LightInfluenceMap map;
+		map.Bake(boundsMin, boundsMax, lights.data(), lightCount, &bvh, LightInfluenceSettings());
+		printf("    %u x %u x %u nodes %.2f apart, %u baked lights: bake %.1f ms unshadowed, %.1f ms with %u triangles in the way, %u threads\n",
+			map.GetCountX(), map.GetCountY(), map.GetCountZ(), map.GetSpacing(), lightCount - movingCount - 1,
+			unshadowed.GetBakeMs(), map.GetBakeMs(), bvh.GetTriangleCount(), map.GetWorkerCount());
+
+		// every node unshadowed is the plain exposure of every light there, shadows only take light away
+		LightExposure exposure;
+		exposure.SetLights(lights.data(), lightCount);
+		std::vector<unsigned int> allLights(lightCount);
+		for (unsigned int i = 0; i < lightCount; ++i)
+			allLights[i] = i;
+		unsigned int wrongNodes = 0, brighterNodes = 0, litNodes = 0, shadowedNodes = 0;
+		for (unsigned int z = 0; z < map.GetCountZ(); ++z)
+		{
+			for (unsigned int y = 0; y < map.GetCountY(); ++y)
+			{
+				for (unsigned int x = 0; x < map.GetCountX(); ++x)
+				{
+					XMFLOAT3 node(x * map.GetSpacing(), y * map.GetSpacing(), z * map.GetSpacing());
+					float expected = exposure.Evaluate(node, allLights.data(), lightCount);
+					wrongNodes += fabsf(unshadowed.GetExposure(x, y, z) - expected) > 1e-4f * (1.0f + expected);
+					brighterNodes += map.GetStatic(x, y, z) > unshadowed.GetStatic(x, y, z) + 1e-6f;
+					litNodes += unshadowed.GetStatic(x, y, z) > 0.0f;
+					shadowedNodes += map.GetStatic(x, y, z) < unshadowed.GetStatic(x, y, z) - 1e-6f;
+				}
+			}
+		}
+		printf("    %u nodes not matching LightExposure, %u brighter with shadows; walls shade %.1f%% of the lit nodes\n",
+			wrongNodes, brighterNodes, litNodes ? 100.0 * shadowedNodes / litNodes : 0.0);
+		passed &= Check(wrongNodes == 0, "unshadowed map differs from LightExposure");
+		passed &= Check(brighterNodes == 0, "shadows added light");
+		passed &= Check(shadowedNodes > 0, "no node in a shadow");
+
+		// the same moving lights over every node
+		std::vector<XMFLOAT3> nodes;
+		for (unsigned int z = 0; z < map.GetCountZ(); ++z)
+			for (unsigned int y = 0; y < map.GetCountY(); ++y)
+				for (unsigned int x = 0; x < map.GetCountX(); ++x)
+					nodes.push_back(XMFLOAT3(x * map.GetSpacing(), y * map.GetSpacing(), z * map.GetSpacing()));
+		std::vector<float> nodeExposure(nodes.size());
+		LightExposure movingExposure;
+		movingExposure.SetLights(lights.data(), movingCount);
+		BenchmarkTimer fullTimer;
+		movingExposure.Evaluate(nodes.data(), nodes.size(), nodeExposure.data());
+		double fullMs = fullTimer.ElapsedMs();
+		printf("    %u moving spot lights over every node: %.2f ms\n", movingCount, fullMs);
+
+		// the light spot lights leave past their cone isn't redone, at most LIGHT_SPOT_CUTOFF of each
+		float tailBound = 0.0f;
+		for (unsigned int i = 0; i < movingCount; ++i)
+			tailBound += lights[i].intensity * (lights[i].color.x * 0.299f + lights[i].color.y * 0.587f + lights[i].color.z * 0.114f) * LIGHT_SPOT_CUTOFF;
+
+		// moving lights, only the nodes around them again. Every change, then with the default tolerance
+		const float tolerances[] = { 0.0f, LightInfluenceSettings().moveTolerance };
+		for (float tolerance : tolerances)
+		{
+			LightInfluenceSettings settings;
+			settings.moveTolerance = tolerance;
+			moveLights(0.0f);
+			LightInfluenceMap moving;
+			moving.Bake(boundsMin, boundsMax, lights.data(), lightCount, &bvh, settings);
+
+			double updateMs = 0.0, worstMs = 0.0;
+			unsigned long long updatedNodes = 0;
+			for (int frame = 1; frame <= frames; ++frame)
+			{
+				moveLights(frame * deltaTime);
+				moving.UpdateDynamic(lights.data(), lightCount);
+				updateMs += moving.GetUpdateMs();
+				worstMs = (std::max)(worstMs, moving.GetUpdateMs());
+				updatedNodes += moving.GetUpdatedNodeCount();
+			}
+
+			// updated bit by bit against a fresh bake with the lights where they ended
+			LightInfluenceMap fresh;
+			fresh.Bake(boundsMin, boundsMax, lights.data(), lightCount, &bvh, settings);
+			float worstDifference = 0.0f;
+			for (unsigned int z = 0; z < map.GetCountZ(); ++z)
+				for (unsigned int y = 0; y < map.GetCountY(); ++y)
+					for (unsigned int x = 0; x < map.GetCountX(); ++x)
+						worstDifference = (std::max)(worstDifference, fabsf(moving.GetExposure(x, y, z) - fresh.GetExposure(x, y, z)));
+			printf("    tolerance %.2f, %d frames: %.3f ms per update (worst %.3f), %llu of %u nodes; off a fresh bake by %.4f at most\n",
+				tolerance, frames, updateMs / frames, worstMs, updatedNodes / frames, moving.GetNodeCount(), worstDifference);
+			passed &= Check(updateMs / frames < fullMs, "incremental updates slower than redoing every node");
+			if (tolerance == 0.0f)
+				passed &= Check(worstDifference <= tailBound, "incremental updates drift from a fresh bake");
+		}
+
+		// a stealth check per point: the map against the light index and LightExposure
+		const unsigned int sampleCount = 1000000;
+		std::vector<XMFLOAT3> points(sampleCount);
+		for (XMFLOAT3& point : points)
+			point = XMFLOAT3(RandomFloat(seed) * boundsMax.x, 0.5f + RandomFloat(seed) * 1.5f, RandomFloat(seed) * boundsMax.z);
+		exposure.SetLights(lights.data(), lightCount);
+		LightSpatialIndex index;
+		index.Build(lights.data(), lightCount);
+		std::vector<unsigned int> candidates;
+
+		float sum = 0.0f;
+		BenchmarkTimer sampleTimer;
+		for (const XMFLOAT3& point : points)
+			sum += map.Sample(point);
+		double sampleMs = sampleTimer.ElapsedMs();
+		BenchmarkTimer queryTimer;
+		for (const XMFLOAT3& point : points)
+		{
+			index.Query(point, candidates);
+			sum += exposure.Evaluate(point, candidates.data(), (unsigned int)candidates.size());
+		}
+		double queryMs = queryTimer.ElapsedMs();
+
+		// trilinear blending against the exact value, without shadows on either side
+		unshadowed.UpdateDynamic(lights.data(), lightCount);
+		double error = 0.0, exact = 0.0;
+		for (unsigned int i = 0; i < 10000; ++i)
+		{
+			index.Query(points[i], candidates);
+			float expected = exposure.Evaluate(points[i], candidates.data(), (unsigned int)candidates.size());
+			error += fabsf(unshadowed.Sample(points[i]) - expected);
+			exact += expected;
+		}
+		printf("    %u points: map %.1f ns each, light index + LightExposure %.1f ns each (%.1fx); blending off by %.1f%% on average (%g)\n",
+			sampleCount, sampleMs * 1e6 / sampleCount, queryMs * 1e6 / sampleCount, queryMs / sampleMs, exact > 0.0 ? 100.0 * error / exact : 0.0, sum);
+		passed &= Check(sampleMs < queryMs, "sampling the map is slower than querying the lights");
+
+		return passed;
+	}
+}
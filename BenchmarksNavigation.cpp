@@ -0,0 +1,967 @@
+#include "BenchmarkUtils.h"
+#include "TriangleBVH.h"
+#include "AISystem.h"
+#include "NavMesh.h"
+#include "FlowField.h"
+#include "NavHierarchy.h"
+#include "PathRequestService.h"
+#include "SimpleAI.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace Benchmarks
+{
+	// ----------------------------------------------------
+	// Navigation
+	// ----------------------------------------------------
+
+	// Dijkstra over the same moves as NavMeshQuery, for checking its costs
+	float ReferencePathCost(const NavMesh& navMesh, unsigned int start, unsigned int goal)
+	{
+		std::vector<float> cost(navMesh.GetSpanCount(), FLT_MAX);
+		typedef std::pair<float, unsigned int> Entry;
+		std::vector<Entry> heap;
+		auto later = [](const Entry& a, const Entry& b) { return a.first > b.first; };
+		auto relax = [&](unsigned int span, float c)
+		{
+			if (c < cost[span])
+			{
+				cost[span] = c;
+				heap.push_back(Entry(c, span));
+				std::push_heap(heap.begin(), heap.end(), later);
+			}
+		};
+
+		relax(start, 0.0f);
+		while (!heap.empty())
+		{
+			std::pop_heap(heap.begin(), heap.end(), later);
+			Entry entry = heap.back();
+			heap.pop_back();
+			if (entry.first > cost[entry.second])
+				continue;
+			if (entry.second == goal)
+				return entry.first;
+
+			for (unsigned int d = 0; d < 4; ++d)
+			{
+				unsigned int side = navMesh.GetNeighbour(entry.second, d);
+				if (side == NAV_NO_SPAN)
+					continue;
+				relax(side, entry.first + 1.0f);
+
+				unsigned int e = (d + 1) & 3;
+				unsigned int otherSide = navMesh.GetNeighbour(entry.second, e);
+				if (otherSide != NAV_NO_SPAN && navMesh.GetNeighbour(side, e) != NAV_NO_SPAN && navMesh.GetNeighbour(side, e) == navMesh.GetNeighbour(otherSide, d))
+					relax(navMesh.GetNeighbour(side, e), entry.first + 1.41421356f);
+			}
+		}
+		return FLT_MAX;
+	}
+
+	// Cost of a floor path in cells, straight steps 1 and diagonal ones sqrt(2)
+	float SpanPathCost(const NavMesh& navMesh, const std::vector<unsigned int>& spanPath)
+	{
+		float cost = 0.0f;
+		for (size_t i = 1; i < spanPath.size(); ++i)
+		{
+			bool diagonal = navMesh.GetSpanX(spanPath[i]) != navMesh.GetSpanX(spanPath[i - 1]) && navMesh.GetSpanZ(spanPath[i]) != navMesh.GetSpanZ(spanPath[i - 1]);
+			cost += diagonal ? 1.41421356f : 1.0f;
+		}
+		return cost;
+	}
+
+	// ----------------------------------------------------
+	// Builds the navmesh of a level, checks A* against
+	// Dijkstra and the smoothed paths against the walls,
+	// then times random queries between connected floors
+	// ----------------------------------------------------
+	bool RunNavMeshLevel(const char* label, const std::vector<DirectX::XMFLOAT3>& corners, unsigned int queryCount)
+	{
+		using namespace DirectX;
+		bool passed = true;
+
+		NavMesh navMesh;
+		TriangleBVH walls;
+		for (size_t i = 0; i + 2 < corners.size(); i += 3)
+		{
+			navMesh.AddTriangle(corners[i], corners[i + 1], corners[i + 2]);
+			walls.AddTriangle(corners[i], corners[i + 1], corners[i + 2]);
+		}
+		walls.Build();
+
+		NavMeshSettings settings;
+		if (!Check(navMesh.Build(settings), "nothing walkable"))
+			return false;
+		printf("    %s: %u triangles, %u x %u columns, %u floors in %u regions, built in %.1f ms\n",
+			label, navMesh.GetTriangleCount(), navMesh.GetWidth(), navMesh.GetDepth(), navMesh.GetSpanCount(), navMesh.GetRegionCount(), navMesh.GetBuildMs());
+
+		// pairs of random floors in the same region
+		unsigned int seed = 1234;
+		std::vector<std::pair<unsigned int, unsigned int>> pairs;
+		while (pairs.size() < queryCount)
+		{
+			unsigned int a = (unsigned int)(RandomFloat(seed) * navMesh.GetSpanCount());
+			unsigned int b = (unsigned int)(RandomFloat(seed) * navMesh.GetSpanCount());
+			if (navMesh.GetRegion(a) == navMesh.GetRegion(b))
+				pairs.push_back(std::make_pair(a, b));
+		}
+
+		NavMeshQuery query(navMesh);
+		std::vector<unsigned int> spanPath;
+		std::vector<XMFLOAT3> path;
+
+		// optimal floor paths, and smoothed ones that stay off the walls at half the agent's height
+		unsigned int suboptimal = 0, throughWalls = 0, failed = 0;
+		const unsigned int checkedCount = (std::min)(20u, queryCount);
+		for (unsigned int q = 0; q < checkedCount; ++q)
+		{
+			if (!query.FindSpanPath(pairs[q].first, pairs[q].second, spanPath))
+			{
+				failed++;
+				continue;
+			}
+			float reference = ReferencePathCost(navMesh, pairs[q].first, pairs[q].second);
+			suboptimal += fabsf(SpanPathCost(navMesh, spanPath) - reference) > 1e-3f * reference + 1e-4f;
+		}
+		for (unsigned int q = 0; q < queryCount; ++q)
+		{
+			if (!query.FindPath(navMesh.GetSpanPosition(pairs[q].first), navMesh.GetSpanPosition(pairs[q].second), path))
+			{
+				failed++;
+				continue;
+			}
+			for (size_t i = 1; i < path.size(); ++i)
+			{
+				XMVECTOR from = XMLoadFloat3(&path[i - 1]) + XMVectorSet(0, settings.agentHeight * 0.5f, 0, 0);
+				XMVECTOR offset = XMLoadFloat3(&path[i]) - XMLoadFloat3(&path[i - 1]);
+				float length = XMVectorGetX(XMVector3Length(offset));
+				if (length <= 0.0f)
+					continue;
+				XMFLOAT3 origin, direction;
+				XMStoreFloat3(&origin, from);
+				XMStoreFloat3(&direction, XMVectorScale(offset, 1.0f / length));
+				throughWalls += walls.Occluded(origin, direction, length);
+			}
+		}
+		printf("    %u paths failed, %u of %u floor paths longer than Dijkstra's, %u smoothed segments through a wall\n",
+			failed, suboptimal, checkedCount, throughWalls);
+		passed &= Check(failed == 0, "no path between connected floors");
+		passed &= Check(suboptimal == 0, "A* path isn't the shortest");
+		passed &= Check(throughWalls == 0, "smoothed path goes through a wall");
+
+		// throughput, floor paths alone and smoothed
+		unsigned long long expanded = 0, pathCorners = 0;
+		BenchmarkTimer searchTimer;
+		for (unsigned int q = 0; q < queryCount; ++q)
+		{
+			query.FindSpanPath(pairs[q].first, pairs[q].second, spanPath);
+			expanded += query.GetLastExpanded();
+		}
+		double searchMs = searchTimer.ElapsedMs();
+
+		BenchmarkTimer pathTimer;
+		for (unsigned int q = 0; q < queryCount; ++q)
+		{
+			query.FindPath(navMesh.GetSpanPosition(pairs[q].first), navMesh.GetSpanPosition(pairs[q].second), path);
+			pathCorners += path.size();
+		}
+		double pathMs = pathTimer.ElapsedMs();
+
+		printf("    %u queries: A* %.0f/s (%.1f us, %llu floors expanded each), smoothed %.0f/s (%.1f us, %.1f corners each)\n",
+			queryCount, queryCount * 1000.0 / searchMs, searchMs * 1000.0 / queryCount, expanded / queryCount,
+			queryCount * 1000.0 / pathMs, pathMs * 1000.0 / queryCount, (double)pathCorners / queryCount);
+		return passed;
+	}
+
+	bool RunNavMeshBenchmark()
+	{
+		using namespace DirectX;
+		bool passed = true;
+
+		std::vector<XMFLOAT3> corners;
+		if (Check(LoadShippedLevel(corners), "room models not found, run from the project folder"))
+			passed &= RunNavMeshLevel("shipped level", corners, 10000);
+		else
+			passed = false;
+
+		MakeBenchmarkLevel(20, 10.0f, corners);
+		passed &= RunNavMeshLevel("20 x 20 rooms", corners, 500);
+
+		// the other side of a wall is a detour through the doorway
+		{
+			MakeBenchmarkLevel(2, 10.0f, corners);
+			NavMesh navMesh;
+			for (size_t i = 0; i + 2 < corners.size(); i += 3)
+				navMesh.AddTriangle(corners[i], corners[i + 1], corners[i + 2]);
+			navMesh.Build(NavMeshSettings());
+
+			NavMeshQuery query(navMesh);
+			std::vector<XMFLOAT3> path;
+			XMFLOAT3 start(9.0f, 0.0f, 5.0f), goal(11.0f, 0.0f, 5.0f);
+			bool found = query.FindPath(start, goal, path);
+			float length = 0.0f;
+			for (size_t i = 1; i < path.size(); ++i)
+				length += XMVectorGetX(XMVector3Length(XMLoadFloat3(&path[i]) - XMLoadFloat3(&path[i - 1])));
+			printf("    across a wall: %zu corners, %.2f m for 2 m straight\n", path.size(), length);
+			passed &= Check(found && path.size() > 2 && length > 2.5f, "path goes straight through the wall");
+
+			// a ghost patrolling over there walks the same way
+			TriangleBVH walls;
+			for (size_t i = 0; i + 2 < corners.size(); i += 3)
+				walls.AddTriangle(corners[i], corners[i + 1], corners[i + 2]);
+			walls.Build();
+
+			AISystem system;
+			system.SetNavMesh(&navMesh);
+			XMFLOAT3 route[2] = { goal, start };
+			system.AddAgent(start, system.AddRoute(route, 2));
+			bool crossed = false, arrived = false;
+			int tick = 0;
+			for (; tick < 600 && !arrived; ++tick)
+			{
+				XMFLOAT3 before = system.GetPosition(0);
+				system.Update(XMFLOAT3(-100, 0, -100), 0.0f, 1.0f / 60.0f);
+				XMFLOAT3 after = system.GetPosition(0);
+				XMVECTOR offset = XMLoadFloat3(&after) - XMLoadFloat3(&before);
+				float step = XMVectorGetX(XMVector3Length(offset));
+				XMFLOAT3 origin(before.x, 1.0f, before.z), direction;
+				XMStoreFloat3(&direction, XMVectorScale(offset, 1.0f / (std::max)(step, 1e-6f)));
+				crossed |= step > 0.0f && walls.Occluded(origin, direction, step);
+				arrived = system.GetActiveRoute(0) == 1;
+			}
+			printf("    ghost reached the other side after %.2f s\n", tick / 60.0f);
+			passed &= Check(arrived && !crossed, "ghost doesn't walk around the wall");
+		}
+
+		return passed;
+	}
+
+	// True if b is one move of NavMeshQuery away from a, straight or diagonal around an open corner
+	bool IsSpanStep(const NavMesh& navMesh, unsigned int a, unsigned int b)
+	{
+		for (unsigned int d = 0; d < 4; ++d)
+		{
+			unsigned int side = navMesh.GetNeighbour(a, d);
+			if (side == NAV_NO_SPAN)
+				continue;
+			if (side == b)
+				return true;
+
+			unsigned int e = (d + 1) & 3;
+			unsigned int otherSide = navMesh.GetNeighbour(a, e);
+			if (otherSide != NAV_NO_SPAN && navMesh.GetNeighbour(side, e) == b && navMesh.GetNeighbour(otherSide, d) == b)
+				return true;
+		}
+		return false;
+	}
+
+	// ----------------------------------------------------
+	// Long queries across a generated level of rooms, flat
+	// A* against the room/portal hierarchy: the lazy path
+	// agents walk along and the fully refined one
+	// ----------------------------------------------------
+	bool RunNavHierarchyLevel(unsigned int roomsPerSide, unsigned int queryCount)
+	{
+		using namespace DirectX;
+		bool passed = true;
+
+		const float roomSize = 10.0f;
+		std::vector<XMFLOAT3> corners;
+		MakeBenchmarkLevel(roomsPerSide, roomSize, corners);
+		NavMesh navMesh;
+		TriangleBVH walls;
+		for (size_t i = 0; i + 2 < corners.size(); i += 3)
+		{
+			navMesh.AddTriangle(corners[i], corners[i + 1], corners[i + 2]);
+			walls.AddTriangle(corners[i], corners[i + 1], corners[i + 2]);
+		}
+		walls.Build();
+		NavMeshSettings navSettings;
+		if (!Check(navMesh.Build(navSettings), "nothing walkable"))
+			return false;
+
+		NavHierarchy rooms(navMesh);
+		for (unsigned int z = 0; z < roomsPerSide; ++z)
+		{
+			for (unsigned int x = 0; x < roomsPerSide; ++x)
+				rooms.AddRoom(XMFLOAT3(x * roomSize, -1.0f, z * roomSize), XMFLOAT3((x + 1) * roomSize, 3.0f, (z + 1) * roomSize));
+		}
+		rooms.Build(NavHierarchySettings());
+
+		// the same level cut into blocks of columns that know nothing of the rooms, 16 m so they don't line up with them
+		NavHierarchySettings blockSettings;
+		blockSettings.clusterColumns = 64;
+		NavHierarchy blocks(navMesh);
+		blocks.Build(blockSettings);
+
+		printf("    %u x %u rooms: %u floors, navmesh built in %.0f ms\n", roomsPerSide, roomsPerSide, navMesh.GetSpanCount(), navMesh.GetBuildMs());
+
+		unsigned int seed = 99;
+		std::vector<std::pair<unsigned int, unsigned int>> pairs;
+		while (pairs.size() < queryCount)
+		{
+			unsigned int a = (unsigned int)(RandomFloat(seed) * navMesh.GetSpanCount());
+			unsigned int b = (unsigned int)(RandomFloat(seed) * navMesh.GetSpanCount());
+			if (navMesh.GetRegion(a) == navMesh.GetRegion(b))
+				pairs.push_back(std::make_pair(a, b));
+		}
+
+		NavMeshQuery flat(navMesh);
+		std::vector<XMFLOAT3> path;
+		std::vector<unsigned int> spanPath;
+		std::vector<float> optimal(queryCount);
+		BenchmarkTimer flatTimer;
+		for (unsigned int q = 0; q < queryCount; ++q)
+			flat.FindPath(navMesh.GetSpanPosition(pairs[q].first), navMesh.GetSpanPosition(pairs[q].second), path);
+		double flatMs = flatTimer.ElapsedMs() / queryCount;
+		for (unsigned int q = 0; q < queryCount; ++q)
+		{
+			flat.FindSpanPath(pairs[q].first, pairs[q].second, spanPath);
+			optimal[q] = SpanPathCost(navMesh, spanPath);
+		}
+		printf("      flat A*: %.0f us per path\n", flatMs * 1000.0);
+
+		NavHierarchy* hierarchies[] = { &rooms, &blocks };
+		const char* labels[] = { "rooms", "blocks" };
+		for (int h = 0; h < 2; ++h)
+		{
+			NavHierarchy& hierarchy = *hierarchies[h];
+			NavHierarchyQuery query(hierarchy);
+
+			unsigned long long expanded = 0, nodes = 0;
+			BenchmarkTimer lazyTimer;
+			for (unsigned int q = 0; q < queryCount; ++q)
+			{
+				query.FindPath(navMesh.GetSpanPosition(pairs[q].first), navMesh.GetSpanPosition(pairs[q].second), path);
+				expanded += query.GetLastExpanded();
+				nodes += query.GetLastNodeCount();
+			}
+			double lazyMs = lazyTimer.ElapsedMs() / queryCount;
+
+			BenchmarkTimer refinedTimer;
+			for (unsigned int q = 0; q < queryCount; ++q)
+				query.FindSpanPath(pairs[q].first, pairs[q].second, spanPath);
+			double refinedMs = refinedTimer.ElapsedMs() / queryCount;
+
+			// refined paths are real moves from start to goal, a little longer than the shortest
+			unsigned int failed = 0, broken = 0, throughWalls = 0;
+			double overhead = 0.0, worst = 0.0;
+			for (unsigned int q = 0; q < queryCount; ++q)
+			{
+				if (!query.FindSpanPath(pairs[q].first, pairs[q].second, spanPath))
+				{
+					failed++;
+					continue;
+				}
+				bool valid = spanPath.front() == pairs[q].first && spanPath.back() == pairs[q].second;
+				for (size_t i = 1; i < spanPath.size() && valid; ++i)
+					valid = IsSpanStep(navMesh, spanPath[i - 1], spanPath[i]);
+				broken += !valid;
+
+				double ratio = optimal[q] > 0.0f ? SpanPathCost(navMesh, spanPath) / optimal[q] : 1.0;
+				overhead += ratio - 1.0;
+				worst = (std::max)(worst, ratio - 1.0);
+
+				// the segment agents walk, to the first corner
+				query.FindPath(navMesh.GetSpanPosition(pairs[q].first), navMesh.GetSpanPosition(pairs[q].second), path);
+				XMVECTOR from = XMLoadFloat3(&path[0]) + XMVectorSet(0, navSettings.agentHeight * 0.5f, 0, 0);
+				XMVECTOR offset = XMLoadFloat3(&path[1]) - XMLoadFloat3(&path[0]);
+				float length = XMVectorGetX(XMVector3Length(offset));
+				if (length > 0.0f)
+				{
+					XMFLOAT3 origin, direction;
+					XMStoreFloat3(&origin, from);
+					XMStoreFloat3(&direction, XMVectorScale(offset, 1.0f / length));
+					throughWalls += walls.Occluded(origin, direction, length);
+				}
+			}
+
+			printf("      %-6s %4u clusters, %5u nodes, %6u edges, %7u cached floors, built in %.0f ms\n",
+				labels[h], hierarchy.GetClusterCount(), hierarchy.GetNodeCount(), hierarchy.GetEdgeCount(), hierarchy.GetCachedSpanCount(), hierarchy.GetBuildMs());
+			printf("             %.0f us per path to the first portal (%.0fx), %.0f us refined (%.0fx), %llu nodes expanded, %.1f on the path, %.1f%% longer (worst %.1f%%)\n",
+				lazyMs * 1000.0, flatMs / lazyMs, refinedMs * 1000.0, flatMs / refinedMs, expanded / queryCount, (double)nodes / queryCount,
+				overhead / (queryCount - failed) * 100.0, worst * 100.0);
+			passed &= Check(failed == 0, "no hierarchical path between connected floors");
+			passed &= Check(broken == 0, "refined path isn't a walk from start to goal");
+			passed &= Check(throughWalls == 0, "first path segment goes through a wall");
+			passed &= Check(overhead / (queryCount - failed) < 0.1, "hierarchical paths are more than 10% longer on average");
+			passed &= Check(lazyMs * 5.0 < flatMs, "hierarchy isn't much faster than flat A*");
+		}
+		return passed;
+	}
+
+	bool RunNavHierarchyBenchmark()
+	{
+		using namespace DirectX;
+
+		bool passed = RunNavHierarchyLevel(20, 200);
+		passed &= RunNavHierarchyLevel(30, 100);
+
+		// a ghost patrolling to the far corner of 4 x 4 rooms follows the hierarchy's portals there
+		std::vector<XMFLOAT3> corners;
+		MakeBenchmarkLevel(4, 10.0f, corners);
+		NavMesh navMesh;
+		for (size_t i = 0; i + 2 < corners.size(); i += 3)
+			navMesh.AddTriangle(corners[i], corners[i + 1], corners[i + 2]);
+		navMesh.Build(NavMeshSettings());
+		NavHierarchy hierarchy(navMesh);
+		for (unsigned int z = 0; z < 4; ++z)
+		{
+			for (unsigned int x = 0; x < 4; ++x)
+				hierarchy.AddRoom(XMFLOAT3(x * 10.0f, -1.0f, z * 10.0f), XMFLOAT3(x * 10.0f + 10.0f, 3.0f, z * 10.0f + 10.0f));
+		}
+		hierarchy.Build(NavHierarchySettings());
+
+		AISystem system;
+		system.SetNavMesh(&navMesh);
+		system.SetNavHierarchy(&hierarchy);
+		XMFLOAT3 route[2] = { XMFLOAT3(35.0f, 0.0f, 35.0f), XMFLOAT3(5.0f, 0.0f, 5.0f) };
+		system.AddAgent(route[1], system.AddRoute(route, 2));
+		int tick = 0;
+		for (; tick < 60 * 60 && system.GetActiveRoute(0) == 0; ++tick)
+			system.Update(XMFLOAT3(-100, 0, -100), 0.0f, 1.0f / 60.0f);
+		printf("    ghost crossed 4 x 4 rooms corner to corner in %.2f s\n", tick / 60.0f);
+		passed &= Check(system.GetActiveRoute(0) == 1, "ghost didn't reach the far room");
+		return passed;
+	}
+
+	// ----------------------------------------------------
+	// Chasers spread around the player in the synthetic
+	// level, stepping along the player's flow field while
+	// the player walks, against one A* search per chaser
+	// ----------------------------------------------------
+	bool RunFlowFieldBenchmark()
+	{
+		using namespace DirectX;
+
+		const unsigned int chaserCount = 10000;
+		const float chaseDistance = 40.0f;
+		const int ticks = 600;
+		const float deltaTime = 1.0f / 60.0f;
+		bool passed = true;
+
+		std::vector<XMFLOAT3> corners;
+		MakeBenchmarkLevel(20, 10.0f, corners);
+		NavMesh navMesh;
+		for (size_t i = 0; i + 2 < corners.size(); i += 3)
+			navMesh.AddTriangle(corners[i], corners[i + 1], corners[i + 2]);
+		navMesh.Build(NavMeshSettings());
+
+		// the player walks 20 m through a few rooms from the middle of the level
+		NavMeshQuery query(navMesh);
+		std::vector<XMFLOAT3> playerPath;
+		query.FindPath(XMFLOAT3(105, 0, 105), XMFLOAT3(125, 0, 95), playerPath);
+		auto playerAt = [&](int tick)
+		{
+			float remaining = tick * deltaTime * 2.0f;
+			for (size_t i = 1; i < playerPath.size(); ++i)
+			{
+				XMVECTOR from = XMLoadFloat3(&playerPath[i - 1]);
+				XMVECTOR offset = XMLoadFloat3(&playerPath[i]) - from;
+				float length = XMVectorGetX(XMVector3Length(offset));
+				if (remaining <= length)
+				{
+					XMFLOAT3 position;
+					XMStoreFloat3(&position, from + XMVectorScale(offset, remaining / length));
+					return position;
+				}
+				remaining -= length;
+			}
+			return playerPath.back();
+		};
+
+		// every floor within the chase distance of the player's start is a spot for a chaser
+		FlowField fullField(navMesh, FlowFieldSettings());
+		fullField.SetTarget(playerAt(0));
+		std::vector<unsigned int> nearby;
+		for (unsigned int s = 0; s < navMesh.GetSpanCount(); ++s)
+		{
+			if (fullField.GetNextSpan(s) != NAV_NO_SPAN && fullField.GetCost(s) * navMesh.GetCellSize() <= chaseDistance)
+				nearby.push_back(s);
+		}
+		unsigned int seed = 99;
+		std::vector<unsigned int> chaserSpans(chaserCount);
+		std::vector<XMFLOAT3> chasers(chaserCount);
+		for (unsigned int i = 0; i < chaserCount; ++i)
+		{
+			chaserSpans[i] = nearby[(size_t)(RandomFloat(seed) * nearby.size())];
+			chasers[i] = navMesh.GetSpanPosition(chaserSpans[i]);
+		}
+
+		FlowFieldSettings settings;
+		settings.maxDistance = chaseDistance * 1.5f;
+		FlowField field(navMesh, settings);
+		field.SetTarget(playerAt(0));
+		printf("    %u floors, %u chasers within %.0f m: whole level field %.2f ms (%u floors), bounded to %.0f m %.2f ms (%u floors)\n",
+			navMesh.GetSpanCount(), chaserCount, chaseDistance, fullField.GetIntegrationMs(), fullField.GetReachedCount(),
+			settings.maxDistance, field.GetIntegrationMs(), field.GetReachedCount());
+
+		// following the field is a shortest path, as long as A*'s
+		unsigned int wrongCosts = 0, brokenChains = 0;
+		std::vector<unsigned int> spanPath;
+		for (unsigned int i = 0; i < 200; ++i)
+		{
+			unsigned int span = chaserSpans[i];
+			float walked = 0.0f;
+			unsigned int steps = 0;
+			while (span != field.GetTargetSpan() && span != NAV_NO_SPAN && steps++ < navMesh.GetSpanCount())
+			{
+				unsigned int nextSpan = field.GetNextSpan(span);
+				if (nextSpan == NAV_NO_SPAN)
+				{
+					span = NAV_NO_SPAN;
+					break;
+				}
+				bool diagonal = navMesh.GetSpanX(span) != navMesh.GetSpanX(nextSpan) && navMesh.GetSpanZ(span) != navMesh.GetSpanZ(nextSpan);
+				walked += diagonal ? 1.41421356f : 1.0f;
+				span = nextSpan;
+			}
+			brokenChains += span != field.GetTargetSpan();
+
+			query.FindSpanPath(chaserSpans[i], field.GetTargetSpan(), spanPath);
+			float optimal = SpanPathCost(navMesh, spanPath);
+			wrongCosts += fabsf(walked - optimal) > 1e-3f * optimal + 1e-4f || fabsf(field.GetCost(chaserSpans[i]) - optimal) > 1e-3f * optimal + 1e-4f;
+		}
+		printf("    200 chasers followed to the player: %u don't arrive, %u not on a shortest path\n", brokenChains, wrongCosts);
+		passed &= Check(brokenChains == 0, "field doesn't lead to the target");
+		passed &= Check(wrongCosts == 0, "field doesn't follow shortest paths");
+
+		// one A* per chaser, sampled
+		const unsigned int searchSamples = 200;
+		BenchmarkTimer searchTimer;
+		for (unsigned int i = 0; i < searchSamples; ++i)
+			query.FindSpanPath(chaserSpans[i], field.GetTargetSpan(), spanPath);
+		double searchFrameMs = searchTimer.ElapsedMs() / searchSamples * chaserCount;
+
+		// the chase
+		double integrationMs = 0.0, sampleMs = 0.0;
+		unsigned int integrations = 0, floorChanges = 0, lost = 0;
+		unsigned int lastTarget = field.GetTargetSpan();
+		for (int tick = 1; tick <= ticks; ++tick)
+		{
+			XMFLOAT3 player = playerAt(tick);
+			floorChanges += navMesh.FindSpan(player) != lastTarget;
+			lastTarget = navMesh.FindSpan(player);
+			if (field.SetTarget(player))
+			{
+				integrations++;
+				integrationMs += field.GetIntegrationMs();
+			}
+
+			BenchmarkTimer sampleTimer;
+			for (XMFLOAT3& chaser : chasers)
+			{
+				XMFLOAT3 steer;
+				if (!field.GetSteerTarget(chaser, steer))
+				{
+					lost++;
+					continue;
+				}
+				XMVECTOR offset = XMLoadFloat3(&steer) - XMLoadFloat3(&chaser);
+				float length = XMVectorGetX(XMVector3Length(offset));
+				if (length > 0.0f)
+					XMStoreFloat3(&chaser, XMLoadFloat3(&chaser) + XMVectorScale(offset, (std::min)(length, AI_GHOST_SPEED * deltaTime) / length));
+			}
+			sampleMs += sampleTimer.ElapsedMs();
+		}
+
+		unsigned int caught = 0;
+		XMFLOAT3 player = playerAt(ticks);
+		for (const XMFLOAT3& chaser : chasers)
+			caught += XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&chaser) - XMLoadFloat3(&player))) < 1.0f;
+
+		printf("    %d ticks: %u integrations for %u player floor changes, %.2f ms each\n",
+			ticks, integrations, floorChanges, integrations ? integrationMs / integrations : 0.0);
+		printf("    per tick: flow field %.3f ms (%.1f ns per chaser) + integration %.3f ms amortized, vs A* per chaser %.1f ms\n",
+			sampleMs / ticks, sampleMs * 1e6 / ((double)ticks * chaserCount), integrationMs / ticks, searchFrameMs);
+		printf("    %u chasers caught the player, %u samples off the field\n", caught, lost);
+		passed &= Check(integrations == floorChanges, "field integrated without the player changing floors");
+		passed &= Check(lost == 0, "chasers left the field");
+		passed &= Check(caught > 0, "no chaser caught up");
+
+		return passed;
+	}
+
+
+	// ----------------------------------------------------
+	// Ghosts patrolling between a few points of the large
+	// level, asking for a path per leg like SimpleAI does,
+	// over real time 60 Hz frames. Half of them start on the
+	// patrol route, half anywhere
+	// ----------------------------------------------------
+	struct PathServiceRun
+	{
+		PathRequestStats stats;
+		double mainMsPerFrame;
+		double searchMsPerFrame;
+		unsigned int badEnds;
+		unsigned int arrivals;
+	};
+
+	PathServiceRun RunPathServiceFrames(const NavMesh& navMesh, const NavHierarchy& hierarchy, const PathRequestSettings& settings,
+		const std::vector<DirectX::XMFLOAT3>& goals, unsigned int agentCount, int frames, PathRequestService** keep = nullptr)
+	{
+		using namespace DirectX;
+
+		// ten times ghost speed, legs are walked within the run
+		const float deltaTime = 1.0f / 60.0f;
+		const float speed = AI_GHOST_SPEED * 10.0f;
+		PathRequestService* service = new PathRequestService(navMesh, &hierarchy, settings);
+
+		struct Walker
+		{
+			XMFLOAT3 position;
+			XMFLOAT3 requestedFrom;
+			unsigned int requestedGoal;
+			unsigned int goal;
+			unsigned int ticket;
+			std::vector<XMFLOAT3> path;
+			size_t corner;
+		};
+		unsigned int seed = 4242;
+		std::vector<Walker> walkers(agentCount);
+		for (unsigned int i = 0; i < agentCount; ++i)
+		{
+			Walker& walker = walkers[i];
+			walker.goal = (unsigned int)(RandomFloat(seed) * goals.size());
+			if (i % 2 == 0)
+			{
+				const XMFLOAT3& from = goals[(walker.goal + goals.size() - 1) % goals.size()];
+				walker.position = XMFLOAT3(from.x + RandomFloat(seed) - 0.5f, from.y, from.z + RandomFloat(seed) - 0.5f);
+			}
+			else
+				walker.position = navMesh.GetSpanPosition((unsigned int)(RandomFloat(seed) * navMesh.GetSpanCount()));
+			walker.requestedGoal = walker.goal;
+			walker.ticket = PATH_NO_TICKET;
+			walker.corner = 0;
+		}
+
+		PathServiceRun run = {};
+		double mainMs = 0.0;
+		auto frameEnd = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			frameEnd += std::chrono::microseconds(16667);
+			BenchmarkTimer mainTimer;
+			service->Update();
+			for (Walker& walker : walkers)
+			{
+				if (walker.ticket != PATH_NO_TICKET && service->GetStatus(walker.ticket) != PathStatus::PENDING)
+				{
+					if (service->TakePath(walker.ticket, walker.path))
+					{
+						const XMFLOAT3& goal = goals[walker.requestedGoal];
+						bool startOk = memcmp(&walker.path.front(), &walker.requestedFrom, sizeof(XMFLOAT3)) == 0;
+						bool goalOk = memcmp(&walker.path.back(), &goal, sizeof(XMFLOAT3)) == 0;
+						run.badEnds += !startOk || !goalOk;
+					}
+					walker.ticket = PATH_NO_TICKET;
+					walker.corner = 1;
+				}
+				if (walker.ticket == PATH_NO_TICKET && (walker.path.empty() || walker.requestedGoal != walker.goal))
+				{
+					walker.requestedFrom = walker.position;
+					walker.requestedGoal = walker.goal;
+					walker.ticket = service->Request(walker.position, goals[walker.goal]);
+				}
+
+				// waits for the first path of a leg, then corner by corner and the goal itself once past the last one
+				XMFLOAT3 target = walker.path.empty() ? walker.position : goals[walker.goal];
+				while (walker.corner + 1 < walker.path.size())
+				{
+					float dx = walker.path[walker.corner].x - walker.position.x;
+					float dz = walker.path[walker.corner].z - walker.position.z;
+					if (dx * dx + dz * dz > AI_CORNER_REACHED_SQ)
+					{
+						target = walker.path[walker.corner];
+						break;
+					}
+					walker.corner++;
+				}
+				float dx = target.x - walker.position.x;
+				float dz = target.z - walker.position.z;
+				float distance = sqrtf(dx * dx + dz * dz);
+				float step = (std::min)(distance, speed * deltaTime);
+				if (distance > 0.0f)
+				{
+					walker.position.x += dx / distance * step;
+					walker.position.z += dz / distance * step;
+				}
+
+				const XMFLOAT3& goal = goals[walker.goal];
+				float goalX = goal.x - walker.position.x;
+				float goalZ = goal.z - walker.position.z;
+				if (goalX * goalX + goalZ * goalZ < AI_WAYPOINT_REACHED_SQ)
+				{
+					walker.goal = (unsigned int)((walker.goal + 1) % goals.size());
+					walker.path.clear();
+					run.arrivals++;
+				}
+			}
+			mainMs += mainTimer.ElapsedMs();
+			std::this_thread::sleep_until(frameEnd);
+		}
+
+		run.stats = service->GetStats();
+		run.mainMsPerFrame = mainMs / frames;
+		run.searchMsPerFrame = run.stats.searchMs / frames;
+		if (keep)
+			*keep = service;
+		else
+			delete service;
+		return run;
+	}
+
+	bool RunPathServiceBenchmark()
+	{
+		using namespace DirectX;
+
+		const unsigned int agentCount = 2000;
+		const int frames = 240;
+		bool passed = true;
+
+		std::vector<XMFLOAT3> corners;
+		MakeBenchmarkLevel(20, 10.0f, corners);
+		NavMesh navMesh;
+		for (size_t i = 0; i + 2 < corners.size(); i += 3)
+			navMesh.AddTriangle(corners[i], corners[i + 1], corners[i + 2]);
+		navMesh.Build(NavMeshSettings());
+		NavHierarchy hierarchy(navMesh);
+		for (unsigned int z = 0; z < 20; ++z)
+		{
+			for (unsigned int x = 0; x < 20; ++x)
+				hierarchy.AddRoom(XMFLOAT3(x * 10.0f, -1.0f, z * 10.0f), XMFLOAT3(x * 10.0f + 10.0f, 3.0f, z * 10.0f + 10.0f));
+		}
+		hierarchy.Build(NavHierarchySettings());
+
+		// patrol points in the middle of a few rooms
+		unsigned int seed = 31;
+		std::vector<XMFLOAT3> goals;
+		for (unsigned int i = 0; i < 16; ++i)
+			goals.push_back(XMFLOAT3((unsigned int)(RandomFloat(seed) * 20) * 10.0f + 5.0f, 0.0f, (unsigned int)(RandomFloat(seed) * 20) * 10.0f + 5.0f));
+
+		// what the same walkers would pay searching inline, one path each
+		std::vector<XMFLOAT3> path;
+		NavHierarchyQuery inlineQuery(hierarchy);
+		unsigned int sampleSeed = 4242;
+		BenchmarkTimer inlineTimer;
+		for (unsigned int i = 0; i < agentCount; ++i)
+		{
+			XMFLOAT3 start = navMesh.GetSpanPosition((unsigned int)(RandomFloat(sampleSeed) * navMesh.GetSpanCount()));
+			inlineQuery.FindPath(start, goals[(unsigned int)(RandomFloat(sampleSeed) * goals.size())], path, true);
+		}
+		double inlineMs = inlineTimer.ElapsedMs();
+		printf("    %u floors, %u walkers to %u patrol points: one inline hierarchy search each %.2f ms per frame\n",
+			navMesh.GetSpanCount(), agentCount, (unsigned int)goals.size(), inlineMs);
+
+		PathRequestSettings settings;
+		settings.workerCount = 2;
+		struct Variant
+		{
+			const char* name;
+			unsigned int cacheCapacity;
+			double frameBudgetMs;
+		};
+		const Variant variants[] =
+		{
+			{ "cache, 2 ms budget", 4096, 2.0 },
+			{ "cache, no budget", 4096, 0.0 },
+			{ "no cache, 2 ms budget", 0, 2.0 },
+		};
+		PathRequestService* service = nullptr;
+		for (const Variant& variant : variants)
+		{
+			settings.cacheCapacity = variant.cacheCapacity;
+			settings.frameBudgetMs = variant.frameBudgetMs;
+			PathServiceRun run = RunPathServiceFrames(navMesh, hierarchy, settings, goals, agentCount, frames, &service);
+			double hitRate = run.stats.requests ? 100.0 * run.stats.cacheHits / run.stats.requests : 0.0;
+			printf("    %-22s %llu requests, %.1f%% cache hits, %llu coalesced, %llu searched again for their ends, %llu searches (%.3f ms each), %u budget frames\n",
+				variant.name, run.stats.requests, hitRate, run.stats.coalesced, run.stats.refitted, run.stats.searches,
+				run.stats.searches ? run.stats.searchMs / run.stats.searches : 0.0, run.stats.budgetFrames);
+			printf("    %-22s latency p50/p90/p99 %u/%u/%u frames, %.2f/%.2f/%.2f ms; game thread %.2f ms, workers %.2f ms per frame, %u arrivals\n",
+				"", service->GetLatencyFrames(0.5f), service->GetLatencyFrames(0.9f), service->GetLatencyFrames(0.99f),
+				service->GetLatencyMs(0.5f), service->GetLatencyMs(0.9f), service->GetLatencyMs(0.99f),
+				run.mainMsPerFrame, run.searchMsPerFrame, run.arrivals);
+			passed &= Check(run.badEnds == 0, "paths don't start and end where they were asked for");
+			passed &= Check(run.arrivals > 0, "no walker reached a patrol point");
+			if (variant.frameBudgetMs > 0.0)
+			{
+				// a search started under the budget still finishes, one each per worker at most
+				double longest = run.stats.searches ? 20.0 * run.stats.searchMs / run.stats.searches : 0.0;
+				passed &= Check(run.searchMsPerFrame <= variant.frameBudgetMs + settings.workerCount * longest, "workers went over the frame budget");
+			}
+			// walkers on the same leg share a search, queued or cached
+			if (variant.cacheCapacity > 0)
+				passed &= Check(run.stats.cacheHits + run.stats.coalesced > run.stats.searches, "most requests needed a search of their own");
+			else
+				passed &= Check(run.stats.cacheHits == 0, "cache hits without a cache");
+
+			// nothing stays pending once the queue is flushed
+			service->Flush();
+			service->Update();
+			passed &= Check(service->GetQueuedCount() == 0, "searches left queued after Flush()");
+			delete service;
+		}
+
+		// without a cache the service finds exactly the inline paths, over the hierarchy and flat
+		settings.cacheCapacity = 0;
+		settings.frameBudgetMs = 0.0;
+		PathRequestService hierarchyService(navMesh, &hierarchy, settings);
+		PathRequestService flatService(navMesh, nullptr, settings);
+		NavMeshQuery flatQuery(navMesh);
+		const unsigned int compared = 100;
+		std::vector<XMFLOAT3> starts, ends;
+		std::vector<unsigned int> hierarchyTickets, flatTickets;
+		for (unsigned int i = 0; i < compared; ++i)
+		{
+			starts.push_back(navMesh.GetSpanPosition((unsigned int)(RandomFloat(seed) * navMesh.GetSpanCount())));
+			ends.push_back(navMesh.GetSpanPosition((unsigned int)(RandomFloat(seed) * navMesh.GetSpanCount())));
+			hierarchyTickets.push_back(hierarchyService.Request(starts[i], ends[i]));
+			flatTickets.push_back(flatService.Request(starts[i], ends[i]));
+		}
+		hierarchyService.Flush();
+		flatService.Flush();
+		passed &= Check(hierarchyService.GetStatus(hierarchyTickets[0]) == PathStatus::PENDING, "results came in before Update()");
+		hierarchyService.Update();
+		flatService.Update();
+		unsigned int differ = 0;
+		std::vector<XMFLOAT3> servicePath;
+		for (unsigned int i = 0; i < compared; ++i)
+		{
+			bool found = hierarchyService.TakePath(hierarchyTickets[i], servicePath);
+			differ += found != inlineQuery.FindPath(starts[i], ends[i], path, true) || servicePath.size() != path.size() ||
+				(!path.empty() && memcmp(servicePath.data(), path.data(), path.size() * sizeof(XMFLOAT3)) != 0);
+			found = flatService.TakePath(flatTickets[i], servicePath);
+			differ += found != flatQuery.FindPath(starts[i], ends[i], path) || servicePath.size() != path.size() ||
+				(!path.empty() && memcmp(servicePath.data(), path.data(), path.size() * sizeof(XMFLOAT3)) != 0);
+		}
+		printf("    %u paths through the service against inline, hierarchy and flat: %u differ\n", compared, differ);
+		passed &= Check(differ == 0, "service paths differ from inline searches");
+
+		// cache cells wider than a doorway, so cached paths are asked for from the other side of walls: whatever the
+		// service hands out stays off the walls at half the agent's height, and fails only where a search fails
+		TriangleBVH walls;
+		for (size_t i = 0; i + 2 < corners.size(); i += 3)
+			walls.AddTriangle(corners[i], corners[i + 1], corners[i + 2]);
+		walls.Build();
+		PathRequestSettings wideSettings;
+		wideSettings.workerCount = 2;
+		wideSettings.frameBudgetMs = 0.0;
+		wideSettings.cacheCellColumns = 24;
+		PathRequestService wideService(navMesh, &hierarchy, wideSettings);
+		const float halfHeight = NavMeshSettings().agentHeight * 0.5f;
+		const unsigned int basePairs = 50, jittered = 2000;
+		std::vector<XMFLOAT3> wideStarts, wideGoals;
+		for (unsigned int i = 0; i < basePairs; ++i)
+		{
+			wideStarts.push_back(navMesh.GetSpanPosition((unsigned int)(RandomFloat(seed) * navMesh.GetSpanCount())));
+			wideGoals.push_back(navMesh.GetSpanPosition((unsigned int)(RandomFloat(seed) * navMesh.GetSpanCount())));
+		}
+		for (unsigned int i = 0; i < basePairs; ++i)
+			wideService.Request(wideStarts[i], wideGoals[i]);
+		wideService.Flush();
+		wideService.Update();
+
+		std::vector<unsigned int> wideTickets;
+		std::vector<XMFLOAT3> jitteredStarts, jitteredGoals;
+		for (unsigned int i = 0; i < jittered; ++i)
+		{
+			unsigned int base = i % basePairs;
+			unsigned int startSpan = navMesh.FindNearestSpan(XMFLOAT3(wideStarts[base].x + RandomFloat(seed) * 6.0f - 3.0f, wideStarts[base].y, wideStarts[base].z + RandomFloat(seed) * 6.0f - 3.0f));
+			unsigned int goalSpan = navMesh.FindNearestSpan(XMFLOAT3(wideGoals[base].x + RandomFloat(seed) * 6.0f - 3.0f, wideGoals[base].y, wideGoals[base].z + RandomFloat(seed) * 6.0f - 3.0f));
+			if (startSpan == NAV_NO_SPAN || goalSpan == NAV_NO_SPAN)
+				continue;
+			jitteredStarts.push_back(navMesh.GetSpanPosition(startSpan));
+			jitteredGoals.push_back(navMesh.GetSpanPosition(goalSpan));
+			wideTickets.push_back(wideService.Request(jitteredStarts.back(), jitteredGoals.back()));
+		}
+		wideService.Flush();
+		wideService.Update();
+
+		unsigned int throughWalls = 0, wrongFailures = 0;
+		for (size_t i = 0; i < wideTickets.size(); ++i)
+		{
+			bool found = wideService.TakePath(wideTickets[i], servicePath);
+			wrongFailures += found != inlineQuery.FindPath(jitteredStarts[i], jitteredGoals[i], path, true);
+			for (size_t k = 1; k < servicePath.size(); ++k)
+			{
+				XMVECTOR from = XMLoadFloat3(&servicePath[k - 1]) + XMVectorSet(0, halfHeight, 0, 0);
+				XMVECTOR offset = XMLoadFloat3(&servicePath[k]) - XMLoadFloat3(&servicePath[k - 1]);
+				float length = XMVectorGetX(XMVector3Length(offset));
+				if (length <= 0.0f)
+					continue;
+				XMFLOAT3 origin, direction;
+				XMStoreFloat3(&origin, from);
+				XMStoreFloat3(&direction, XMVectorScale(offset, 1.0f / length));
+				throughWalls += walls.Occluded(origin, direction, length);
+			}
+		}
+		PathRequestStats wideStats = wideService.GetStats();
+		printf("    %zu requests around %u cached paths in %u column cells: %llu cache hits, %llu coalesced, %llu searched again for their ends, %u segments through a wall, %u wrong failures\n",
+			wideTickets.size(), basePairs, wideSettings.cacheCellColumns, wideStats.cacheHits, wideStats.coalesced, wideStats.refitted, throughWalls, wrongFailures);
+		passed &= Check(wideStats.cacheHits > 0, "no request was served from the cache");
+		passed &= Check(throughWalls == 0, "cached path goes through a wall");
+		passed &= Check(wrongFailures == 0, "cached failure handed to a request with a path, or a path to one without");
+
+		// batched ghosts patrolling from the patrol points to the next room over and back at 60 fps, searching in
+		// AISystem::Update() and through the service
+		const unsigned int ghostCount = 100;
+		const int ghostFrames = 600;
+		unsigned int totalArrivals[2] = {};
+		double updateMs[2] = {};
+		PathRequestStats ghostStats;
+		for (int useService = 0; useService < 2; ++useService)
+		{
+			settings.cacheCapacity = 4096;
+			PathRequestService ghostService(navMesh, &hierarchy, settings);
+			AISystem system;
+			system.SetNavMesh(&navMesh);
+			system.SetNavHierarchy(&hierarchy);
+			if (useService)
+				system.SetPathService(&ghostService);
+			for (unsigned int i = 0; i < (unsigned int)goals.size(); ++i)
+			{
+				XMFLOAT3 route[2] = { goals[i], XMFLOAT3(goals[i].x + (goals[i].x < 100.0f ? 10.0f : -10.0f), goals[i].y, goals[i].z) };
+				system.AddRoute(route, 2);
+			}
+			unsigned int ghostSeed = 77;
+			for (unsigned int i = 0; i < ghostCount; ++i)
+			{
+				const XMFLOAT3& first = goals[i % goals.size()];
+				system.AddAgent(XMFLOAT3(first.x + RandomFloat(ghostSeed) * 6.0f - 3.0f, first.y, first.z + RandomFloat(ghostSeed) * 6.0f - 3.0f), i % (unsigned int)goals.size());
+			}
+
+			std::vector<unsigned int> lastPoints(ghostCount, 0);
+			auto frameEnd = std::chrono::high_resolution_clock::now();
+			for (int frame = 0; frame < ghostFrames; ++frame)
+			{
+				frameEnd += std::chrono::microseconds(16667);
+				BenchmarkTimer updateTimer;
+				if (useService)
+					ghostService.Update();
+				system.Update(XMFLOAT3(-100, 0, -100), 0.0f, 1.0f / 60.0f);
+				updateMs[useService] += updateTimer.ElapsedMs();
+				for (unsigned int i = 0; i < ghostCount; ++i)
+				{
+					totalArrivals[useService] += system.GetActiveRoute(i) != lastPoints[i];
+					lastPoints[i] = system.GetActiveRoute(i);
+				}
+				std::this_thread::sleep_until(frameEnd);
+			}
+			if (useService)
+				ghostStats = ghostService.GetStats();
+		}
+		printf("    %u batched ghosts for %d frames: inline searches %.2f ms per update, %u arrivals; service %.2f ms per update, %u arrivals, %llu requests, %llu searches\n",
+			ghostCount, ghostFrames, updateMs[0] / ghostFrames, totalArrivals[0], updateMs[1] / ghostFrames, totalArrivals[1], ghostStats.requests, ghostStats.searches);
+		passed &= Check(totalArrivals[1] * 2 > totalArrivals[0], "batched ghosts reached far fewer patrol points through the service");
+		passed &= Check(ghostStats.requests < (unsigned long long)ghostCount * ghostFrames / 10, "batched ghosts asked for a path nearly every update");
+
+		return passed;
+	}
+}
@@ -0,0 +1,596 @@
+#include "BenchmarkUtils.h"
+#include "ParallelDrawSubmitter.h"
+#include "HeadlessRenderContext.h"
+#include "HeadlessDrawRecorder.h"
+#include "OcclusionCuller.h"
+#include "RenderGraph.h"
+#include "Vertex.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Benchmarks
+{
+	// ----------------------------------------------------
+	// Draw submission
+	// ----------------------------------------------------
+
+	// Fake handles, the headless backend only compares addresses
+	const unsigned int SUBMISSION_MATERIALS = 64;
+	const unsigned int SUBMISSION_MESHES = 256;
+	char fakeShaders[2][2];
+	char fakeInputLayout;
+	char fakeConstantBuffers[2];
+	char fakeTextures[SUBMISSION_MATERIALS];
+	char fakeSampler;
+	char fakeMeshes[SUBMISSION_MESHES][2];
+	char fakeRenderTarget;
+	char fakeDepthBuffer;
+
+	// Per frame constants SimpleShaders keep on the CPU (camera, lights). Parallel
+	// workers draw with their own copy, synced from the source at the start of the
+	// frame like DeferredContextRecorder's shader mirrors
+	struct SubmissionFrameConstants
+	{
+		float viewProjection[32];
+		float lights[8];
+	};
+
+	SubmissionFrameConstants MakeSubmissionFrame(unsigned int frame)
+	{
+		SubmissionFrameConstants constants = {};
+		for (unsigned int i = 0; i < 32; ++i)
+			constants.viewProjection[i] = (float)(frame * 32 + i);
+		for (unsigned int i = 0; i < 8; ++i)
+			constants.lights[i] = (float)(frame * 8 + i) * 0.5f;
+		return constants;
+	}
+
+	// Same call pattern as Entity::Draw: material data, camera/world constants, mesh streams
+	void DrawSubmissionItem(IRenderContext* context, const SubmissionFrameConstants& frame, const DrawItem& item)
+	{
+		unsigned int material = (unsigned int)(item.sortKey >> 32);
+		unsigned int mesh = (unsigned int)(item.sortKey & 0xffffffff) % SUBMISSION_MESHES;
+		unsigned int shader = material & 1;
+
+		float vsConstants[52] = {};
+		float psConstants[12] = {};
+		vsConstants[0] = (float)mesh;
+		memcpy(&vsConstants[16], frame.viewProjection, sizeof(frame.viewProjection));
+		psConstants[0] = (float)material;
+		memcpy(&psConstants[4], frame.lights, sizeof(frame.lights));
+
+		context->SetInputLayout((ID3D11InputLayout*)&fakeInputLayout);
+		context->SetVertexShader((ID3D11VertexShader*)&fakeShaders[shader][0]);
+		context->SetPixelShader((ID3D11PixelShader*)&fakeShaders[shader][1]);
+		context->SetConstantBuffer(ShaderStage::Vertex, 0, (ID3D11Buffer*)&fakeConstantBuffers[0]);
+		context->SetConstantBuffer(ShaderStage::Pixel, 0, (ID3D11Buffer*)&fakeConstantBuffers[1]);
+
+		context->UpdateBuffer((ID3D11Buffer*)&fakeConstantBuffers[0], vsConstants, sizeof(vsConstants));
+		context->UpdateBuffer((ID3D11Buffer*)&fakeConstantBuffers[1], psConstants, sizeof(psConstants));
+		context->SetShaderResource(ShaderStage::Pixel, 0, (ID3D11ShaderResourceView*)&fakeTextures[material]);
+		context->SetSampler(ShaderStage::Pixel, 0, (ID3D11SamplerState*)&fakeSampler);
+
+		context->SetVertexBuffer((ID3D11Buffer*)&fakeMeshes[mesh][0], 48);
+		context->SetIndexBuffer((ID3D11Buffer*)&fakeMeshes[mesh][1]);
+		context->DrawIndexed(36 + mesh);
+	}
+
+	void PrintStats(const char* label, const RenderStats& stats, double ms)
+	{
+		printf("    %-10s %8.3f ms  draws %u  state changes %u  redundant %u  uploaded %llu KB\n",
+			label, ms, stats.drawCalls, stats.stateChanges, stats.redundantStateChanges, stats.bytesUploaded / 1024);
+	}
+
+	// ----------------------------------------------------
+	// Records a sorted opaque draw list serially and through
+	// the parallel submitter, checks both produce identical
+	// draws with valid bindings and constants, and that a
+	// worker drawing with last frame's constants is caught,
+	// then times both paths.
+	// Only the submission path runs: the draw list and the
+	// handles are synthetic, Game::Update() and Draw() need
+	// a device for their shaders and aren't run headless
+	// ----------------------------------------------------
+	bool RunSubmissionBenchmark()
+	{
+		const size_t itemCount = 20000;
+		const int frames = 50;
+		const float width = 1280.0f;
+		const float height = 720.0f;
+
+		std::vector<DrawItem> drawList(itemCount);
+		unsigned int seed = 12345;
+		for (size_t i = 0; i < itemCount; ++i)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			unsigned long long material = (seed >> 8) % SUBMISSION_MATERIALS;
+			drawList[i].entity = nullptr;
+			drawList[i].sortKey = (material << 32) | i;
+		}
+		ParallelDrawSubmitter::SortDrawList(drawList);
+
+		ID3D11RenderTargetView* rtv = (ID3D11RenderTargetView*)&fakeRenderTarget;
+		ID3D11DepthStencilView* dsv = (ID3D11DepthStencilView*)&fakeDepthBuffer;
+
+		// Correctness: same draws, same bindings, same constants, nothing missing.
+		// At least four workers so every partition boundary is exercised
+		SubmissionFrameConstants sourceFrame = MakeSubmissionFrame(1);
+		const unsigned int checkWorkers = (std::max)(WorkerCount(), 4u);
+		std::vector<SubmissionFrameConstants> workerFrames(checkWorkers, sourceFrame);
+		auto drawOnWorker = [&workerFrames](IRenderContext* context, unsigned int worker, const DrawItem& item)
+		{
+			DrawSubmissionItem(context, workerFrames[worker], item);
+		};
+
+		HeadlessRenderContext serial;
+		serial.SetRenderTargets(rtv, dsv);
+		serial.SetViewport(width, height);
+		for (const DrawItem& item : drawList)
+			DrawSubmissionItem(&serial, sourceFrame, item);
+
+		HeadlessRenderContext merged;
+		HeadlessDrawRecorder recorder(checkWorkers, &merged, drawOnWorker);
+		ParallelDrawSubmitter submitter;
+		recorder.BeginFrame(rtv, dsv, width, height);
+		submitter.Submit(drawList, &recorder);
+
+		bool passed = true;
+		passed &= Check(serial.GetValidationErrorCount() == 0, "serial recording has binding errors");
+		passed &= Check(merged.GetValidationErrorCount() == 0, "merged recording has binding errors");
+		passed &= Check(merged.HasSameDraws(serial), "merged draws differ from the serial order");
+		printf("    %zu items, %u workers, %zu ranges\n", itemCount, recorder.GetWorkerCount(), submitter.GetLastRanges().size());
+
+		// Next frame the camera and lights change, and one worker's copy is left behind
+		sourceFrame = MakeSubmissionFrame(2);
+		for (unsigned int worker = 0; worker + 1 < checkWorkers; ++worker)
+			workerFrames[worker] = sourceFrame;
+
+		HeadlessRenderContext nextSerial;
+		nextSerial.SetRenderTargets(rtv, dsv);
+		nextSerial.SetViewport(width, height);
+		for (const DrawItem& item : drawList)
+			DrawSubmissionItem(&nextSerial, sourceFrame, item);
+
+		HeadlessRenderContext stale;
+		HeadlessDrawRecorder staleRecorder(checkWorkers, &stale, drawOnWorker);
+		staleRecorder.BeginFrame(rtv, dsv, width, height);
+		submitter.Submit(drawList, &staleRecorder);
+		passed &= Check(submitter.GetLastRanges().size() == checkWorkers, "not every worker got a range, the stale copy isn't drawn with");
+		passed &= Check(!stale.HasSameDraws(nextSerial), "a worker drawing with last frame's constants wasn't caught");
+
+		workerFrames.back() = sourceFrame;
+		HeadlessRenderContext synced;
+		HeadlessDrawRecorder syncedRecorder(checkWorkers, &synced, drawOnWorker);
+		syncedRecorder.BeginFrame(rtv, dsv, width, height);
+		submitter.Submit(drawList, &syncedRecorder);
+		passed &= Check(synced.HasSameDraws(nextSerial), "merged draws differ from the serial order once every worker is synced");
+
+		// Timing: stats only, like a frame that is thrown away after submission
+		HeadlessRenderContext serialTarget(false);
+		BenchmarkTimer serialTimer;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			serialTarget.SetRenderTargets(rtv, dsv);
+			serialTarget.SetViewport(width, height);
+			for (const DrawItem& item : drawList)
+				DrawSubmissionItem(&serialTarget, sourceFrame, item);
+		}
+		double serialMs = serialTimer.ElapsedMs() / frames;
+
+		HeadlessRenderContext parallelTarget(false);
+		std::vector<SubmissionFrameConstants> timedFrames(WorkerCount(), sourceFrame);
+		HeadlessDrawRecorder timedRecorder(WorkerCount(), &parallelTarget, [&timedFrames](IRenderContext* context, unsigned int worker, const DrawItem& item)
+		{
+			DrawSubmissionItem(context, timedFrames[worker], item);
+		});
+		BenchmarkTimer parallelTimer;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			timedRecorder.BeginFrame(rtv, dsv, width, height);
+			submitter.Submit(drawList, &timedRecorder);
+		}
+		double parallelMs = parallelTimer.ElapsedMs() / frames;
+
+		RenderStats serialStats = serial.GetStats();
+		RenderStats mergedStats = merged.GetStats();
+		PrintStats("serial", serialStats, serialMs);
+		PrintStats("parallel", mergedStats, parallelMs);
+
+		return passed;
+	}
+
+	// ----------------------------------------------------
+	// Frame graph
+	// ----------------------------------------------------
+
+	// Position of every pass in the execution order, -1 for culled ones
+	std::vector<int> ExecutionPositions(const RenderGraph& graph)
+	{
+		std::vector<int> positions(graph.GetPassCount(), -1);
+		const std::vector<int>& order = graph.GetExecutionOrder();
+		for (size_t i = 0; i < order.size(); ++i)
+			positions[order[i]] = (int)i;
+		return positions;
+	}
+
+	// Passes each reading a few of the last textures written and writing one or
+	// two, cycling through the textures so their lifetimes are short and can be
+	// aliased. The last pass writes the back buffer, some outputs are never read
+	RenderGraphResource MakeRandomGraph(RenderGraph& graph, unsigned int passCount, unsigned int textureCount, unsigned int seed,
+		std::vector<std::vector<RenderGraphResource>>& reads, std::vector<std::vector<RenderGraphResource>>& writes)
+	{
+		RenderGraphTextureDesc descs[2] = { { 1280, 720, 28 }, { 640, 360, 10 } };
+		graph.Reset();
+		reads.assign(passCount, std::vector<RenderGraphResource>());
+		writes.assign(passCount, std::vector<RenderGraphResource>());
+
+		std::vector<RenderGraphResource> textures;
+		for (unsigned int t = 0; t < textureCount; ++t)
+			textures.push_back(graph.CreateTexture("Texture " + std::to_string(t), descs[t & 1]));
+		RenderGraphResource backBuffer = graph.ImportTexture("BackBuffer");
+
+		std::vector<unsigned int> recent;
+		unsigned int next = 0;
+		for (unsigned int p = 0; p < passCount; ++p)
+		{
+			int pass = graph.AddPass("Pass " + std::to_string(p), nullptr);
+			for (unsigned int r = 0; r < 2 && !recent.empty(); ++r)
+			{
+				unsigned int t = recent[recent.size() - 1 - (unsigned int)(RandomFloat(seed) * (std::min)((unsigned int)recent.size(), 4u))];
+				graph.Read(pass, textures[t]);
+				reads[p].push_back(textures[t]);
+			}
+
+			unsigned int writeCount = 1 + (RandomFloat(seed) < 0.3f);
+			for (unsigned int w = 0; w < writeCount; ++w)
+			{
+				unsigned int t = RandomFloat(seed) < 0.8f ? next++ % textureCount : (unsigned int)(RandomFloat(seed) * textureCount);
+				graph.Write(pass, textures[t]);
+				writes[p].push_back(textures[t]);
+				recent.push_back(t);
+			}
+
+			if (p + 1 == passCount)
+			{
+				graph.Write(pass, backBuffer);
+				writes[p].push_back(backBuffer);
+			}
+		}
+		return backBuffer;
+	}
+
+	// ----------------------------------------------------
+	// Compiles small graphs with known answers for culling,
+	// side effects, ordering, aliasing and the errors
+	// Compile() reports, checks ordering and aliasing rules
+	// on random graphs, then times compiling a large one.
+	// No device, every pass is a callback or nothing
+	// ----------------------------------------------------
+	bool RunRenderGraphBenchmark()
+	{
+		const RenderGraphTextureDesc fullScreen = { 1280, 720, 28 };
+		const RenderGraphTextureDesc halfScreen = { 640, 360, 10 };
+		bool passed = true;
+
+		// Culling: "Debug" writes a texture nothing reads, "Readback" too but has side effects
+		{
+			RenderGraph graph;
+			RenderGraphResource backBuffer = graph.ImportTexture("BackBuffer");
+			RenderGraphResource sceneColor = graph.CreateTexture("SceneColor", fullScreen);
+			RenderGraphResource debugView = graph.CreateTexture("DebugView", fullScreen);
+			RenderGraphResource readback = graph.CreateTexture("Readback", halfScreen);
+
+			std::vector<std::string> executed;
+			int scene = graph.AddPass("Scene", [&executed]() { executed.push_back("Scene"); });
+			int debug = graph.AddPass("Debug", [&executed]() { executed.push_back("Debug"); });
+			int copy = graph.AddPass("Readback", [&executed]() { executed.push_back("Readback"); });
+			int present = graph.AddPass("Present", [&executed]() { executed.push_back("Present"); });
+			graph.Write(scene, sceneColor);
+			graph.Read(debug, sceneColor);
+			graph.Write(debug, debugView);
+			graph.Read(copy, sceneColor);
+			graph.Write(copy, readback);
+			graph.SetSideEffects(copy);
+			graph.Read(present, sceneColor);
+			graph.Write(present, backBuffer);
+
+			passed &= Check(graph.Compile(), "the culling graph doesn't compile");
+			passed &= Check(graph.IsPassCulled(debug), "a pass writing only an unread transient survived");
+			passed &= Check(!graph.IsPassCulled(copy), "a pass with side effects was culled");
+			passed &= Check(!graph.IsPassCulled(scene) && !graph.IsPassCulled(present), "a pass reaching the back buffer was culled");
+			graph.Execute();
+			passed &= Check(executed == std::vector<std::string>({ "Scene", "Readback", "Present" }), "Execute() didn't run exactly the surviving passes in order");
+			passed &= Check(graph.GetPhysicalSlot(debugView) == -1, "a texture only a culled pass uses got a physical slot");
+		}
+
+		// Ordering: independent passes keep declaration order, readers follow writers
+		{
+			RenderGraph graph;
+			RenderGraphResource backBuffer = graph.ImportTexture("BackBuffer");
+			RenderGraphResource shadow = graph.CreateTexture("Shadow", halfScreen);
+			RenderGraphResource lit = graph.CreateTexture("Lit", fullScreen);
+			RenderGraphResource bloom = graph.CreateTexture("Bloom", halfScreen);
+
+			int compose = graph.AddPass("Compose", nullptr);
+			int shadows = graph.AddPass("Shadows", nullptr);
+			int lighting = graph.AddPass("Lighting", nullptr);
+			int bright = graph.AddPass("Bloom", nullptr);
+			graph.Write(shadows, shadow);
+			graph.Read(lighting, shadow);
+			graph.Write(lighting, lit);
+			graph.Read(bright, lit);
+			graph.Write(bright, bloom);
+			graph.Write(compose, backBuffer);
+
+			// compose only writes the back buffer, nothing orders it after the others
+			passed &= Check(graph.Compile(), "the ordering graph doesn't compile");
+			passed &= Check(graph.GetExecutionOrder() == std::vector<int>({ compose }), "unread transients kept their passes alive");
+
+			int present = graph.AddPass("Present", nullptr);
+			graph.Read(present, lit);
+			graph.Read(present, bloom);
+			graph.Write(present, backBuffer);
+			passed &= Check(graph.Compile(), "the ordering graph doesn't compile with a present pass");
+			passed &= Check(graph.GetExecutionOrder() == std::vector<int>({ compose, shadows, lighting, bright, present }),
+				"passes aren't in declaration order where dependencies allow it");
+		}
+
+		// Aliasing: Lit and Bloom share a slot, lifetimes [0, 1] and [2, 3]. Blur overlaps both,
+		// HalfRes is as short lived as Lit but a different size
+		{
+			RenderGraph graph;
+			RenderGraphResource backBuffer = graph.ImportTexture("BackBuffer");
+			RenderGraphResource lit = graph.CreateTexture("Lit", fullScreen);
+			RenderGraphResource blur = graph.CreateTexture("Blur", fullScreen);
+			RenderGraphResource bloom = graph.CreateTexture("Bloom", fullScreen);
+			RenderGraphResource halfRes = graph.CreateTexture("HalfRes", halfScreen);
+
+			int lighting = graph.AddPass("Lighting", nullptr);
+			int blurring = graph.AddPass("Blur", nullptr);
+			int combine = graph.AddPass("Combine", nullptr);
+			int present = graph.AddPass("Present", nullptr);
+			graph.Write(lighting, lit);
+			graph.Write(lighting, halfRes);
+			graph.Read(blurring, lit);
+			graph.Read(blurring, halfRes);
+			graph.Write(blurring, blur);
+			graph.Read(combine, blur);
+			graph.Write(combine, bloom);
+			graph.Read(present, bloom);
+			graph.Write(present, backBuffer);
+
+			passed &= Check(graph.Compile(), "the aliasing graph doesn't compile");
+			passed &= Check(graph.GetPhysicalSlot(lit) == graph.GetPhysicalSlot(bloom), "equal textures with disjoint lifetimes don't share a slot");
+			passed &= Check(graph.GetPhysicalSlot(blur) != graph.GetPhysicalSlot(lit) && graph.GetPhysicalSlot(blur) != graph.GetPhysicalSlot(bloom),
+				"textures with overlapping lifetimes share a slot");
+			passed &= Check(graph.GetPhysicalSlot(halfRes) != graph.GetPhysicalSlot(bloom), "textures of different sizes share a slot");
+			passed &= Check(graph.GetPhysicalSlotCount() == 3 && graph.GetLiveTransientCount() == 4, "four transients should need three slots");
+			passed &= Check(graph.GetPhysicalSlot(backBuffer) == -1, "an imported texture got a physical slot");
+		}
+
+		// Errors
+		{
+			RenderGraph graph;
+			RenderGraphResource backBuffer = graph.ImportTexture("BackBuffer");
+			RenderGraphResource never = graph.CreateTexture("NeverWritten", fullScreen);
+			int present = graph.AddPass("Present", nullptr);
+			graph.Read(present, backBuffer);
+			graph.Write(present, backBuffer);
+			passed &= Check(graph.Compile(), "reading an imported texture nothing wrote was rejected");
+
+			graph.Read(present, never);
+			passed &= Check(!graph.Compile() && graph.GetError().find("before any pass writes it") != std::string::npos,
+				"reading a transient nothing wrote wasn't rejected");
+			passed &= Check(!graph.IsCompiled() && graph.GetExecutionOrder().empty(), "a failed compile left an execution order");
+
+			RenderGraph badRead;
+			int pass = badRead.AddPass("Pass", nullptr);
+			badRead.Write(pass, badRead.ImportTexture("BackBuffer"));
+			badRead.Read(pass, 42);
+			passed &= Check(!badRead.Compile() && badRead.GetError().find("invalid resource") != std::string::npos, "reading a bad handle wasn't rejected");
+
+			RenderGraph badWrite;
+			pass = badWrite.AddPass("Pass", nullptr);
+			badWrite.Write(pass, -1);
+			passed &= Check(!badWrite.Compile() && badWrite.GetError().find("invalid resource") != std::string::npos, "writing a bad handle wasn't rejected");
+		}
+
+		// Random graphs: every surviving reader runs after the closest earlier writer of what it reads,
+		// writers after the previous writer and its readers, slots are never shared by overlapping
+		// lifetimes, and compiling again gives the same order
+		const unsigned int graphs = 200;
+		unsigned int orderErrors = 0, aliasErrors = 0, unstable = 0;
+		size_t liveTransients = 0, slots = 0;
+		std::vector<std::vector<RenderGraphResource>> reads, writes;
+		RenderGraph graph;
+		for (unsigned int g = 0; g < graphs; ++g)
+		{
+			MakeRandomGraph(graph, 40, 24, 1000 + g, reads, writes);
+			if (!graph.Compile())
+			{
+				++orderErrors;
+				continue;
+			}
+
+			std::vector<int> first = graph.GetExecutionOrder();
+			graph.Compile();
+			unstable += graph.GetExecutionOrder() != first;
+
+			std::vector<int> positions = ExecutionPositions(graph);
+			std::vector<int> firstUse(25, -1), lastUse(25, -1);
+			for (int p = 0; p < (int)reads.size(); ++p)
+			{
+				if (positions[p] < 0)
+					continue;
+
+				for (RenderGraphResource read : reads[p])
+				{
+					int writer = p - 1;
+					while (std::find(writes[writer].begin(), writes[writer].end(), read) == writes[writer].end())
+						--writer;
+					orderErrors += positions[writer] < 0 || positions[writer] > positions[p];
+				}
+				for (RenderGraphResource write : writes[p])
+				{
+					for (int w = p - 1; w >= 0; --w)
+					{
+						bool earlierReads = std::find(reads[w].begin(), reads[w].end(), write) != reads[w].end();
+						bool earlierWrites = std::find(writes[w].begin(), writes[w].end(), write) != writes[w].end();
+						if ((earlierReads || earlierWrites) && positions[w] > positions[p])
+							++orderErrors;
+						if (earlierWrites)
+							break;
+					}
+				}
+
+				for (int written = 0; written < 2; ++written)
+				{
+					for (RenderGraphResource resource : written ? writes[p] : reads[p])
+					{
+						if (firstUse[resource] < 0 || positions[p] < firstUse[resource])
+							firstUse[resource] = positions[p];
+						lastUse[resource] = (std::max)(lastUse[resource], positions[p]);
+					}
+				}
+			}
+
+			for (RenderGraphResource a = 0; a < 24; ++a)
+			{
+				for (RenderGraphResource b = a + 1; b < 24; ++b)
+				{
+					int slot = graph.GetPhysicalSlot(a);
+					bool overlap = firstUse[a] >= 0 && firstUse[b] >= 0 && firstUse[a] <= lastUse[b] && firstUse[b] <= lastUse[a];
+					aliasErrors += slot >= 0 && slot == graph.GetPhysicalSlot(b) && (overlap || (a & 1) != (b & 1));
+				}
+			}
+			liveTransients += graph.GetLiveTransientCount();
+			slots += graph.GetPhysicalSlotCount();
+		}
+		printf("    %u random graphs of 40 passes: %.1f live transients in %.1f slots on average\n",
+			graphs, (double)liveTransients / graphs, (double)slots / graphs);
+		passed &= Check(orderErrors == 0, "a pass runs before a pass it depends on");
+		passed &= Check(aliasErrors == 0, "textures with overlapping lifetimes or different descriptions share a slot");
+		passed &= Check(unstable == 0, "compiling the same graph twice gave different orders");
+
+		const unsigned int compiles = 20;
+		MakeRandomGraph(graph, 2000, 64, 99, reads, writes);
+		BenchmarkTimer compileTimer;
+		for (unsigned int i = 0; i < compiles; ++i)
+			graph.Compile();
+		printf("    2000 passes over 64 textures: %.2f ms per compile, %zu passes survive, %zu slots\n",
+			compileTimer.ElapsedMs() / compiles, graph.GetExecutionOrder().size(), graph.GetPhysicalSlotCount());
+
+		return passed;
+	}
+
+	// ----------------------------------------------------
+	// Occlusion culling
+	// ----------------------------------------------------
+
+	// Appends an axis aligned wall as two triangles
+	void AddWall(std::vector<DirectX::XMFLOAT3>& positions, std::vector<unsigned int>& indices, DirectX::XMFLOAT3 min, DirectX::XMFLOAT3 max)
+	{
+		unsigned int base = (unsigned int)positions.size();
+		bool alongX = (max.x - min.x) > (max.z - min.z);
+		positions.push_back(DirectX::XMFLOAT3(min.x, min.y, min.z));
+		positions.push_back(alongX ? DirectX::XMFLOAT3(max.x, min.y, min.z) : DirectX::XMFLOAT3(min.x, min.y, max.z));
+		positions.push_back(DirectX::XMFLOAT3(max.x, max.y, max.z));
+		positions.push_back(alongX ? DirectX::XMFLOAT3(min.x, max.y, max.z) : DirectX::XMFLOAT3(max.x, max.y, min.z));
+
+		unsigned int quad[6] = { 0, 1, 2, 0, 2, 3 };
+		for (unsigned int i : quad)
+			indices.push_back(base + i);
+	}
+
+	// ----------------------------------------------------
+	// A corridor of rooms separated by walls with doorways,
+	// seen from the first room. Checks a few placements with
+	// known answers, then times rasterization and box tests.
+	// ----------------------------------------------------
+	bool RunOcclusionBenchmark()
+	{
+		using namespace DirectX;
+
+		const int frames = 200;
+		const int rooms = 8;
+		const float roomDepth = 10.0f;
+		const size_t boxCount = 4096;
+
+		std::vector<XMFLOAT3> positions;
+		std::vector<unsigned int> indices;
+
+		// floor under the whole corridor, crosses the near plane like a real room does
+		AddWall(positions, indices, XMFLOAT3(-10.0f, 0.0f, -5.0f), XMFLOAT3(10.0f, 0.0f, rooms * roomDepth));
+		for (int room = 1; room <= rooms; ++room)
+		{
+			// dividing wall with a 2m doorway, offset every other room so doorways don't line up
+			float z = room * roomDepth;
+			float door = (room % 2) ? 4.0f : -4.0f;
+			AddWall(positions, indices, XMFLOAT3(-10.0f, 0.0f, z), XMFLOAT3(door - 1.0f, 4.0f, z));
+			AddWall(positions, indices, XMFLOAT3(door + 1.0f, 0.0f, z), XMFLOAT3(10.0f, 4.0f, z));
+			AddWall(positions, indices, XMFLOAT3(door - 1.0f, 2.5f, z), XMFLOAT3(door + 1.0f, 4.0f, z));
+		}
+
+		XMFLOAT4X4 view, proj, identity;
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(0.0f, 1.7f, 0.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+		XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.01f, 100.0f));
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+		OcclusionCuller culler;
+		culler.BeginFrame(view, proj);
+		culler.AddOccluder(positions.data(), indices.data(), indices.size(), identity);
+		culler.Rasterize();
+
+		bool passed = true;
+		passed &= Check(culler.IsVisible(XMFLOAT3(-0.5f, 0.0f, 4.0f), XMFLOAT3(0.5f, 1.0f, 5.0f), identity), "box in the first room was culled");
+		passed &= Check(!culler.IsVisible(XMFLOAT3(-0.5f, 0.0f, 14.0f), XMFLOAT3(0.5f, 1.0f, 15.0f), identity), "box behind the first wall is visible");
+		passed &= Check(culler.IsVisible(XMFLOAT3(3.5f, 0.5f, 14.0f), XMFLOAT3(4.5f, 1.5f, 15.0f), identity), "box seen through the doorway was culled");
+		passed &= Check(culler.IsVisible(XMFLOAT3(-1.0f, 0.0f, -1.0f), XMFLOAT3(1.0f, 2.0f, 1.0f), identity), "box around the camera was culled");
+		passed &= Check(!culler.IsVisible(XMFLOAT3(-1.0f, 0.0f, -9.0f), XMFLOAT3(1.0f, 2.0f, -8.0f), identity), "box behind the camera is visible");
+
+		std::vector<XMFLOAT3> boxes(boxCount * 2);
+		unsigned int seed = 777;
+		auto random01 = [&seed]()
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return (float)(seed >> 8) / 16777216.0f;
+		};
+		for (size_t i = 0; i < boxCount; ++i)
+		{
+			XMFLOAT3 center(random01() * 18.0f - 9.0f, random01() * 3.0f, random01() * rooms * roomDepth);
+			boxes[i * 2] = XMFLOAT3(center.x - 0.5f, center.y - 0.5f, center.z - 0.5f);
+			boxes[i * 2 + 1] = XMFLOAT3(center.x + 0.5f, center.y + 0.5f, center.z + 0.5f);
+		}
+
+		BenchmarkTimer rasterTimer;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			culler.BeginFrame(view, proj);
+			culler.AddOccluder(positions.data(), indices.data(), indices.size(), identity);
+			culler.Rasterize();
+		}
+		double rasterMs = rasterTimer.ElapsedMs() / frames;
+
+		size_t visible = 0;
+		BenchmarkTimer testTimer;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			visible = 0;
+			for (size_t i = 0; i < boxCount; ++i)
+			{
+				if (culler.IsVisible(boxes[i * 2], boxes[i * 2 + 1], identity))
+					visible++;
+			}
+		}
+		double testMs = testTimer.ElapsedMs() / frames;
+
+		printf("    %ux%u buffer, %zu occluder triangles\n", culler.GetWidth(), culler.GetHeight(), culler.GetOccluderTriangleCount());
+		printf("    rasterize %8.3f ms   test %zu boxes %8.3f ms   culled %zu (%.1f%%)\n",
+			rasterMs, boxCount, testMs, boxCount - visible, 100.0 * (boxCount - visible) / boxCount);
+
+		passed &= Check(visible < boxCount / 2, "less than half of the corridor was culled");
+		return passed;
+	}
+}
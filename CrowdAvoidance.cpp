@@ -0,0 +1,316 @@
+#include "CrowdAvoidance.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#ifdef _WIN32
+#include <ppl.h>
+#endif
+
+using namespace DirectX;
+
+// Agents per block handed to a worker
+#define CROWD_AGENTS_PER_TASK 64
+
+// Lines closer to parallel than this don't cross
+#define CROWD_EPSILON 0.00001f
+
+// Shortest step for overlapping agents, a paused update doesn't blow them apart
+#define CROWD_MIN_DELTA_TIME 0.001f
+
+namespace
+{
+	inline XMFLOAT2 Add(const XMFLOAT2& a, const XMFLOAT2& b) { return XMFLOAT2(a.x + b.x, a.y + b.y); }
+	inline XMFLOAT2 Subtract(const XMFLOAT2& a, const XMFLOAT2& b) { return XMFLOAT2(a.x - b.x, a.y - b.y); }
+	inline XMFLOAT2 Scale(const XMFLOAT2& a, float s) { return XMFLOAT2(a.x * s, a.y * s); }
+	inline float Dot(const XMFLOAT2& a, const XMFLOAT2& b) { return a.x * b.x + a.y * b.y; }
+	inline float Det(const XMFLOAT2& a, const XMFLOAT2& b) { return a.x * b.y - a.y * b.x; }
+	inline float LengthSq(const XMFLOAT2& a) { return a.x * a.x + a.y * a.y; }
+
+	inline XMFLOAT2 Normalize(const XMFLOAT2& a)
+	{
+		float length = sqrtf(LengthSq(a));
+		return length > 0.0f ? Scale(a, 1.0f / length) : XMFLOAT2(0.0f, 0.0f);
+	}
+
+	// Task 0 to taskCount - 1 at once: on PPL's threads, or plain ones where there is no PPL (the headless AIStress build)
+	template <typename Task>
+	void RunTasks(unsigned int taskCount, const Task& task)
+	{
+#ifdef _WIN32
+		Concurrency::parallel_for(0u, taskCount, task, Concurrency::static_partitioner());
+#else
+		std::vector<std::thread> threads;
+		for (unsigned int i = 1; i < taskCount; ++i)
+			threads.push_back(std::thread(task, i));
+		if (taskCount > 0)
+			task(0u);
+		for (std::thread& thread : threads)
+			thread.join();
+#endif
+	}
+}
+
+CrowdAvoidance::CrowdAvoidance(const CrowdAvoidanceSettings& settings)
+	: settings(settings), hash(settings.neighbourDistance)
+{
+	workerCount = settings.workerCount > 0 ? settings.workerCount : (std::max)(1u, std::thread::hardware_concurrency());
+	scratch.resize(workerCount);
+}
+
+void CrowdAvoidance::SetAgents(const float* x, const float* y, const float* z, const float* agentVelocityX, const float* agentVelocityZ, unsigned int count)
+{
+	positionX = x;
+	positionY = y;
+	positionZ = z;
+	velocityX = agentVelocityX;
+	velocityZ = agentVelocityZ;
+	agentCount = count;
+	hash.Build(x, y, z, count);
+}
+
+// --------------------------------------------------------
+// Blocks of agents to workerCount tasks, every agent only
+// reads the shared state so the blocks can go anywhere
+// --------------------------------------------------------
+void CrowdAvoidance::Solve(const unsigned int* agents, unsigned int count, const float* preferredX, const float* preferredZ, const float* maxSpeeds,
+	const float* deltaTimes, float* newVelocityX, float* newVelocityZ)
+{
+	std::atomic<unsigned int> next(0);
+	unsigned int tasks = (std::min)(workerCount, (count + CROWD_AGENTS_PER_TASK - 1) / CROWD_AGENTS_PER_TASK);
+	RunTasks(tasks, [&](unsigned int task)
+	{
+		for (;;)
+		{
+			unsigned int first = next.fetch_add(CROWD_AGENTS_PER_TASK);
+			if (first >= count)
+				break;
+
+			unsigned int last = (std::min)(first + CROWD_AGENTS_PER_TASK, count);
+			for (unsigned int i = first; i < last; ++i)
+			{
+				unsigned int agent = agents[i];
+				XMFLOAT2 velocity = SolveAgent(agent, XMFLOAT2(preferredX[agent], preferredZ[agent]), maxSpeeds[agent], deltaTimes[agent], scratch[task]);
+				newVelocityX[agent] = velocity.x;
+				newVelocityZ[agent] = velocity.y;
+			}
+		}
+	});
+}
+
+// --------------------------------------------------------
+// One ORCA half plane per neighbour: the smallest change
+// u of the relative velocity that leaves the velocity
+// obstacle (the cone of velocities colliding within the
+// time horizon), half of it taken by this agent
+// --------------------------------------------------------
+XMFLOAT2 CrowdAvoidance::SolveAgent(unsigned int agent, const XMFLOAT2& preferred, float maxSpeed, float deltaTime, Scratch& work) const
+{
+	XMFLOAT3 position3(positionX[agent], positionY[agent], positionZ[agent]);
+	XMFLOAT2 position(position3.x, position3.z);
+	XMFLOAT2 velocity(velocityX[agent], velocityZ[agent]);
+
+	// the closest neighbours, ties broken by index so the order never depends on the threads
+	hash.Query(position3, settings.neighbourDistance, work.found);
+	work.neighbours.clear();
+	for (unsigned int other : work.found)
+	{
+		if (other != agent)
+			work.neighbours.push_back(std::make_pair(LengthSq(XMFLOAT2(positionX[other] - position.x, positionZ[other] - position.y)), other));
+	}
+	if (work.neighbours.size() > settings.maxNeighbours)
+	{
+		std::nth_element(work.neighbours.begin(), work.neighbours.begin() + settings.maxNeighbours, work.neighbours.end());
+		work.neighbours.resize(settings.maxNeighbours);
+	}
+	std::sort(work.neighbours.begin(), work.neighbours.end());
+
+	float invTimeHorizon = 1.0f / settings.timeHorizon;
+	float invTimeStep = 1.0f / (std::max)(deltaTime, CROWD_MIN_DELTA_TIME);
+	float combinedRadius = settings.radius * 2.0f;
+	float combinedRadiusSq = combinedRadius * combinedRadius;
+
+	work.lines.clear();
+	for (const std::pair<float, unsigned int>& neighbour : work.neighbours)
+	{
+		unsigned int other = neighbour.second;
+		XMFLOAT2 relativePosition(positionX[other] - position.x, positionZ[other] - position.y);
+		XMFLOAT2 relativeVelocity = Subtract(velocity, XMFLOAT2(velocityX[other], velocityZ[other]));
+		float distSq = neighbour.first;
+
+		Line line;
+		XMFLOAT2 u;
+		if (distSq > combinedRadiusSq)
+		{
+			// w from the centre of the cone's cutoff circle to the relative velocity
+			XMFLOAT2 w = Subtract(relativeVelocity, Scale(relativePosition, invTimeHorizon));
+			float wLengthSq = LengthSq(w);
+			float dotProduct = Dot(w, relativePosition);
+
+			if (dotProduct < 0.0f && dotProduct * dotProduct > combinedRadiusSq * wLengthSq)
+			{
+				// closest to the cutoff circle
+				float wLength = sqrtf(wLengthSq);
+				XMFLOAT2 unitW = Scale(w, 1.0f / wLength);
+				line.direction = XMFLOAT2(unitW.y, -unitW.x);
+				u = Scale(unitW, combinedRadius * invTimeHorizon - wLength);
+			}
+			else
+			{
+				// closest to one of the cone's legs
+				float leg = sqrtf(distSq - combinedRadiusSq);
+				if (Det(relativePosition, w) > 0.0f)
+					line.direction = Scale(XMFLOAT2(relativePosition.x * leg - relativePosition.y * combinedRadius, relativePosition.x * combinedRadius + relativePosition.y * leg), 1.0f / distSq);
+				else
+					line.direction = Scale(XMFLOAT2(relativePosition.x * leg + relativePosition.y * combinedRadius, -relativePosition.x * combinedRadius + relativePosition.y * leg), -1.0f / distSq);
+				u = Subtract(Scale(line.direction, Dot(relativeVelocity, line.direction)), relativeVelocity);
+			}
+		}
+		else
+		{
+			// already overlapping, get apart within the next step. Agents on the same spot split along X by index
+			XMFLOAT2 w = Subtract(relativeVelocity, Scale(relativePosition, invTimeStep));
+			float wLength = sqrtf(LengthSq(w));
+			XMFLOAT2 unitW = wLength > CROWD_EPSILON ? Scale(w, 1.0f / wLength) : XMFLOAT2(agent < other ? -1.0f : 1.0f, 0.0f);
+			line.direction = XMFLOAT2(unitW.y, -unitW.x);
+			u = Scale(unitW, combinedRadius * invTimeStep - wLength);
+		}
+
+		line.point = Add(velocity, Scale(u, 0.5f));
+		work.lines.push_back(line);
+	}
+
+	XMFLOAT2 result;
+	size_t failed = LinearProgram2(work.lines, maxSpeed, preferred, false, result);
+	if (failed < work.lines.size())
+		LinearProgram3(work.lines, failed, maxSpeed, work.projected, result);
+	return result;
+}
+
+// --------------------------------------------------------
+// The point of line lineNo within the speed circle and
+// left of all the lines before it closest to the optimum,
+// false if there is none
+// --------------------------------------------------------
+bool CrowdAvoidance::LinearProgram1(const std::vector<Line>& lines, size_t lineNo, float radius, const XMFLOAT2& optimal, bool directionOptimal, XMFLOAT2& result)
+{
+	const Line& line = lines[lineNo];
+	float dotProduct = Dot(line.point, line.direction);
+	float discriminant = dotProduct * dotProduct + radius * radius - LengthSq(line.point);
+	if (discriminant < 0.0f)
+		return false;	// the line misses the speed circle
+
+	float sqrtDiscriminant = sqrtf(discriminant);
+	float tLeft = -dotProduct - sqrtDiscriminant;
+	float tRight = -dotProduct + sqrtDiscriminant;
+
+	for (size_t i = 0; i < lineNo; ++i)
+	{
+		float denominator = Det(line.direction, lines[i].direction);
+		float numerator = Det(lines[i].direction, Subtract(line.point, lines[i].point));
+
+		if (fabsf(denominator) <= CROWD_EPSILON)
+		{
+			// parallel, either all of the line is allowed or none of it
+			if (numerator < 0.0f)
+				return false;
+			continue;
+		}
+
+		float t = numerator / denominator;
+		if (denominator >= 0.0f)
+			tRight = (std::min)(tRight, t);
+		else
+			tLeft = (std::max)(tLeft, t);
+
+		if (tLeft > tRight)
+			return false;
+	}
+
+	if (directionOptimal)
+	{
+		// furthest along the optimal direction
+		result = Add(line.point, Scale(line.direction, Dot(optimal, line.direction) > 0.0f ? tRight : tLeft));
+	}
+	else
+	{
+		// closest to the optimal point
+		float t = (std::min)((std::max)(Dot(line.direction, Subtract(optimal, line.point)), tLeft), tRight);
+		result = Add(line.point, Scale(line.direction, t));
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Incremental 2D linear program: the optimum so far only
+// moves when a new line cuts it off, then to the best
+// point on that line. Returns the line that left nothing,
+// or the line count on success
+// --------------------------------------------------------
+size_t CrowdAvoidance::LinearProgram2(const std::vector<Line>& lines, float radius, const XMFLOAT2& optimal, bool directionOptimal, XMFLOAT2& result)
+{
+	if (directionOptimal)
+		result = Scale(optimal, radius);
+	else if (LengthSq(optimal) > radius * radius)
+		result = Scale(Normalize(optimal), radius);
+	else
+		result = optimal;
+
+	for (size_t i = 0; i < lines.size(); ++i)
+	{
+		if (Det(lines[i].direction, Subtract(lines[i].point, result)) > 0.0f)
+		{
+			XMFLOAT2 previous = result;
+			if (!LinearProgram1(lines, i, radius, optimal, directionOptimal, result))
+			{
+				result = previous;
+				return i;
+			}
+		}
+	}
+	return lines.size();
+}
+
+// --------------------------------------------------------
+// No velocity satisfies every line (too crowded), so the
+// one that violates the worst line the least: a 2D program
+// on each violated line against its intersections with
+// the lines before it
+// --------------------------------------------------------
+void CrowdAvoidance::LinearProgram3(const std::vector<Line>& lines, size_t beginLine, float radius, std::vector<Line>& projected, XMFLOAT2& result)
+{
+	float distance = 0.0f;
+	for (size_t i = beginLine; i < lines.size(); ++i)
+	{
+		if (Det(lines[i].direction, Subtract(lines[i].point, result)) <= distance)
+			continue;
+
+		projected.clear();
+		for (size_t j = 0; j < i; ++j)
+		{
+			Line line;
+			float determinant = Det(lines[i].direction, lines[j].direction);
+			if (fabsf(determinant) <= CROWD_EPSILON)
+			{
+				// same direction adds nothing, opposite ones meet halfway
+				if (Dot(lines[i].direction, lines[j].direction) > 0.0f)
+					continue;
+				line.point = Scale(Add(lines[i].point, lines[j].point), 0.5f);
+			}
+			else
+			{
+				line.point = Add(lines[i].point, Scale(lines[i].direction, Det(lines[j].direction, Subtract(lines[i].point, lines[j].point)) / determinant));
+			}
+			line.direction = Normalize(Subtract(lines[j].direction, lines[i].direction));
+			projected.push_back(line);
+		}
+
+		XMFLOAT2 previous = result;
+		if (LinearProgram2(projected, radius, XMFLOAT2(-lines[i].direction.y, lines[i].direction.x), true, result) < projected.size())
+		{
+			// only from rounding, the result already was optimal
+			result = previous;
+		}
+		distance = Det(lines[i].direction, Subtract(lines[i].point, result));
+	}
+}
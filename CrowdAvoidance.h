@@ -0,0 +1,95 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <utility>
+#include <vector>
+#include "AgentSpatialHash.h"
+
+struct CrowdAvoidanceSettings
+{
+	// Agents are discs of this radius in XZ
+	float radius = 0.4f;
+
+	// Only agents this close are avoided, and only the closest maxNeighbours of them
+	float neighbourDistance = AGENT_HASH_CELL_SIZE;
+	unsigned int maxNeighbours = 10;
+
+	// Seconds ahead a velocity has to stay clear of the neighbours, shorter reacts later but leaves more room to move
+	float timeHorizon = 1.5f;
+
+	// Threads solving at once, 0 for one per core
+	unsigned int workerCount = 0;
+};
+
+/**
+ * Local avoidance between moving agents with optimal reciprocal
+ * collision avoidance (ORCA): each agent picks the velocity closest to
+ * the one it wants that stays clear of its neighbours for the time
+ * horizon, assuming they all do the same and take half the effort each.
+ *
+ * Every neighbour turns into a half plane of allowed velocities, the new
+ * velocity is the point of their intersection (within the max speed)
+ * closest to the preferred one, a small 2D linear program. When the half
+ * planes leave nothing, the velocity that violates them the least wins.
+ *
+ * Works in XZ only, and knows nothing of walls: agents steered along a
+ * navmesh may get pushed a little off their paths.
+ *
+ * Solve() only reads the agents' current state and writes the new
+ * velocities to separate arrays, every agent independently, so the
+ * agents are split over the workers and the result doesn't depend on the
+ * number of threads.
+ */
+class CrowdAvoidance
+{
+public:
+	explicit CrowdAvoidance(const CrowdAvoidanceSettings& settings = CrowdAvoidanceSettings());
+	~CrowdAvoidance() = default;
+
+	// Every agent as SoA arrays (e.g. AISystem's), with the XZ velocity it moves with now. Rebuilds the neighbour hash
+	void SetAgents(const float* x, const float* y, const float* z, const float* velocityX, const float* velocityZ, unsigned int agentCount);
+
+	// New velocities for the listed agents only, the others are still avoided. All arrays but agents are indexed by agent.
+	// deltaTimes are each agent's next step, agents already overlapping move apart within it
+	void Solve(const unsigned int* agents, unsigned int count, const float* preferredX, const float* preferredZ, const float* maxSpeeds,
+		const float* deltaTimes, float* newVelocityX, float* newVelocityZ);
+
+	inline const CrowdAvoidanceSettings& GetSettings() const { return settings; }
+	inline unsigned int GetWorkerCount() const { return workerCount; }
+	inline const AgentSpatialHash& GetHash() const { return hash; }
+
+private:
+	// A half plane of velocities, everything left of direction through point
+	struct Line
+	{
+		DirectX::XMFLOAT2 point;
+		DirectX::XMFLOAT2 direction;
+	};
+
+	// Lines and neighbours of one worker
+	struct Scratch
+	{
+		std::vector<unsigned int> found;
+		std::vector<std::pair<float, unsigned int>> neighbours;	// squared distance and agent
+		std::vector<Line> lines;
+		std::vector<Line> projected;
+	};
+
+	DirectX::XMFLOAT2 SolveAgent(unsigned int agent, const DirectX::XMFLOAT2& preferred, float maxSpeed, float deltaTime, Scratch& scratch) const;
+
+	static bool LinearProgram1(const std::vector<Line>& lines, size_t lineNo, float radius, const DirectX::XMFLOAT2& optimal, bool directionOptimal, DirectX::XMFLOAT2& result);
+	static size_t LinearProgram2(const std::vector<Line>& lines, float radius, const DirectX::XMFLOAT2& optimal, bool directionOptimal, DirectX::XMFLOAT2& result);
+	static void LinearProgram3(const std::vector<Line>& lines, size_t beginLine, float radius, std::vector<Line>& projected, DirectX::XMFLOAT2& result);
+
+	CrowdAvoidanceSettings settings;
+	unsigned int workerCount = 1;
+	std::vector<Scratch> scratch;
+
+	AgentSpatialHash hash;
+	const float* positionX = nullptr;
+	const float* positionY = nullptr;
+	const float* positionZ = nullptr;
+	const float* velocityX = nullptr;
+	const float* velocityZ = nullptr;
+	unsigned int agentCount = 0;
+};
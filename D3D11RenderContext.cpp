@@ -0,0 +1,145 @@
+#include "D3D11RenderContext.h"
+#include <d3d11.h>
+
+D3D11RenderContext::D3D11RenderContext(ID3D11DeviceContext* context)
+{
+	this->context = context;
+}
+
+void D3D11RenderContext::SetRenderTargets(ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv)
+{
+	stats.stateChanges++;
+	context->OMSetRenderTargets(rtv ? 1 : 0, rtv ? &rtv : nullptr, dsv);
+}
+
+void D3D11RenderContext::ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4])
+{
+	context->ClearRenderTargetView(rtv, color);
+}
+
+void D3D11RenderContext::ClearDepthStencil(ID3D11DepthStencilView* dsv, float depth, unsigned char stencil)
+{
+	context->ClearDepthStencilView(dsv, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, depth, stencil);
+}
+
+void D3D11RenderContext::SetViewport(float width, float height)
+{
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = width;
+	viewport.Height = height;
+	viewport.MinDepth = 0.0f;
+	viewport.MaxDepth = 1.0f;
+
+	stats.stateChanges++;
+	context->RSSetViewports(1, &viewport);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+void D3D11RenderContext::SetBlendState(ID3D11BlendState* blendState)
+{
+	stats.stateChanges++;
+	context->OMSetBlendState(blendState, 0, UINT_MAX);
+}
+
+void D3D11RenderContext::SetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	stats.stateChanges++;
+	context->IASetInputLayout(inputLayout);
+}
+
+void D3D11RenderContext::SetVertexShader(ID3D11VertexShader* shader)
+{
+	stats.stateChanges++;
+	context->VSSetShader(shader, 0, 0);
+}
+
+void D3D11RenderContext::SetPixelShader(ID3D11PixelShader* shader)
+{
+	stats.stateChanges++;
+	context->PSSetShader(shader, 0, 0);
+}
+
+void D3D11RenderContext::SetConstantBuffer(ShaderStage stage, unsigned int slot, ID3D11Buffer* buffer)
+{
+	stats.stateChanges++;
+	if (stage == ShaderStage::Vertex)
+		context->VSSetConstantBuffers(slot, 1, &buffer);
+	else
+		context->PSSetConstantBuffers(slot, 1, &buffer);
+}
+
+void D3D11RenderContext::SetShaderResource(ShaderStage stage, unsigned int slot, ID3D11ShaderResourceView* srv)
+{
+	stats.stateChanges++;
+	if (stage == ShaderStage::Vertex)
+		context->VSSetShaderResources(slot, 1, &srv);
+	else
+		context->PSSetShaderResources(slot, 1, &srv);
+}
+
+void D3D11RenderContext::SetSampler(ShaderStage stage, unsigned int slot, ID3D11SamplerState* sampler)
+{
+	stats.stateChanges++;
+	if (stage == ShaderStage::Vertex)
+		context->VSSetSamplers(slot, 1, &sampler);
+	else
+		context->PSSetSamplers(slot, 1, &sampler);
+}
+
+void D3D11RenderContext::UnbindShaderResources(ShaderStage stage)
+{
+	ID3D11ShaderResourceView* nullSRVs[RENDER_CONTEXT_SRV_SLOTS] = {};
+
+	stats.stateChanges++;
+	if (stage == ShaderStage::Vertex)
+		context->VSSetShaderResources(0, RENDER_CONTEXT_SRV_SLOTS, nullSRVs);
+	else
+		context->PSSetShaderResources(0, RENDER_CONTEXT_SRV_SLOTS, nullSRVs);
+}
+
+void D3D11RenderContext::UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size)
+{
+	stats.bytesUploaded += size;
+	context->UpdateSubresource(buffer, 0, 0, data, 0, 0);
+}
+
+void D3D11RenderContext::UpdateBufferRange(ID3D11Buffer* buffer, unsigned int byteOffset, const void* data, unsigned int size)
+{
+	if (size == 0)
+		return;
+
+	D3D11_BOX box = {};
+	box.left = byteOffset;
+	box.right = byteOffset + size;
+	box.bottom = 1;
+	box.back = 1;
+
+	stats.bytesUploaded += size;
+	context->UpdateSubresource(buffer, 0, &box, data, 0, 0);
+}
+
+void D3D11RenderContext::SetVertexBuffer(ID3D11Buffer* buffer, unsigned int stride)
+{
+	UINT offset = 0;
+
+	stats.stateChanges++;
+	context->IASetVertexBuffers(0, 1, &buffer, &stride, &offset);
+}
+
+void D3D11RenderContext::SetIndexBuffer(ID3D11Buffer* buffer)
+{
+	stats.stateChanges++;
+	context->IASetIndexBuffer(buffer, DXGI_FORMAT_R32_UINT, 0);
+}
+
+void D3D11RenderContext::Draw(unsigned int vertexCount)
+{
+	stats.drawCalls++;
+	context->Draw(vertexCount, 0);
+}
+
+void D3D11RenderContext::DrawIndexed(unsigned int indexCount)
+{
+	stats.drawCalls++;
+	context->DrawIndexed(indexCount, 0, 0);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "RenderBackend.h"
+
+struct ID3D11DeviceContext;
+
+/**
+ * Forwards every call to an immediate or deferred D3D11 context.
+ * Does not track bindings, so every bind counts as a state change.
+ */
+class D3D11RenderContext : public IRenderContext
+{
+public:
+	D3D11RenderContext(struct ID3D11DeviceContext* context);
+	~D3D11RenderContext() = default;
+
+	inline struct ID3D11DeviceContext* GetDeviceContext() const { return context; }
+
+	void SetRenderTargets(ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv) override;
+	void ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4]) override;
+	void ClearDepthStencil(ID3D11DepthStencilView* dsv, float depth, unsigned char stencil) override;
+	void SetViewport(float width, float height) override;
+	void SetBlendState(ID3D11BlendState* blendState) override;
+
+	void SetInputLayout(ID3D11InputLayout* inputLayout) override;
+	void SetVertexShader(ID3D11VertexShader* shader) override;
+	void SetPixelShader(ID3D11PixelShader* shader) override;
+	void SetConstantBuffer(ShaderStage stage, unsigned int slot, ID3D11Buffer* buffer) override;
+	void SetShaderResource(ShaderStage stage, unsigned int slot, ID3D11ShaderResourceView* srv) override;
+	void SetSampler(ShaderStage stage, unsigned int slot, ID3D11SamplerState* sampler) override;
+	void UnbindShaderResources(ShaderStage stage) override;
+
+	void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size) override;
+	void UpdateBufferRange(ID3D11Buffer* buffer, unsigned int byteOffset, const void* data, unsigned int size) override;
+
+	void SetVertexBuffer(ID3D11Buffer* buffer, unsigned int stride) override;
+	void SetIndexBuffer(ID3D11Buffer* buffer) override;
+
+	void Draw(unsigned int vertexCount) override;
+	void DrawIndexed(unsigned int indexCount) override;
+
+private:
+	struct ID3D11DeviceContext* context;
+};
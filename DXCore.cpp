@@ -1,4 +1,5 @@
 #include "DXCore.h"
+#include "RawInputSource.h"
 
 #include <WindowsX.h>
 #include <sstream>
@@ -57,6 +58,10 @@ DXCore::DXCore(
 	this->startTime = 0;
 	this->totalTime = 0;
 
+	this->inputSystem = 0;
+	this->inputSource = 0;
+	this->inputThread = 0;
+
 	// Query performance counter for accurate timing information
 	__int64 perfFreq;
 	QueryPerformanceFrequency((LARGE_INTEGER*)&perfFreq);
@@ -72,6 +77,10 @@ DXCore::~DXCore()
 	// we don't need to explicitly clean up those DirectX objects
 	// - If we weren't using smart pointers, we'd need
 	//   to call Release() on each DirectX object
+
+	// Stop the input thread before what it reads from and writes to goes away
+	delete inputThread;
+	delete inputSource;
 	delete inputSystem;
 }
 
@@ -386,6 +395,13 @@ HRESULT DXCore::Run()
 	// After game is initialized, create an input system
 	inputSystem = new Input::InputSystem();
 
+	// Keys and mouse are collected as they happen from here on,
+	// Frame() takes them at the start of every Update()
+	inputSource = new Input::RawInputSource(hWnd);
+	inputThread = new Input::InputThread(inputSource);
+	inputThread->Start();
+	inputSystem->SetInputThread(inputThread);
+
 	// Our overall game and message loop
 	MSG msg = {};
 	while (msg.message != WM_QUIT)
@@ -505,6 +521,8 @@ void DXCore::UpdateTitleBarStats()
 	default:                     output << "    DX ???";  break;
 	}
 
+	AppendTitleBarStats(output);
+
 	// Actually update the title bar and reset fps data
 	SetWindowText(hWnd, output.str().c_str());
 	fpsFrameCount = 0;
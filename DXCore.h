@@ -3,6 +3,7 @@
 #include <Windows.h>
 #include <d3d11.h>
 #include <string>
+#include <iosfwd>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 
 // Base DXCore holds the owning pointer to the input wrangler
@@ -70,6 +71,9 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> backBufferRTV;
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthStencilView;
 
+	// Lets the game add its own counters to the once per second title bar update
+	virtual void AppendTitleBarStats(std::ostream& output) {}
+
 	// Helper function for allocating a console window
 	void CreateConsoleWindow(int bufferLines, int bufferColumns, int windowLines, int windowColumns);
 
@@ -80,8 +84,10 @@ protected:
 	std::string GetFullPathTo(std::string relativeFilePath);
 	std::wstring GetFullPathTo_Wide(std::wstring relativeFilePath);
 
-	// Input System
+	// Input System, fed by raw input read on its own thread
 	Input::InputSystem* inputSystem;
+	Input::InputSource* inputSource;
+	Input::InputThread* inputThread;
 
 private:
 	// Timing related data
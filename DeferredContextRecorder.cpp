@@ -0,0 +1,196 @@
+#include "DeferredContextRecorder.h"
+#include "Entity.h"
+#include "Material.h"
+#include "SimpleShader.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+DeferredContextRecorder::DeferredContextRecorder(ID3D11Device* device, ID3D11DeviceContext* immediateContext, unsigned int workerCount)
+{
+	this->device = device;
+	this->immediateContext = immediateContext;
+
+	for (unsigned int i = 0; i < workerCount; ++i)
+	{
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> deferred;
+		if (FAILED(device->CreateDeferredContext(0, deferred.GetAddressOf())))
+			break;
+
+		deferredContexts.push_back(deferred);
+		workerContexts.push_back(D3D11RenderContext(deferred.Get()));
+	}
+
+	commandLists.resize(deferredContexts.size());
+}
+
+DeferredContextRecorder::~DeferredContextRecorder()
+{
+	for (auto& pair : vertexMirrors)
+	{
+		for (SimpleVertexShader* mirror : pair.second)
+			delete mirror;
+	}
+
+	for (auto& pair : pixelMirrors)
+	{
+		for (SimplePixelShader* mirror : pair.second)
+			delete mirror;
+	}
+}
+
+void DeferredContextRecorder::MirrorVertexShader(SimpleVertexShader* source, LPCWSTR shaderFile)
+{
+	std::vector<SimpleVertexShader*>& mirrors = vertexMirrors[source];
+	for (size_t i = mirrors.size(); i < deferredContexts.size(); ++i)
+	{
+		SimpleVertexShader* mirror = new SimpleVertexShader(device, deferredContexts[i].Get(), shaderFile);
+		mirror->SetRenderContext(&workerContexts[i]);
+		mirrors.push_back(mirror);
+	}
+}
+
+void DeferredContextRecorder::MirrorPixelShader(SimplePixelShader* source, LPCWSTR shaderFile)
+{
+	std::vector<SimplePixelShader*>& mirrors = pixelMirrors[source];
+	for (size_t i = mirrors.size(); i < deferredContexts.size(); ++i)
+	{
+		SimplePixelShader* mirror = new SimplePixelShader(device, deferredContexts[i].Get(), shaderFile);
+		mirror->SetRenderContext(&workerContexts[i]);
+		mirrors.push_back(mirror);
+	}
+}
+
+void DeferredContextRecorder::SetFramePixelResource(unsigned int slot, ID3D11ShaderResourceView* srv)
+{
+	assert(slot < RENDER_CONTEXT_SRV_SLOTS);
+	framePixelResources[slot] = srv;
+}
+
+// --------------------------------------------------------
+// Has to run on the submitting thread after the shared
+// per-frame shader data (lights, camera) has been set on
+// the source shaders and before Submit() is called.
+// --------------------------------------------------------
+void DeferredContextRecorder::BeginFrame(Camera* camera, ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv, const D3D11_VIEWPORT& viewport)
+{
+	this->camera = camera;
+	this->renderTarget = rtv;
+	this->depthStencil = dsv;
+	this->viewport = viewport;
+
+	for (auto& pair : vertexMirrors)
+	{
+		for (SimpleVertexShader* mirror : pair.second)
+			SyncConstantData(pair.first, mirror);
+	}
+
+	for (auto& pair : pixelMirrors)
+	{
+		for (SimplePixelShader* mirror : pair.second)
+			SyncConstantData(pair.first, mirror);
+	}
+}
+
+unsigned int DeferredContextRecorder::GetWorkerCount() const
+{
+	return (unsigned int)deferredContexts.size();
+}
+
+void DeferredContextRecorder::Record(unsigned int worker, const DrawItem* items, size_t count)
+{
+	ID3D11DeviceContext* deferred = deferredContexts[worker].Get();
+	D3D11RenderContext* renderContext = &workerContexts[worker];
+
+	// deferred contexts don't inherit anything from the immediate context
+	renderContext->SetRenderTargets(renderTarget, depthStencil);
+	renderContext->SetViewport(viewport.Width, viewport.Height);
+	for (unsigned int slot = 0; slot < RENDER_CONTEXT_SRV_SLOTS; ++slot)
+	{
+		if (framePixelResources[slot])
+			renderContext->SetShaderResource(ShaderStage::Pixel, slot, framePixelResources[slot]);
+	}
+
+	SimpleVertexShader* activeVS = nullptr;
+	SimplePixelShader* activePS = nullptr;
+
+	// entities only upload per object pixel constants, the per frame ones go up once per mirror
+	std::vector<SimplePixelShader*> uploadedPS;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		Entity* entity = items[i].entity;
+		Material* material = entity->GetMaterial();
+
+		// find() only: the maps are shared between workers and must not be modified here
+		auto vsMirror = vertexMirrors.find(material->GetVertexShader());
+		auto psMirror = pixelMirrors.find(material->GetPixelShader());
+		if (vsMirror == vertexMirrors.end() || psMirror == pixelMirrors.end())
+		{
+			assert(false && "Shader used by the draw list was never mirrored");
+			continue;
+		}
+
+		SimpleVertexShader* vs = vsMirror->second[worker];
+		SimplePixelShader* ps = psMirror->second[worker];
+
+		// the list is sorted by shader, so most of these are skipped
+		if (vs != activeVS)
+		{
+			vs->SetShader();
+			activeVS = vs;
+		}
+		if (ps != activePS)
+		{
+			ps->SetShader();
+			activePS = ps;
+
+			if (std::find(uploadedPS.begin(), uploadedPS.end(), ps) == uploadedPS.end())
+			{
+				ps->CopyAllBufferData();
+				uploadedPS.push_back(ps);
+			}
+		}
+
+		entity->Draw(renderContext, camera, vs, ps);
+	}
+
+	deferred->FinishCommandList(FALSE, commandLists[worker].ReleaseAndGetAddressOf());
+}
+
+void DeferredContextRecorder::Execute(unsigned int worker)
+{
+	if (!commandLists[worker])
+		return;
+
+	// FALSE: don't save/restore immediate state around every list, the caller rebinds what it needs afterwards
+	immediateContext->ExecuteCommandList(commandLists[worker].Get(), FALSE);
+	commandLists[worker].Reset();
+}
+
+void DeferredContextRecorder::CollectStats(RenderStats& total)
+{
+	for (D3D11RenderContext& workerContext : workerContexts)
+	{
+		const RenderStats& stats = workerContext.GetStats();
+		total.drawCalls += stats.drawCalls;
+		total.stateChanges += stats.stateChanges;
+		total.redundantStateChanges += stats.redundantStateChanges;
+		total.bytesUploaded += stats.bytesUploaded;
+		workerContext.ResetStats();
+	}
+}
+
+void DeferredContextRecorder::SyncConstantData(ISimpleShader* source, ISimpleShader* mirror)
+{
+	unsigned int bufferCount = source->GetBufferCount();
+	for (unsigned int b = 0; b < bufferCount; ++b)
+	{
+		const SimpleConstantBuffer* src = source->GetBufferInfo(b);
+		const SimpleConstantBuffer* dst = mirror->GetBufferInfo(b);
+		if (!src || !dst || src->Size != dst->Size)
+			continue;
+
+		memcpy(dst->LocalDataBuffer, src->LocalDataBuffer, src->Size);
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <unordered_map>
+#include <vector>
+#include "ParallelDrawSubmitter.h"
+#include "D3D11RenderContext.h"
+
+class Camera;
+class ISimpleShader;
+class SimpleVertexShader;
+class SimplePixelShader;
+
+/**
+ * Records draw ranges into D3D11 deferred contexts, one per worker,
+ * and executes the resulting command lists on the immediate context.
+ *
+ * SimpleShaders are bound to a single context and keep their constant
+ * data on the CPU, so each worker gets its own mirror of every shader
+ * the draw list uses. Mirrors pick up the source shader's constants at
+ * the start of the frame (lights, camera position, ...) and upload them
+ * the first time a worker binds them.
+ */
+class DeferredContextRecorder : public IDrawRecorder
+{
+public:
+	DeferredContextRecorder(ID3D11Device* device, ID3D11DeviceContext* immediateContext, unsigned int workerCount);
+	~DeferredContextRecorder();
+
+	// Creates a per-worker copy of the shader. Must be called for every shader the draw list can use
+	void MirrorVertexShader(class SimpleVertexShader* source, LPCWSTR shaderFile);
+	void MirrorPixelShader(class SimplePixelShader* source, LPCWSTR shaderFile);
+
+	// Pixel shader resource every worker binds before its draws (e.g. light cluster lists). Kept until changed
+	void SetFramePixelResource(unsigned int slot, ID3D11ShaderResourceView* srv);
+
+	// Captures per-frame state every worker needs, since deferred contexts start from default state
+	void BeginFrame(class Camera* camera, ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv, const D3D11_VIEWPORT& viewport);
+
+	unsigned int GetWorkerCount() const override;
+	void Record(unsigned int worker, const DrawItem* items, size_t count) override;
+	void Execute(unsigned int worker) override;
+
+	inline bool IsValid() const { return !deferredContexts.empty(); }
+
+	// Adds what the workers recorded since the last call to total and resets the worker counters
+	void CollectStats(RenderStats& total);
+
+private:
+	// Copies the CPU side constant data from the source shader into its mirror
+	void SyncConstantData(class ISimpleShader* source, class ISimpleShader* mirror);
+
+	ID3D11DeviceContext* immediateContext = nullptr;
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D11DeviceContext>> deferredContexts;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11CommandList>> commandLists;
+
+	// What entities draw through, one wrapper per deferred context
+	std::vector<D3D11RenderContext> workerContexts;
+
+	// source shader -> one mirror per worker
+	std::unordered_map<class SimpleVertexShader*, std::vector<class SimpleVertexShader*>> vertexMirrors;
+	std::unordered_map<class SimplePixelShader*, std::vector<class SimplePixelShader*>> pixelMirrors;
+
+	ID3D11Device* device = nullptr;
+
+	// Frame state
+	class Camera* camera = nullptr;
+	ID3D11RenderTargetView* renderTarget = nullptr;
+	ID3D11DepthStencilView* depthStencil = nullptr;
+	D3D11_VIEWPORT viewport = {};
+	ID3D11ShaderResourceView* framePixelResources[RENDER_CONTEXT_SRV_SLOTS] = {};
+};
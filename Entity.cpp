@@ -5,6 +5,7 @@
 #include "Material.h"
 #include "Vertex.h"
 #include "SimpleShader.h"
+#include "RenderBackend.h"
 
 Entity::Entity(Mesh* incomingMesh, Material* incomingMaterial)
 {
@@ -34,12 +35,13 @@ class Material* Entity::GetMaterial() const
 }
 
 // doesn't involve instanced rendering yet
-void Entity::Draw(ID3D11DeviceContext* context, Camera* mainCamera)
+void Entity::Draw(IRenderContext* context, Camera* mainCamera)
 {
+	Draw(context, mainCamera, material->GetVertexShader(), material->GetPixelShader());
+}
 
-	SimpleVertexShader* vs = material->GetVertexShader();
-	SimplePixelShader* ps = material->GetPixelShader();
-
+void Entity::Draw(IRenderContext* context, Camera* mainCamera, SimpleVertexShader* vs, SimplePixelShader* ps)
+{
 	// set the vertex shader data
 	vs->SetFloat4("colorTint",  material->GetColorTint());
 	vs->SetMatrix4x4("world", transform->GetWorldMatrix());
@@ -48,7 +50,12 @@ void Entity::Draw(ID3D11DeviceContext* context, Camera* mainCamera)
 	vs->CopyAllBufferData();
 
 	ps->SetFloat("shininess", material->GetShininess());
-	ps->CopyAllBufferData();
+	ps->SetData("objectLights", objectLights.lights, sizeof(Light) * objectLights.count);
+	ps->SetInt("objectLightCount", objectLights.count);
+	ps->SetInt("bakedLighting", bakedLighting);
+	if (bakedLighting == BAKED_LIGHTING_PROBES)
+		ps->SetData("probeSH", probeLight.coefficients, sizeof(probeLight.coefficients));
+	ps->CopyBufferData("ObjectData");
 
 	ps->SetShaderResourceView("diffuseTexture", material->GetDiffuseTextureWrapper());
 	if(material->IsNormalMapMaterial()) 
@@ -57,21 +64,13 @@ void Entity::Draw(ID3D11DeviceContext* context, Camera* mainCamera)
 	}
 	ps->SetSamplerState("samplerOptions", material->GetTextureSampler());
 
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-
 	// set vertex and index buffers and draw the mesh
-	context->IASetVertexBuffers(0, 1, mesh->GetVertexBuffer(), &stride, &offset);
-	context->IASetIndexBuffer(mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
-	context->DrawIndexed
-	(
-		mesh->GetIndexCount(),
-		0,
-		0
-	);
+	context->SetVertexBuffer(*mesh->GetVertexBuffer(), sizeof(Vertex));
+	context->SetIndexBuffer(mesh->GetIndexBuffer());
+	context->DrawIndexed(mesh->GetIndexCount());
 }
 
-void Entity::DrawTransparent(struct ID3D11DeviceContext* context, class Camera* mainCamera)
+void Entity::DrawTransparent(IRenderContext* context, class Camera* mainCamera)
 {
 	SimpleVertexShader* vs = material->GetVertexShader();
 	SimplePixelShader* ps = material->GetPixelShader();
@@ -85,16 +84,8 @@ void Entity::DrawTransparent(struct ID3D11DeviceContext* context, class Camera*
 	ps->SetFloat4("colorAndAlpha",  material->GetColorTint());
 	ps->CopyAllBufferData();
 
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-
 	// set vertex and index buffers and draw the mesh
-	context->IASetVertexBuffers(0, 1, mesh->GetVertexBuffer(), &stride, &offset);
-	context->IASetIndexBuffer(mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
-	context->DrawIndexed
-	(
-		mesh->GetIndexCount(),
-		0,
-		0
-	);
+	context->SetVertexBuffer(*mesh->GetVertexBuffer(), sizeof(Vertex));
+	context->SetIndexBuffer(mesh->GetIndexBuffer());
+	context->DrawIndexed(mesh->GetIndexCount());
 }
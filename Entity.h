@@ -1,13 +1,16 @@
 #pragma once
 
 #include "Transform.h"
+#include "Lights.h"
 
 class Mesh;
 class Camera;
 class Material;
 class Transform;
+class SimpleVertexShader;
+class SimplePixelShader;
 
-struct ID3D11DeviceContext;
+class IRenderContext;
 
 class Entity 
 {
@@ -19,10 +22,27 @@ public:
 	class Transform* GetTransform();
 	class Material* GetMaterial() const;
 
-	void Draw(struct ID3D11DeviceContext* context, class Camera* mainCamera);
-	void DrawTransparent(struct ID3D11DeviceContext* context, class Camera* mainCamera);
+	// Lights picked for this entity by ObjectLightSelector, used with LIGHTING_MODE_PER_OBJECT
+	inline ObjectLights& GetObjectLights() { return objectLights; }
+
+	// BAKED_LIGHTING_LIGHTMAP needs lightmap UVs in the mesh, BAKED_LIGHTING_PROBES the probe light below
+	inline void SetBakedLighting(int bakedLighting) { this->bakedLighting = bakedLighting; }
+	inline int GetBakedLighting() const { return bakedLighting; }
+
+	// Baked light sampled from the IrradianceProbes where the entity is, used with BAKED_LIGHTING_PROBES
+	inline IrradianceSH& GetProbeLight() { return probeLight; }
+
+	// Only uploads the pixel shader's per object constants (ObjectData), the per frame ones are up to the caller
+	void Draw(class IRenderContext* context, class Camera* mainCamera);
+
+	// Same as Draw, but with explicit shaders (e.g. per-thread copies bound to a deferred context)
+	void Draw(class IRenderContext* context, class Camera* mainCamera, class SimpleVertexShader* vs, class SimplePixelShader* ps);
+	void DrawTransparent(class IRenderContext* context, class Camera* mainCamera);
 private:
 	class Transform* transform;
 	class Mesh* mesh;
 	class Material* material;
+	ObjectLights objectLights;
+	int bakedLighting = BAKED_LIGHTING_NONE;
+	IrradianceSH probeLight;
 };
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "FlowField.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+
+using namespace DirectX;
+
+namespace
+{
+	const float diagonalCost = 1.41421356f;
+}
+
+FlowField::FlowField(const NavMesh& navMesh, const FlowFieldSettings& settings)
+	: navMesh(navMesh), settings(settings)
+{
+}
+
+bool FlowField::SetTarget(const XMFLOAT3& newTarget)
+{
+	target = newTarget;
+	unsigned int span = navMesh.FindSpan(newTarget);
+	if (span == targetSpan && visited.size() == navMesh.GetSpanCount())
+		return false;
+
+	targetSpan = span;
+	Integrate();
+	return true;
+}
+
+// --------------------------------------------------------
+// Dijkstra outward from the target's floor. Every floor
+// remembers the one it was reached from, which is its
+// next step toward the target
+// --------------------------------------------------------
+void FlowField::Integrate()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	unsigned int spanCount = navMesh.GetSpanCount();
+	if (visited.size() != spanCount || ++fieldId == 0)
+	{
+		visited.assign(spanCount, 0);
+		costs.resize(spanCount);
+		next.resize(spanCount);
+		fieldId = 1;
+	}
+	open.clear();
+	reachedCount = 0;
+	integrationCount++;
+
+	if (targetSpan != NAV_NO_SPAN)
+	{
+		float maxCost = settings.maxDistance > 0.0f ? settings.maxDistance / navMesh.GetCellSize() : FLT_MAX;
+
+		Visit(targetSpan, targetSpan, 0.0f);
+		while (!open.empty())
+		{
+			std::pop_heap(open.begin(), open.end(), Later);
+			OpenNode node = open.back();
+			open.pop_back();
+			if (node.cost > costs[node.span])
+				continue;
+
+			reachedCount++;
+			for (unsigned int d = 0; d < 4; ++d)
+			{
+				unsigned int side = navMesh.GetNeighbour(node.span, d);
+				if (side == NAV_NO_SPAN)
+					continue;
+				if (node.cost + 1.0f <= maxCost)
+					Visit(side, node.span, node.cost + 1.0f);
+
+				// diagonal, the same span around both sides of the corner
+				unsigned int e = (d + 1) & 3;
+				unsigned int otherSide = navMesh.GetNeighbour(node.span, e);
+				if (otherSide == NAV_NO_SPAN)
+					continue;
+				unsigned int corner = navMesh.GetNeighbour(side, e);
+				if (corner != NAV_NO_SPAN && corner == navMesh.GetNeighbour(otherSide, d) && node.cost + diagonalCost <= maxCost)
+					Visit(corner, node.span, node.cost + diagonalCost);
+			}
+		}
+	}
+
+	integrationMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool FlowField::Later(const OpenNode& a, const OpenNode& b)
+{
+	return a.cost > b.cost;
+}
+
+void FlowField::Visit(unsigned int span, unsigned int from, float cost)
+{
+	if (visited[span] == fieldId && costs[span] <= cost)
+		return;
+
+	visited[span] = fieldId;
+	costs[span] = cost;
+	next[span] = from;
+
+	OpenNode node = { cost, span };
+	open.push_back(node);
+	std::push_heap(open.begin(), open.end(), Later);
+}
+
+bool FlowField::GetSteerTarget(const XMFLOAT3& position, XMFLOAT3& steer) const
+{
+	if (targetSpan == NAV_NO_SPAN)
+		return false;
+
+	unsigned int span = navMesh.FindSpan(position);
+	unsigned int nextSpan = span == NAV_NO_SPAN ? NAV_NO_SPAN : GetNextSpan(span);
+	if (nextSpan == NAV_NO_SPAN)
+		return false;
+
+	if (nextSpan == targetSpan)
+	{
+		steer = target;
+	}
+	else
+	{
+		XMFLOAT3 center = navMesh.GetSpanPosition(nextSpan);
+		steer = XMFLOAT3(center.x, position.y, center.z);
+	}
+	return true;
+}
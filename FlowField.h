@@ -0,0 +1,79 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "NavMesh.h"
+
+struct FlowFieldSettings
+{
+	// Floors farther than this along the paths from the target get no flow, 0 for the target's whole region
+	float maxDistance = 0.0f;
+};
+
+/**
+ * Paths from every floor of a NavMesh to one target, for many agents
+ * chasing the same thing (the ghosts attacking the player).
+ *
+ * SetTarget() integrates the path costs outward from the target's floor
+ * with Dijkstra, over the same moves NavMeshQuery takes, and every floor
+ * keeps the neighbour it was reached from. That neighbour is one step
+ * along a shortest path to the target, so an agent looks up its next
+ * floor in O(1) instead of searching. The field is only integrated again
+ * once the target moves to a different floor.
+ */
+class FlowField
+{
+public:
+	FlowField(const NavMesh& navMesh, const FlowFieldSettings& settings);
+	~FlowField() = default;
+
+	// Integrates the field again if the target moved to another floor. True if it did
+	bool SetTarget(const DirectX::XMFLOAT3& target);
+
+	// Next floor toward the target from the given one, the target floor for itself. NAV_NO_SPAN if the field doesn't reach it
+	inline unsigned int GetNextSpan(unsigned int span) const { return visited[span] == fieldId ? next[span] : NAV_NO_SPAN; }
+
+	// Path cost from the floor to the target in cells, straight steps 1 and diagonal ones sqrt(2). Only for floors GetNextSpan() reaches
+	inline float GetCost(unsigned int span) const { return costs[span]; }
+
+	// Where an agent at the position walks to: the next floor's center at the agent's height, or the
+	// target itself from its floor and the one next to it. False if the field doesn't reach the position
+	bool GetSteerTarget(const DirectX::XMFLOAT3& position, DirectX::XMFLOAT3& steer) const;
+
+	inline bool IsValid() const { return targetSpan != NAV_NO_SPAN; }
+	inline unsigned int GetTargetSpan() const { return targetSpan; }
+	inline unsigned int GetReachedCount() const { return reachedCount; }
+	inline unsigned int GetIntegrationCount() const { return integrationCount; }
+	inline double GetIntegrationMs() const { return integrationMs; }
+	inline const NavMesh& GetNavMesh() const { return navMesh; }
+
+private:
+	struct OpenNode
+	{
+		float cost;
+		unsigned int span;
+	};
+
+	// Heap order, cheapest first
+	static bool Later(const OpenNode& a, const OpenNode& b);
+
+	void Integrate();
+	void Visit(unsigned int span, unsigned int from, float cost);
+
+	const NavMesh& navMesh;
+	FlowFieldSettings settings;
+
+	DirectX::XMFLOAT3 target = DirectX::XMFLOAT3(0, 0, 0);
+	unsigned int targetSpan = NAV_NO_SPAN;
+
+	// per floor, only valid while visited[span] == fieldId
+	std::vector<unsigned int> visited;
+	std::vector<float> costs;
+	std::vector<unsigned int> next;
+	unsigned int fieldId = 0;
+
+	std::vector<OpenNode> open;
+	unsigned int reachedCount = 0;
+	unsigned int integrationCount = 0;
+	double integrationMs = 0;
+};
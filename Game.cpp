@@ -6,11 +6,34 @@
 #include "Material.h"
 #include "SimpleShader.h"
 #include "SimpleAI.h"
+#include "AISystem.h"
+#include "AIScheduler.h"
 #include "WICTextureLoader.h"
 #include "PlayerInterface.h"
+#include "DeferredContextRecorder.h"
+#include "D3D11RenderContext.h"
+#include "OcclusionCuller.h"
+#include "LightClusters.h"
+#include "ObjectLightSelector.h"
+#include "LightSpatialIndex.h"
+#include "LightExposure.h"
+#include "LightInfluenceMap.h"
+#include "LightUploader.h"
+#include "LightmapBaker.h"
+#include "IrradianceProbes.h"
+#include "TriangleBVH.h"
+#include "NavMesh.h"
+#include "FlowField.h"
+#include "NavHierarchy.h"
+#include "CrowdAvoidance.h"
+#include "PathRequestService.h"
+#include <DirectXPackedVector.h>
 #include <algorithm>
+#include <cfloat>
+#include <chrono>
 #include <ppl.h>
 #include <iostream>
+#include <thread>
 
 using namespace Concurrency;
 using namespace std;
@@ -148,6 +171,26 @@ Game::~Game()
 	delete ppVS;
 	
 	delete ppPS;
+
+	delete drawRecorder;
+	delete drawSubmitter;
+
+	delete renderContext;
+	delete occlusionCuller;
+	delete lightClusters;
+	delete lightSelector;
+	delete lightIndex;
+	delete lightExposure;
+	delete lightInfluence;
+	delete lightUploader;
+	delete irradianceProbes;
+	delete aiSystem;
+	delete aiScheduler;
+	delete flowField;
+	delete pathService;
+	delete navHierarchy;
+	delete navMesh;
+	delete sightOccluders;
 }
 
 // --------------------------------------------------------
@@ -156,11 +199,13 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
+	renderContext = new D3D11RenderContext(context.Get());
+
 	LoadShaders();
 
 	CreateBasicGeometry();
 
-	lights = new Light[MAX_LIGHTS_IN_SCENE];
+	lights = new Light[MAX_LIGHTS_IN_SCENE]();
 
 	// Tell the input assembler stage of the pipeline what kind of
 	// geometric primitives (points, lines or triangles) we want to draw.  
@@ -239,7 +284,20 @@ void Game::Init()
 	lights[lightsInScene].type = LIGHT_TYPE_AMBIENT;
 	lights[lightsInScene++].intensity = .1f;
 
-	ResizePostProcessResources();
+	CreateStructuredBuffer(sizeof(Light), MAX_LIGHTS_IN_SCENE, lightBuffer, lightSRV);
+	lightUploader = new LightUploader(MAX_LIGHTS_IN_SCENE);
+	lightUploader->MarkDirty(0, lightsInScene);
+
+	lightClusters = new LightClusters();
+	lightClusters->SetProjection(playerCamera->GetProjectionMatrix(), width, height);
+	CreateStructuredBuffer(sizeof(LightClusterRange), lightClusters->GetClusterCount(), clusterRangeBuffer, clusterRangeSRV);
+	lightSelector = new ObjectLightSelector();
+	lightIndex = new LightSpatialIndex();
+	lightIndex->Build(lights, lightsInScene);
+	lightExposure = new LightExposure();
+	lightExposure->SetLights(lights, lightsInScene);
+
+	BuildFrameGraph();
 
 	ppData.opacity = .95f;
 	ppData.innerRadius = 0.2f;
@@ -247,6 +305,12 @@ void Game::Init()
 	
 	// all the initialization for the engine has to be done prior to this. Now the game specific stuff needs to initialize
 	BeginPlay();
+
+	// needs the room pieces where BeginPlay() put them
+	BakeLightmap();
+	BakeIrradianceProbes();
+	BuildNavMesh();
+	BakeLightInfluence();
 }
 
 // --------------------------------------------------------
@@ -279,6 +343,23 @@ void Game::LoadShaders()
 		context.Get(),
 		GetFullPathTo_Wide(L"VignettePS.cso").c_str());
 
+	// Route shader binds and constant uploads through the same context as the draws
+	ISimpleShader* immediateShaders[] = { vertexShader, pixelShader, normalVS, normalPS, solidColorTransparentPS, ppVS, ppPS };
+	for (ISimpleShader* shader : immediateShaders)
+	{
+		shader->SetRenderContext(renderContext);
+	}
+
+	// Every shader an opaque entity can use needs a copy per deferred context
+	unsigned int drawWorkers = std::thread::hardware_concurrency();
+	drawWorkers = drawWorkers == 0 ? 1 : (drawWorkers > 4 ? 4 : drawWorkers);
+	drawSubmitter = new ParallelDrawSubmitter();
+	drawRecorder = new DeferredContextRecorder(device.Get(), context.Get(), drawWorkers);
+	drawRecorder->MirrorVertexShader(vertexShader, GetFullPathTo_Wide(L"VertexShader.cso").c_str());
+	drawRecorder->MirrorPixelShader(pixelShader, GetFullPathTo_Wide(L"PixelShader.cso").c_str());
+	drawRecorder->MirrorVertexShader(normalVS, GetFullPathTo_Wide(L"NormalMapVS.cso").c_str());
+	drawRecorder->MirrorPixelShader(normalPS, GetFullPathTo_Wide(L"NormalMapPS.cso").c_str());
+
 	// Make the blend state for basic alpha blending
 	D3D11_BLEND_DESC blendDesc = {};
 	blendDesc.AlphaToCoverageEnable = false;
@@ -431,19 +512,25 @@ void Game::CreateBasicGeometry()
 
 	// blue building
 	entities.push_back(new Entity(meshes[5], materials[5]));
+	roomEntities.push_back(entities.back());
 	// gray building
 	entities.push_back(new Entity(meshes[6], materials[6]));
+	roomEntities.push_back(entities.back());
 
 	// room assets
 	
 	//arch
 	entities.push_back(new Entity(meshes[7], materials[7]));
+	roomEntities.push_back(entities.back());
 	//doorway
 	entities.push_back(new Entity(meshes[8], materials[8]));
+	roomEntities.push_back(entities.back());
 	//prism
 	entities.push_back(new Entity(meshes[9], materials[8]));
+	roomEntities.push_back(entities.back());
 	//pipe
 	entities.push_back(new Entity(meshes[10], materials[9]));
+	roomEntities.push_back(entities.back());
 
 	// Ghost
 	ghostEntities.push_back(new Entity(meshes[11], materials[10]));
@@ -468,10 +555,390 @@ void Game::CreateBasicGeometry()
 	aiGhosts.push_back(new SimpleAI(playerCamera, &route1[0], ghostEntities[0]));
 	aiGhosts.push_back(new SimpleAI(playerCamera, &route2[0], ghostEntities[1]));
 
+	BuildOpaqueDrawList();
+
+	// the rooms hide most of each other and everything inside them
+	occluders.push_back(entities[5]);
+	occluders.push_back(entities[6]);
+	occlusionCuller = new OcclusionCuller();
 	
 	bDrawWaypoints = true;
 }
 
+// --------------------------------------------------------
+// Sorts the opaque entities so draws sharing a shader and
+// material are adjacent. Both the serial and the deferred
+// path submit in this order.
+// --------------------------------------------------------
+void Game::BuildOpaqueDrawList()
+{
+	opaqueDrawList.clear();
+
+	for (Entity* entity : entities)
+	{
+		Material* mat = entity->GetMaterial();
+		unsigned long long shaderKey = (mat->GetPixelShader() == normalPS) ? 1ull : 0ull;
+		unsigned long long materialKey = (unsigned long long)(std::find(materials.begin(), materials.end(), mat) - materials.begin());
+
+		opaqueDrawList.push_back({ entity, (shaderKey << 32) | materialKey });
+	}
+
+	ParallelDrawSubmitter::SortDrawList(opaqueDrawList);
+}
+
+
+const std::vector<DrawItem>& Game::CullOpaqueDrawList()
+{
+	lastCulledCount = 0;
+	if (!bOcclusionCulling)
+		return opaqueDrawList;
+
+	occlusionCuller->BeginFrame(playerCamera->GetViewMatrix(), playerCamera->GetProjectionMatrix());
+	for (Entity* occluder : occluders)
+	{
+		Mesh* mesh = occluder->GetMesh();
+		occlusionCuller->AddOccluder(mesh->GetPositions().data(), mesh->GetIndices().data(), mesh->GetIndices().size(), occluder->GetTransform()->GetWorldMatrix());
+	}
+	occlusionCuller->Rasterize();
+
+	// filtering keeps the list sorted
+	visibleDrawList.clear();
+	for (const DrawItem& item : opaqueDrawList)
+	{
+		Mesh* mesh = item.entity->GetMesh();
+		if (occlusionCuller->IsVisible(mesh->GetBoundsMin(), mesh->GetBoundsMax(), item.entity->GetTransform()->GetWorldMatrix()))
+			visibleDrawList.push_back(item);
+	}
+
+	lastCulledCount = opaqueDrawList.size() - visibleDrawList.size();
+	return visibleDrawList;
+}
+
+void Game::UpdateLightClusters()
+{
+	lightClusters->Assign(lights, lightsInScene, playerCamera->GetViewMatrix());
+
+	// the index list changes size every frame, grow its buffer when it doesn't fit anymore
+	const std::vector<unsigned int>& indices = lightClusters->GetIndices();
+	if (indices.size() > clusterIndexCapacity)
+	{
+		clusterIndexCapacity = (std::max)((unsigned int)indices.size(), (std::max)(clusterIndexCapacity * 2, 1024u));
+		CreateStructuredBuffer(sizeof(unsigned int), clusterIndexCapacity, clusterIndexBuffer, clusterIndexSRV);
+	}
+
+	const std::vector<LightClusterRange>& ranges = lightClusters->GetRanges();
+	renderContext->UpdateBuffer(clusterRangeBuffer.Get(), ranges.data(), (unsigned int)(ranges.size() * sizeof(LightClusterRange)));
+	if (!indices.empty())
+		renderContext->UpdateBufferRange(clusterIndexBuffer.Get(), 0, indices.data(), (unsigned int)(indices.size() * sizeof(unsigned int)));
+
+	// the shaders don't own these, so bind them directly for the immediate context and every worker
+	renderContext->SetShaderResource(ShaderStage::Pixel, LIGHT_CLUSTER_RANGE_SLOT, clusterRangeSRV.Get());
+	renderContext->SetShaderResource(ShaderStage::Pixel, LIGHT_CLUSTER_INDEX_SLOT, clusterIndexSRV.Get());
+	drawRecorder->SetFramePixelResource(LIGHT_CLUSTER_RANGE_SLOT, clusterRangeSRV.Get());
+	drawRecorder->SetFramePixelResource(LIGHT_CLUSTER_INDEX_SLOT, clusterIndexSRV.Get());
+}
+
+void Game::SelectObjectLights(const std::vector<DrawItem>& drawList)
+{
+	lightSelector->BeginFrame(lights, lightsInScene);
+
+	parallel_for
+	(
+		size_t(0), drawList.size(), [&](size_t i)
+		{
+			Entity* entity = drawList[i].entity;
+			Mesh* mesh = entity->GetMesh();
+			lightSelector->Select(mesh->GetBoundsMin(), mesh->GetBoundsMax(), entity->GetTransform()->GetWorldMatrix(), entity->GetObjectLights());
+		},
+		static_partitioner()
+	);
+}
+
+void Game::CreateStructuredBuffer(unsigned int stride, unsigned int count, Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+{
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	bufferDesc.ByteWidth = stride * count;
+	bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	bufferDesc.StructureByteStride = stride;
+	device->CreateBuffer(&bufferDesc, 0, buffer.ReleaseAndGetAddressOf());
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = count;
+	device->CreateShaderResourceView(buffer.Get(), &srvDesc, srv.ReleaseAndGetAddressOf());
+}
+
+// --------------------------------------------------------
+// Bakes every light except the two ghost lights for the
+// room entities and switches those to the lightmap.
+// Runs at load, takes a moment on the worker threads
+// --------------------------------------------------------
+void Game::BakeLightmap()
+{
+	// the ghost lights move with the ghosts
+	for (unsigned int i = 2; i < lightsInScene; i++)
+		lights[i].baked = 1;
+
+	LightmapBaker baker;
+	for (Entity* entity : roomEntities)
+	{
+		Mesh* mesh = entity->GetMesh();
+		LightmapInstance instance;
+		instance.vertices = mesh->GetVertices().data();
+		instance.vertexCount = (unsigned int)mesh->GetVertices().size();
+		instance.indices = mesh->GetIndices().data();
+		instance.indexCount = (unsigned int)mesh->GetIndices().size();
+		instance.world = entity->GetTransform()->GetWorldMatrix();
+		instance.albedo = XMFLOAT3(0.5f, 0.5f, 0.5f);
+		baker.AddInstance(instance);
+	}
+
+	LightmapSettings settings;
+	bool baked = baker.Bake(lights, lightsInScene, settings);
+	for (unsigned int i = 0; baked && i < roomEntities.size(); i++)
+		baked = roomEntities[i]->GetMesh()->SetLightmapUVs(baker.GetLightmapUVs(i), device.Get());
+
+	if (!baked)
+	{
+		printf("Lightmap bake failed, lighting everything at runtime\n");
+		for (unsigned int i = 0; i < lightsInScene; i++)
+			lights[i].baked = 0;
+		return;
+	}
+
+	// half floats keep the light above 1 and filter on every card
+	const unsigned int size = baker.GetAtlasSize();
+	const std::vector<XMFLOAT4>& texels = baker.GetTexels();
+	std::vector<PackedVector::XMHALF4> halfTexels(texels.size());
+	for (size_t i = 0; i < texels.size(); i++)
+		PackedVector::XMStoreHalf4(&halfTexels[i], XMLoadFloat4(&texels[i]));
+
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = size;
+	textureDesc.Height = size;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_SUBRESOURCE_DATA initialData = {};
+	initialData.pSysMem = halfTexels.data();
+	initialData.SysMemPitch = size * sizeof(PackedVector::XMHALF4);
+	device->CreateTexture2D(&textureDesc, &initialData, lightmapTexture.ReleaseAndGetAddressOf());
+	device->CreateShaderResourceView(lightmapTexture.Get(), 0, lightmapSRV.ReleaseAndGetAddressOf());
+
+	for (Entity* entity : roomEntities)
+		entity->SetBakedLighting(BAKED_LIGHTING_LIGHTMAP);
+
+	// the shaders need the baked flags
+	lightUploader->MarkDirty(0, lightsInScene);
+
+	printf("Lightmap: %u texels covered at %.1f texels per unit, charts %.1f ms, direct %.1f ms, bounce %.1f ms on %u threads\n",
+		baker.GetCoveredTexelCount(), baker.GetTexelsPerUnit(), baker.GetChartMs(), baker.GetDirectMs(), baker.GetBounceMs(), baker.GetWorkerCount());
+}
+
+// --------------------------------------------------------
+// Bakes the lights BakeLightmap() flagged into a probe grid
+// over the room, blocked by the room pieces, and switches
+// the demo objects over to it
+// --------------------------------------------------------
+void Game::BakeIrradianceProbes()
+{
+	// the lightmap bake failed, nothing is flagged as baked
+	if (!lightmapSRV)
+		return;
+
+	TriangleBVH occluders;
+	XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+	for (Entity* entity : roomEntities)
+	{
+		Mesh* mesh = entity->GetMesh();
+		XMFLOAT4X4 worldMatrix = entity->GetTransform()->GetWorldMatrix();
+		XMMATRIX world = XMLoadFloat4x4(&worldMatrix);
+
+		const std::vector<XMFLOAT3>& positions = mesh->GetPositions();
+		const std::vector<unsigned int>& indices = mesh->GetIndices();
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			XMFLOAT3 corners[3];
+			for (int k = 0; k < 3; k++)
+			{
+				XMVECTOR corner = XMVector3TransformCoord(XMLoadFloat3(&positions[indices[t + k]]), world);
+				boundsMin = XMVectorMin(boundsMin, corner);
+				boundsMax = XMVectorMax(boundsMax, corner);
+				XMStoreFloat3(&corners[k], corner);
+			}
+			occluders.AddTriangle(corners[0], corners[1], corners[2]);
+		}
+	}
+	occluders.Build();
+
+	XMFLOAT3 volumeMin, volumeMax;
+	XMStoreFloat3(&volumeMin, boundsMin);
+	XMStoreFloat3(&volumeMax, boundsMax);
+
+	irradianceProbes = new IrradianceProbes();
+	irradianceProbes->Bake(volumeMin, volumeMax, lights, lightsInScene, occluders, IrradianceProbeSettings());
+
+	// the demo objects, everything that isn't the room
+	for (Entity* entity : entities)
+	{
+		if (std::find(roomEntities.begin(), roomEntities.end(), entity) == roomEntities.end())
+			entity->SetBakedLighting(BAKED_LIGHTING_PROBES);
+	}
+
+	printf("Irradiance probes: %u x %u x %u, %.1f apart, %.1f ms on %u threads\n",
+		irradianceProbes->GetCountX(), irradianceProbes->GetCountY(), irradianceProbes->GetCountZ(), irradianceProbes->GetSpacing(),
+		irradianceProbes->GetBakeMs(), irradianceProbes->GetWorkerCount());
+}
+
+// --------------------------------------------------------
+// Walkable floors of the room pieces for the ghosts, they
+// follow its paths from now on, and the same triangles in
+// a BVH for their line of sight
+// --------------------------------------------------------
+void Game::BuildNavMesh()
+{
+	navMesh = new NavMesh();
+	sightOccluders = new TriangleBVH();
+	for (Entity* entity : roomEntities)
+	{
+		Mesh* mesh = entity->GetMesh();
+		XMFLOAT4X4 worldMatrix = entity->GetTransform()->GetWorldMatrix();
+		XMMATRIX world = XMLoadFloat4x4(&worldMatrix);
+
+		const std::vector<XMFLOAT3>& positions = mesh->GetPositions();
+		const std::vector<unsigned int>& indices = mesh->GetIndices();
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			XMFLOAT3 corners[3];
+			for (int k = 0; k < 3; k++)
+				XMStoreFloat3(&corners[k], XMVector3TransformCoord(XMLoadFloat3(&positions[indices[t + k]]), world));
+			navMesh->AddTriangle(corners[0], corners[1], corners[2]);
+			sightOccluders->AddTriangle(corners[0], corners[1], corners[2]);
+		}
+	}
+
+	// the ghosts stop seeing through walls, whether or not they can path around them
+	sightOccluders->Build();
+	aiSystem->SetOccluders(sightOccluders);
+	for (SimpleAI* ai : aiGhosts)
+		ai->SetOccluders(sightOccluders);
+
+	if (!navMesh->Build(NavMeshSettings()))
+	{
+		printf("NavMesh: nothing walkable, the ghosts keep walking in straight lines\n");
+		return;
+	}
+
+	// a cluster per room piece within its world bounds. The buildings come first, the arch
+	// and the doorway only get the floors the buildings leave
+	navHierarchy = new NavHierarchy(*navMesh);
+	for (Entity* entity : roomEntities)
+	{
+		Mesh* mesh = entity->GetMesh();
+		XMFLOAT4X4 worldMatrix = entity->GetTransform()->GetWorldMatrix();
+		XMMATRIX world = XMLoadFloat4x4(&worldMatrix);
+		XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+		XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+		for (int c = 0; c < 8; c++)
+		{
+			XMFLOAT3 corner(c & 1 ? mesh->GetBoundsMax().x : mesh->GetBoundsMin().x, c & 2 ? mesh->GetBoundsMax().y : mesh->GetBoundsMin().y, c & 4 ? mesh->GetBoundsMax().z : mesh->GetBoundsMin().z);
+			XMVECTOR position = XMVector3TransformCoord(XMLoadFloat3(&corner), world);
+			boundsMin = XMVectorMin(boundsMin, position);
+			boundsMax = XMVectorMax(boundsMax, position);
+		}
+		XMFLOAT3 roomMin, roomMax;
+		XMStoreFloat3(&roomMin, boundsMin);
+		XMStoreFloat3(&roomMax, boundsMax);
+		navHierarchy->AddRoom(roomMin, roomMax);
+	}
+	navHierarchy->Build(NavHierarchySettings());
+	aiSystem->SetNavHierarchy(navHierarchy);
+
+	// the ghosts only chase what they see, a path around the walls can be a few times longer
+	FlowFieldSettings flowSettings;
+	flowSettings.maxDistance = AI_SIGHT_RANGE_LIT * 3.0f;
+	flowField = new FlowField(*navMesh, flowSettings);
+
+	// patrol paths are searched off the game thread and kept, every ghost asks for the same few
+	pathService = new PathRequestService(*navMesh, navHierarchy);
+
+	aiSystem->SetNavMesh(navMesh);
+	aiSystem->SetPathService(pathService);
+	aiSystem->SetFlowField(flowField);
+	for (SimpleAI* ai : aiGhosts)
+	{
+		ai->SetNavMesh(navMesh);
+		ai->SetPathService(pathService);
+		ai->SetFlowField(flowField);
+	}
+
+	printf("NavMesh: %u x %u columns, %u floors in %u regions from %u triangles, %.1f ms\n",
+		navMesh->GetWidth(), navMesh->GetDepth(), navMesh->GetSpanCount(), navMesh->GetRegionCount(), navMesh->GetTriangleCount(), navMesh->GetBuildMs());
+	printf("NavHierarchy: %u clusters for %u rooms, %u portal nodes, %u edges, %.1f ms\n",
+		navHierarchy->GetClusterCount(), navHierarchy->GetRoomCount(), navHierarchy->GetNodeCount(), navHierarchy->GetEdgeCount(), navHierarchy->GetBuildMs());
+}
+
+// --------------------------------------------------------
+// Light exposure over every floor up to head height. The
+// baked lights are in the lightmap with their shadows, the
+// map has them shadowed by the same rooms
+// --------------------------------------------------------
+void Game::BakeLightInfluence()
+{
+	if (!navMesh || !navMesh->IsBuilt())
+		return;
+
+	XMFLOAT3 boundsMin = navMesh->GetOrigin();
+	XMFLOAT3 boundsMax(boundsMin.x + navMesh->GetWidth() * navMesh->GetCellSize(), -FLT_MAX, boundsMin.z + navMesh->GetDepth() * navMesh->GetCellSize());
+	boundsMin.y = FLT_MAX;
+	for (unsigned int i = 0; i < navMesh->GetSpanCount(); i++)
+	{
+		float floor = navMesh->GetSpanPosition(i).y;
+		boundsMin.y = (std::min)(boundsMin.y, floor);
+		boundsMax.y = (std::max)(boundsMax.y, floor + LIGHT_INFLUENCE_HEAD_ROOM);
+	}
+
+	lightInfluence = new LightInfluenceMap();
+	lightInfluence->Bake(boundsMin, boundsMax, lights, lightsInScene, sightOccluders, LightInfluenceSettings());
+
+	printf("Light influence: %u x %u x %u nodes, %.2f apart, %u moving lights, %.1f ms on %u threads\n",
+		lightInfluence->GetCountX(), lightInfluence->GetCountY(), lightInfluence->GetCountZ(), lightInfluence->GetSpacing(),
+		lightInfluence->GetDynamicLightCount(), lightInfluence->GetBakeMs(), lightInfluence->GetWorkerCount());
+}
+
+void Game::UpdateProbeLight(const std::vector<DrawItem>& drawList)
+{
+	if (!irradianceProbes)
+		return;
+
+	parallel_for
+	(
+		size_t(0), drawList.size(), [&](size_t i)
+		{
+			Entity* entity = drawList[i].entity;
+			if (entity->GetBakedLighting() != BAKED_LIGHTING_PROBES)
+				return;
+
+			// at the center of the entity's bounds
+			Mesh* mesh = entity->GetMesh();
+			XMFLOAT4X4 worldMatrix = entity->GetTransform()->GetWorldMatrix();
+			XMVECTOR center = XMVectorScale(XMLoadFloat3(&mesh->GetBoundsMin()) + XMLoadFloat3(&mesh->GetBoundsMax()), 0.5f);
+			XMFLOAT3 worldCenter;
+			XMStoreFloat3(&worldCenter, XMVector3TransformCoord(center, XMLoadFloat4x4(&worldMatrix)));
+			irradianceProbes->Sample(worldCenter, entity->GetProbeLight());
+		},
+		static_partitioner()
+	);
+}
 
 void Game::BeginPlay()
 {
@@ -532,6 +999,25 @@ void Game::BeginPlay()
 
 	route2[4]->GetTransform()->MoveAbsolute(-13.5f, 1.5f, -20.f);
 	route2[4]->GetTransform()->SetScale(.25f, .25f, .25f);
+
+	// the batched AI starts where the ghosts and their routes were just put
+	aiSystem = new AISystem();
+	aiSystem->SetAlertRange(AI_ALERT_RANGE);
+	CrowdAvoidanceSettings avoidanceSettings;
+	aiSystem->SetAvoidance(&avoidanceSettings);
+	aiScheduler = new AIScheduler();
+	std::vector<class Entity*>* routes[] = { &route1, &route2 };
+	for (size_t i = 0; i < aiGhosts.size(); i++)
+	{
+		std::vector<XMFLOAT3> points;
+		for (Entity* point : *routes[i])
+			points.push_back(point->GetTransform()->GetPosition());
+
+		Transform* ghostTransform = aiGhosts[i]->self->GetTransform();
+		unsigned int route = aiSystem->AddRoute(points.data(), (unsigned int)points.size());
+		unsigned int agent = aiSystem->AddAgent(ghostTransform->GetPosition(), route);
+		aiSystem->SetYaw(agent, ghostTransform->GetPitchYawRoll().y);
+	}
 }
 
 // ghostEntities are all transparent
@@ -540,7 +1026,7 @@ void Game::SortAndRenderTransparentEntities()
 	ghostEntities[0]->GetMaterial()->GetVertexShader()->SetShader();
 	ghostEntities[0]->GetMaterial()->GetPixelShader()->SetShader();
 	// Turn on the blend state
-	context->OMSetBlendState(blendState, 0, UINT_MAX);
+	renderContext->SetBlendState(blendState);
 
 	auto camTransform = playerCamera->GetTransform();
 	std::sort(ghostEntities.begin(), ghostEntities.end(), [&](const auto& lhs, const auto& rhs)
@@ -550,10 +1036,10 @@ void Game::SortAndRenderTransparentEntities()
 
 	for (auto& ghost : ghostEntities)
 	{
-		ghost->DrawTransparent(context.Get(), playerCamera);
+		ghost->DrawTransparent(renderContext, playerCamera);
 	}
 
-	context->OMSetBlendState(nullptr, 0, UINT_MAX);
+	renderContext->SetBlendState(nullptr);
 }
 
 
@@ -568,7 +1054,9 @@ void Game::OnResize()
 	if(!playerCamera)
 		return;
 	playerCamera->UpdateProjectionMatrix((float)this->width / this->height);
-	ResizePostProcessResources();
+	if (lightClusters)
+		lightClusters->SetProjection(playerCamera->GetProjectionMatrix(), width, height);
+	BuildFrameGraph();
 }
 
 // --------------------------------------------------------
@@ -580,7 +1068,7 @@ void Game::Update(float deltaTime, float totalTime)
 	if (GetAsyncKeyState(VK_ESCAPE))
 		Quit();
 
-	// Handle input
+	// Handle input, everything the input thread queued since the last frame
 	inputSystem->Frame(deltaTime, playerCamera);
 
 	if(entities.size() == 0) 
@@ -608,22 +1096,79 @@ void Game::Update(float deltaTime, float totalTime)
 	entities[4]->GetTransform()->Rotate(0, 0,  offset*2.f);
 	
 	// Vignette Calculation
-	float	distToLight;
-	int	lightType;
-	float	lightRange;
-	bool	inLight = PlayerInLight(&distToLight, &lightType, &lightRange);
-	CalculateVignette(inLight, distToLight, lightType, lightRange);
+	float playerVisibility = LightExposure::Visibility(PlayerExposure());
+	CalculateVignette(playerVisibility);
 	
-	for (SimpleAI* ai : aiGhosts)
+	// integrated again only once the player is over another floor
+	if (flowField)
+		flowField->SetTarget(playerCamera->GetTransform()->GetPosition());
+
+	// paths finished since last frame go out before anyone asks again
+	if (pathService)
+		pathService->Update();
+
+	XMFLOAT3 playerPosition = playerCamera->GetTransform()->GetPosition();
+	auto aiStart = std::chrono::high_resolution_clock::now();
+	if (bBatchedAI)
+	{
+		// a batch is as urgent and as visible as its most urgent and most visible ghost
+		aiSystem->GetBatchDistances(playerPosition, aiDistances);
+		aiFlags.assign(aiSystem->GetBatchCount(), 0);
+		for (unsigned int i = 0; i < aiSystem->GetAgentCount(); i++)
+			aiFlags[aiSystem->GetBatch(i)] |= AIScheduleFlags(aiSystem->GetPosition(i), aiSystem->GetState(i) == AI_State::ATTACK_PLAYER);
+
+		aiScheduler->Resize(aiSystem->GetBatchCount());
+		aiScheduler->Schedule(aiDistances.data(), aiFlags.data(), deltaTime);
+		aiStart = std::chrono::high_resolution_clock::now();
+		aiSystem->UpdateBatches(playerPosition, playerVisibility, aiScheduler->GetDueItems().data(), aiScheduler->GetDueDeltaTimes().data(), (unsigned int)aiScheduler->GetDueItems().size());
+		for (unsigned int i = 0; i < aiSystem->GetAgentCount(); i++)
+		{
+			Transform* ghostTransform = aiGhosts[i]->self->GetTransform();
+			XMFLOAT3 position = aiSystem->GetPosition(i);
+			XMFLOAT3 rotation = ghostTransform->GetPitchYawRoll();
+			ghostTransform->SetPosition(position.x, position.y, position.z);
+			ghostTransform->SetRotation(rotation.x, aiSystem->GetYaw(i), rotation.z);
+		}
+
+		// the ghosts share their material, the last change wins like with SimpleAI
+		for (unsigned int agent : aiSystem->GetStateChanges())
+		{
+			bool attacking = aiSystem->GetState(agent) == AI_State::ATTACK_PLAYER;
+			aiGhosts[agent]->self->GetMaterial()->SetColorTint(attacking ? SimpleAI::AttackColor : SimpleAI::PatrolColor);
+		}
+	}
+	else
 	{
-		ai->Update(inLight, deltaTime);
+		aiDistances.resize(aiGhosts.size());
+		aiFlags.resize(aiGhosts.size());
+		for (size_t i = 0; i < aiGhosts.size(); i++)
+		{
+			XMFLOAT3 position = aiGhosts[i]->self->GetTransform()->GetPosition();
+			XMStoreFloat(&aiDistances[i], XMVector3Length(XMLoadFloat3(&position) - XMLoadFloat3(&playerPosition)));
+			aiFlags[i] = AIScheduleFlags(position, aiGhosts[i]->GetState() == AI_State::ATTACK_PLAYER);
+		}
+
+		aiScheduler->Resize((unsigned int)aiGhosts.size());
+		aiScheduler->Schedule(aiDistances.data(), aiFlags.data(), deltaTime);
+		aiStart = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < aiScheduler->GetDueItems().size(); i++)
+		{
+			aiGhosts[aiScheduler->GetDueItems()[i]]->Update(playerVisibility, aiScheduler->GetDueDeltaTimes()[i]);
+		}
 	}
+	aiScheduler->ReportUpdateMs(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - aiStart).count());
 
 	lights[0].position = aiGhosts[0]->self->GetTransform()->GetPosition();
 	lights[0].position.y = 1.5f;
 	
 	lights[1].position = aiGhosts[1]->self->GetTransform()->GetPosition();
 	lights[1].position.y = 1.5f;	
+	lightIndex->UpdateLight(0, lights[0]);
+	lightIndex->UpdateLight(1, lights[1]);
+	lightUploader->MarkDirty(0, 2);
+	lightExposure->SetLights(lights, lightsInScene);
+	if (lightInfluence)
+		lightInfluence->UpdateDynamic(lights, lightsInScene);
 
 	playerCamera->UpdateViewMatrix();
 }
@@ -633,191 +1178,300 @@ void Game::Update(float deltaTime, float totalTime)
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
-	// Background color (Cornflower Blue in this case) for clearing
-	const float color[4] = { 0.4f, 0.6f, 0.75f, 0.0f };
+	// Opaque, waypoint, transparent and vignette passes in dependency order
+	frameGraph.Execute();
 
-	// Clear the render target and depth buffer (erases what's on the screen)
-	//  - Do this ONCE PER FRAME
-	//  - At the beginning of Draw (before drawing *anything*)
-	context->ClearRenderTargetView(backBufferRTV.Get(), color);
-	context->ClearDepthStencilView(
-		depthStencilView.Get(),
-		D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
-		1.0f,
-		0);
-
-	// Clear post process target too
-	context->ClearRenderTargetView(ppRTV.Get(), color);
-	
-	// --- Post Processing - Pre-Draw ---------------------
+	// Command list draws are counted per worker, fold them into the frame total
+	lastFrameStats = renderContext->GetStats();
+	drawRecorder->CollectStats(lastFrameStats);
+	renderContext->ResetStats();
+
+	// Present the back buffer to the user
+	//  - Puts the final frame we're drawing into the window so the user can see it
+	//  - Do this exactly ONCE PER FRAME (always at the very end of the frame)
+	swapChain->Present(0, 0);
+
+	// Due to the usage of a more sophisticated swap chain,
+	// the render target must be re-bound after every call to Present()
+	renderContext->SetRenderTargets(backBufferRTV.Get(), depthStencilView.Get());
+}
+
+void Game::AppendTitleBarStats(std::ostream& output)
+{
+	output <<
+		"    Draws: "			<< lastFrameStats.drawCalls <<
+		"    State Changes: "	<< lastFrameStats.stateChanges <<
+		"    Uploaded: "		<< lastFrameStats.bytesUploaded / 1024 << "KB" <<
+		"    Lights: "			<< lightUploader->GetLastUploadBytes() << "B" <<
+		"    Occluded: "		<< lastCulledCount <<
+		"    AI Updates: "		<< aiScheduler->GetDueItems().size() << "/" << aiScheduler->GetItemCount();
+}
+
+unsigned char Game::AIScheduleFlags(const XMFLOAT3& position, bool attacking) const
+{
+	// on screen when the position lands inside the clip volume, in front of the camera
+	XMFLOAT4X4 view = playerCamera->GetViewMatrix();
+	XMFLOAT4X4 projection = playerCamera->GetProjectionMatrix();
+	XMVECTOR clip = XMVector4Transform(XMVectorSet(position.x, position.y, position.z, 1.0f), XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+	XMFLOAT4 c;
+	XMStoreFloat4(&c, clip);
+	bool visible = c.w > 0.0f && fabsf(c.x) <= c.w && fabsf(c.y) <= c.w;
+
+	return (visible ? AI_SCHEDULE_VISIBLE : 0) | (attacking ? AI_SCHEDULE_URGENT : 0);
+}
+
+// --------------------------------------------------------
+// Declares the frame's passes and the textures they touch.
+// The graph owns the intermediate scene color target, the
+// back buffer and depth buffer come from DXCore.
+// Has to be rebuilt whenever the window size changes.
+// --------------------------------------------------------
+void Game::BuildFrameGraph()
+{
+	frameGraph.Reset();
+
+	RenderGraphTextureDesc colorDesc = {};
+	colorDesc.width = width;
+	colorDesc.height = height;
+	colorDesc.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+	rgSceneColor = frameGraph.CreateTexture("SceneColor", colorDesc);
+	rgDepth = frameGraph.ImportTexture("Depth");
+	rgBackBuffer = frameGraph.ImportTexture("BackBuffer");
+
+	int opaquePass = frameGraph.AddPass("Opaque", [this]() { DrawOpaquePass(); });
+	frameGraph.Write(opaquePass, rgSceneColor);
+	frameGraph.Write(opaquePass, rgDepth);
+
+	if (bDrawWaypoints)
 	{
-		// Change the render target
-		context->OMSetRenderTargets(1, ppRTV.GetAddressOf(), depthStencilView.Get());
+		int waypointPass = frameGraph.AddPass("Waypoints", [this]() { DrawWaypointPass(); });
+		frameGraph.Write(waypointPass, rgDepth);
+		frameGraph.Write(waypointPass, rgSceneColor);
 	}
 
-	// since they are all shared we don't need to individually set it per entity
-	normalPS->SetData("lights", (void*)(lights), sizeof(Light) * lightsInScene);
-	normalPS->SetInt("lightCount", lightsInScene);
-	normalPS->SetFloat3("cameraPosition", playerCamera->GetTransform()->GetPosition());
-	normalPS->CopyAllBufferData();
+	int transparentPass = frameGraph.AddPass("Transparent", [this]() { SortAndRenderTransparentEntities(); });
+	frameGraph.Write(transparentPass, rgDepth);
+	frameGraph.Write(transparentPass, rgSceneColor);
 
-	pixelShader->SetData("lights", (void*)(lights), sizeof(Light) * lightsInScene);
-	pixelShader->SetInt("lightCount", lightsInScene);
-	pixelShader->SetFloat3("cameraPosition", playerCamera->GetTransform()->GetPosition());
-	pixelShader->CopyAllBufferData();
+	int vignettePass = frameGraph.AddPass("Vignette", [this]() { DrawVignettePass(); });
+	frameGraph.Read(vignettePass, rgSceneColor);
+	frameGraph.Write(vignettePass, rgBackBuffer);
 
-	for (Entity* entity : entities)
+	if (!frameGraph.Compile())
 	{
-		// detect if light affects the material
-		Material* entityMat = entity->GetMaterial();
-		entityMat->GetVertexShader()->SetShader();
-		entityMat->GetPixelShader()->SetShader();
-
-		entity->Draw(context.Get(), playerCamera);
+		printf("Frame graph failed to compile: %s\n", frameGraph.GetError().c_str());
+		assert(false);
+		return;
 	}
 
+	CreateFrameGraphTargets();
+}
 
-	if(bDrawWaypoints) 
+// --------------------------------------------------------
+// Creates one texture per physical slot of the compiled
+// graph. Transients with disjoint lifetimes share a slot.
+// --------------------------------------------------------
+void Game::CreateFrameGraphTargets()
+{
+	frameGraphRTVs.clear();
+	frameGraphSRVs.clear();
+	frameGraphRTVs.resize(frameGraph.GetPhysicalSlotCount());
+	frameGraphSRVs.resize(frameGraph.GetPhysicalSlotCount());
+
+	for (size_t slot = 0; slot < frameGraph.GetPhysicalSlotCount(); ++slot)
 	{
-		route1[0]->GetMaterial()->GetPixelShader()->SetShader();
-		for(Entity* route : route1) 
-		{
-			route->DrawTransparent(context.Get(), playerCamera);
-		}
-		for (Entity* route : route2)
-		{
-			route->DrawTransparent(context.Get(), playerCamera);
-		}
+		const RenderGraphTextureDesc& desc = frameGraph.GetPhysicalSlotDesc(slot);
+
+		D3D11_TEXTURE2D_DESC textureDesc = {};
+		textureDesc.Width = desc.width;
+		textureDesc.Height = desc.height;
+		textureDesc.ArraySize = 1;
+		textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE; // Will render to it and sample from it!
+		textureDesc.CPUAccessFlags = 0;
+		textureDesc.Format = (DXGI_FORMAT)desc.format;
+		textureDesc.MipLevels = 1;
+		textureDesc.MiscFlags = 0;
+		textureDesc.SampleDesc.Count = 1;
+		textureDesc.SampleDesc.Quality = 0;
+		textureDesc.Usage = D3D11_USAGE_DEFAULT;
+
+		ID3D11Texture2D* texture;
+		device->CreateTexture2D(&textureDesc, 0, &texture);
+
+		// Create the Render Target View
+		D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
+		rtvDesc.Format = textureDesc.Format;
+		rtvDesc.Texture2D.MipSlice = 0;
+		rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+
+		device->CreateRenderTargetView(texture, &rtvDesc, frameGraphRTVs[slot].GetAddressOf());
+
+		// Create the Shader Resource View
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = textureDesc.Format;
+		srvDesc.Texture2D.MipLevels = 1;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+
+		device->CreateShaderResourceView(texture, &srvDesc, frameGraphSRVs[slot].GetAddressOf());
+
+		// We don't need the texture reference itself no mo'
+		texture->Release();
 	}
+}
 
-	SortAndRenderTransparentEntities();
+ID3D11RenderTargetView* Game::GetFrameGraphRTV(RenderGraphResource resource)
+{
+	int slot = frameGraph.GetPhysicalSlot(resource);
+	return slot >= 0 ? frameGraphRTVs[slot].Get() : nullptr;
+}
 
-	// --- Post processing - Post-Draw -----------------------
-	{
-		context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), 0);
+ID3D11ShaderResourceView* Game::GetFrameGraphSRV(RenderGraphResource resource)
+{
+	int slot = frameGraph.GetPhysicalSlot(resource);
+	return slot >= 0 ? frameGraphSRVs[slot].Get() : nullptr;
+}
+
+void Game::DrawOpaquePass()
+{
+	// Background color (Cornflower Blue in this case) for clearing
+	const float color[4] = { 0.4f, 0.6f, 0.75f, 0.0f };
+
+	ID3D11RenderTargetView* sceneColor = GetFrameGraphRTV(rgSceneColor);
+
+	// Clear the render target and depth buffer (erases what's on the screen)
+	//  - Do this ONCE PER FRAME
+	//  - At the beginning of Draw (before drawing *anything*)
+	renderContext->ClearRenderTarget(sceneColor, color);
+	renderContext->ClearDepthStencil(depthStencilView.Get(), 1.0f, 0);
+
+	renderContext->SetRenderTargets(sceneColor, depthStencilView.Get());
+	renderContext->SetViewport((float)width, (float)height);
+
+	if (lightingMode == LIGHTING_MODE_CLUSTERED)
+		UpdateLightClusters();
 
-		// Set up post process shaders
-		ppVS->SetShader();
+	XMFLOAT2 clusterTileSize(lightClusters->GetTileWidth(), lightClusters->GetTileHeight());
 
-		ppPS->SetShaderResourceView("pixels", ppSRV.Get());
-		ppPS->SetSamplerState("samplerOptions", textureSampler);
-		ppPS->SetShader();
+	// only the lights that changed since the last frame are sent, the buffer is shared by both shaders
+	lightUploader->Upload(renderContext, lightBuffer.Get(), lights);
+	renderContext->SetShaderResource(ShaderStage::Pixel, LIGHT_BUFFER_SLOT, lightSRV.Get());
+	drawRecorder->SetFramePixelResource(LIGHT_BUFFER_SLOT, lightSRV.Get());
+	renderContext->SetShaderResource(ShaderStage::Pixel, LIGHTMAP_SLOT, lightmapSRV.Get());
+	drawRecorder->SetFramePixelResource(LIGHTMAP_SLOT, lightmapSRV.Get());
 
-		ppData.ppgData.width = 1.f / width;
-		ppData.ppgData.height = 1.f / height;
-		ppPS->SetData("vignetteData", (void*)&ppData, sizeof(VignetteData));
-		ppPS->CopyAllBufferData();
+	// since they are all shared we don't need to individually set it per entity
+	normalPS->SetInt("lightCount", (int)lightsInScene);
+	normalPS->SetFloat3("cameraPosition", playerCamera->GetTransform()->GetPosition());
+	normalPS->SetInt("lightingMode", lightingMode);
+	normalPS->SetFloat2("clusterTileSize", clusterTileSize);
+	normalPS->SetFloat("clusterDepthScale", lightClusters->GetDepthScale());
+	normalPS->CopyBufferData("ExternalData");
 
-		// Turn OFF vertex and index buffers
-		UINT stride = sizeof(Vertex);
-		UINT offset = 0;
-		ID3D11Buffer* nothing = 0;
-		context->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
-		context->IASetVertexBuffers(0, 1, &nothing, &stride, &offset);
+	pixelShader->SetInt("lightCount", (int)lightsInScene);
+	pixelShader->SetFloat3("cameraPosition", playerCamera->GetTransform()->GetPosition());
+	pixelShader->SetInt("lightingMode", lightingMode);
+	pixelShader->SetFloat2("clusterTileSize", clusterTileSize);
+	pixelShader->SetFloat("clusterDepthScale", lightClusters->GetDepthScale());
+	pixelShader->CopyBufferData("ExternalData");
 
-		// Draw exactly 3 vertices for our "full screen triangle"
-		context->Draw(3, 0);
+	const std::vector<DrawItem>& drawList = CullOpaqueDrawList();
+	if (lightingMode == LIGHTING_MODE_PER_OBJECT)
+		SelectObjectLights(drawList);
+	UpdateProbeLight(drawList);
 
+	if (bDeferredDraw && drawRecorder->IsValid())
+	{
+		D3D11_VIEWPORT viewport = {};
+		viewport.Width = (float)width;
+		viewport.Height = (float)height;
+		viewport.MaxDepth = 1.0f;
 
-		// Unbind shader resource views at the end of the frame,
-		// since we'll be rendering into one of those textures
-		// at the start of the next
-		ID3D11ShaderResourceView* nullSRVs[16] = {};
-		context->PSSetShaderResources(0, 16, nullSRVs);
+		drawRecorder->BeginFrame(playerCamera, sceneColor, depthStencilView.Get(), viewport);
+		drawSubmitter->Submit(drawList, drawRecorder);
+
+		// Executing command lists clears the immediate context state
+		renderContext->SetRenderTargets(sceneColor, depthStencilView.Get());
+		renderContext->SetViewport((float)width, (float)height);
 	}
+	else
+	{
+		for (const DrawItem& item : drawList)
+		{
+			// detect if light affects the material
+			Material* entityMat = item.entity->GetMaterial();
+			entityMat->GetVertexShader()->SetShader();
+			entityMat->GetPixelShader()->SetShader();
 
-	// Present the back buffer to the user
-	//  - Puts the final frame we're drawing into the window so the user can see it
-	//  - Do this exactly ONCE PER FRAME (always at the very end of the frame)
-	swapChain->Present(0, 0);
+			item.entity->Draw(renderContext, playerCamera);
+		}
+	}
+}
 
-	// Due to the usage of a more sophisticated swap chain,
-	// the render target must be re-bound after every call to Present()
-	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthStencilView.Get());
+void Game::DrawWaypointPass()
+{
+	route1[0]->GetMaterial()->GetVertexShader()->SetShader();
+	route1[0]->GetMaterial()->GetPixelShader()->SetShader();
+	for(Entity* route : route1) 
+	{
+		route->DrawTransparent(renderContext, playerCamera);
+	}
+	for (Entity* route : route2)
+	{
+		route->DrawTransparent(renderContext, playerCamera);
+	}
 }
 
-void Game::ResizePostProcessResources()
+void Game::DrawVignettePass()
 {
-	D3D11_TEXTURE2D_DESC textureDesc = {};
-	textureDesc.Width = width;
-	textureDesc.Height = height;
-	textureDesc.ArraySize = 1;
-	textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE; // Will render to it and sample from it!
-	textureDesc.CPUAccessFlags = 0;
-	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	textureDesc.MipLevels = 1;
-	textureDesc.MiscFlags = 0;
-	textureDesc.SampleDesc.Count = 1;
-	textureDesc.SampleDesc.Quality = 0;
-	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	renderContext->SetRenderTargets(backBufferRTV.Get(), nullptr);
 
-	ID3D11Texture2D* ppTexture;
-	device->CreateTexture2D(&textureDesc, 0, &ppTexture);
+	// Set up post process shaders
+	ppVS->SetShader();
 
-	// Create the Render Target View
-	D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
-	rtvDesc.Format = textureDesc.Format;
-	rtvDesc.Texture2D.MipSlice = 0;
-	rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+	ppPS->SetShaderResourceView("pixels", GetFrameGraphSRV(rgSceneColor));
+	ppPS->SetSamplerState("samplerOptions", textureSampler);
+	ppPS->SetShader();
 
-	device->CreateRenderTargetView(ppTexture, &rtvDesc, ppRTV.ReleaseAndGetAddressOf());
+	ppData.ppgData.width = 1.f / width;
+	ppData.ppgData.height = 1.f / height;
+	ppPS->SetData("vignetteData", (void*)&ppData, sizeof(VignetteData));
+	ppPS->CopyAllBufferData();
 
-	// Create the Shader Resource View
-	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Format = textureDesc.Format;
-	srvDesc.Texture2D.MipLevels = 1;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	// Turn OFF vertex and index buffers
+	renderContext->SetIndexBuffer(nullptr);
+	renderContext->SetVertexBuffer(nullptr, sizeof(Vertex));
 
-	device->CreateShaderResourceView(ppTexture, &srvDesc, ppSRV.ReleaseAndGetAddressOf());
+	// Draw exactly 3 vertices for our "full screen triangle"
+	renderContext->Draw(3);
 
-	// We don't need the texture reference itself no mo'
-	ppTexture->Release();
+
+	// Unbind shader resource views at the end of the frame,
+	// since we'll be rendering into one of those textures
+	// at the start of the next
+	renderContext->UnbindShaderResources(ShaderStage::Pixel);
 }
 
 // --------------------------------------------------------
 // Calculate the vignette opacity and pass to post processing
 // --------------------------------------------------------
-void Game::CalculateVignette(bool inLight, float sqDist, int lightType, float lightRange)
+void Game::CalculateVignette(float playerVisibility)
 {
-	// Only point lights affect vignette
-	if (!inLight || lightType != LIGHT_TYPE_POINT)
-	{
-		ppData.opacity = .95f;
-		return;
-	}
-
-	// Calculate vignette based on light range
-	ppData.opacity = (sqDist / lightRange) - .05f;
+	// Dark at .95, fading out as the player gets more exposed
+	ppData.opacity = .95f - playerVisibility;
 }
 
 // --------------------------------------------------------
-// Iterate through all lights, and return information about
-// any lights the player is standing in.
+// The influence map's exposure where the player is, or the
+// sum of every light the index finds there off the map
 // --------------------------------------------------------
-bool Game::PlayerInLight(_Out_ float* _sqDist, _Out_ int* _lightType, _Out_ float* _sqLightRange)
+float Game::PlayerExposure()
 {
-	// Return true if player is within the range of any light
-	for (int i = 0; i < lightsInScene; ++i)
-	{
-		float SqLightRange = lights[i].range * lights[i].range;
-		XMFLOAT3 lightPos = lights[i].position;
-		float sqDistToLight = playerCamera->GetTransform()->DistanceSquaredTo(lightPos);
-
-		if (sqDistToLight < SqLightRange)
-		{
-			// If in light range, return light type and distance to light thru params
-			// some processes like vignette need this info
-			*_sqDist = sqDistToLight;
-			*_lightType = lights[i].type;
-			*_sqLightRange = SqLightRange;
-			return true;
-		}
-	}
-	// If false, return clearly invalid values to each 
-	*_sqDist = -1.0f;
-	*_lightType = -1;
-	*_sqLightRange = -1.0f;
+	XMFLOAT3 position = playerCamera->GetTransform()->GetPosition();
+	if (lightInfluence && lightInfluence->Contains(position))
+		return lightInfluence->Sample(position);
 
-	return false;
+	lightIndex->Query(position, lightQuery);
+	return lightExposure->Evaluate(position, lightQuery.data(), (unsigned int)lightQuery.size());
 }
\ No newline at end of file
@@ -5,13 +5,14 @@
 #include <vector>
 #include "Lights.h"
 #include "PostProcessData.h"
+#include "ParallelDrawSubmitter.h"
+#include "RenderGraph.h"
+#include "RenderBackend.h"
 
 #define MAX_LIGHTS_IN_SCENE 128
 
-#define LIGHT_TYPE_DIR 0
-#define LIGHT_TYPE_POINT 1
-#define LIGHT_TYPE_SPOT 2
-#define LIGHT_TYPE_AMBIENT 3
+// The light influence map reaches this far above the highest floor, over anyone's head
+#define LIGHT_INFLUENCE_HEAD_ROOM 2.5f
 
 class Mesh;
 class Entity;
@@ -20,6 +21,11 @@ class Material;
 class SimplePixelShader;
 class SimpleVertexShader;
 class SimpleAI;
+class DeferredContextRecorder;
+class D3D11RenderContext;
+class OcclusionCuller;
+class LightClusters;
+class ObjectLightSelector;
 
 class Game 
 	: public DXCore
@@ -40,10 +46,34 @@ private:
 	// Initialization helper methods
 	void LoadShaders(); 
 	void CreateBasicGeometry();
-	void ResizePostProcessResources();
+	void BuildFrameGraph();
+	void CreateFrameGraphTargets();
+	void BuildOpaqueDrawList();
+
+	// Returns the opaque draw list minus everything hidden behind the occluders
+	const std::vector<DrawItem>& CullOpaqueDrawList();
+
+	// Assigns the scene lights to clusters, uploads the lists and binds them for the pixel shaders
+	void UpdateLightClusters();
+	// Picks the strongest lights for every entity in the list (LIGHTING_MODE_PER_OBJECT)
+	void SelectObjectLights(const std::vector<DrawItem>& drawList);
+	void CreateStructuredBuffer(unsigned int stride, unsigned int count, Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv);
+	// Bakes the static lights into a lightmap for the room geometry (see LightmapBaker)
+	void BakeLightmap();
+	// Bakes the same lights into irradianceProbes for the moving entities, after BakeLightmap()
+	void BakeIrradianceProbes();
+	// Samples the probes for every probe lit entity in the list
+	void UpdateProbeLight(const std::vector<DrawItem>& drawList);
+	// Builds navMesh, navHierarchy and sightOccluders from the room pieces and hands them to the AI
+	void BuildNavMesh();
+	// Bakes lightInfluence over the navmesh's floors, shadowed by sightOccluders, after BuildNavMesh()
+	void BakeLightInfluence();
 
 	// AI helpers
-	bool PlayerInLight(_Out_ float* sqDist, _Out_ int* lightType, _Out_ float* sqLightRange);
+	// How much light reaches the player, 0 in the dark (see LightExposure)
+	float PlayerExposure();
+	// AI_SCHEDULE_* flags for a ghost at the position: on screen, attacking
+	unsigned char AIScheduleFlags(const DirectX::XMFLOAT3& position, bool attacking) const;
 
 	// Shaders and shader-related constructs
 	class SimplePixelShader* pixelShader = nullptr;
@@ -78,14 +108,122 @@ private:
 	ID3D11ShaderResourceView* srvBlueprintGreen;
 
 	std::vector<class Entity*> entities;
+	// the static room pieces out of entities, lightmapped, blocking light for the probes and walked on by the ghosts
+	std::vector<class Entity*> roomEntities;
 	std::vector<class Material*> materials;
 	std::vector<class Mesh*> meshes;
 
 	std::vector<class Entity*> ghostEntities;
 
+	// entities sorted by shader/material, rebuilt whenever entities are added
+	std::vector<DrawItem> opaqueDrawList;
+	class ParallelDrawSubmitter* drawSubmitter = nullptr;
+	class DeferredContextRecorder* drawRecorder = nullptr;
+
+	/**
+	 * Everything drawn on the immediate context goes through this,
+	 * shaders included, so its stats cover the whole frame
+	 */
+	class D3D11RenderContext* renderContext = nullptr;
+	RenderStats lastFrameStats;
+
+	/**
+	 * Software occlusion culling of the opaque draw list,
+	 * the room meshes are the only occluders
+	 */
+	bool bOcclusionCulling = true;
+	class OcclusionCuller* occlusionCuller = nullptr;
+	std::vector<class Entity*> occluders;
+	std::vector<DrawItem> visibleDrawList;
+	size_t lastCulledCount = 0;
+
+	/**
+	 * Which lights the pixel shaders evaluate: all of them, the ones
+	 * assigned to the pixel's cluster, or the ones picked per entity
+	 */
+	int lightingMode = LIGHTING_MODE_CLUSTERED;
+	class LightClusters* lightClusters = nullptr;
+	class ObjectLightSelector* lightSelector = nullptr;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> clusterRangeBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> clusterRangeSRV;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> clusterIndexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> clusterIndexSRV;
+	unsigned int clusterIndexCapacity = 0;
+
+	/**
+	 * The scene lights on the GPU, shared by both lit pixel shaders.
+	 * Lights changed on the CPU have to be marked dirty on the uploader
+	 */
+	class LightUploader* lightUploader = nullptr;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> lightBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> lightSRV;
+
+	/**
+	 * Every light but the moving ghost lights, baked for the room pieces
+	 * at load. Null if the bake failed, then everything is lit at runtime
+	 */
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> lightmapTexture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> lightmapSRV;
+
+	/**
+	 * The baked lights over the level for the entities that move (the
+	 * demo objects), sampled where they are every frame
+	 */
+	class IrradianceProbes* irradianceProbes = nullptr;
+
+	/**
+	 * Grid over the scene lights for PlayerExposure(), the ghost lights
+	 * are updated in place as they move. The lights it finds are summed
+	 * up by lightExposure
+	 */
+	class LightSpatialIndex* lightIndex = nullptr;
+	class LightExposure* lightExposure = nullptr;
+	std::vector<unsigned int> lightQuery;
+
+	/**
+	 * The same exposure precomputed over the floors, the baked lights
+	 * shadowed by the rooms and the ghost lights redone where they move.
+	 * PlayerExposure() samples it instead of the query where it can
+	 */
+	class LightInfluenceMap* lightInfluence = nullptr;
+
 	// requires a built entity to control
 	std::vector<class SimpleAI*> aiGhosts;
 
+	/**
+	 * Runs every ghost's SimpleAI logic in SoA batches instead of one
+	 * virtual Update() per ghost. Agent i drives aiGhosts[i]->self.
+	 * Only batched ghosts alert each other when one sees the player
+	 */
+	bool bBatchedAI = true;
+	class AISystem* aiSystem = nullptr;
+
+	/**
+	 * Walkable floors of the room pieces, the ghosts path around the
+	 * walls with it. Null until Init() is done
+	 */
+	class NavMesh* navMesh = nullptr;
+
+	// The navmesh's floors split by room piece, the ghosts' long paths go from doorway to doorway
+	class NavHierarchy* navHierarchy = nullptr;
+
+	// Searches SimpleAI's paths on worker threads and caches them, results come in with the next frames
+	class PathRequestService* pathService = nullptr;
+
+	// Paths from everywhere near the player to the player, for all the attacking ghosts at once
+	class FlowField* flowField = nullptr;
+
+	// The room pieces again, the ghosts only see the player if none of them is in the way
+	class TriangleBVH* sightOccluders = nullptr;
+
+	/**
+	 * Which ghosts (or AISystem batches) update this frame, far ones less
+	 * often with the time they skipped. Distances and flags per item
+	 */
+	class AIScheduler* aiScheduler = nullptr;
+	std::vector<float> aiDistances;
+	std::vector<unsigned char> aiFlags;
+
 	std::vector<class Entity*> route1;
 	std::vector<class Entity*> route2;
 
@@ -94,14 +232,31 @@ private:
 	 */
 	bool bDrawWaypoints = false;
 
+	/**
+	 * Record opaque draws on worker threads into deferred contexts
+	 * instead of submitting them serially on the immediate context
+	 */
+	bool bDeferredDraw = true;
+
 	struct Light* lights = nullptr; // all the lights
-	int lightsInScene = 0;
+	unsigned int lightsInScene = 0;
 
 	class Camera* playerCamera = nullptr;
 
+	/**
+	 * Frame graph and the physical targets backing its transient textures
+	 */
+	RenderGraph frameGraph;
+	RenderGraphResource rgSceneColor = -1;
+	RenderGraphResource rgDepth = -1;
+	RenderGraphResource rgBackBuffer = -1;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11RenderTargetView>> frameGraphRTVs;		// Allows us to render to a texture
+	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> frameGraphSRVs;	// Allows us to sample from the same texture
+
+	ID3D11RenderTargetView* GetFrameGraphRTV(RenderGraphResource resource);
+	ID3D11ShaderResourceView* GetFrameGraphSRV(RenderGraphResource resource);
+
 	// Post processing resources
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> ppRTV;		// Allows us to render to a texture
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> ppSRV;		// Allows us to sample from the same texture
 	SimpleVertexShader* ppVS;
 	SimplePixelShader* ppPS;
 
@@ -111,5 +266,11 @@ private:
 protected:
 	virtual void BeginPlay();
 	virtual void SortAndRenderTransparentEntities();
-	void CalculateVignette(bool inLight, float sqDist, int lightType, float lightRange);
+	void AppendTitleBarStats(std::ostream& output) override;
+
+	// Frame graph pass bodies
+	void DrawOpaquePass();
+	void DrawWaypointPass();
+	void DrawVignettePass();
+	void CalculateVignette(float playerVisibility);
 };
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "HeadlessDrawRecorder.h"
+
+HeadlessDrawRecorder::HeadlessDrawRecorder(unsigned int workerCount, IRenderContext* target, DrawFunction drawItem)
+{
+	this->target = target;
+	this->drawItem = drawItem;
+	workers.resize(workerCount > 0 ? workerCount : 1);
+}
+
+void HeadlessDrawRecorder::BeginFrame(ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv, float width, float height)
+{
+	this->renderTarget = rtv;
+	this->depthStencil = dsv;
+	this->width = width;
+	this->height = height;
+}
+
+unsigned int HeadlessDrawRecorder::GetWorkerCount() const
+{
+	return (unsigned int)workers.size();
+}
+
+void HeadlessDrawRecorder::Record(unsigned int worker, const DrawItem* items, size_t count)
+{
+	HeadlessRenderContext& context = workers[worker];
+	context.Reset();
+
+	context.SetRenderTargets(renderTarget, depthStencil);
+	context.SetViewport(width, height);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		drawItem(&context, worker, items[i]);
+	}
+}
+
+void HeadlessDrawRecorder::Execute(unsigned int worker)
+{
+	workers[worker].Replay(target);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "ParallelDrawSubmitter.h"
+#include "HeadlessRenderContext.h"
+
+/**
+ * CPU stand-in for DeferredContextRecorder.
+ *
+ * Each worker records into its own HeadlessRenderContext, Execute()
+ * replays the recordings into the target in partition order. Comparing
+ * the target against a serial recording checks that partitioning and
+ * merging keep the draw order and bindings intact, without a GPU.
+ */
+class HeadlessDrawRecorder : public IDrawRecorder
+{
+public:
+	// Issues the calls for one item. Called from worker threads, must only touch the given context
+	// and the worker's own copies of shared data (like DeferredContextRecorder's shader mirrors)
+	typedef std::function<void(IRenderContext* context, unsigned int worker, const DrawItem& item)> DrawFunction;
+
+	HeadlessDrawRecorder(unsigned int workerCount, IRenderContext* target, DrawFunction drawItem);
+	~HeadlessDrawRecorder() = default;
+
+	// Per-frame state every worker recording starts with, like a deferred context would need
+	void BeginFrame(ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv, float width, float height);
+
+	unsigned int GetWorkerCount() const override;
+	void Record(unsigned int worker, const DrawItem* items, size_t count) override;
+	void Execute(unsigned int worker) override;
+
+private:
+	std::vector<HeadlessRenderContext> workers;
+	IRenderContext* target;
+	DrawFunction drawItem;
+
+	// Frame state
+	ID3D11RenderTargetView* renderTarget = nullptr;
+	ID3D11DepthStencilView* depthStencil = nullptr;
+	float width = 0.0f;
+	float height = 0.0f;
+};
@@ -0,0 +1,420 @@
+#include "HeadlessRenderContext.h"
+#include <cstring>
+
+// Keeps a broken frame from flooding memory with the same message
+#define MAX_STORED_VALIDATION_ERRORS 64
+
+HeadlessRenderContext::HeadlessRenderContext(bool recordCommands)
+{
+	this->recordCommands = recordCommands;
+	Reset();
+}
+
+void HeadlessRenderContext::Reset()
+{
+	memset(&bindings, 0, sizeof(Bindings));
+	commands.clear();
+	uploads.clear();
+	draws.clear();
+	bufferContents.clear();
+	drawConstants.clear();
+	validationErrors.clear();
+	validationErrorCount = 0;
+}
+
+void HeadlessRenderContext::Replay(IRenderContext* target) const
+{
+	for (const RenderCommand& command : commands)
+	{
+		switch (command.type)
+		{
+		case RenderCommandType::SetRenderTargets:
+			target->SetRenderTargets((ID3D11RenderTargetView*)command.object, (ID3D11DepthStencilView*)command.secondObject);
+			break;
+		case RenderCommandType::ClearRenderTarget:
+			target->ClearRenderTarget((ID3D11RenderTargetView*)command.object, command.values);
+			break;
+		case RenderCommandType::ClearDepthStencil:
+			target->ClearDepthStencil((ID3D11DepthStencilView*)command.object, command.values[0], (unsigned char)command.count);
+			break;
+		case RenderCommandType::SetViewport:
+			target->SetViewport(command.values[0], command.values[1]);
+			break;
+		case RenderCommandType::SetBlendState:
+			target->SetBlendState((ID3D11BlendState*)command.object);
+			break;
+		case RenderCommandType::SetInputLayout:
+			target->SetInputLayout((ID3D11InputLayout*)command.object);
+			break;
+		case RenderCommandType::SetVertexShader:
+			target->SetVertexShader((ID3D11VertexShader*)command.object);
+			break;
+		case RenderCommandType::SetPixelShader:
+			target->SetPixelShader((ID3D11PixelShader*)command.object);
+			break;
+		case RenderCommandType::SetConstantBuffer:
+			target->SetConstantBuffer(command.stage, command.slot, (ID3D11Buffer*)command.object);
+			break;
+		case RenderCommandType::SetShaderResource:
+			target->SetShaderResource(command.stage, command.slot, (ID3D11ShaderResourceView*)command.object);
+			break;
+		case RenderCommandType::SetSampler:
+			target->SetSampler(command.stage, command.slot, (ID3D11SamplerState*)command.object);
+			break;
+		case RenderCommandType::UnbindShaderResources:
+			target->UnbindShaderResources(command.stage);
+			break;
+		case RenderCommandType::UpdateBuffer:
+			target->UpdateBuffer((ID3D11Buffer*)command.object, uploads.data() + command.dataOffset, command.count);
+			break;
+		case RenderCommandType::UpdateBufferRange:
+			target->UpdateBufferRange((ID3D11Buffer*)command.object, command.slot, uploads.data() + command.dataOffset, command.count);
+			break;
+		case RenderCommandType::SetVertexBuffer:
+			target->SetVertexBuffer((ID3D11Buffer*)command.object, command.count);
+			break;
+		case RenderCommandType::SetIndexBuffer:
+			target->SetIndexBuffer((ID3D11Buffer*)command.object);
+			break;
+		case RenderCommandType::Draw:
+			target->Draw(command.count);
+			break;
+		case RenderCommandType::DrawIndexed:
+			target->DrawIndexed(command.count);
+			break;
+		}
+	}
+}
+
+bool HeadlessRenderContext::HasSameDraws(const HeadlessRenderContext& other) const
+{
+	if (draws.size() != other.draws.size())
+		return false;
+
+	for (size_t i = 0; i < draws.size(); ++i)
+	{
+		const DrawSnapshot& a = draws[i];
+		const DrawSnapshot& b = other.draws[i];
+		bool same =
+			a.vertexShader == b.vertexShader &&
+			a.pixelShader == b.pixelShader &&
+			a.inputLayout == b.inputLayout &&
+			a.vertexBuffer == b.vertexBuffer &&
+			a.indexBuffer == b.indexBuffer &&
+			a.renderTarget == b.renderTarget &&
+			a.blendState == b.blendState &&
+			a.count == b.count &&
+			a.indexed == b.indexed &&
+			a.constantsSize == b.constantsSize &&
+			memcmp(GetDrawConstants(a), other.GetDrawConstants(b), a.constantsSize) == 0;
+
+		if (!same)
+			return false;
+	}
+
+	return true;
+}
+
+void HeadlessRenderContext::SetRenderTargets(ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv)
+{
+	Bind(bindings.renderTarget, rtv);
+	bindings.depthStencil = dsv;
+
+	RenderCommand& command = Push(RenderCommandType::SetRenderTargets);
+	command.object = rtv;
+	command.secondObject = dsv;
+}
+
+void HeadlessRenderContext::ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4])
+{
+	if (!rtv)
+		Fail("ClearRenderTarget with a null render target");
+
+	RenderCommand& command = Push(RenderCommandType::ClearRenderTarget);
+	command.object = rtv;
+	memcpy(command.values, color, sizeof(float) * 4);
+}
+
+void HeadlessRenderContext::ClearDepthStencil(ID3D11DepthStencilView* dsv, float depth, unsigned char stencil)
+{
+	if (!dsv)
+		Fail("ClearDepthStencil with a null depth stencil view");
+
+	RenderCommand& command = Push(RenderCommandType::ClearDepthStencil);
+	command.object = dsv;
+	command.values[0] = depth;
+	command.count = stencil;
+}
+
+void HeadlessRenderContext::SetViewport(float width, float height)
+{
+	if (width <= 0.0f || height <= 0.0f)
+		Fail("SetViewport with an empty viewport");
+
+	stats.stateChanges++;
+	bindings.viewportSet = true;
+
+	RenderCommand& command = Push(RenderCommandType::SetViewport);
+	command.values[0] = width;
+	command.values[1] = height;
+}
+
+void HeadlessRenderContext::SetBlendState(ID3D11BlendState* blendState)
+{
+	Bind(bindings.blendState, blendState);
+	Push(RenderCommandType::SetBlendState).object = blendState;
+}
+
+void HeadlessRenderContext::SetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	Bind(bindings.inputLayout, inputLayout);
+	Push(RenderCommandType::SetInputLayout).object = inputLayout;
+}
+
+void HeadlessRenderContext::SetVertexShader(ID3D11VertexShader* shader)
+{
+	Bind(bindings.vertexShader, shader);
+	Push(RenderCommandType::SetVertexShader).object = shader;
+}
+
+void HeadlessRenderContext::SetPixelShader(ID3D11PixelShader* shader)
+{
+	Bind(bindings.pixelShader, shader);
+	Push(RenderCommandType::SetPixelShader).object = shader;
+}
+
+void HeadlessRenderContext::SetConstantBuffer(ShaderStage stage, unsigned int slot, ID3D11Buffer* buffer)
+{
+	if (slot >= HEADLESS_CB_SLOTS)
+	{
+		Fail("SetConstantBuffer slot out of range");
+		return;
+	}
+
+	Bind(bindings.constantBuffers[(int)stage][slot], buffer);
+
+	RenderCommand& command = Push(RenderCommandType::SetConstantBuffer);
+	command.stage = stage;
+	command.slot = slot;
+	command.object = buffer;
+}
+
+void HeadlessRenderContext::SetShaderResource(ShaderStage stage, unsigned int slot, ID3D11ShaderResourceView* srv)
+{
+	if (slot >= RENDER_CONTEXT_SRV_SLOTS)
+	{
+		Fail("SetShaderResource slot out of range");
+		return;
+	}
+
+	Bind(bindings.shaderResources[(int)stage][slot], srv);
+
+	RenderCommand& command = Push(RenderCommandType::SetShaderResource);
+	command.stage = stage;
+	command.slot = slot;
+	command.object = srv;
+}
+
+void HeadlessRenderContext::SetSampler(ShaderStage stage, unsigned int slot, ID3D11SamplerState* sampler)
+{
+	if (slot >= HEADLESS_SAMPLER_SLOTS)
+	{
+		Fail("SetSampler slot out of range");
+		return;
+	}
+
+	Bind(bindings.samplers[(int)stage][slot], sampler);
+
+	RenderCommand& command = Push(RenderCommandType::SetSampler);
+	command.stage = stage;
+	command.slot = slot;
+	command.object = sampler;
+}
+
+void HeadlessRenderContext::UnbindShaderResources(ShaderStage stage)
+{
+	stats.stateChanges++;
+	memset(bindings.shaderResources[(int)stage], 0, sizeof(bindings.shaderResources[(int)stage]));
+
+	Push(RenderCommandType::UnbindShaderResources).stage = stage;
+}
+
+void HeadlessRenderContext::UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size)
+{
+	if (!buffer || !data)
+	{
+		Fail("UpdateBuffer with a null buffer or data pointer");
+		return;
+	}
+
+	stats.bytesUploaded += size;
+
+	RenderCommand& command = Push(RenderCommandType::UpdateBuffer);
+	command.object = buffer;
+	command.count = size;
+
+	if (recordCommands)
+	{
+		// keep a copy, the caller is free to overwrite its data once this returns
+		command.dataOffset = uploads.size();
+		uploads.insert(uploads.end(), (const unsigned char*)data, (const unsigned char*)data + size);
+		TrackUpload(buffer, 0, data, size, true);
+	}
+}
+
+void HeadlessRenderContext::UpdateBufferRange(ID3D11Buffer* buffer, unsigned int byteOffset, const void* data, unsigned int size)
+{
+	if (!buffer || !data)
+	{
+		Fail("UpdateBufferRange with a null buffer or data pointer");
+		return;
+	}
+
+	stats.bytesUploaded += size;
+
+	RenderCommand& command = Push(RenderCommandType::UpdateBufferRange);
+	command.object = buffer;
+	command.slot = byteOffset;
+	command.count = size;
+
+	if (recordCommands)
+	{
+		command.dataOffset = uploads.size();
+		uploads.insert(uploads.end(), (const unsigned char*)data, (const unsigned char*)data + size);
+		TrackUpload(buffer, byteOffset, data, size, false);
+	}
+}
+
+void HeadlessRenderContext::SetVertexBuffer(ID3D11Buffer* buffer, unsigned int stride)
+{
+	Bind(bindings.vertexBuffer, buffer);
+	bindings.vertexStride = stride;
+
+	RenderCommand& command = Push(RenderCommandType::SetVertexBuffer);
+	command.object = buffer;
+	command.count = stride;
+}
+
+void HeadlessRenderContext::SetIndexBuffer(ID3D11Buffer* buffer)
+{
+	Bind(bindings.indexBuffer, buffer);
+	Push(RenderCommandType::SetIndexBuffer).object = buffer;
+}
+
+void HeadlessRenderContext::Draw(unsigned int vertexCount)
+{
+	ValidateDraw(false);
+	stats.drawCalls++;
+	Push(RenderCommandType::Draw).count = vertexCount;
+
+	if (recordCommands)
+		SnapshotDraw(vertexCount, false);
+}
+
+void HeadlessRenderContext::DrawIndexed(unsigned int indexCount)
+{
+	ValidateDraw(true);
+	stats.drawCalls++;
+	Push(RenderCommandType::DrawIndexed).count = indexCount;
+
+	if (recordCommands)
+		SnapshotDraw(indexCount, true);
+}
+
+// --------------------------------------------------------
+// A draw is only the same as another if its shaders read
+// the same constants: a worker drawing with a stale world
+// matrix or light list binds the same buffers as the
+// serial path but with different bytes in them. Buffers
+// nothing was uploaded to yet contribute nothing.
+// --------------------------------------------------------
+void HeadlessRenderContext::SnapshotDraw(unsigned int count, bool indexed)
+{
+	DrawSnapshot snapshot = { bindings.vertexShader, bindings.pixelShader, bindings.inputLayout, bindings.vertexBuffer, bindings.indexBuffer, bindings.renderTarget, bindings.blendState, count, indexed, drawConstants.size(), 0 };
+
+	for (int stage = 0; stage < (int)ShaderStage::Count; ++stage)
+	{
+		for (unsigned int slot = 0; slot < HEADLESS_CB_SLOTS; ++slot)
+		{
+			auto contents = bufferContents.find(bindings.constantBuffers[stage][slot]);
+			if (contents != bufferContents.end())
+				drawConstants.insert(drawConstants.end(), contents->second.begin(), contents->second.end());
+		}
+	}
+
+	snapshot.constantsSize = drawConstants.size() - snapshot.constantsOffset;
+	draws.push_back(snapshot);
+}
+
+void HeadlessRenderContext::TrackUpload(void* buffer, unsigned int byteOffset, const void* data, unsigned int size, bool discard)
+{
+	std::vector<unsigned char>& contents = bufferContents[buffer];
+	if (discard)
+		contents.clear();
+	if (contents.size() < byteOffset + size)
+		contents.resize(byteOffset + size);
+	memcpy(contents.data() + byteOffset, data, size);
+}
+
+void HeadlessRenderContext::Bind(void*& binding, void* value)
+{
+	if (binding == value)
+	{
+		stats.redundantStateChanges++;
+		return;
+	}
+
+	stats.stateChanges++;
+	binding = value;
+}
+
+RenderCommand& HeadlessRenderContext::Push(RenderCommandType type)
+{
+	RenderCommand command = {};
+	command.type = type;
+
+	if (!recordCommands)
+	{
+		scratch = command;
+		return scratch;
+	}
+
+	commands.push_back(command);
+	return commands.back();
+}
+
+// --------------------------------------------------------
+// Catches the mistakes a real device would only report as
+// a black screen or a debug layer warning: missing shaders,
+// no output, no viewport and missing geometry streams.
+// Non-indexed draws may run without buffers (full screen
+// triangles build their vertices from SV_VertexID).
+// --------------------------------------------------------
+void HeadlessRenderContext::ValidateDraw(bool indexed)
+{
+	if (!bindings.vertexShader)
+		Fail("Draw without a vertex shader");
+	if (!bindings.pixelShader)
+		Fail("Draw without a pixel shader");
+	if (!bindings.renderTarget && !bindings.depthStencil)
+		Fail("Draw without a render target or depth buffer");
+	if (!bindings.viewportSet)
+		Fail("Draw without a viewport");
+
+	if (indexed)
+	{
+		if (!bindings.inputLayout)
+			Fail("DrawIndexed without an input layout");
+		if (!bindings.vertexBuffer || bindings.vertexStride == 0)
+			Fail("DrawIndexed without a vertex buffer");
+		if (!bindings.indexBuffer)
+			Fail("DrawIndexed without an index buffer");
+	}
+}
+
+void HeadlessRenderContext::Fail(const std::string& message)
+{
+	validationErrorCount++;
+	if (validationErrors.size() < MAX_STORED_VALIDATION_ERRORS)
+		validationErrors.push_back(message);
+}
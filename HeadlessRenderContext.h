@@ -0,0 +1,172 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "RenderBackend.h"
+
+// Max constant buffer / sampler slots tracked per stage, matches D3D11
+#define HEADLESS_CB_SLOTS 14
+#define HEADLESS_SAMPLER_SLOTS 16
+
+enum class RenderCommandType
+{
+	SetRenderTargets,
+	ClearRenderTarget,
+	ClearDepthStencil,
+	SetViewport,
+	SetBlendState,
+	SetInputLayout,
+	SetVertexShader,
+	SetPixelShader,
+	SetConstantBuffer,
+	SetShaderResource,
+	SetSampler,
+	UnbindShaderResources,
+	UpdateBuffer,
+	UpdateBufferRange,
+	SetVertexBuffer,
+	SetIndexBuffer,
+	Draw,
+	DrawIndexed
+};
+
+// One recorded call. Only the fields the command type uses are filled
+struct RenderCommand
+{
+	RenderCommandType type;
+	ShaderStage stage;
+	unsigned int slot;		// binding slot, or the byte offset of UpdateBufferRange
+	unsigned int count;		// vertex/index count, upload size or vertex stride
+	void* object;			// the resource being bound
+	void* secondObject;		// depth stencil view for SetRenderTargets
+	float values[4];		// clear color, clear depth or viewport size
+	size_t dataOffset;		// UpdateBuffer(Range): start of the uploaded bytes in the upload arena
+};
+
+// Everything a single draw call saw, used to compare two submission paths
+struct DrawSnapshot
+{
+	void* vertexShader;
+	void* pixelShader;
+	void* inputLayout;
+	void* vertexBuffer;
+	void* indexBuffer;
+	void* renderTarget;
+	void* blendState;
+	unsigned int count;
+	bool indexed;
+
+	// Contents of every bound constant buffer, stage and slot order, in GetDrawConstants()
+	size_t constantsOffset;
+	size_t constantsSize;
+};
+
+/**
+ * Render context without a device.
+ *
+ * Records every call into a command list that can be replayed into
+ * another context, tracks the current bindings to count real and
+ * redundant state changes, and validates that each draw has what it
+ * needs bound. Handles are never dereferenced, any unique pointer works.
+ *
+ * Like a D3D11 deferred context, it starts out with nothing bound.
+ */
+class HeadlessRenderContext : public IRenderContext
+{
+public:
+	// Without recording only stats and validation are kept, which is all a perf run needs
+	HeadlessRenderContext(bool recordCommands = true);
+	~HeadlessRenderContext() = default;
+
+	// Drops recorded commands, snapshots, errors and bindings. Stats are kept, see ResetStats()
+	void Reset();
+
+	// Re-issues every recorded command on the target, e.g. to merge worker recordings in order
+	void Replay(IRenderContext* target) const;
+
+	// True if both contexts issued the same draws with the same bindings and the same constant buffer contents
+	bool HasSameDraws(const HeadlessRenderContext& other) const;
+
+	inline const std::vector<RenderCommand>& GetCommands() const { return commands; }
+
+	// Copy of the bytes an UpdateBuffer(Range) command sent
+	inline const unsigned char* GetUploadData(const RenderCommand& command) const { return uploads.data() + command.dataOffset; }
+	inline const std::vector<DrawSnapshot>& GetDraws() const { return draws; }
+
+	// What a draw's constant buffers held when it was issued
+	inline const unsigned char* GetDrawConstants(const DrawSnapshot& draw) const { return drawConstants.data() + draw.constantsOffset; }
+	inline const std::vector<std::string>& GetValidationErrors() const { return validationErrors; }
+	inline unsigned int GetValidationErrorCount() const { return validationErrorCount; }
+
+	void SetRenderTargets(ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv) override;
+	void ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4]) override;
+	void ClearDepthStencil(ID3D11DepthStencilView* dsv, float depth, unsigned char stencil) override;
+	void SetViewport(float width, float height) override;
+	void SetBlendState(ID3D11BlendState* blendState) override;
+
+	void SetInputLayout(ID3D11InputLayout* inputLayout) override;
+	void SetVertexShader(ID3D11VertexShader* shader) override;
+	void SetPixelShader(ID3D11PixelShader* shader) override;
+	void SetConstantBuffer(ShaderStage stage, unsigned int slot, ID3D11Buffer* buffer) override;
+	void SetShaderResource(ShaderStage stage, unsigned int slot, ID3D11ShaderResourceView* srv) override;
+	void SetSampler(ShaderStage stage, unsigned int slot, ID3D11SamplerState* sampler) override;
+	void UnbindShaderResources(ShaderStage stage) override;
+
+	void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size) override;
+	void UpdateBufferRange(ID3D11Buffer* buffer, unsigned int byteOffset, const void* data, unsigned int size) override;
+
+	void SetVertexBuffer(ID3D11Buffer* buffer, unsigned int stride) override;
+	void SetIndexBuffer(ID3D11Buffer* buffer) override;
+
+	void Draw(unsigned int vertexCount) override;
+	void DrawIndexed(unsigned int indexCount) override;
+
+private:
+	struct Bindings
+	{
+		void* renderTarget;
+		void* depthStencil;
+		void* blendState;
+		void* inputLayout;
+		void* vertexShader;
+		void* pixelShader;
+		void* vertexBuffer;
+		void* indexBuffer;
+		void* constantBuffers[(int)ShaderStage::Count][HEADLESS_CB_SLOTS];
+		void* shaderResources[(int)ShaderStage::Count][RENDER_CONTEXT_SRV_SLOTS];
+		void* samplers[(int)ShaderStage::Count][HEADLESS_SAMPLER_SLOTS];
+		unsigned int vertexStride;
+		bool viewportSet;
+	};
+
+	// Updates a tracked binding and counts it as a real or redundant change
+	void Bind(void*& binding, void* value);
+
+	// Appends a zeroed command, or returns a scratch one when not recording
+	RenderCommand& Push(RenderCommandType type);
+	void ValidateDraw(bool indexed);
+
+	// Records the bindings and the bound constant buffers' contents for HasSameDraws()
+	void SnapshotDraw(unsigned int count, bool indexed);
+
+	// Applies an upload to the buffer's tracked contents
+	void TrackUpload(void* buffer, unsigned int byteOffset, const void* data, unsigned int size, bool discard);
+
+	void Fail(const std::string& message);
+
+	bool recordCommands;
+	Bindings bindings;
+
+	std::vector<RenderCommand> commands;
+	RenderCommand scratch;
+	std::vector<unsigned char> uploads;
+	std::vector<DrawSnapshot> draws;
+
+	// Buffer contents as the uploads so far left them, and each draw's copy of its constants
+	std::unordered_map<void*, std::vector<unsigned char>> bufferContents;
+	std::vector<unsigned char> drawConstants;
+
+	std::vector<std::string> validationErrors;
+	unsigned int validationErrorCount = 0;
+};
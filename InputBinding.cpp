@@ -6,6 +6,7 @@ Description : Implementation for structures defined in InputBinding.h
 #include "InputBinding.h"
 #include <vector>
 #include <string>
+#include <cstring>
 
 namespace Input {
     // Default Binding Constructor
@@ -45,4 +46,83 @@ namespace Input {
         name(pName),
         chord(plBinding)
     {};
+
+    void KeyMask::Clear()
+    {
+        memset(words, 0, sizeof(words));
+    }
+
+    // 32 keys per word, bit by bit
+    void KeyMask::FromBytes(const unsigned char* pkeys)
+    {
+        for (unsigned int word = 0; word < 8; word++)
+        {
+            uint32_t bits = 0;
+            for (unsigned int bit = 0; bit < 32; bit++)
+                bits |= (uint32_t)(pkeys[word * 32 + bit] >> 7) << bit;
+            words[word] = bits;
+        }
+    }
+
+    void ChordTable::Clear()
+    {
+        chords.clear();
+        commands.clear();
+        commandCount = 0;
+    }
+
+    // Each binding's state is a pair of wanted bits: pressed this frame, pressed last frame
+    bool ChordTable::Add(const unsigned int pcommand, const Chord& pchord)
+    {
+        CompiledChord compiled;
+        for (const Binding& binding : pchord.GetChord())
+        {
+            KeyState state = binding.GetKeyState();
+            unsigned int keyCode = binding.GetKeyCode();
+            bool current = state == KeyState::JustPressed || state == KeyState::StillPressed;
+            bool previous = state == KeyState::JustReleased || state == KeyState::StillPressed;
+
+            if (compiled.keys.Test(keyCode) && (compiled.current.Test(keyCode) != current || compiled.previous.Test(keyCode) != previous))
+                return false;
+
+            compiled.keys.Set(keyCode);
+            if (current)
+                compiled.current.Set(keyCode);
+            if (previous)
+                compiled.previous.Set(keyCode);
+        }
+
+        chords.push_back(compiled);
+        commands.push_back(pcommand);
+        if (pcommand >= commandCount)
+            commandCount = pcommand + 1;
+        return true;
+    }
+
+    // Per chord: (current ^ wanted current) | (previous ^ wanted previous), masked by its keys, is zero when fulfilled.
+    // 256 bits are two vectors
+    void ChordTable::Match(const KeyMask& pcurrent, const KeyMask& pprevious, std::vector<uint64_t>& pactive) const
+    {
+        using namespace DirectX;
+
+        pactive.assign((commandCount + 63) / 64, 0);
+
+        const XMVECTOR currentLow   = XMLoadInt4A(&pcurrent.words[0]);
+        const XMVECTOR currentHigh  = XMLoadInt4A(&pcurrent.words[4]);
+        const XMVECTOR previousLow  = XMLoadInt4A(&pprevious.words[0]);
+        const XMVECTOR previousHigh = XMLoadInt4A(&pprevious.words[4]);
+        const XMVECTOR zero = XMVectorZero();
+
+        for (size_t i = 0; i < chords.size(); i++)
+        {
+            const CompiledChord& chord = chords[i];
+            XMVECTOR low = XMVectorAndInt(XMLoadInt4A(&chord.keys.words[0]),
+                XMVectorOrInt(XMVectorXorInt(currentLow, XMLoadInt4A(&chord.current.words[0])), XMVectorXorInt(previousLow, XMLoadInt4A(&chord.previous.words[0]))));
+            XMVECTOR high = XMVectorAndInt(XMLoadInt4A(&chord.keys.words[4]),
+                XMVectorOrInt(XMVectorXorInt(currentHigh, XMLoadInt4A(&chord.current.words[4])), XMVectorXorInt(previousHigh, XMLoadInt4A(&chord.previous.words[4]))));
+
+            if (XMVector4EqualInt(XMVectorOrInt(low, high), zero))
+                pactive[commands[i] >> 6] |= 1ull << (commands[i] & 63);
+        }
+    }
 }
@@ -11,6 +11,9 @@ to be used by the Inputhandling InputSystem class
 #include <string>
 #include <array>
 #include <vector>
+#include <cstdint>
+
+#include <DirectXMath.h>
 
 #include <windows.h>
 
@@ -48,6 +51,10 @@ namespace Input {
         Binding(const unsigned int pkeyCode, const KeyState pkeyState);
         ~Binding() {};
 
+        // Accessors for member variables
+        unsigned int GetKeyCode()  const { return keyCode;  }
+        KeyState     GetKeyState() const { return keyState; }
+
         friend class InputSystem;
     };
 
@@ -66,8 +73,56 @@ namespace Input {
         ~Chord() {};
 
         // Accessors for member variables
-        std::vector<Binding>& GetChord() { return chord; }
-        std::wstring&         GetName()  { return name;  }
+        std::vector<Binding>&       GetChord()       { return chord; }
+        const std::vector<Binding>& GetChord() const { return chord; }
+        std::wstring&               GetName()        { return name;  }
+    };
+
+    // One bit per Windows virtual key code, key k is bit k % 32 of word k / 32
+    struct KeyMask
+    {
+        alignas(16) uint32_t words[8];
+
+        KeyMask() { Clear(); }
+
+        void Clear();
+        inline bool Test(const unsigned int pkeyCode) const { return (words[pkeyCode >> 5] >> (pkeyCode & 31)) & 1; }
+        inline void Set(const unsigned int pkeyCode) { words[pkeyCode >> 5] |= 1u << (pkeyCode & 31); }
+        inline void Reset(const unsigned int pkeyCode) { words[pkeyCode >> 5] &= ~(1u << (pkeyCode & 31)); }
+
+        // Keys whose byte has the high bit set, like ::GetKeyboardState() fills them
+        void FromBytes(const unsigned char* pkeys);
+    };
+
+    // Chords compiled to key masks, so every command is resolved at once:
+    // a chord is fulfilled when its keys are down now and before exactly as
+    // its bindings want, three masks and a few vector ANDs and compares
+    class ChordTable
+    {
+    public:
+        void Clear();
+
+        // Returns false, and adds nothing, if the chord can never be fulfilled (one key bound to two states)
+        bool Add(const unsigned int pcommand, const Chord& pchord);
+
+        // Sets bit c % 64 of word c / 64 for every command c with a fulfilled chord, clears the others
+        void Match(const KeyMask& pcurrent, const KeyMask& pprevious, std::vector<uint64_t>& pactive) const;
+
+        inline unsigned int GetCommandCount() const { return commandCount; }
+        inline size_t GetChordCount() const { return commands.size(); }
+
+    private:
+        // Keys the chord looks at, and which of those it wants down this frame and the last
+        struct CompiledChord
+        {
+            KeyMask keys;
+            KeyMask current;
+            KeyMask previous;
+        };
+
+        std::vector<CompiledChord> chords;
+        std::vector<unsigned int> commands;
+        unsigned int commandCount = 0;
     };
 }
 
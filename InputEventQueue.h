@@ -0,0 +1,107 @@
+#ifndef INPUTEVENTQUEUE_H
+#define INPUTEVENTQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Events an InputThread queues at most between two frames
+#define INPUT_QUEUE_CAPACITY 4096
+
+// Bytes kept between the producer's and the consumer's indices, so they never share a cache line
+#define INPUT_CACHE_LINE 64
+
+namespace Input {
+
+    enum class InputEventType : uint8_t
+    {
+        KeyDown,
+        KeyUp,
+        MouseMove
+    };
+
+    // One key change or mouse motion, as the source saw it
+    struct InputEvent
+    {
+        InputEventType type;
+        uint8_t  keyCode;       // Windows virtual key code, mouse buttons included (VK_RBUTTON)
+        int32_t  dx, dy;        // relative mouse motion, MouseMove only
+        uint64_t timestamp;     // InputClockNow() when it happened
+    };
+
+    // Nanoseconds on a steady clock, comparable across threads
+    inline uint64_t InputClockNow()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Lock-free ring of events from exactly one producer thread to exactly
+    // one consumer thread. Each side only writes its own index, publishes
+    // it with a release store and reads the other's with an acquire load,
+    // and keeps a copy of the other's index so a call only touches the
+    // shared line when the copy says the ring looks full (or empty)
+    class InputEventQueue
+    {
+    public:
+        // Rounded up to a power of two
+        explicit InputEventQueue(const unsigned int pcapacity = INPUT_QUEUE_CAPACITY)
+        {
+            unsigned int capacity = 2;
+            while (capacity < pcapacity)
+                capacity <<= 1;
+            events.resize(capacity);
+            mask = capacity - 1;
+        }
+
+        // Producer only. False if the ring is full, the event is dropped
+        inline bool Push(const InputEvent& pevent)
+        {
+            uint32_t position = tail.load(std::memory_order_relaxed);
+            if (position - headCopy > mask)
+            {
+                headCopy = head.load(std::memory_order_acquire);
+                if (position - headCopy > mask)
+                    return false;
+            }
+
+            events[position & mask] = pevent;
+            tail.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer only. False if the ring is empty
+        inline bool Pop(InputEvent& pevent)
+        {
+            uint32_t position = head.load(std::memory_order_relaxed);
+            if (position == tailCopy)
+            {
+                tailCopy = tail.load(std::memory_order_acquire);
+                if (position == tailCopy)
+                    return false;
+            }
+
+            pevent = events[position & mask];
+            head.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        inline unsigned int GetCapacity() const { return mask + 1; }
+
+    private:
+        std::vector<InputEvent> events;
+        uint32_t mask;
+
+        // producer side
+        std::atomic<uint32_t> tail{ 0 };
+        uint32_t headCopy = 0;
+        char producerPad[INPUT_CACHE_LINE];
+
+        // consumer side
+        std::atomic<uint32_t> head{ 0 };
+        uint32_t tailCopy = 0;
+        char consumerPad[INPUT_CACHE_LINE];
+    };
+}
+
+#endif
@@ -9,16 +9,17 @@ Description : InputSystem method definitions
 namespace Input {
 
     // Init all keyboard states to 0
-    InputSystem::InputSystem()
+    InputSystem::InputSystem() :
+        inputThread(nullptr),
+        eventMouseDelta(0.0f, 0.0f)
     {
-        keyboardCurrent.fill(0);
-        keyboardPrevious.fill(0);
         mousePrevious.x = 0;
         mousePrevious.y = 0;
         mouseCurrent.x = 0;
         mouseCurrent.y = 0;
 
         SetDefaultKeyMap();
+        CompileKeyMap();
     }
 
     // Release all dynamic memory
@@ -28,9 +29,6 @@ namespace Input {
         for (auto pair : keyMap)
             delete pair.second;
         keyMap.clear();
-
-        // No need to delete dynamic memory from activeKeyMap, it's already deleted in keymap*
-        activeKeyMap.clear();
     }
 
     void InputSystem::Frame(float dt, Camera* camera)
@@ -43,12 +41,15 @@ namespace Input {
         Transform* playerTransform = camera->GetTransform();
 
         // Act on user input:
-        // - Iterate through all active keys
-        // - Check for commands corresponding to activated chords
-        // - Do something based on those commands
-        for (auto pair : activeKeyMap)
+        // - Iterate through all commands
+        // - Skip those without a fulfilled chord
+        // - Do something based on the others
+        for (unsigned int command = 0; command < chordTable.GetCommandCount(); command++)
         {
-            switch (pair.first)
+            if (!IsCommandActive(static_cast<GameCommands>(command)))
+                continue;
+
+            switch (static_cast<GameCommands>(command))
             {
             case GameCommands::Quit:
                 PostQuitMessage(0);
@@ -98,13 +99,24 @@ namespace Input {
     // Updates mouse mapping
     void InputSystem::GetKeyboardInput()
     {
-        // Get the keyboard state from windows
-        GetKeyboardState();
+        // Get the keyboard state from the input thread, or from windows
+        // if there's none, or its source couldn't be opened
+        if (inputThread && inputThread->IsRunning())
+            ConsumeEvents();
+        else
+            GetKeyboardState();
 
         // Update active/non-active keymaps
         UpdateKeymaps();
     }
 
+    void InputSystem::SetInputThread(InputThread* pthread)
+    {
+        inputThread = pthread;
+        keysDown.Clear();
+        eventMouseDelta = { 0.0f, 0.0f };
+    }
+
     void InputSystem::OnMouseMove(short newX, short newY)
     {
         mouseCurrent = { newX, newY };
@@ -112,6 +124,9 @@ namespace Input {
 
     std::pair<float,float> InputSystem::GetMouseDelta() const
     {
+        if (inputThread && inputThread->IsRunning())
+            return eventMouseDelta;
+
         std::pair<float, float> pt;
         
         pt.first  = static_cast<float>(mouseCurrent.x - mousePrevious.x);
@@ -119,31 +134,22 @@ namespace Input {
         return pt;
     }
 
-    // Clears active key map, then fills it with all values from keyMap with a 'fulfilled' chord
+    // Sets the bit of every command in keyMap with a 'fulfilled' chord, clears the others
     void InputSystem::UpdateKeymaps()
     {
-        // Reset active key map
-        activeKeyMap.clear();
+        chordTable.Match(keyboardCurrent, keyboardPrevious, activeCommands);
+    }
 
-        // Map which keys are active into the active key map
+    // Chords that can never be fulfilled are left out, and said so
+    void InputSystem::CompileKeyMap()
+    {
+        chordTable.Clear();
         for (auto key : keyMap)
         {
-            bool activeKey = true;
-
-            // Test Chord
-            for (Binding binding : key.second->GetChord())
-            {
-                if (GetKeyboardKeyState(binding.keyCode) != binding.keyState)
-                {
-                    activeKey = false;
-                    break;
-                }
-            }
-
-            // Passed Chord Check : move key to active key map
-            if (activeKey)
-                activeKeyMap.insert(std::pair<GameCommands, Chord*>(key.first, key.second));
+            if (!chordTable.Add(static_cast<unsigned int>(key.first), *key.second))
+                wprintf(L"Chord '%s' binds a key to two states, it's ignored\n", key.second->GetName().c_str());
         }
+        activeCommands.assign((chordTable.GetCommandCount() + 63) / 64, 0);
     }
 
     void InputSystem::UpdateMouseState()
@@ -152,25 +158,60 @@ namespace Input {
     }
 
     // Stores the current state of the keyboard as 'previous'
-    // then reads in new 'current values from windows
+    // then reads in new 'current values from windows.
+    // Windows' own copy of the keys as of the last message
+    // this thread took from its queue, all 256 in one call
     void InputSystem::GetKeyboardState()
     {
         keyboardPrevious = keyboardCurrent;
 
-        for (int i = 0; i < 256; i++)
-            keyboardCurrent[i] = isPressed(i);
+        BYTE keys[256];
+        if (::GetKeyboardState(keys))
+            keyboardCurrent.FromBytes(keys);
+    }
+
+    // Keys go down and up in the order they were pressed. A key that was
+    // pressed at any point since the last frame counts as down this frame,
+    // so a tap shorter than a frame is still seen, and is released the next
+    void InputSystem::ConsumeEvents()
+    {
+        keyboardPrevious = keyboardCurrent;
+        KeyMask pressed;
+        eventMouseDelta = { 0.0f, 0.0f };
+
+        inputThread->Consume(frameEvents);
+        for (const InputEvent& event : frameEvents)
+        {
+            switch (event.type)
+            {
+            case InputEventType::KeyDown:
+                keysDown.Set(event.keyCode);
+                pressed.Set(event.keyCode);
+                break;
+            case InputEventType::KeyUp:
+                keysDown.Reset(event.keyCode);
+                break;
+            case InputEventType::MouseMove:
+                eventMouseDelta.first += static_cast<float>(event.dx);
+                eventMouseDelta.second += static_cast<float>(event.dy);
+                break;
+            }
+        }
+
+        for (unsigned int word = 0; word < 8; word++)
+            keyboardCurrent.words[word] = keysDown.words[word] | pressed.words[word];
     }
 
     // Use logic to deduce Keystate from current and previous keyboard states
     const KeyState InputSystem::GetKeyboardKeyState(const unsigned int pkeyCode) const
     {
-        if (keyboardPrevious[pkeyCode] == 1)
-            if (keyboardCurrent[pkeyCode] == 1)
+        if (keyboardPrevious.Test(pkeyCode))
+            if (keyboardCurrent.Test(pkeyCode))
                 return KeyState::StillPressed;  // true, true
             else
                 return KeyState::JustReleased;  // true, false
         else
-            if (keyboardCurrent[pkeyCode] == 1)
+            if (keyboardCurrent.Test(pkeyCode))
                 return KeyState::JustPressed;   // false, true
             else
                 return KeyState::StillReleased; // false, false
@@ -7,8 +7,11 @@ Description : Interface for the InputSystem class
 #define INPUTSYSTEM_H
 
 #include <array>
+#include <cstdint>
 #include <unordered_map>
+#include <vector>
 #include "InputBinding.h"
+#include "InputThread.h"
 #include "Camera.h"
 
 #include <Windows.h>
@@ -21,11 +24,20 @@ public:
     InputSystem();
     virtual ~InputSystem();
 
-    std::unordered_map<GameCommands, Chord*> activeKeyMap;
+    // True if the command's chord was fulfilled by the last Frame()
+    inline bool IsCommandActive(const GameCommands pcommand) const
+    {
+        unsigned int command = static_cast<unsigned int>(pcommand);
+        return command < chordTable.GetCommandCount() && ((activeCommands[command >> 6] >> (command & 63)) & 1);
+    }
 
     // Main "Update" method
     void Frame(float dt, Camera* camera);
 
+    // Frame() takes keys and mouse motion from the thread's events instead of
+    // polling Windows. Not owned, nullptr goes back to polling
+    void SetInputThread(InputThread* pthread);
+
     // On WM_MOUSEMOVE message, trigger this method
     void OnMouseMove(short newX, short newY);
 
@@ -36,27 +48,34 @@ public:
     std::pair<float, float> GetMouseDelta() const;
 
 private:
-    // Keyboard States
-    std::array<BYTE, 256> keyboardCurrent;
-    std::array<BYTE, 256> keyboardPrevious;
+    // Keyboard States, one bit per key
+    KeyMask keyboardCurrent;
+    KeyMask keyboardPrevious;
 
     // Mouse States
     POINT mouseCurrent;
     POINT mousePrevious;
 
+    // Events from the input thread, keys they left down, and mouse motion since the last Frame()
+    InputThread* inputThread;
+    std::vector<InputEvent> frameEvents;
+    KeyMask keysDown;
+    std::pair<float, float> eventMouseDelta;
+
+    // keyMap compiled, and one bit per command with a fulfilled chord
+    ChordTable chordTable;
+    std::vector<uint64_t> activeCommands;
+
     // returns the state of the key in enum form
     const KeyState GetKeyboardKeyState(const unsigned int pkeyCode) const;
 
-    // returns true if the key is down
-    inline const bool isPressed(int pkeyCode) const
-    {
-        return (GetAsyncKeyState(pkeyCode) & 0x8000) ? 1 : 0;
-    }
-    
-    // Uses GetAsyncKeyState to read in 256 bytes
+    // Reads all 256 keys with one ::GetKeyboardState() call into the current mask
     void GetKeyboardState();
 
-    // Clears Active Map, then populates it with new active keys
+    // Replays the input thread's events since the last frame into the current mask and the mouse delta
+    void ConsumeEvents();
+
+    // Matches every compiled chord at once into activeCommands
     void UpdateKeymaps();
 
     // Curr = Prev
@@ -69,6 +88,9 @@ protected:
     std::unordered_map<GameCommands, Chord*> keyMap;
 
     virtual void SetDefaultKeyMap();
+
+    // Compiles keyMap for UpdateKeymaps(), needed again after changing it
+    void CompileKeyMap();
 };
 }
 #endif
\ No newline at end of file
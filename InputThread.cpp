@@ -0,0 +1,165 @@
+#include "InputThread.h"
+#include <algorithm>
+
+namespace Input {
+
+    // Events a tick, one per 1/rate seconds. Half are mouse motion, half a
+    // tap of a letter key not already held
+    SyntheticInputSource::SyntheticInputSource(const float peventsPerSecond, const unsigned int pseed) :
+        interval((uint64_t)(1e9 / (std::max)(peventsPerSecond, 1.0f))),
+        nextEvent(0),
+        seed(pseed ? pseed : 1)
+    {};
+
+    bool SyntheticInputSource::Open()
+    {
+        nextEvent = InputClockNow() + interval;
+        heldKeys.clear();
+        releaseTimes.clear();
+        return true;
+    }
+
+    float SyntheticInputSource::RandomFloat()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Sleeps until the next release or event is due, at most the timeout,
+    // then emits everything that came due, each stamped as it's emitted
+    void SyntheticInputSource::Poll(const unsigned int ptimeoutMs, std::vector<InputEvent>& pevents)
+    {
+        uint64_t now = InputClockNow();
+        uint64_t wake = (std::min)(nextEvent, now + (uint64_t)ptimeoutMs * 1000000);
+        for (uint64_t release : releaseTimes)
+            wake = (std::min)(wake, release);
+        if (wake > now)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(wake - now));
+
+        now = InputClockNow();
+        for (size_t i = 0; i < heldKeys.size();)
+        {
+            if (releaseTimes[i] > now)
+            {
+                ++i;
+                continue;
+            }
+
+            InputEvent up = { InputEventType::KeyUp, heldKeys[i], 0, 0, InputClockNow() };
+            pevents.push_back(up);
+            heldKeys[i] = heldKeys.back();
+            releaseTimes[i] = releaseTimes.back();
+            heldKeys.pop_back();
+            releaseTimes.pop_back();
+        }
+
+        for (; nextEvent <= now; nextEvent += interval)
+        {
+            InputEvent event = { InputEventType::MouseMove, 0, 0, 0, 0 };
+            if (RandomFloat() < 0.5f || heldKeys.size() == 26)
+            {
+                event.dx = (int32_t)(RandomFloat() * 21.0f) - 10;
+                event.dy = (int32_t)(RandomFloat() * 21.0f) - 10;
+            }
+            else
+            {
+                uint8_t key;
+                do
+                    key = (uint8_t)('A' + (int)(RandomFloat() * 26.0f) % 26);
+                while (std::find(heldKeys.begin(), heldKeys.end(), key) != heldKeys.end());
+
+                event.type = InputEventType::KeyDown;
+                event.keyCode = key;
+                heldKeys.push_back(key);
+                releaseTimes.push_back(now + (uint64_t)((2.0f + RandomFloat() * 58.0f) * 1e6f));
+            }
+            event.timestamp = InputClockNow();
+            pevents.push_back(event);
+        }
+
+        emitted.store(emitted.load(std::memory_order_relaxed) + pevents.size(), std::memory_order_relaxed);
+    }
+
+    InputThread::InputThread(InputSource* psource, const unsigned int pcapacity) :
+        source(psource),
+        queue(pcapacity)
+    {
+        latencyMs.resize(INPUT_LATENCY_SAMPLES);
+    }
+
+    InputThread::~InputThread()
+    {
+        Stop();
+    }
+
+    void InputThread::Start()
+    {
+        if (thread.joinable() || !source)
+            return;
+
+        running.store(true);
+        thread = std::thread(&InputThread::ThreadLoop, this);
+    }
+
+    void InputThread::Stop()
+    {
+        running.store(false);
+        if (thread.joinable())
+            thread.join();
+    }
+
+    // Poll, queue, repeat. A full queue drops the newest events and counts
+    // them: the game stopped consuming, and it's better to lose input than
+    // to block the thread reading it
+    void InputThread::ThreadLoop()
+    {
+        if (!source->Open())
+        {
+            running.store(false);
+            return;
+        }
+
+        while (running.load(std::memory_order_relaxed))
+        {
+            polled.clear();
+            source->Poll(INPUT_POLL_TIMEOUT_MS, polled);
+
+            uint64_t dropped = 0;
+            for (const InputEvent& event : polled)
+            {
+                if (!queue.Push(event))
+                    ++dropped;
+            }
+            queuedCount.store(queuedCount.load(std::memory_order_relaxed) + polled.size() - dropped, std::memory_order_relaxed);
+            if (dropped)
+                droppedCount.store(droppedCount.load(std::memory_order_relaxed) + dropped, std::memory_order_relaxed);
+        }
+
+        source->Close();
+    }
+
+    void InputThread::Consume(std::vector<InputEvent>& pevents)
+    {
+        pevents.clear();
+
+        InputEvent event;
+        while (queue.Pop(event))
+            pevents.push_back(event);
+
+        uint64_t now = InputClockNow();
+        for (const InputEvent& consumed : pevents)
+            latencyMs[latencyCount++ % INPUT_LATENCY_SAMPLES] = (now - consumed.timestamp) * 1e-6;
+        consumedCount += pevents.size();
+    }
+
+    double InputThread::GetLatencyMs(const float ppercentile) const
+    {
+        std::vector<double> samples(latencyMs.begin(), latencyMs.begin() + (std::min)(latencyCount, (unsigned int)INPUT_LATENCY_SAMPLES));
+        if (samples.empty())
+            return 0.0;
+
+        size_t rank = (size_t)((std::min)((std::max)(ppercentile, 0.0f), 1.0f) * (samples.size() - 1));
+        std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+        return samples[rank];
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef INPUTTHREAD_H
+#define INPUTTHREAD_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "InputEventQueue.h"
+
+// Longest the input thread waits in one Poll(), and so the longest Stop() waits for it
+#define INPUT_POLL_TIMEOUT_MS 1
+
+// Latencies kept for the percentiles, the most recent ones
+#define INPUT_LATENCY_SAMPLES 4096
+
+namespace Input {
+
+    // Where an InputThread gets its events: the OS, or a script
+    class InputSource
+    {
+    public:
+        virtual ~InputSource() {};
+
+        // On the input thread, before its first Poll() and after its last. False stops the thread
+        virtual bool Open() { return true; }
+        virtual void Close() {}
+
+        // Waits up to ptimeoutMs for input, then appends whatever came in, stamped with InputClockNow()
+        virtual void Poll(const unsigned int ptimeoutMs, std::vector<InputEvent>& pevents) = 0;
+    };
+
+    // Random key taps and mouse motion at a fixed rate, in real time, for
+    // benchmarks and runs without a window. Taps are held 2 to 60 ms
+    class SyntheticInputSource : public InputSource
+    {
+    public:
+        SyntheticInputSource(const float peventsPerSecond, const unsigned int pseed = 1);
+
+        bool Open() override;
+        void Poll(const unsigned int ptimeoutMs, std::vector<InputEvent>& pevents) override;
+
+        inline uint64_t GetEmittedCount() const { return emitted.load(std::memory_order_relaxed); }
+
+    private:
+        float RandomFloat();
+
+        uint64_t interval;      // ns between events
+        uint64_t nextEvent;
+        unsigned int seed;
+
+        // held keys and when they go up
+        std::vector<uint8_t>  heldKeys;
+        std::vector<uint64_t> releaseTimes;
+
+        std::atomic<uint64_t> emitted{ 0 };
+    };
+
+    // Collects input on its own thread, as it happens, into an SPSC queue
+    // the game thread empties with Consume() once per frame. Events keep
+    // their order and their time, key taps shorter than a frame included
+    class InputThread
+    {
+    public:
+        // The source is used from the input thread only, between Start() and Stop(). Not owned
+        InputThread(InputSource* psource, const unsigned int pcapacity = INPUT_QUEUE_CAPACITY);
+        ~InputThread();
+
+        void Start();
+
+        // Waits for the thread, events still queued stay for Consume()
+        void Stop();
+
+        // Game thread: every queued event, oldest first, into pevents (cleared first). Records their latency
+        void Consume(std::vector<InputEvent>& pevents);
+
+        // Event to Consume() time of the events consumed lately, in ms, for percentile 0 to 1
+        double GetLatencyMs(const float ppercentile) const;
+
+        inline uint64_t GetQueuedCount()   const { return queuedCount.load(std::memory_order_relaxed); }
+        inline uint64_t GetDroppedCount()  const { return droppedCount.load(std::memory_order_relaxed); }
+        inline uint64_t GetConsumedCount() const { return consumedCount; }
+        inline bool     IsRunning()        const { return running.load(std::memory_order_relaxed); }
+
+    private:
+        void ThreadLoop();
+
+        InputSource* source;
+        InputEventQueue queue;
+        std::thread thread;
+        std::atomic<bool> running{ false };
+
+        // input thread side
+        std::vector<InputEvent> polled;
+        std::atomic<uint64_t> queuedCount{ 0 };
+        std::atomic<uint64_t> droppedCount{ 0 };
+
+        // game thread side
+        uint64_t consumedCount = 0;
+        std::vector<double> latencyMs;
+        unsigned int latencyCount = 0;
+    };
+}
+
+#endif
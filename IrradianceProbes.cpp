@@ -0,0 +1,206 @@
+#include "IrradianceProbes.h"
+#include "TriangleBVH.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <ppl.h>
+#include <thread>
+
+using namespace DirectX;
+using namespace Concurrency;
+
+// Shadow rays start this far from the probe, and stop this far short of the light
+#define IRRADIANCE_PROBE_RAY_BIAS 0.01f
+
+// Length of directional light shadow rays
+#define IRRADIANCE_PROBE_RAY_DISTANCE 1000.0f
+
+namespace
+{
+	// Real L2 spherical harmonics basis for a unit direction
+	void ShBasis(const XMFLOAT3& d, float basis[IRRADIANCE_SH_COEFFICIENTS])
+	{
+		basis[0] = 0.282095f;
+		basis[1] = 0.488603f * d.y;
+		basis[2] = 0.488603f * d.z;
+		basis[3] = 0.488603f * d.x;
+		basis[4] = 1.092548f * d.x * d.y;
+		basis[5] = 1.092548f * d.y * d.z;
+		basis[6] = 0.315392f * (3.0f * d.z * d.z - 1.0f);
+		basis[7] = 1.092548f * d.x * d.z;
+		basis[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+	}
+
+	// Cosine lobe convolution per band, turns radiance coefficients into irradiance ones
+	const float cosineLobe[IRRADIANCE_SH_COEFFICIENTS] =
+	{
+		XM_PI,
+		2.0f * XM_PI / 3.0f, 2.0f * XM_PI / 3.0f, 2.0f * XM_PI / 3.0f,
+		XM_PI / 4.0f, XM_PI / 4.0f, XM_PI / 4.0f, XM_PI / 4.0f, XM_PI / 4.0f
+	};
+
+	inline float Saturate(float f) { return (std::min)((std::max)(f, 0.0f), 1.0f); }
+}
+
+void IrradianceProbes::Bake(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax, const Light* lights, unsigned int lightCount, const TriangleBVH& occluders, const IrradianceProbeSettings& settings)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// one spacing for every axis, wider if the volume needs more probes than allowed
+	float extent = (std::max)((std::max)(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y), boundsMax.z - boundsMin.z);
+	spacing = (std::max)(settings.spacing, extent / (IRRADIANCE_PROBE_MAX_PER_AXIS - 1));
+	origin = boundsMin;
+	countX = (std::max)(1u, (unsigned int)ceilf((boundsMax.x - boundsMin.x) / spacing) + 1);
+	countY = (std::max)(1u, (unsigned int)ceilf((boundsMax.y - boundsMin.y) / spacing) + 1);
+	countZ = (std::max)(1u, (unsigned int)ceilf((boundsMax.z - boundsMin.z) / spacing) + 1);
+	countX = (std::min)(countX, (unsigned int)IRRADIANCE_PROBE_MAX_PER_AXIS);
+	countY = (std::min)(countY, (unsigned int)IRRADIANCE_PROBE_MAX_PER_AXIS);
+	countZ = (std::min)(countZ, (unsigned int)IRRADIANCE_PROBE_MAX_PER_AXIS);
+
+	probes.assign(countX * countY * countZ, IrradianceSH());
+	workerCount = settings.workerCount > 0 ? settings.workerCount : (std::max)(1u, std::thread::hardware_concurrency());
+
+	// rows of probes handed out as the workers finish, every probe is independent of the others
+	const unsigned int rowCount = countY * countZ;
+	std::atomic<unsigned int> nextRow(0);
+	parallel_for(0u, workerCount, [&](unsigned int)
+	{
+		for (unsigned int row = nextRow++; row < rowCount; row = nextRow++)
+		{
+			for (unsigned int x = 0; x < countX; ++x)
+				BakeProbe(row * countX + x, lights, lightCount, occluders);
+		}
+	}, static_partitioner());
+
+	bakeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Every baked light reaching the probe is a single
+// direction of incoming light, projected into the SH with
+// the falloff from ShaderIncludes.hlsli
+// --------------------------------------------------------
+void IrradianceProbes::BakeProbe(unsigned int index, const Light* lights, unsigned int lightCount, const TriangleBVH& occluders)
+{
+	unsigned int x = index % countX;
+	unsigned int y = (index / countX) % countY;
+	unsigned int z = index / (countX * countY);
+	XMFLOAT3 position(origin.x + x * spacing, origin.y + y * spacing, origin.z + z * spacing);
+
+	XMVECTOR sh[IRRADIANCE_SH_COEFFICIENTS];
+	for (int i = 0; i < IRRADIANCE_SH_COEFFICIENTS; ++i)
+		sh[i] = XMVectorZero();
+
+	for (unsigned int i = 0; i < lightCount; ++i)
+	{
+		const Light& light = lights[i];
+		if (!light.baked)
+			continue;
+
+		XMVECTOR color = XMVectorScale(XMLoadFloat3(&light.color), light.intensity);
+		if (light.type == LIGHT_TYPE_AMBIENT)
+		{
+			// the same light for every normal, only the constant band
+			sh[0] += XMVectorScale(color, 1.0f / 0.282095f);
+			continue;
+		}
+
+		XMFLOAT3 toLight;
+		float distance = IRRADIANCE_PROBE_RAY_DISTANCE;
+		float amount = 1.0f;
+		if (light.type == LIGHT_TYPE_DIR)
+		{
+			XMStoreFloat3(&toLight, XMVector3Normalize(XMVectorNegate(XMLoadFloat3(&light.direction))));
+		}
+		else if (light.type == LIGHT_TYPE_POINT || light.type == LIGHT_TYPE_SPOT)
+		{
+			XMVECTOR offset = XMLoadFloat3(&light.position) - XMLoadFloat3(&position);
+			distance = XMVectorGetX(XMVector3Length(offset));
+			if (distance >= light.range || distance <= 0.0f)
+				continue;
+
+			XMStoreFloat3(&toLight, XMVectorScale(offset, 1.0f / distance));
+			float attenuation = Saturate(1.0f - distance * distance / (light.range * light.range));
+			amount = attenuation * attenuation;
+			if (light.type == LIGHT_TYPE_SPOT)
+				amount *= powf(Saturate(-XMVectorGetX(XMVector3Dot(XMLoadFloat3(&toLight), XMLoadFloat3(&light.direction)))), light.spotFalloff);
+		}
+		else
+		{
+			continue;
+		}
+
+		if (amount <= 0.0f)
+			continue;
+
+		XMFLOAT3 rayOrigin;
+		XMStoreFloat3(&rayOrigin, XMLoadFloat3(&position) + XMVectorScale(XMLoadFloat3(&toLight), IRRADIANCE_PROBE_RAY_BIAS));
+		if (occluders.Occluded(rayOrigin, toLight, distance - 2.0f * IRRADIANCE_PROBE_RAY_BIAS))
+			continue;
+
+		float basis[IRRADIANCE_SH_COEFFICIENTS];
+		ShBasis(toLight, basis);
+		color = XMVectorScale(color, amount);
+		for (int c = 0; c < IRRADIANCE_SH_COEFFICIENTS; ++c)
+			sh[c] += XMVectorScale(color, basis[c] * cosineLobe[c]);
+	}
+
+	IrradianceSH& probe = probes[index];
+	for (int c = 0; c < IRRADIANCE_SH_COEFFICIENTS; ++c)
+		XMStoreFloat4(&probe.coefficients[c], XMVectorSetW(sh[c], 0.0f));
+}
+
+void IrradianceProbes::Sample(const XMFLOAT3& point, IrradianceSH& irradiance) const
+{
+	if (probes.empty())
+	{
+		irradiance = IrradianceSH();
+		return;
+	}
+
+	// grid coordinates clamped to the grid, then the cell and the position in it
+	float gx = (std::min)((std::max)((point.x - origin.x) / spacing, 0.0f), (float)(countX - 1));
+	float gy = (std::min)((std::max)((point.y - origin.y) / spacing, 0.0f), (float)(countY - 1));
+	float gz = (std::min)((std::max)((point.z - origin.z) / spacing, 0.0f), (float)(countZ - 1));
+	unsigned int x0 = (std::min)((unsigned int)gx, countX > 1 ? countX - 2 : 0);
+	unsigned int y0 = (std::min)((unsigned int)gy, countY > 1 ? countY - 2 : 0);
+	unsigned int z0 = (std::min)((unsigned int)gz, countZ > 1 ? countZ - 2 : 0);
+	float fx = gx - x0, fy = gy - y0, fz = gz - z0;
+	unsigned int x1 = (std::min)(x0 + 1, countX - 1);
+	unsigned int y1 = (std::min)(y0 + 1, countY - 1);
+	unsigned int z1 = (std::min)(z0 + 1, countZ - 1);
+
+	const IrradianceSH* corners[8] =
+	{
+		&GetProbe(x0, y0, z0), &GetProbe(x1, y0, z0), &GetProbe(x0, y1, z0), &GetProbe(x1, y1, z0),
+		&GetProbe(x0, y0, z1), &GetProbe(x1, y0, z1), &GetProbe(x0, y1, z1), &GetProbe(x1, y1, z1)
+	};
+	const float weights[8] =
+	{
+		(1 - fx) * (1 - fy) * (1 - fz), fx * (1 - fy) * (1 - fz), (1 - fx) * fy * (1 - fz), fx * fy * (1 - fz),
+		(1 - fx) * (1 - fy) * fz, fx * (1 - fy) * fz, (1 - fx) * fy * fz, fx * fy * fz
+	};
+
+	for (int c = 0; c < IRRADIANCE_SH_COEFFICIENTS; ++c)
+	{
+		XMVECTOR sum = XMVectorZero();
+		for (int i = 0; i < 8; ++i)
+			sum += XMVectorScale(XMLoadFloat4(&corners[i]->coefficients[c]), weights[i]);
+		XMStoreFloat4(&irradiance.coefficients[c], sum);
+	}
+}
+
+XMFLOAT3 IrradianceProbes::Evaluate(const IrradianceSH& irradiance, const XMFLOAT3& normal)
+{
+	float basis[IRRADIANCE_SH_COEFFICIENTS];
+	ShBasis(normal, basis);
+
+	XMVECTOR sum = XMVectorZero();
+	for (int c = 0; c < IRRADIANCE_SH_COEFFICIENTS; ++c)
+		sum += XMVectorScale(XMLoadFloat4(&irradiance.coefficients[c]), basis[c]);
+
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, XMVectorMax(sum, XMVectorZero()));
+	return result;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Lights.h"
+
+class TriangleBVH;
+
+// Probes along each axis at most, the spacing grows for bigger volumes
+#define IRRADIANCE_PROBE_MAX_PER_AXIS 64
+
+struct IrradianceProbeSettings
+{
+	// World units between neighbouring probes
+	float spacing = 1.0f;
+
+	// Threads baking at once, 0 for one per core
+	unsigned int workerCount = 0;
+};
+
+/**
+ * Grid of irradiance probes over a box, for lighting moving objects with
+ * the static lights without looping over them.
+ *
+ * Every probe stores the light of the baked lights reaching its center as
+ * L2 spherical harmonics, already convolved with the cosine lobe, so the
+ * diffuse light for a normal is a dot product with the SH basis (see
+ * ProbeIrradiance() in ShaderIncludes.hlsli). Point, spot and directional
+ * lights use the shader's falloff and a shadow ray through the occluders,
+ * ambient lights go into the constant band. Light bouncing off the
+ * geometry isn't included.
+ *
+ * Sample() blends the eight probes around a point trilinearly, points
+ * outside the grid get the nearest face of it.
+ */
+class IrradianceProbes
+{
+public:
+	IrradianceProbes() = default;
+	~IrradianceProbes() = default;
+
+	// Probes cover boundsMin to boundsMax. Only lights with baked set are used
+	void Bake(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax, const Light* lights, unsigned int lightCount, const TriangleBVH& occluders, const IrradianceProbeSettings& settings);
+
+	// Trilinear blend of the probes around the point. Only reads, any number of threads can sample at once
+	void Sample(const DirectX::XMFLOAT3& point, IrradianceSH& irradiance) const;
+
+	// Diffuse light for a unit normal, the same as ProbeIrradiance() in the shaders
+	static DirectX::XMFLOAT3 Evaluate(const IrradianceSH& irradiance, const DirectX::XMFLOAT3& normal);
+
+	inline bool IsBaked() const { return !probes.empty(); }
+	inline unsigned int GetProbeCount() const { return (unsigned int)probes.size(); }
+	inline unsigned int GetCountX() const { return countX; }
+	inline unsigned int GetCountY() const { return countY; }
+	inline unsigned int GetCountZ() const { return countZ; }
+	inline float GetSpacing() const { return spacing; }
+	inline const IrradianceSH& GetProbe(unsigned int x, unsigned int y, unsigned int z) const { return probes[(z * countY + y) * countX + x]; }
+	inline unsigned int GetWorkerCount() const { return workerCount; }
+	inline double GetBakeMs() const { return bakeMs; }
+
+private:
+	void BakeProbe(unsigned int index, const Light* lights, unsigned int lightCount, const TriangleBVH& occluders);
+
+	DirectX::XMFLOAT3 origin = DirectX::XMFLOAT3(0, 0, 0);	// center of the first probe
+	float spacing = 1.0f;
+	unsigned int countX = 0, countY = 0, countZ = 0;
+
+	// x fastest, then y, then z
+	std::vector<IrradianceSH> probes;
+
+	unsigned int workerCount = 0;
+	double bakeMs = 0;
+};
@@ -0,0 +1,330 @@
+#include "LightClusters.h"
+#include "Lights.h"
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <ppl.h>
+
+using namespace DirectX;
+using namespace Concurrency;
+
+#define LIGHT_CLUSTERS_PER_SLICE (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y)
+
+// Rows are split into whole SIMD groups so a light can skip the columns it can't reach
+static_assert(LIGHT_CLUSTERS_X % 4 == 0, "LIGHT_CLUSTERS_X has to be a multiple of 4");
+
+LightClusters::LightClusters()
+{
+	groups.resize(LIGHT_CLUSTERS_PER_SLICE / 4 * LIGHT_CLUSTERS_Z);
+	sliceDepths.resize(LIGHT_CLUSTERS_Z + 1, 0.0f);
+
+	clusterScratch.resize(GetClusterCount() * MAX_LIGHTS_PER_CLUSTER);
+	clusterCounts.resize(GetClusterCount(), 0);
+	sliceOverflow.resize(LIGHT_CLUSTERS_Z, 0);
+	ranges.resize(GetClusterCount());
+}
+
+// --------------------------------------------------------
+// Near/far come straight out of the LH perspective matrix,
+// so this stays in sync with whatever Camera builds.
+// Each cluster's box is the 8 corners of its tile at the
+// slice's near and far depth.
+// --------------------------------------------------------
+void LightClusters::SetProjection(const XMFLOAT4X4& proj, unsigned int screenWidth, unsigned int screenHeight)
+{
+	float nearClip = -proj._43 / proj._33;
+	float farClip = proj._43 / (1.0f - proj._33);
+	float split = LIGHT_CLUSTER_NEAR_SPLIT;
+
+	// tiles are whole pixels, the last column/row may reach past the screen
+	this->screenWidth = (float)screenWidth;
+	this->screenHeight = (float)screenHeight;
+	projScaleX = proj._11;
+	projScaleY = proj._22;
+	tileWidth = ceilf((float)screenWidth / LIGHT_CLUSTERS_X);
+	tileHeight = ceilf((float)screenHeight / LIGHT_CLUSTERS_Y);
+	depthScale = (LIGHT_CLUSTERS_Z - 1) / logf(farClip / split);
+
+	sliceDepths[0] = nearClip < split ? nearClip : split;
+	for (unsigned int s = 1; s <= LIGHT_CLUSTERS_Z; ++s)
+		sliceDepths[s] = split * powf(farClip / split, (float)(s - 1) / (LIGHT_CLUSTERS_Z - 1));
+
+	for (unsigned int s = 0; s < LIGHT_CLUSTERS_Z; ++s)
+	{
+		for (unsigned int g = 0; g < LIGHT_CLUSTERS_PER_SLICE / 4; ++g)
+		{
+			XMFLOAT3 boxMin[4];
+			XMFLOAT3 boxMax[4];
+
+			for (unsigned int lane = 0; lane < 4; ++lane)
+			{
+				unsigned int tile = g * 4 + lane;
+
+				float ndcLeft = ((tile % LIGHT_CLUSTERS_X) * tileWidth) / screenWidth * 2.0f - 1.0f;
+				float ndcRight = ((tile % LIGHT_CLUSTERS_X + 1) * tileWidth) / screenWidth * 2.0f - 1.0f;
+				float ndcTop = 1.0f - ((tile / LIGHT_CLUSTERS_X) * tileHeight) / screenHeight * 2.0f;
+				float ndcBottom = 1.0f - ((tile / LIGHT_CLUSTERS_X + 1) * tileHeight) / screenHeight * 2.0f;
+
+				boxMin[lane] = XMFLOAT3(FLT_MAX, FLT_MAX, sliceDepths[s]);
+				boxMax[lane] = XMFLOAT3(-FLT_MAX, -FLT_MAX, sliceDepths[s + 1]);
+				for (float depth : { sliceDepths[s], sliceDepths[s + 1] })
+				{
+					for (float ndcX : { ndcLeft, ndcRight })
+					{
+						float x = ndcX * depth / proj._11;
+						boxMin[lane].x = x < boxMin[lane].x ? x : boxMin[lane].x;
+						boxMax[lane].x = x > boxMax[lane].x ? x : boxMax[lane].x;
+					}
+					for (float ndcY : { ndcTop, ndcBottom })
+					{
+						float y = ndcY * depth / proj._22;
+						boxMin[lane].y = y < boxMin[lane].y ? y : boxMin[lane].y;
+						boxMax[lane].y = y > boxMax[lane].y ? y : boxMax[lane].y;
+					}
+				}
+			}
+
+			ClusterGroup& group = groups[s * LIGHT_CLUSTERS_PER_SLICE / 4 + g];
+			group.minX = XMVectorSet(boxMin[0].x, boxMin[1].x, boxMin[2].x, boxMin[3].x);
+			group.minY = XMVectorSet(boxMin[0].y, boxMin[1].y, boxMin[2].y, boxMin[3].y);
+			group.minZ = XMVectorSet(boxMin[0].z, boxMin[1].z, boxMin[2].z, boxMin[3].z);
+			group.maxX = XMVectorSet(boxMax[0].x, boxMax[1].x, boxMax[2].x, boxMax[3].x);
+			group.maxY = XMVectorSet(boxMax[0].y, boxMax[1].y, boxMax[2].y, boxMax[3].y);
+			group.maxZ = XMVectorSet(boxMax[0].z, boxMax[1].z, boxMax[2].z, boxMax[3].z);
+
+			// bounding spheres of the boxes, used by the spot cone test
+			XMVECTOR halfX = XMVectorScale(XMVectorSubtract(group.maxX, group.minX), 0.5f);
+			XMVECTOR halfY = XMVectorScale(XMVectorSubtract(group.maxY, group.minY), 0.5f);
+			XMVECTOR halfZ = XMVectorScale(XMVectorSubtract(group.maxZ, group.minZ), 0.5f);
+			group.centerX = XMVectorAdd(group.minX, halfX);
+			group.centerY = XMVectorAdd(group.minY, halfY);
+			group.centerZ = XMVectorAdd(group.minZ, halfZ);
+			group.radius = XMVectorSqrt(XMVectorMultiplyAdd(halfX, halfX, XMVectorMultiplyAdd(halfY, halfY, XMVectorMultiply(halfZ, halfZ))));
+		}
+	}
+}
+
+void LightClusters::Assign(const Light* lights, unsigned int lightCount, const XMFLOAT4X4& view)
+{
+	// cluster lists store 16 bit light indices
+	assert(lightCount <= 0xffff);
+
+	XMMATRIX viewMatrix = XMLoadFloat4x4(&view);
+
+	clusterLights.clear();
+	globalLights.clear();
+	for (unsigned int i = 0; i < lightCount; ++i)
+	{
+		const Light& light = lights[i];
+		if (light.type == LIGHT_TYPE_DIR || light.type == LIGHT_TYPE_AMBIENT)
+		{
+			globalLights.push_back(i);
+			continue;
+		}
+
+		if (light.range <= 0.0f)
+			continue;
+
+		ClusterLight clusterLight = {};
+		XMStoreFloat3(&clusterLight.position, XMVector3TransformCoord(XMLoadFloat3(&light.position), viewMatrix));
+		clusterLight.range = light.range;
+		clusterLight.index = i;
+		clusterLight.spot = light.type == LIGHT_TYPE_SPOT;
+
+		if (clusterLight.spot)
+		{
+			XMStoreFloat3(&clusterLight.direction, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&light.direction), viewMatrix)));
+
+			clusterLight.cosAngle = SpotCutoffCos(light);
+			clusterLight.sinAngle = sqrtf(1.0f - clusterLight.cosAngle * clusterLight.cosAngle);
+		}
+
+		clusterLights.push_back(clusterLight);
+	}
+
+	// every slice owns its clusters, so no two workers touch the same list
+	parallel_for(0u, (unsigned int)LIGHT_CLUSTERS_Z, [&](unsigned int slice)
+	{
+		AssignSlice(slice);
+	});
+
+	BuildIndexList();
+}
+
+unsigned int LightClusters::FindCluster(float pixelX, float pixelY, float viewDepth) const
+{
+	unsigned int x = TileIndex(pixelX, tileWidth, LIGHT_CLUSTERS_X);
+	unsigned int y = TileIndex(pixelY, tileHeight, LIGHT_CLUSTERS_Y);
+	unsigned int z = viewDepth < LIGHT_CLUSTER_NEAR_SPLIT ? 0 : 1 + (unsigned int)(logf(viewDepth / LIGHT_CLUSTER_NEAR_SPLIT) * depthScale);
+
+	z = z < LIGHT_CLUSTERS_Z - 1 ? z : LIGHT_CLUSTERS_Z - 1;
+	return (z * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + x;
+}
+
+unsigned int LightClusters::TileIndex(float pixel, float tileSize, unsigned int tileCount)
+{
+	if (pixel <= 0.0f)
+		return 0;
+
+	unsigned int tile = (unsigned int)(pixel / tileSize);
+	return tile < tileCount - 1 ? tile : tileCount - 1;
+}
+
+// --------------------------------------------------------
+// Tests every light overlapping the slice's depth range
+// against the slice's clusters, four at a time:
+//  - sphere vs box for point and spot lights
+//  - cone vs the cluster's bounding sphere for spot lights
+// --------------------------------------------------------
+void LightClusters::AssignSlice(unsigned int slice)
+{
+	float sliceNear = sliceDepths[slice];
+	float sliceFar = sliceDepths[slice + 1];
+	unsigned int firstCluster = slice * LIGHT_CLUSTERS_PER_SLICE;
+	const ClusterGroup* sliceGroups = &groups[slice * LIGHT_CLUSTERS_PER_SLICE / 4];
+
+	// global lights are placed in front of each list later
+	unsigned int globalCount = (unsigned int)globalLights.size();
+	unsigned int capacity = globalCount < MAX_LIGHTS_PER_CLUSTER ? MAX_LIGHTS_PER_CLUSTER - globalCount : 0;
+
+	unsigned int* counts = &clusterCounts[firstCluster];
+	for (unsigned int c = 0; c < LIGHT_CLUSTERS_PER_SLICE; ++c)
+		counts[c] = 0;
+	unsigned int overflow = 0;
+
+	XMVECTOR zero = XMVectorZero();
+	for (const ClusterLight& light : clusterLights)
+	{
+		if (light.position.z + light.range < sliceNear || light.position.z - light.range > sliceFar)
+			continue;
+
+		// screen rectangle the sphere can cover within this slice, x/depth is extreme at the depth limits
+		float nearDepth = light.position.z - light.range > sliceNear ? light.position.z - light.range : sliceNear;
+		float farDepth = light.position.z + light.range < sliceFar ? light.position.z + light.range : sliceFar;
+		float ndcMinX = FLT_MAX, ndcMaxX = -FLT_MAX, ndcMinY = FLT_MAX, ndcMaxY = -FLT_MAX;
+		for (float depth : { nearDepth, farDepth })
+		{
+			for (float x : { light.position.x - light.range, light.position.x + light.range })
+			{
+				float ndc = x * projScaleX / depth;
+				ndcMinX = ndc < ndcMinX ? ndc : ndcMinX;
+				ndcMaxX = ndc > ndcMaxX ? ndc : ndcMaxX;
+			}
+			for (float y : { light.position.y - light.range, light.position.y + light.range })
+			{
+				float ndc = y * projScaleY / depth;
+				ndcMinY = ndc < ndcMinY ? ndc : ndcMinY;
+				ndcMaxY = ndc > ndcMaxY ? ndc : ndcMaxY;
+			}
+		}
+
+		if (ndcMaxX < -1.0f || ndcMinX > 1.0f || ndcMaxY < -1.0f || ndcMinY > 1.0f)
+			continue;
+
+		unsigned int firstColumn = TileIndex((ndcMinX + 1.0f) * 0.5f * screenWidth, tileWidth, LIGHT_CLUSTERS_X);
+		unsigned int lastColumn = TileIndex((ndcMaxX + 1.0f) * 0.5f * screenWidth, tileWidth, LIGHT_CLUSTERS_X);
+		unsigned int firstRow = TileIndex((1.0f - ndcMaxY) * 0.5f * screenHeight, tileHeight, LIGHT_CLUSTERS_Y);
+		unsigned int lastRow = TileIndex((1.0f - ndcMinY) * 0.5f * screenHeight, tileHeight, LIGHT_CLUSTERS_Y);
+
+		XMVECTOR lightX = XMVectorReplicate(light.position.x);
+		XMVECTOR lightY = XMVectorReplicate(light.position.y);
+		XMVECTOR lightZ = XMVectorReplicate(light.position.z);
+		XMVECTOR range = XMVectorReplicate(light.range);
+		XMVECTOR rangeSq = XMVectorMultiply(range, range);
+
+		XMVECTOR dirX = XMVectorReplicate(light.direction.x);
+		XMVECTOR dirY = XMVectorReplicate(light.direction.y);
+		XMVECTOR dirZ = XMVectorReplicate(light.direction.z);
+		XMVECTOR cosAngle = XMVectorReplicate(light.cosAngle);
+		XMVECTOR sinAngle = XMVectorReplicate(light.sinAngle);
+
+		for (unsigned int row = firstRow; row <= lastRow; ++row)
+		{
+			unsigned int lastGroup = (row * LIGHT_CLUSTERS_X + lastColumn) / 4;
+			for (unsigned int g = (row * LIGHT_CLUSTERS_X + firstColumn) / 4; g <= lastGroup; ++g)
+			{
+				const ClusterGroup& group = sliceGroups[g];
+
+				// distance from the light to the closest point of each box
+				XMVECTOR dx = XMVectorMax(XMVectorMax(XMVectorSubtract(group.minX, lightX), XMVectorSubtract(lightX, group.maxX)), zero);
+				XMVECTOR dy = XMVectorMax(XMVectorMax(XMVectorSubtract(group.minY, lightY), XMVectorSubtract(lightY, group.maxY)), zero);
+				XMVECTOR dz = XMVectorMax(XMVectorMax(XMVectorSubtract(group.minZ, lightZ), XMVectorSubtract(lightZ, group.maxZ)), zero);
+				XMVECTOR distSq = XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz)));
+				XMVECTOR hit = XMVectorLessOrEqual(distSq, rangeSq);
+
+				if (light.spot)
+				{
+					XMVECTOR vx = XMVectorSubtract(group.centerX, lightX);
+					XMVECTOR vy = XMVectorSubtract(group.centerY, lightY);
+					XMVECTOR vz = XMVectorSubtract(group.centerZ, lightZ);
+					XMVECTOR lengthSq = XMVectorMultiplyAdd(vx, vx, XMVectorMultiplyAdd(vy, vy, XMVectorMultiply(vz, vz)));
+					XMVECTOR alongAxis = XMVectorMultiplyAdd(vx, dirX, XMVectorMultiplyAdd(vy, dirY, XMVectorMultiply(vz, dirZ)));
+
+					// distance from the sphere center to the cone's surface
+					XMVECTOR offAxis = XMVectorSqrt(XMVectorMax(XMVectorSubtract(lengthSq, XMVectorMultiply(alongAxis, alongAxis)), zero));
+					XMVECTOR toCone = XMVectorSubtract(XMVectorMultiply(cosAngle, offAxis), XMVectorMultiply(alongAxis, sinAngle));
+
+					XMVECTOR outsideAngle = XMVectorGreater(toCone, group.radius);
+					XMVECTOR pastRange = XMVectorGreater(alongAxis, XMVectorAdd(group.radius, range));
+					XMVECTOR behind = XMVectorLess(alongAxis, XMVectorNegate(group.radius));
+					hit = XMVectorAndCInt(hit, XMVectorOrInt(outsideAngle, XMVectorOrInt(pastRange, behind)));
+				}
+
+				uint32_t lanes[4];
+				XMStoreInt4(lanes, hit);
+				for (unsigned int lane = 0; lane < 4; ++lane)
+				{
+					unsigned int tile = g * 4 + lane;
+					if (!lanes[lane])
+						continue;
+
+					if (counts[tile] >= capacity)
+					{
+						overflow++;
+						continue;
+					}
+
+					clusterScratch[(firstCluster + tile) * MAX_LIGHTS_PER_CLUSTER + counts[tile]++] = (unsigned short)light.index;
+				}
+			}
+		}
+	}
+
+	sliceOverflow[slice] = overflow;
+}
+
+void LightClusters::BuildIndexList()
+{
+	unsigned int clusterCount = GetClusterCount();
+	unsigned int globalCount = (unsigned int)globalLights.size();
+	overflowCount = 0;
+	if (globalCount > MAX_LIGHTS_PER_CLUSTER)
+	{
+		overflowCount += (globalCount - MAX_LIGHTS_PER_CLUSTER) * clusterCount;
+		globalCount = MAX_LIGHTS_PER_CLUSTER;
+	}
+
+	for (unsigned int overflow : sliceOverflow)
+		overflowCount += overflow;
+
+	unsigned int total = 0;
+	for (unsigned int c = 0; c < clusterCount; ++c)
+	{
+		ranges[c].offset = total;
+		ranges[c].count = globalCount + clusterCounts[c];
+		total += ranges[c].count;
+	}
+
+	indices.resize(total);
+	for (unsigned int c = 0; c < clusterCount; ++c)
+	{
+		unsigned int* list = &indices[ranges[c].offset];
+		for (unsigned int i = 0; i < globalCount; ++i)
+			*list++ = globalLights[i];
+
+		const unsigned short* scratch = &clusterScratch[c * MAX_LIGHTS_PER_CLUSTER];
+		for (unsigned int i = 0; i < clusterCounts[c]; ++i)
+			*list++ = scratch[i];
+	}
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// Cluster grid: screen tiles in x/y, exponential depth slices in z
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+
+// Slice 0 covers everything closer than this, the other slices split the rest exponentially
+#define LIGHT_CLUSTER_NEAR_SPLIT 0.5f
+
+// Lights past this in a single cluster are dropped (and counted as overflow)
+#define MAX_LIGHTS_PER_CLUSTER 256
+
+// Pixel shader registers of the cluster ranges and the light index list
+#define LIGHT_CLUSTER_RANGE_SLOT 4
+#define LIGHT_CLUSTER_INDEX_SLOT 5
+
+struct Light;
+
+// Where a cluster's lights are in the index list, uint2 in the shader
+struct LightClusterRange
+{
+	unsigned int offset;
+	unsigned int count;
+};
+
+/**
+ * Clustered forward light assignment.
+ *
+ * The view frustum is split into LIGHT_CLUSTERS_X * Y * Z clusters, each
+ * with a view space bounding box. Every frame the point and spot lights
+ * are tested against the clusters of the depth slices they overlap, four
+ * clusters at a time, and the result is flattened into one index list plus
+ * an (offset, count) range per cluster that the pixel shaders look up.
+ *
+ * Directional and ambient lights affect everything and are put at the
+ * front of every cluster's list. Slices are assigned in parallel since
+ * each one owns its clusters.
+ */
+class LightClusters
+{
+public:
+	LightClusters();
+	~LightClusters() = default;
+
+	// Rebuilds the cluster bounds. Needed whenever the projection or screen size changes
+	void SetProjection(const DirectX::XMFLOAT4X4& proj, unsigned int screenWidth, unsigned int screenHeight);
+
+	// Assigns the lights (world space) to every cluster they can touch
+	void Assign(const Light* lights, unsigned int lightCount, const DirectX::XMFLOAT4X4& view);
+
+	// Cluster a pixel (render target coordinates) at the given view depth falls into, same math as the shaders
+	unsigned int FindCluster(float pixelX, float pixelY, float viewDepth) const;
+
+	inline const std::vector<LightClusterRange>& GetRanges() const { return ranges; }
+	inline const std::vector<unsigned int>& GetIndices() const { return indices; }
+	inline unsigned int GetClusterCount() const { return LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z; }
+
+	// Shader constants for FindCluster()
+	inline float GetTileWidth() const { return tileWidth; }
+	inline float GetTileHeight() const { return tileHeight; }
+	inline float GetDepthScale() const { return depthScale; }
+
+	// Light/cluster pairs that didn't fit into MAX_LIGHTS_PER_CLUSTER during the last Assign()
+	inline unsigned int GetOverflowCount() const { return overflowCount; }
+
+private:
+	// Bounds of four clusters next to each other in a slice, in SoA form for the SIMD tests
+	struct ClusterGroup
+	{
+		DirectX::XMVECTOR minX, minY, minZ;
+		DirectX::XMVECTOR maxX, maxY, maxZ;
+		DirectX::XMVECTOR centerX, centerY, centerZ, radius;
+	};
+
+	// A point or spot light moved to view space
+	struct ClusterLight
+	{
+		DirectX::XMFLOAT3 position;
+		float range;
+		DirectX::XMFLOAT3 direction;
+		float cosAngle;
+		float sinAngle;
+		unsigned int index;
+		bool spot;
+	};
+
+	void AssignSlice(unsigned int slice);
+	void BuildIndexList();
+
+	// Pixel coordinate to tile, clamped to the grid
+	static unsigned int TileIndex(float pixel, float tileSize, unsigned int tileCount);
+
+	float screenWidth = 0;
+	float screenHeight = 0;
+	float projScaleX = 0;
+	float projScaleY = 0;
+	float tileWidth = 0;
+	float tileHeight = 0;
+	float depthScale = 0;
+
+	// LIGHT_CLUSTERS_Z + 1 view depths, slice s spans [sliceDepths[s], sliceDepths[s + 1]]
+	std::vector<float> sliceDepths;
+
+	// LIGHT_CLUSTERS_X / 4 groups per row, row by row, slice by slice
+	std::vector<ClusterGroup> groups;
+
+	std::vector<ClusterLight> clusterLights;
+	std::vector<unsigned int> globalLights;
+
+	// Per cluster light lists before they are flattened, MAX_LIGHTS_PER_CLUSTER entries each
+	std::vector<unsigned short> clusterScratch;
+	std::vector<unsigned int> clusterCounts;
+	std::vector<unsigned int> sliceOverflow;
+
+	std::vector<LightClusterRange> ranges;
+	std::vector<unsigned int> indices;
+	unsigned int overflowCount = 0;
+};
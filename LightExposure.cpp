@@ -0,0 +1,224 @@
+#include "LightExposure.h"
+#include <algorithm>
+#include <cstdint>
+
+using namespace DirectX;
+
+namespace
+{
+	// Four lights, or one light replicated four times, for the shared kernel
+	struct LightLanes
+	{
+		XMVECTOR positionX, positionY, positionZ;
+		XMVECTOR inverseRangeSq;
+		XMVECTOR directionX, directionY, directionZ;
+		XMVECTOR falloff;
+		XMVECTOR weight;
+		XMVECTOR spotMask;
+	};
+
+	// Exposure from each light lane at each point lane
+	inline XMVECTOR Contribution(const LightLanes& light, XMVECTOR pointX, XMVECTOR pointY, XMVECTOR pointZ)
+	{
+		XMVECTOR x = XMVectorSubtract(pointX, light.positionX);
+		XMVECTOR y = XMVectorSubtract(pointY, light.positionY);
+		XMVECTOR z = XMVectorSubtract(pointZ, light.positionZ);
+		XMVECTOR distSq = XMVectorMultiplyAdd(x, x, XMVectorMultiplyAdd(y, y, XMVectorMultiply(z, z)));
+
+		// Attenuate() from ShaderIncludes.hlsli
+		XMVECTOR attenuation = XMVectorSaturate(XMVectorSubtract(XMVectorSplatOne(), XMVectorMultiply(distSq, light.inverseRangeSq)));
+		attenuation = XMVectorMultiply(attenuation, attenuation);
+
+		// pow(saturate(dot(normalize(point - light), direction)), falloff) as exp2(falloff * log2(cos)).
+		// A point right on a spot light gets cos 0 and no light
+		XMVECTOR along = XMVectorMultiplyAdd(x, light.directionX, XMVectorMultiplyAdd(y, light.directionY, XMVectorMultiply(z, light.directionZ)));
+		XMVECTOR cosAngle = XMVectorSaturate(XMVectorMultiply(along, XMVectorReciprocalSqrt(XMVectorMax(distSq, XMVectorReplicate(1e-12f)))));
+		XMVECTOR penumbra = XMVectorExp2(XMVectorMultiply(light.falloff, XMVectorLog2(cosAngle)));
+		penumbra = XMVectorSelect(XMVectorSplatOne(), penumbra, light.spotMask);
+
+		return XMVectorMultiply(XMVectorMultiply(attenuation, penumbra), light.weight);
+	}
+}
+
+void LightExposure::SetLights(const Light* lights, unsigned int lightCount)
+{
+	positionX.clear(); positionY.clear(); positionZ.clear();
+	range.clear();
+	inverseRangeSq.clear();
+	directionX.clear(); directionY.clear(); directionZ.clear();
+	falloff.clear();
+	weight.clear();
+	spotMask.clear();
+	slots.assign(lightCount, -1);
+
+	for (unsigned int i = 0; i < lightCount; ++i)
+	{
+		const Light& light = lights[i];
+		if ((light.type != LIGHT_TYPE_POINT && light.type != LIGHT_TYPE_SPOT) || light.range <= 0.0f)
+			continue;
+
+		slots[i] = (int)positionX.size();
+		positionX.push_back(light.position.x);
+		positionY.push_back(light.position.y);
+		positionZ.push_back(light.position.z);
+		range.push_back(light.range);
+		inverseRangeSq.push_back(1.0f / (light.range * light.range));
+		directionX.push_back(light.direction.x);
+		directionY.push_back(light.direction.y);
+		directionZ.push_back(light.direction.z);
+
+		// A zero falloff would turn log2(0) into 0 * -inf, any cone direction passes with it anyway
+		falloff.push_back((std::max)(light.spotFalloff, 1e-6f));
+		weight.push_back(light.intensity * (light.color.x * 0.299f + light.color.y * 0.587f + light.color.z * 0.114f));
+		spotMask.push_back(light.type == LIGHT_TYPE_SPOT ? 0xFFFFFFFF : 0);
+	}
+
+	// Padding lights sit far away with zero weight
+	while (positionX.size() % 4 != 0)
+	{
+		positionX.push_back(1e30f);
+		positionY.push_back(1e30f);
+		positionZ.push_back(1e30f);
+		range.push_back(0.0f);
+		inverseRangeSq.push_back(1.0f);
+		directionX.push_back(0.0f);
+		directionY.push_back(0.0f);
+		directionZ.push_back(1.0f);
+		falloff.push_back(1.0f);
+		weight.push_back(0.0f);
+		spotMask.push_back(0);
+	}
+}
+
+// --------------------------------------------------------
+// Four points at a time. Every group of four lights is first
+// tested against the box around the four points so the kernel
+// only runs for lights that can reach at least one of them
+// --------------------------------------------------------
+void LightExposure::Evaluate(const XMFLOAT3* points, size_t pointCount, float* exposures) const
+{
+	const size_t lightCount = positionX.size();
+	const XMVECTOR zero = XMVectorZero();
+
+	for (size_t first = 0; first < pointCount; first += 4)
+	{
+		// Short batches repeat the last point
+		XMFLOAT3 lanes[4];
+		for (size_t lane = 0; lane < 4; ++lane)
+			lanes[lane] = points[(std::min)(first + lane, pointCount - 1)];
+
+		XMVECTOR pointX = XMVectorSet(lanes[0].x, lanes[1].x, lanes[2].x, lanes[3].x);
+		XMVECTOR pointY = XMVectorSet(lanes[0].y, lanes[1].y, lanes[2].y, lanes[3].y);
+		XMVECTOR pointZ = XMVectorSet(lanes[0].z, lanes[1].z, lanes[2].z, lanes[3].z);
+
+		float boxMin[3] = { lanes[0].x, lanes[0].y, lanes[0].z };
+		float boxMax[3] = { lanes[0].x, lanes[0].y, lanes[0].z };
+		for (size_t lane = 1; lane < 4; ++lane)
+		{
+			boxMin[0] = (std::min)(boxMin[0], lanes[lane].x); boxMax[0] = (std::max)(boxMax[0], lanes[lane].x);
+			boxMin[1] = (std::min)(boxMin[1], lanes[lane].y); boxMax[1] = (std::max)(boxMax[1], lanes[lane].y);
+			boxMin[2] = (std::min)(boxMin[2], lanes[lane].z); boxMax[2] = (std::max)(boxMax[2], lanes[lane].z);
+		}
+		XMVECTOR minX = XMVectorReplicate(boxMin[0]), minY = XMVectorReplicate(boxMin[1]), minZ = XMVectorReplicate(boxMin[2]);
+		XMVECTOR maxX = XMVectorReplicate(boxMax[0]), maxY = XMVectorReplicate(boxMax[1]), maxZ = XMVectorReplicate(boxMax[2]);
+
+		XMVECTOR exposure = zero;
+		for (size_t group = 0; group < lightCount; group += 4)
+		{
+			// squared distance from each light to the box, against its range
+			XMVECTOR lightX = XMLoadFloat4((const XMFLOAT4*)&positionX[group]);
+			XMVECTOR lightY = XMLoadFloat4((const XMFLOAT4*)&positionY[group]);
+			XMVECTOR lightZ = XMLoadFloat4((const XMFLOAT4*)&positionZ[group]);
+			XMVECTOR lightRange = XMLoadFloat4((const XMFLOAT4*)&range[group]);
+			XMVECTOR dx = XMVectorMax(XMVectorMax(XMVectorSubtract(minX, lightX), XMVectorSubtract(lightX, maxX)), zero);
+			XMVECTOR dy = XMVectorMax(XMVectorMax(XMVectorSubtract(minY, lightY), XMVectorSubtract(lightY, maxY)), zero);
+			XMVECTOR dz = XMVectorMax(XMVectorMax(XMVectorSubtract(minZ, lightZ), XMVectorSubtract(lightZ, maxZ)), zero);
+			XMVECTOR distSq = XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz)));
+
+			uint32_t reaches[4];
+			XMStoreInt4(reaches, XMVectorLess(distSq, XMVectorMultiply(lightRange, lightRange)));
+			for (size_t lane = 0; lane < 4; ++lane)
+			{
+				if (!reaches[lane])
+					continue;
+
+				size_t l = group + lane;
+				LightLanes light;
+				light.positionX = XMVectorReplicatePtr(&positionX[l]);
+				light.positionY = XMVectorReplicatePtr(&positionY[l]);
+				light.positionZ = XMVectorReplicatePtr(&positionZ[l]);
+				light.inverseRangeSq = XMVectorReplicatePtr(&inverseRangeSq[l]);
+				light.directionX = XMVectorReplicatePtr(&directionX[l]);
+				light.directionY = XMVectorReplicatePtr(&directionY[l]);
+				light.directionZ = XMVectorReplicatePtr(&directionZ[l]);
+				light.falloff = XMVectorReplicatePtr(&falloff[l]);
+				light.weight = XMVectorReplicatePtr(&weight[l]);
+				light.spotMask = XMVectorReplicateInt(spotMask[l]);
+				exposure = XMVectorAdd(exposure, Contribution(light, pointX, pointY, pointZ));
+			}
+		}
+
+		float results[4];
+		XMStoreFloat4((XMFLOAT4*)results, exposure);
+		for (size_t lane = 0; lane < 4 && first + lane < pointCount; ++lane)
+			exposures[first + lane] = results[lane];
+	}
+}
+
+float LightExposure::Evaluate(const XMFLOAT3& point, const unsigned int* lightIndices, unsigned int indexCount) const
+{
+	XMVECTOR pointX = XMVectorReplicate(point.x);
+	XMVECTOR pointY = XMVectorReplicate(point.y);
+	XMVECTOR pointZ = XMVectorReplicate(point.z);
+	XMVECTOR exposure = XMVectorZero();
+
+	// Gather four candidates at a time, directional/ambient and missing lanes get a zero weight
+	for (unsigned int first = 0; first < indexCount; first += 4)
+	{
+		float lanes[9][4] = {};
+		uint32_t spot[4] = {};
+		for (unsigned int lane = 0; lane < 4; ++lane)
+		{
+			int slot = first + lane < indexCount ? slots[lightIndices[first + lane]] : -1;
+			if (slot < 0)
+			{
+				lanes[3][lane] = 1.0f;
+				lanes[7][lane] = 1.0f;
+				continue;
+			}
+
+			lanes[0][lane] = positionX[slot];
+			lanes[1][lane] = positionY[slot];
+			lanes[2][lane] = positionZ[slot];
+			lanes[3][lane] = inverseRangeSq[slot];
+			lanes[4][lane] = directionX[slot];
+			lanes[5][lane] = directionY[slot];
+			lanes[6][lane] = directionZ[slot];
+			lanes[7][lane] = falloff[slot];
+			lanes[8][lane] = weight[slot];
+			spot[lane] = spotMask[slot];
+		}
+
+		LightLanes light;
+		light.positionX = XMLoadFloat4((const XMFLOAT4*)lanes[0]);
+		light.positionY = XMLoadFloat4((const XMFLOAT4*)lanes[1]);
+		light.positionZ = XMLoadFloat4((const XMFLOAT4*)lanes[2]);
+		light.inverseRangeSq = XMLoadFloat4((const XMFLOAT4*)lanes[3]);
+		light.directionX = XMLoadFloat4((const XMFLOAT4*)lanes[4]);
+		light.directionY = XMLoadFloat4((const XMFLOAT4*)lanes[5]);
+		light.directionZ = XMLoadFloat4((const XMFLOAT4*)lanes[6]);
+		light.falloff = XMLoadFloat4((const XMFLOAT4*)lanes[7]);
+		light.weight = XMLoadFloat4((const XMFLOAT4*)lanes[8]);
+		light.spotMask = XMLoadInt4(spot);
+		exposure = XMVectorAdd(exposure, Contribution(light, pointX, pointY, pointZ));
+	}
+
+	XMFLOAT4 sums;
+	XMStoreFloat4(&sums, exposure);
+	return sums.x + sums.y + sums.z + sums.w;
+}
+
+float LightExposure::Visibility(float exposure)
+{
+	return (std::min)((std::max)(exposure / LIGHT_EXPOSURE_LIT, 0.0f), 1.0f);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Lights.h"
+
+// Exposure at which a point counts as fully lit, about standing next to one of the level's point lights
+#define LIGHT_EXPOSURE_LIT 1.0f
+
+/**
+ * How much light reaches arbitrary points, for stealth checks.
+ *
+ * The exposure of a point is the sum over the point and spot lights of
+ * intensity * luminance * Attenuate() * the spot penumbra, the falloff
+ * ShaderIncludes.hlsli lights surfaces with minus the surface terms.
+ * Directional and ambient lights light everything the same and are left
+ * out, so an unlit corner reads 0.
+ *
+ * SetLights() repacks the lights into SoA arrays. The batch Evaluate()
+ * runs four points at a time against every light that can reach the
+ * box around the four, so it wants neighbouring points next to each other
+ * (sample grids, paths). The candidate Evaluate() runs four lights at a
+ * time for a single point, meant for the lights a LightSpatialIndex query
+ * returned.
+ */
+class LightExposure
+{
+public:
+	LightExposure() = default;
+	~LightExposure() = default;
+
+	// Copies what the evaluation needs, call again when lights change
+	void SetLights(const Light* lights, unsigned int lightCount);
+
+	// Exposure of every point, checking every light. Only reads, so batches can run in parallel
+	void Evaluate(const DirectX::XMFLOAT3* points, size_t pointCount, float* exposures) const;
+
+	// Exposure of one point from the given lights (indices into the SetLights() array)
+	float Evaluate(const DirectX::XMFLOAT3& point, const unsigned int* lightIndices, unsigned int indexCount) const;
+
+	// Exposure remapped to [0, 1], 1 at LIGHT_EXPOSURE_LIT and above
+	static float Visibility(float exposure);
+
+	inline unsigned int GetLightCount() const { return (unsigned int)positionX.size(); }
+
+private:
+	// Point and spot lights in SoA form, padded to a multiple of four with zero weight lights
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> range;
+	std::vector<float> inverseRangeSq;
+	std::vector<float> directionX, directionY, directionZ;
+	std::vector<float> falloff;
+	std::vector<float> weight;	// intensity * luminance
+	std::vector<unsigned int> spotMask;
+
+	// SoA slot of every light given to SetLights(), -1 for directional and ambient lights
+	std::vector<int> slots;
+};
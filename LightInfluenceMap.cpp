@@ -0,0 +1,311 @@
+#include "LightInfluenceMap.h"
+#include "TriangleBVH.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <ppl.h>
+#include <thread>
+
+using namespace DirectX;
+using namespace Concurrency;
+
+// Shadow rays start this far from the node, and stop this far short of the light
+#define LIGHT_INFLUENCE_RAY_BIAS 0.01f
+
+namespace
+{
+	inline bool IsLocal(const Light& light)
+	{
+		return (light.type == LIGHT_TYPE_POINT || light.type == LIGHT_TYPE_SPOT) && light.range > 0.0f;
+	}
+
+	// Anything the exposure depends on changed, pad and baked aside. Moving and turning only count past the tolerance
+	inline bool Changed(const Light& before, const Light& now, float tolerance)
+	{
+		if (before.type != now.type || before.range != now.range || before.intensity != now.intensity || before.spotFalloff != now.spotFalloff ||
+			before.color.x != now.color.x || before.color.y != now.color.y || before.color.z != now.color.z)
+			return true;
+
+		XMVECTOR moved = XMLoadFloat3(&now.position) - XMLoadFloat3(&before.position);
+		XMVECTOR turned = XMLoadFloat3(&now.direction) - XMLoadFloat3(&before.direction);
+		float toleranceSq = tolerance * tolerance;
+		return XMVectorGetX(XMVector3LengthSq(moved)) > toleranceSq ||
+			(now.type == LIGHT_TYPE_SPOT && XMVectorGetX(XMVector3LengthSq(turned)) * now.range * now.range > toleranceSq);
+	}
+}
+
+void LightInfluenceMap::Bake(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax, const Light* lights, unsigned int lightCount,
+	const TriangleBVH* occluders, const LightInfluenceSettings& settings)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// one spacing for every axis, wider if the volume needs more nodes than allowed
+	float extent = (std::max)((std::max)(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y), boundsMax.z - boundsMin.z);
+	spacing = (std::max)(settings.spacing, extent / (LIGHT_INFLUENCE_MAX_PER_AXIS - 1));
+	origin = boundsMin;
+	moveTolerance = settings.moveTolerance;
+	countX = (std::min)((std::max)(1u, (unsigned int)ceilf((boundsMax.x - boundsMin.x) / spacing) + 1), (unsigned int)LIGHT_INFLUENCE_MAX_PER_AXIS);
+	countY = (std::min)((std::max)(1u, (unsigned int)ceilf((boundsMax.y - boundsMin.y) / spacing) + 1), (unsigned int)LIGHT_INFLUENCE_MAX_PER_AXIS);
+	countZ = (std::min)((std::max)(1u, (unsigned int)ceilf((boundsMax.z - boundsMin.z) / spacing) + 1), (unsigned int)LIGHT_INFLUENCE_MAX_PER_AXIS);
+
+	staticExposure.assign(countX * countY * countZ, 0.0f);
+	std::vector<unsigned int> bakedLights;
+	dynamicIndices.clear();
+	dynamicLights.clear();
+	for (unsigned int i = 0; i < lightCount; ++i)
+	{
+		if (!IsLocal(lights[i]))
+			continue;
+		if (lights[i].baked)
+			bakedLights.push_back(i);
+		else
+		{
+			dynamicIndices.push_back(i);
+			dynamicLights.push_back(lights[i]);
+		}
+	}
+
+	// rows of nodes handed out as the workers finish, every node is independent of the others
+	workerCount = settings.workerCount > 0 ? settings.workerCount : (std::max)(1u, std::thread::hardware_concurrency());
+	LightExposure staticLights;
+	staticLights.SetLights(lights, lightCount);
+	const unsigned int rowCount = countY * countZ;
+	std::atomic<unsigned int> nextRow(0);
+	parallel_for(0u, workerCount, [&](unsigned int)
+	{
+		for (unsigned int row = nextRow++; row < rowCount; row = nextRow++)
+			BakeRow(row, staticLights, lights, bakedLights, occluders);
+	}, static_partitioner());
+
+	exposure = staticExposure;
+	dynamicExposure.SetLights(dynamicLights.data(), (unsigned int)dynamicLights.size());
+	unsigned int min[3] = { 0, 0, 0 };
+	unsigned int max[3] = { countX - 1, countY - 1, countZ - 1 };
+	if (!dynamicLights.empty())
+		RefreshDynamic(min, max);
+
+	bakeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Every baked light reaching a node of the row, unless the
+// occluders are in the way
+// --------------------------------------------------------
+void LightInfluenceMap::BakeRow(unsigned int row, const LightExposure& staticLights, const Light* lights, const std::vector<unsigned int>& bakedLights,
+	const TriangleBVH* occluders)
+{
+	unsigned int y = row % countY;
+	unsigned int z = row / countY;
+	float* nodes = &staticExposure[row * countX];
+
+	for (unsigned int index : bakedLights)
+	{
+		const Light& light = lights[index];
+		unsigned int min[3], max[3];
+		if (!NodeRange(light, min, max) || y < min[1] || y > max[1] || z < min[2] || z > max[2])
+			continue;
+
+		for (unsigned int x = min[0]; x <= max[0]; ++x)
+		{
+			XMFLOAT3 position(origin.x + x * spacing, origin.y + y * spacing, origin.z + z * spacing);
+			float amount = staticLights.Evaluate(position, &index, 1);
+			if (amount <= 0.0f)
+				continue;
+
+			if (occluders)
+			{
+				XMVECTOR offset = XMLoadFloat3(&light.position) - XMLoadFloat3(&position);
+				float distance = XMVectorGetX(XMVector3Length(offset));
+				XMFLOAT3 toLight, rayOrigin;
+				XMStoreFloat3(&toLight, XMVectorScale(offset, 1.0f / distance));
+				XMStoreFloat3(&rayOrigin, XMLoadFloat3(&position) + XMVectorScale(XMLoadFloat3(&toLight), LIGHT_INFLUENCE_RAY_BIAS));
+				if (distance > 2.0f * LIGHT_INFLUENCE_RAY_BIAS && occluders->Occluded(rayOrigin, toLight, distance - 2.0f * LIGHT_INFLUENCE_RAY_BIAS))
+					continue;
+			}
+			nodes[x] += amount;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// A spot light's cone within its range spans the apex, the
+// rim circle where the cone meets the sphere and, along an
+// axis inside the cone, the sphere itself
+// --------------------------------------------------------
+bool LightInfluenceMap::NodeRange(const Light& light, unsigned int min[3], unsigned int max[3]) const
+{
+	if (!IsLocal(light) || staticExposure.empty())
+		return false;
+
+	const float center[3] = { light.position.x - origin.x, light.position.y - origin.y, light.position.z - origin.z };
+	float boxMin[3], boxMax[3];
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		boxMin[axis] = center[axis] - light.range;
+		boxMax[axis] = center[axis] + light.range;
+	}
+	if (light.type == LIGHT_TYPE_SPOT && XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&light.direction))) > 0.0f)
+	{
+		XMFLOAT3 direction;
+		XMStoreFloat3(&direction, XMVector3Normalize(XMLoadFloat3(&light.direction)));
+		float cutoffCos = SpotCutoffCos(light);
+		float cutoffSin = sqrtf((std::max)(0.0f, 1.0f - cutoffCos * cutoffCos));
+		const float axisDirection[3] = { direction.x, direction.y, direction.z };
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float rimCenter = center[axis] + axisDirection[axis] * light.range * cutoffCos;
+			float rimExtent = light.range * cutoffSin * sqrtf((std::max)(0.0f, 1.0f - axisDirection[axis] * axisDirection[axis]));
+			if (axisDirection[axis] < cutoffCos)
+				boxMax[axis] = (std::max)(center[axis], rimCenter + rimExtent);
+			if (-axisDirection[axis] < cutoffCos)
+				boxMin[axis] = (std::min)(center[axis], rimCenter - rimExtent);
+		}
+	}
+
+	const unsigned int counts[3] = { countX, countY, countZ };
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float low = ceilf(boxMin[axis] / spacing);
+		float high = floorf(boxMax[axis] / spacing);
+		if (high < 0.0f || low > (float)(counts[axis] - 1) || low > high)
+			return false;
+		min[axis] = (unsigned int)(std::max)(low, 0.0f);
+		max[axis] = (unsigned int)(std::min)(high, (float)(counts[axis] - 1));
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Only the nodes a changed light reached before or reaches
+// now. Lights added to or taken out of the unbaked ones
+// redo the whole grid
+// --------------------------------------------------------
+void LightInfluenceMap::UpdateDynamic(const Light* lights, unsigned int lightCount)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	updatedNodes = 0;
+	if (exposure.empty())
+		return;
+
+	std::vector<unsigned int> indices;
+	for (unsigned int i = 0; i < lightCount; ++i)
+	{
+		if (IsLocal(lights[i]) && !lights[i].baked)
+			indices.push_back(i);
+	}
+
+	std::vector<unsigned int> boxes;	// min and max per changed light
+	bool everything = indices != dynamicIndices;
+	for (size_t k = 0; !everything && k < indices.size(); ++k)
+	{
+		const Light& light = lights[indices[k]];
+		if (!Changed(dynamicLights[k], light, moveTolerance))
+			continue;
+
+		unsigned int oldMin[3], oldMax[3], newMin[3], newMax[3];
+		bool before = NodeRange(dynamicLights[k], oldMin, oldMax);
+		bool now = NodeRange(light, newMin, newMax);
+		dynamicLights[k] = light;
+		if (!before && !now)
+			continue;
+		if (!before)
+		{
+			std::copy(newMin, newMin + 3, oldMin);
+			std::copy(newMax, newMax + 3, oldMax);
+		}
+		else if (!now)
+		{
+			std::copy(oldMin, oldMin + 3, newMin);
+			std::copy(oldMax, oldMax + 3, newMax);
+		}
+		for (int axis = 0; axis < 3; ++axis)
+			boxes.push_back((std::min)(oldMin[axis], newMin[axis]));
+		for (int axis = 0; axis < 3; ++axis)
+			boxes.push_back((std::max)(oldMax[axis], newMax[axis]));
+	}
+
+	// lights within the tolerance stay where they were last redone
+	if (everything)
+	{
+		dynamicIndices = indices;
+		dynamicLights.clear();
+		for (unsigned int index : indices)
+			dynamicLights.push_back(lights[index]);
+	}
+	if (everything || !boxes.empty())
+		dynamicExposure.SetLights(dynamicLights.data(), (unsigned int)dynamicLights.size());
+
+	if (everything)
+	{
+		unsigned int min[3] = { 0, 0, 0 };
+		unsigned int max[3] = { countX - 1, countY - 1, countZ - 1 };
+		RefreshDynamic(min, max);
+	}
+	else
+	{
+		// boxes of lights close together overlap, their shared nodes just get the same value twice
+		for (size_t b = 0; b < boxes.size(); b += 6)
+			RefreshDynamic(&boxes[b], &boxes[b + 3]);
+	}
+
+	updateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// A row of nodes at a time, LightExposure's batches want
+// neighbouring points together
+// --------------------------------------------------------
+void LightInfluenceMap::RefreshDynamic(const unsigned int min[3], const unsigned int max[3])
+{
+	unsigned int rowLength = max[0] - min[0] + 1;
+	rowPoints.resize(rowLength);
+	rowExposure.assign(rowLength, 0.0f);
+
+	for (unsigned int z = min[2]; z <= max[2]; ++z)
+	{
+		for (unsigned int y = min[1]; y <= max[1]; ++y)
+		{
+			for (unsigned int x = 0; x < rowLength; ++x)
+				rowPoints[x] = XMFLOAT3(origin.x + (min[0] + x) * spacing, origin.y + y * spacing, origin.z + z * spacing);
+			if (dynamicExposure.GetLightCount() > 0)
+				dynamicExposure.Evaluate(rowPoints.data(), rowLength, rowExposure.data());
+
+			size_t first = (z * countY + y) * countX + min[0];
+			for (unsigned int x = 0; x < rowLength; ++x)
+				exposure[first + x] = staticExposure[first + x] + rowExposure[x];
+		}
+	}
+	updatedNodes += rowLength * (max[1] - min[1] + 1) * (max[2] - min[2] + 1);
+}
+
+float LightInfluenceMap::Sample(const XMFLOAT3& point) const
+{
+	if (exposure.empty())
+		return 0.0f;
+
+	// grid coordinates, clamped onto the grid
+	float fx = (std::min)((std::max)((point.x - origin.x) / spacing, 0.0f), (float)(countX - 1));
+	float fy = (std::min)((std::max)((point.y - origin.y) / spacing, 0.0f), (float)(countY - 1));
+	float fz = (std::min)((std::max)((point.z - origin.z) / spacing, 0.0f), (float)(countZ - 1));
+	unsigned int x0 = (std::min)((unsigned int)fx, countX - 1);
+	unsigned int y0 = (std::min)((unsigned int)fy, countY - 1);
+	unsigned int z0 = (std::min)((unsigned int)fz, countZ - 1);
+	unsigned int x1 = (std::min)(x0 + 1, countX - 1);
+	unsigned int y1 = (std::min)(y0 + 1, countY - 1);
+	unsigned int z1 = (std::min)(z0 + 1, countZ - 1);
+	float tx = fx - x0, ty = fy - y0, tz = fz - z0;
+
+	auto node = [&](unsigned int x, unsigned int y, unsigned int z) { return exposure[(z * countY + y) * countX + x]; };
+	float front = (node(x0, y0, z0) * (1.0f - tx) + node(x1, y0, z0) * tx) * (1.0f - ty) + (node(x0, y1, z0) * (1.0f - tx) + node(x1, y1, z0) * tx) * ty;
+	float back = (node(x0, y0, z1) * (1.0f - tx) + node(x1, y0, z1) * tx) * (1.0f - ty) + (node(x0, y1, z1) * (1.0f - tx) + node(x1, y1, z1) * tx) * ty;
+	return front * (1.0f - tz) + back * tz;
+}
+
+bool LightInfluenceMap::Contains(const XMFLOAT3& point) const
+{
+	return !exposure.empty() &&
+		point.x >= origin.x && point.x <= origin.x + (countX - 1) * spacing &&
+		point.y >= origin.y && point.y <= origin.y + (countY - 1) * spacing &&
+		point.z >= origin.z && point.z <= origin.z + (countZ - 1) * spacing;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "LightExposure.h"
+#include "Lights.h"
+
+class TriangleBVH;
+
+// Nodes along each axis at most, the spacing grows for bigger volumes
+#define LIGHT_INFLUENCE_MAX_PER_AXIS 256
+
+struct LightInfluenceSettings
+{
+	// World units between neighbouring nodes
+	float spacing = 0.5f;
+
+	// Threads baking the static layer at once, 0 for one per core
+	unsigned int workerCount = 0;
+
+	// A moving light is only redone once it moved this far, or turned this far at the end of its range.
+	// The map lags behind it by up to that much, 0 redoes every change
+	float moveTolerance = 0.1f;
+};
+
+/**
+ * Light exposure (see LightExposure) precomputed on a grid of nodes over
+ * the level, so stealth checks anywhere cost a trilinear lookup instead
+ * of a light query.
+ *
+ * The static layer is the lights with baked set, computed once by Bake()
+ * with a shadow ray through the occluders per light and node, as the
+ * lightmap has them. The dynamic layer is every other light, unshadowed
+ * like the renderer lights them, and kept up to date by UpdateDynamic():
+ * only the nodes within reach of a light that changed since the last
+ * call, where it was and where it is now, are evaluated again. A spot
+ * light reaches the box around its cone, the little light it leaves
+ * past LIGHT_SPOT_CUTOFF may stay where it was a while.
+ *
+ * Points outside the grid get the nearest face of it, Contains() tells
+ * when that isn't good enough.
+ */
+class LightInfluenceMap
+{
+public:
+	LightInfluenceMap() = default;
+	~LightInfluenceMap() = default;
+
+	// Nodes cover boundsMin to boundsMax. The static layer takes the baked lights, occluders may be null for no shadows.
+	// Fills the dynamic layer with the other lights too
+	void Bake(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax, const Light* lights, unsigned int lightCount,
+		const TriangleBVH* occluders, const LightInfluenceSettings& settings);
+
+	// The same lights as Bake(), some of the unbaked ones moved or changed. Baked lights are assumed to be where they were
+	void UpdateDynamic(const Light* lights, unsigned int lightCount);
+
+	// Static and dynamic exposure blended from the eight nodes around the point. Only reads, any number of threads can sample at once
+	float Sample(const DirectX::XMFLOAT3& point) const;
+
+	bool Contains(const DirectX::XMFLOAT3& point) const;
+
+	inline bool IsBaked() const { return !exposure.empty(); }
+	inline unsigned int GetNodeCount() const { return (unsigned int)exposure.size(); }
+	inline unsigned int GetCountX() const { return countX; }
+	inline unsigned int GetCountY() const { return countY; }
+	inline unsigned int GetCountZ() const { return countZ; }
+	inline float GetSpacing() const { return spacing; }
+	inline float GetStatic(unsigned int x, unsigned int y, unsigned int z) const { return staticExposure[(z * countY + y) * countX + x]; }
+	inline float GetExposure(unsigned int x, unsigned int y, unsigned int z) const { return exposure[(z * countY + y) * countX + x]; }
+	inline unsigned int GetDynamicLightCount() const { return (unsigned int)dynamicLights.size(); }
+	inline unsigned int GetWorkerCount() const { return workerCount; }
+	inline double GetBakeMs() const { return bakeMs; }
+
+	// Of the last UpdateDynamic()
+	inline double GetUpdateMs() const { return updateMs; }
+	inline unsigned int GetUpdatedNodeCount() const { return updatedNodes; }
+
+private:
+	// Node ranges, min and max included, within reach of a light: the box around its sphere, or around a spot light's cone
+	bool NodeRange(const Light& light, unsigned int min[3], unsigned int max[3]) const;
+
+	void BakeRow(unsigned int row, const LightExposure& staticLights, const Light* lights, const std::vector<unsigned int>& bakedLights, const TriangleBVH* occluders);
+
+	// Static plus the dynamic lights again for the nodes in the box
+	void RefreshDynamic(const unsigned int min[3], const unsigned int max[3]);
+
+	DirectX::XMFLOAT3 origin = DirectX::XMFLOAT3(0, 0, 0);	// the first node
+	float spacing = 1.0f;
+	unsigned int countX = 0, countY = 0, countZ = 0;
+
+	// x fastest, then y, then z. exposure is the static layer plus the dynamic lights
+	std::vector<float> staticExposure;
+	std::vector<float> exposure;
+
+	float moveTolerance = 0.0f;
+
+	// Unbaked lights as of their last update, and their indices in the lights given
+	std::vector<Light> dynamicLights;
+	std::vector<unsigned int> dynamicIndices;
+	LightExposure dynamicExposure;
+
+	// scratch for RefreshDynamic()
+	std::vector<DirectX::XMFLOAT3> rowPoints;
+	std::vector<float> rowExposure;
+
+	unsigned int workerCount = 0;
+	double bakeMs = 0;
+	double updateMs = 0;
+	unsigned int updatedNodes = 0;
+};
@@ -0,0 +1,186 @@
+#include "LightSpatialIndex.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+LightSpatialIndex::LightSpatialIndex(float cellSize)
+	: baseCellSize(cellSize), cellSize(cellSize), origin(0, 0, 0)
+{
+}
+
+void LightSpatialIndex::Build(const Light* lights, unsigned int lightCount)
+{
+	indexedLights.resize(lightCount);
+	for (unsigned int i = 0; i < lightCount; ++i)
+		Store(i, lights[i]);
+
+	Rebuild();
+}
+
+void LightSpatialIndex::UpdateLight(unsigned int index, const Light& light)
+{
+	Store(index, light);
+
+	// Lights already out of the grid just take the new values
+	if (indexedLights[index].moved)
+		return;
+
+	indexedLights[index].moved = true;
+	movedLights.push_back(index);
+	if (movedLights.size() > LIGHT_INDEX_MAX_MOVED)
+		Rebuild();
+}
+
+void LightSpatialIndex::Query(const XMFLOAT3& point, std::vector<unsigned int>& result) const
+{
+	result.clear();
+
+	if (!cellLights.empty())
+	{
+		float fx = (point.x - origin.x) / cellSize;
+		float fy = (point.y - origin.y) / cellSize;
+		float fz = (point.z - origin.z) / cellSize;
+
+		// Outside the grid nothing indexed can reach
+		if (fx >= 0 && fy >= 0 && fz >= 0 && fx < cellsX && fy < cellsY && fz < cellsZ)
+		{
+			unsigned int cell = ((unsigned int)fz * cellsY + (unsigned int)fy) * cellsX + (unsigned int)fx;
+			for (unsigned int i = cellStarts[cell]; i < cellStarts[cell + 1]; ++i)
+			{
+				unsigned int index = cellLights[i];
+				if (!indexedLights[index].moved && Reaches(index, point))
+					result.push_back(index);
+			}
+		}
+	}
+
+	for (unsigned int index : movedLights)
+	{
+		if (Reaches(index, point))
+			result.push_back(index);
+	}
+}
+
+bool LightSpatialIndex::Reaches(unsigned int index, const XMFLOAT3& point) const
+{
+	const IndexedLight& light = indexedLights[index];
+	if (!light.local)
+		return false;
+
+	float x = point.x - light.position.x;
+	float y = point.y - light.position.y;
+	float z = point.z - light.position.z;
+	float distSq = x * x + y * y + z * z;
+	if (distSq >= light.rangeSq)
+		return false;
+
+	// Inside the cone when the angle to the axis is below the cutoff, compared
+	// without the square root: dot >= cos * |v|
+	if (light.cutoffCos < -1.0f || distSq == 0.0f)
+		return true;
+
+	float along = x * light.direction.x + y * light.direction.y + z * light.direction.z;
+	return along > 0.0f && along * along > light.cutoffCos * light.cutoffCos * distSq;
+}
+
+void LightSpatialIndex::Store(unsigned int index, const Light& light)
+{
+	IndexedLight& indexed = indexedLights[index];
+	indexed.position = light.position;
+	indexed.range = light.range;
+	indexed.rangeSq = light.range * light.range;
+	indexed.direction = light.direction;
+	indexed.cutoffCos = light.type == LIGHT_TYPE_SPOT ? SpotCutoffCos(light) : -2.0f;
+	indexed.local = (light.type == LIGHT_TYPE_POINT || light.type == LIGHT_TYPE_SPOT) && light.range > 0.0f;
+}
+
+// --------------------------------------------------------
+// Fits the grid around every local light's sphere and lists
+// each light in the cells its sphere's box touches
+// --------------------------------------------------------
+void LightSpatialIndex::Rebuild()
+{
+	buildCount++;
+
+	for (IndexedLight& light : indexedLights)
+		light.moved = false;
+	movedLights.clear();
+
+	XMFLOAT3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (const IndexedLight& light : indexedLights)
+	{
+		if (!light.local)
+			continue;
+
+		boundsMin.x = (std::min)(boundsMin.x, light.position.x - light.range);
+		boundsMin.y = (std::min)(boundsMin.y, light.position.y - light.range);
+		boundsMin.z = (std::min)(boundsMin.z, light.position.z - light.range);
+		boundsMax.x = (std::max)(boundsMax.x, light.position.x + light.range);
+		boundsMax.y = (std::max)(boundsMax.y, light.position.y + light.range);
+		boundsMax.z = (std::max)(boundsMax.z, light.position.z + light.range);
+	}
+
+	cellStarts.clear();
+	cellLights.clear();
+	if (boundsMin.x > boundsMax.x)
+	{
+		cellsX = cellsY = cellsZ = 0;
+		return;
+	}
+
+	float extent = (std::max)(boundsMax.x - boundsMin.x, (std::max)(boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z));
+	cellSize = (std::max)(baseCellSize, extent / LIGHT_INDEX_MAX_CELLS_PER_AXIS);
+	origin = boundsMin;
+	cellsX = (std::max)(1u, (unsigned int)ceilf((boundsMax.x - boundsMin.x) / cellSize));
+	cellsY = (std::max)(1u, (unsigned int)ceilf((boundsMax.y - boundsMin.y) / cellSize));
+	cellsZ = (std::max)(1u, (unsigned int)ceilf((boundsMax.z - boundsMin.z) / cellSize));
+
+	// Count, prefix sum, then fill, so every cell's lights are contiguous
+	cellStarts.assign(GetCellCount() + 1, 0);
+	for (const IndexedLight& light : indexedLights)
+	{
+		if (!light.local)
+			continue;
+
+		unsigned int min[3], max[3];
+		CellRange(light, min, max);
+		for (unsigned int z = min[2]; z <= max[2]; ++z)
+			for (unsigned int y = min[1]; y <= max[1]; ++y)
+				for (unsigned int x = min[0]; x <= max[0]; ++x)
+					cellStarts[(z * cellsY + y) * cellsX + x + 1]++;
+	}
+
+	for (unsigned int cell = 0; cell < GetCellCount(); ++cell)
+		cellStarts[cell + 1] += cellStarts[cell];
+
+	cellLights.resize(cellStarts.back());
+	std::vector<unsigned int> fill(cellStarts.begin(), cellStarts.end() - 1);
+	for (unsigned int i = 0; i < indexedLights.size(); ++i)
+	{
+		if (!indexedLights[i].local)
+			continue;
+
+		unsigned int min[3], max[3];
+		CellRange(indexedLights[i], min, max);
+		for (unsigned int z = min[2]; z <= max[2]; ++z)
+			for (unsigned int y = min[1]; y <= max[1]; ++y)
+				for (unsigned int x = min[0]; x <= max[0]; ++x)
+					cellLights[fill[(z * cellsY + y) * cellsX + x]++] = i;
+	}
+}
+
+void LightSpatialIndex::CellRange(const IndexedLight& light, unsigned int min[3], unsigned int max[3]) const
+{
+	const float position[3] = { light.position.x - origin.x, light.position.y - origin.y, light.position.z - origin.z };
+	const unsigned int cells[3] = { cellsX, cellsY, cellsZ };
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float low = (std::max)(0.0f, (position[axis] - light.range) / cellSize);
+		float high = (std::max)(0.0f, (position[axis] + light.range) / cellSize);
+		min[axis] = (std::min)((unsigned int)low, cells[axis] - 1);
+		max[axis] = (std::min)((unsigned int)high, cells[axis] - 1);
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Lights.h"
+
+// Default edge length of a grid cell, about twice the range of the level's lights
+#define LIGHT_INDEX_CELL_SIZE 4.0f
+
+// Cells per axis are capped, the cell size grows for very spread out scenes
+#define LIGHT_INDEX_MAX_CELLS_PER_AXIS 128
+
+// Once this many lights moved since the last build the grid is rebuilt
+#define LIGHT_INDEX_MAX_MOVED 32
+
+/**
+ * Uniform grid over point and spot lights for "which lights reach this
+ * point" queries (stealth checks, AI perception).
+ *
+ * Every light is listed in each cell its range overlaps, so a query only
+ * tests the lights of one cell. Hits use the same range and spot cone
+ * cutoff as the renderer. Directional and ambient lights are not indexed.
+ *
+ * Lights that move after Build() are taken out of the grid and tested
+ * separately instead of rebuilding every frame. The grid is only rebuilt
+ * once more than LIGHT_INDEX_MAX_MOVED lights are out of it.
+ */
+class LightSpatialIndex
+{
+public:
+	LightSpatialIndex(float cellSize = LIGHT_INDEX_CELL_SIZE);
+	~LightSpatialIndex() = default;
+
+	// Copies the lights and builds the grid
+	void Build(const Light* lights, unsigned int lightCount);
+
+	// Call whenever a light changes after Build()
+	void UpdateLight(unsigned int index, const Light& light);
+
+	// Clears the result and fills it with the index of every light reaching the point, in no particular order
+	void Query(const DirectX::XMFLOAT3& point, std::vector<unsigned int>& result) const;
+
+	// True if the light reaches the point, same test Query() uses
+	bool Reaches(unsigned int index, const DirectX::XMFLOAT3& point) const;
+
+	inline unsigned int GetLightCount() const { return (unsigned int)indexedLights.size(); }
+	inline unsigned int GetCellCount() const { return cellsX * cellsY * cellsZ; }
+	inline unsigned int GetMovedCount() const { return (unsigned int)movedLights.size(); }
+	inline unsigned int GetBuildCount() const { return buildCount; }
+
+private:
+	// What a query needs of a light
+	struct IndexedLight
+	{
+		DirectX::XMFLOAT3 position;
+		float rangeSq;
+		DirectX::XMFLOAT3 direction;
+		float cutoffCos;	// -2 for point lights, every direction passes
+		float range;
+		bool local;		// point or spot light with a range, nothing else is ever hit
+		bool moved;		// changed since the last build, tested from movedLights instead of the grid
+	};
+
+	void Store(unsigned int index, const Light& light);
+	void Rebuild();
+	void CellRange(const IndexedLight& light, unsigned int min[3], unsigned int max[3]) const;
+
+	float baseCellSize;
+	float cellSize;
+	DirectX::XMFLOAT3 origin;
+	unsigned int cellsX = 0;
+	unsigned int cellsY = 0;
+	unsigned int cellsZ = 0;
+
+	std::vector<IndexedLight> indexedLights;
+	std::vector<unsigned int> movedLights;
+
+	// Lights of cell c are cellLights[cellStarts[c] .. cellStarts[c + 1])
+	std::vector<unsigned int> cellStarts;
+	std::vector<unsigned int> cellLights;
+
+	unsigned int buildCount = 0;
+};
@@ -0,0 +1,54 @@
+#include "LightUploader.h"
+#include "Lights.h"
+#include <algorithm>
+#include <cassert>
+
+LightUploader::LightUploader(unsigned int capacity)
+	: dirty(capacity, 0), dirtyBegin(capacity)
+{
+}
+
+void LightUploader::MarkDirty(unsigned int index)
+{
+	MarkDirty(index, 1);
+}
+
+void LightUploader::MarkDirty(unsigned int first, unsigned int count)
+{
+	assert(first + count <= dirty.size());
+
+	std::fill(dirty.begin() + first, dirty.begin() + first + count, (unsigned char)1);
+	dirtyBegin = (std::min)(dirtyBegin, first);
+	dirtyEnd = (std::max)(dirtyEnd, first + count);
+}
+
+unsigned int LightUploader::Upload(IRenderContext* context, ID3D11Buffer* buffer, const Light* lights)
+{
+	lastUploadBytes = 0;
+	lastRangeCount = 0;
+
+	unsigned int index = dirtyBegin;
+	while (index < dirtyEnd)
+	{
+		if (!dirty[index])
+		{
+			index++;
+			continue;
+		}
+
+		// One upload for the whole run of dirty lights
+		unsigned int runEnd = index;
+		while (runEnd < dirtyEnd && dirty[runEnd])
+			dirty[runEnd++] = 0;
+
+		unsigned int size = (runEnd - index) * sizeof(Light);
+		context->UpdateBufferRange(buffer, index * sizeof(Light), &lights[index], size);
+		lastUploadBytes += size;
+		lastRangeCount++;
+		index = runEnd;
+	}
+
+	dirtyBegin = (unsigned int)dirty.size();
+	dirtyEnd = 0;
+	return lastUploadBytes;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include "RenderBackend.h"
+
+struct Light;
+
+// Pixel shader register of the scene light structured buffer
+#define LIGHT_BUFFER_SLOT 3
+
+/**
+ * Keeps the GPU copy of the scene lights in sync with as little uploading
+ * as possible.
+ *
+ * Whoever changes a light marks it dirty. Upload() sends every run of
+ * consecutive dirty lights with a single UpdateBufferRange() and clears
+ * the flags, lights nobody touched since the last upload aren't sent
+ * again. One buffer serves every lit pixel shader.
+ */
+class LightUploader
+{
+public:
+	LightUploader(unsigned int capacity);
+	~LightUploader() = default;
+
+	void MarkDirty(unsigned int index);
+	void MarkDirty(unsigned int first, unsigned int count);
+
+	// Uploads the dirty lights of the array into the buffer, returns the bytes sent
+	unsigned int Upload(IRenderContext* context, ID3D11Buffer* buffer, const Light* lights);
+
+	inline unsigned int GetCapacity() const { return (unsigned int)dirty.size(); }
+
+	// What the last Upload() sent
+	inline unsigned int GetLastUploadBytes() const { return lastUploadBytes; }
+	inline unsigned int GetLastRangeCount() const { return lastRangeCount; }
+
+private:
+	std::vector<unsigned char> dirty;
+
+	// Only [dirtyBegin, dirtyEnd) has to be scanned for dirty lights
+	unsigned int dirtyBegin;
+	unsigned int dirtyEnd = 0;
+
+	unsigned int lastUploadBytes = 0;
+	unsigned int lastRangeCount = 0;
+};
@@ -0,0 +1,432 @@
+#include "LightmapBaker.h"
+#include "Lights.h"
+#include "Vertex.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <ppl.h>
+#include <thread>
+
+using namespace DirectX;
+using namespace Concurrency;
+
+// Rays start this far off the surface so they don't hit the triangle they start on
+#define LIGHTMAP_RAY_BIAS 0.02f
+
+// Length of directional light shadow rays and bounce rays
+#define LIGHTMAP_RAY_DISTANCE 1000.0f
+
+namespace
+{
+	inline XMFLOAT3 Add(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x + b.x, a.y + b.y, a.z + b.z); }
+	inline XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	inline XMFLOAT3 Scale(const XMFLOAT3& a, float s) { return XMFLOAT3(a.x * s, a.y * s, a.z * s); }
+	inline XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+	inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+	inline XMFLOAT3 Normalize(const XMFLOAT3& a, const XMFLOAT3& fallback)
+	{
+		float length = sqrtf(Dot(a, a));
+		return length > 1e-12f ? Scale(a, 1.0f / length) : fallback;
+	}
+
+	inline float Saturate(float f) { return (std::min)((std::max)(f, 0.0f), 1.0f); }
+
+	// Small, fast and good enough to spread hemisphere samples
+	inline unsigned int Hash(unsigned int x)
+	{
+		x ^= x >> 16;
+		x *= 0x7feb352d;
+		x ^= x >> 15;
+		x *= 0x846ca68b;
+		x ^= x >> 16;
+		return x;
+	}
+
+	inline float NextRandom(unsigned int& state)
+	{
+		state = Hash(state + 0x9e3779b9);
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	double MillisecondsSince(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+void LightmapBaker::AddInstance(const LightmapInstance& instance)
+{
+	instances.push_back(instance);
+}
+
+bool LightmapBaker::Bake(const Light* lights, unsigned int lightCount, const LightmapSettings& settings)
+{
+	this->lights = lights;
+	this->lightCount = lightCount;
+	this->settings = settings;
+	atlasSize = settings.atlasSize;
+	workerCount = settings.workerCount > 0 ? settings.workerCount : (std::max)(1u, std::thread::hardware_concurrency());
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// world space triangles, one chart each, in the order the BVH gets them
+	charts.clear();
+	bvh.Clear();
+	for (unsigned int i = 0; i < instances.size(); ++i)
+	{
+		const LightmapInstance& instance = instances[i];
+		XMMATRIX world = XMLoadFloat4x4(&instance.world);
+		XMMATRIX normalMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, world));
+
+		for (unsigned int corner = 0; corner + 2 < instance.indexCount; corner += 3)
+		{
+			Chart chart = {};
+			chart.instance = i;
+			XMFLOAT3 normalSum(0, 0, 0);
+			for (int k = 0; k < 3; ++k)
+			{
+				const Vertex& vertex = instance.vertices[instance.indices[corner + k]];
+				XMStoreFloat3(&chart.positions[k], XMVector3TransformCoord(XMLoadFloat3(&vertex.Position), world));
+				XMStoreFloat3(&chart.normals[k], XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&vertex.Normal), normalMatrix)));
+				normalSum = Add(normalSum, chart.normals[k]);
+			}
+
+			// the winding doesn't matter, the face normal follows the vertex normals
+			XMFLOAT3 faceNormal = Cross(Subtract(chart.positions[1], chart.positions[0]), Subtract(chart.positions[2], chart.positions[0]));
+			chart.faceNormal = Normalize(faceNormal, Normalize(normalSum, XMFLOAT3(0, 1, 0)));
+			if (Dot(chart.faceNormal, normalSum) < 0.0f)
+				chart.faceNormal = Scale(chart.faceNormal, -1.0f);
+
+			charts.push_back(chart);
+			bvh.AddTriangle(chart.positions[0], chart.positions[1], chart.positions[2]);
+		}
+	}
+	bvh.Build();
+
+	// fit the density to the atlas, leaving room for the padding and the packing losses
+	float area = 0.0f;
+	for (const Chart& chart : charts)
+	{
+		XMFLOAT3 cross = Cross(Subtract(chart.positions[1], chart.positions[0]), Subtract(chart.positions[2], chart.positions[0]));
+		area += 0.5f * sqrtf(Dot(cross, cross));
+	}
+	float density = settings.texelsPerUnit;
+	if (area > 0.0f)
+		density = (std::min)(density, sqrtf(0.5f * atlasSize * atlasSize / (2.0f * area)));
+
+	bool packed = false;
+	for (int attempt = 0; attempt < 24 && !packed; ++attempt)
+	{
+		packed = LayoutCharts(density, settings.padding);
+		if (!packed)
+			density *= 0.85f;
+	}
+	if (!packed)
+		return false;
+	texelsPerUnit = density;
+
+	instanceUVs.assign(instances.size(), std::vector<XMFLOAT2>());
+	for (unsigned int i = 0; i < instances.size(); ++i)
+		instanceUVs[i].resize(instances[i].indexCount, XMFLOAT2(0, 0));
+
+	std::vector<unsigned int> nextCorner(instances.size(), 0);
+	for (const Chart& chart : charts)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			instanceUVs[chart.instance][nextCorner[chart.instance]++] = XMFLOAT2(
+				(chart.x + chart.corners[k].x) / atlasSize,
+				(chart.y + chart.corners[k].y) / atlasSize);
+		}
+	}
+	chartMs = MillisecondsSince(start);
+
+	direct.assign(atlasSize * atlasSize, XMFLOAT3(0, 0, 0));
+	texels.assign(atlasSize * atlasSize, XMFLOAT4(0, 0, 0, 0));
+
+	start = std::chrono::high_resolution_clock::now();
+	RunWorkers((unsigned int)charts.size(), 32, &LightmapBaker::BakeDirect);
+	directMs = MillisecondsSince(start);
+
+	bounceMs = 0;
+	if (settings.bounceRays > 0)
+	{
+		start = std::chrono::high_resolution_clock::now();
+		RunWorkers((unsigned int)charts.size(), 32, &LightmapBaker::BakeBounce);
+		bounceMs = MillisecondsSince(start);
+	}
+
+	coveredTexels = 0;
+	for (const XMFLOAT4& texel : texels)
+		coveredTexels += texel.w > 0.0f ? 1 : 0;
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Lays every triangle flat at the density and packs the
+// charts in rows, tallest first. False if they don't fit
+// --------------------------------------------------------
+bool LightmapBaker::LayoutCharts(float density, unsigned int padding)
+{
+	for (Chart& chart : charts)
+	{
+		// 2D frame in the triangle's plane: x along the first edge
+		XMFLOAT3 edge1 = Subtract(chart.positions[1], chart.positions[0]);
+		XMFLOAT3 edge2 = Subtract(chart.positions[2], chart.positions[0]);
+		XMFLOAT3 axisX = Normalize(edge1, Normalize(edge2, XMFLOAT3(1, 0, 0)));
+		XMFLOAT3 axisY = Cross(chart.faceNormal, axisX);
+
+		XMFLOAT2 flat[3] = { XMFLOAT2(0, 0), XMFLOAT2(Dot(edge1, axisX), Dot(edge1, axisY)), XMFLOAT2(Dot(edge2, axisX), Dot(edge2, axisY)) };
+		float minX = (std::min)(0.0f, (std::min)(flat[1].x, flat[2].x));
+		float minY = (std::min)(0.0f, (std::min)(flat[1].y, flat[2].y));
+		float maxX = (std::max)(0.0f, (std::max)(flat[1].x, flat[2].x));
+		float maxY = (std::max)(0.0f, (std::max)(flat[1].y, flat[2].y));
+
+		for (int k = 0; k < 3; ++k)
+			chart.corners[k] = XMFLOAT2((flat[k].x - minX) * density + padding, (flat[k].y - minY) * density + padding);
+
+		chart.width = (std::max)(1u, (unsigned int)ceilf((maxX - minX) * density)) + 2 * padding;
+		chart.height = (std::max)(1u, (unsigned int)ceilf((maxY - minY) * density)) + 2 * padding;
+	}
+
+	std::vector<unsigned int> order(charts.size());
+	for (unsigned int i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return charts[a].height > charts[b].height; });
+
+	unsigned int x = 0, y = 0, rowHeight = 0;
+	for (unsigned int index : order)
+	{
+		Chart& chart = charts[index];
+		if (x + chart.width > atlasSize)
+		{
+			x = 0;
+			y += rowHeight;
+			rowHeight = 0;
+		}
+		if (chart.width > atlasSize || y + chart.height > atlasSize)
+			return false;
+
+		chart.x = x;
+		chart.y = y;
+		x += chart.width;
+		rowHeight = (std::max)(rowHeight, chart.height);
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Hands out items in blocks to workerCount tasks, so the
+// result is the same however many threads run
+// --------------------------------------------------------
+void LightmapBaker::RunWorkers(unsigned int itemCount, unsigned int itemsPerTask, void (LightmapBaker::*work)(unsigned int))
+{
+	std::atomic<unsigned int> next(0);
+	parallel_for(0u, workerCount, [&](unsigned int)
+	{
+		for (;;)
+		{
+			unsigned int first = next.fetch_add(itemsPerTask);
+			if (first >= itemCount)
+				break;
+
+			unsigned int last = (std::min)(first + itemsPerTask, itemCount);
+			for (unsigned int item = first; item < last; ++item)
+				(this->*work)(item);
+		}
+	}, static_partitioner());
+}
+
+void LightmapBaker::BakeDirect(unsigned int chartIndex)
+{
+	const Chart& chart = charts[chartIndex];
+	for (unsigned int y = 0; y < chart.height; ++y)
+	{
+		for (unsigned int x = 0; x < chart.width; ++x)
+		{
+			XMFLOAT3 position, normal;
+			TexelSurface(chart, x, y, position, normal);
+			XMFLOAT3 light = DirectLight(position, normal, chart.faceNormal);
+
+			unsigned int texel = (chart.y + y) * atlasSize + chart.x + x;
+			direct[texel] = light;
+			texels[texel] = XMFLOAT4(light.x, light.y, light.z, 1.0f);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// One bounce: cosine weighted rays pick up the direct light
+// of whatever they hit, tinted by that instance's albedo.
+// With cosine weighting the average already is the bounced
+// light, no pdf or pi left to divide by
+// --------------------------------------------------------
+void LightmapBaker::BakeBounce(unsigned int chartIndex)
+{
+	const Chart& chart = charts[chartIndex];
+	const unsigned int rayCount = settings.bounceRays;
+
+	for (unsigned int y = 0; y < chart.height; ++y)
+	{
+		for (unsigned int x = 0; x < chart.width; ++x)
+		{
+			unsigned int texel = (chart.y + y) * atlasSize + chart.x + x;
+
+			XMFLOAT3 position, normal;
+			TexelSurface(chart, x, y, position, normal);
+			XMFLOAT3 origin = Add(position, Scale(chart.faceNormal, LIGHTMAP_RAY_BIAS));
+
+			XMFLOAT3 tangent = Normalize(Cross(fabsf(normal.x) > 0.9f ? XMFLOAT3(0, 1, 0) : XMFLOAT3(1, 0, 0), normal), XMFLOAT3(1, 0, 0));
+			XMFLOAT3 bitangent = Cross(normal, tangent);
+
+			unsigned int state = Hash(texel);
+			XMFLOAT3 gathered(0, 0, 0);
+			for (unsigned int ray = 0; ray < rayCount; ++ray)
+			{
+				float radius = sqrtf(NextRandom(state));
+				float angle = XM_2PI * NextRandom(state);
+				float up = sqrtf((std::max)(0.0f, 1.0f - radius * radius));
+				XMFLOAT3 direction = Add(Add(Scale(tangent, radius * cosf(angle)), Scale(bitangent, radius * sinf(angle))), Scale(normal, up));
+				direction = Normalize(direction, normal);
+
+				RayHit hit;
+				if (!bvh.Intersect(origin, direction, LIGHTMAP_RAY_DISTANCE, hit))
+					continue;
+
+				// the back of a surface, the ray started inside something
+				const Chart& hitChart = charts[hit.triangle];
+				if (Dot(direction, hitChart.faceNormal) > 0.0f)
+					continue;
+
+				float w0 = 1.0f - hit.u - hit.v;
+				float hx = w0 * hitChart.corners[0].x + hit.u * hitChart.corners[1].x + hit.v * hitChart.corners[2].x;
+				float hy = w0 * hitChart.corners[0].y + hit.u * hitChart.corners[1].y + hit.v * hitChart.corners[2].y;
+				unsigned int tx = hitChart.x + (std::min)((unsigned int)(std::max)(hx, 0.0f), hitChart.width - 1);
+				unsigned int ty = hitChart.y + (std::min)((unsigned int)(std::max)(hy, 0.0f), hitChart.height - 1);
+
+				const XMFLOAT3& hitLight = direct[ty * atlasSize + tx];
+				const XMFLOAT3& albedo = instances[hitChart.instance].albedo;
+				gathered = Add(gathered, XMFLOAT3(hitLight.x * albedo.x, hitLight.y * albedo.y, hitLight.z * albedo.z));
+			}
+
+			float scale = 1.0f / rayCount;
+			texels[texel].x += gathered.x * scale;
+			texels[texel].y += gathered.y * scale;
+			texels[texel].z += gathered.z * scale;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Surface at the point of the triangle closest to the texel
+// center, so padding texels repeat the triangle's edge
+// --------------------------------------------------------
+void LightmapBaker::TexelSurface(const Chart& chart, unsigned int x, unsigned int y, XMFLOAT3& position, XMFLOAT3& normal) const
+{
+	const XMFLOAT2 point(x + 0.5f, y + 0.5f);
+	const XMFLOAT2* c = chart.corners;
+
+	float weights[3] = { -1.0f, -1.0f, -1.0f };
+	float area = (c[1].x - c[0].x) * (c[2].y - c[0].y) - (c[2].x - c[0].x) * (c[1].y - c[0].y);
+	if (fabsf(area) > 1e-8f)
+	{
+		weights[1] = ((point.x - c[0].x) * (c[2].y - c[0].y) - (c[2].x - c[0].x) * (point.y - c[0].y)) / area;
+		weights[2] = ((c[1].x - c[0].x) * (point.y - c[0].y) - (point.x - c[0].x) * (c[1].y - c[0].y)) / area;
+		weights[0] = 1.0f - weights[1] - weights[2];
+	}
+
+	// outside: closest point on the nearest edge
+	if (weights[0] < 0.0f || weights[1] < 0.0f || weights[2] < 0.0f)
+	{
+		float closest = FLT_MAX;
+		for (int edge = 0; edge < 3; ++edge)
+		{
+			int a = edge, b = (edge + 1) % 3;
+			float dx = c[b].x - c[a].x, dy = c[b].y - c[a].y;
+			float lengthSq = dx * dx + dy * dy;
+			float t = lengthSq > 0.0f ? Saturate(((point.x - c[a].x) * dx + (point.y - c[a].y) * dy) / lengthSq) : 0.0f;
+			float ex = c[a].x + dx * t - point.x, ey = c[a].y + dy * t - point.y;
+			float distanceSq = ex * ex + ey * ey;
+			if (distanceSq < closest)
+			{
+				closest = distanceSq;
+				weights[a] = 1.0f - t;
+				weights[b] = t;
+				weights[3 - a - b] = 0.0f;
+			}
+		}
+	}
+
+	position = XMFLOAT3(0, 0, 0);
+	XMFLOAT3 normalSum(0, 0, 0);
+	for (int k = 0; k < 3; ++k)
+	{
+		position = Add(position, Scale(chart.positions[k], weights[k]));
+		normalSum = Add(normalSum, Scale(chart.normals[k], weights[k]));
+	}
+	normal = Normalize(normalSum, chart.faceNormal);
+}
+
+// --------------------------------------------------------
+// Diffuse part of EvaluateLight() from ShaderIncludes.hlsli
+// for every baked light, with a shadow ray to each
+// --------------------------------------------------------
+XMFLOAT3 LightmapBaker::DirectLight(const XMFLOAT3& position, const XMFLOAT3& normal, const XMFLOAT3& faceNormal) const
+{
+	XMFLOAT3 result(0, 0, 0);
+	for (unsigned int i = 0; i < lightCount; ++i)
+	{
+		const Light& light = lights[i];
+		if (!light.baked)
+			continue;
+
+		float amount = 0.0f;
+		XMFLOAT3 toLight;
+		float distance = LIGHTMAP_RAY_DISTANCE;
+		switch (light.type)
+		{
+		case LIGHT_TYPE_AMBIENT:
+			result = Add(result, Scale(light.color, light.intensity));
+			continue;
+
+		case LIGHT_TYPE_DIR:
+			toLight = Normalize(Scale(light.direction, -1.0f), XMFLOAT3(0, 1, 0));
+			amount = Saturate(Dot(normal, toLight));
+			break;
+
+		case LIGHT_TYPE_POINT:
+		case LIGHT_TYPE_SPOT:
+		{
+			XMFLOAT3 offset = Subtract(light.position, position);
+			distance = sqrtf(Dot(offset, offset));
+			if (distance >= light.range || distance <= 0.0f)
+				continue;
+
+			toLight = Scale(offset, 1.0f / distance);
+			float attenuation = Saturate(1.0f - distance * distance / (light.range * light.range));
+			amount = Saturate(Dot(normal, toLight)) * attenuation * attenuation;
+			if (light.type == LIGHT_TYPE_SPOT)
+				amount *= powf(Saturate(-Dot(toLight, light.direction)), light.spotFalloff);
+			break;
+		}
+
+		default:
+			continue;
+		}
+
+		if (amount <= 0.0f)
+			continue;
+
+		// start on the side of the surface the light is on
+		XMFLOAT3 origin = Add(position, Scale(faceNormal, Dot(faceNormal, toLight) >= 0.0f ? LIGHTMAP_RAY_BIAS : -LIGHTMAP_RAY_BIAS));
+		if (bvh.Occluded(origin, toLight, distance - LIGHTMAP_RAY_BIAS))
+			continue;
+
+		result = Add(result, Scale(light.color, light.intensity * amount));
+	}
+	return result;
+}
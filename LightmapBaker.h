@@ -0,0 +1,124 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "TriangleBVH.h"
+
+struct Light;
+struct Vertex;
+
+// Pixel shader register of the lightmap atlas
+#define LIGHTMAP_SLOT 2
+
+struct LightmapSettings
+{
+	unsigned int atlasSize = 1024;
+
+	// Wanted texel density, lowered when the charts don't fit the atlas
+	float texelsPerUnit = 8.0f;
+
+	// Texels around every chart so bilinear filtering never reads a neighbour
+	unsigned int padding = 2;
+
+	// Hemisphere rays per texel for one bounce of indirect light, 0 bakes direct light only
+	unsigned int bounceRays = 16;
+
+	// Threads baking at once, 0 for one per core
+	unsigned int workerCount = 0;
+};
+
+// A static mesh placed in the world, light bounces off it with the given albedo
+struct LightmapInstance
+{
+	const Vertex* vertices;
+	unsigned int vertexCount;
+	const unsigned int* indices;
+	unsigned int indexCount;
+	DirectX::XMFLOAT4X4 world;
+	DirectX::XMFLOAT3 albedo;
+};
+
+/**
+ * Bakes the lights flagged as baked into one lightmap atlas for a set of
+ * static meshes.
+ *
+ * Every triangle gets its own chart, laid flat at the texel density and
+ * packed into the atlas in rows, so any mesh can be baked without
+ * authored lightmap UVs. Each chart texel is lit at the closest point of
+ * its triangle with the same falloff as ShaderIncludes.hlsli (diffuse
+ * only, specular depends on the view) and a shadow ray per light through
+ * a TriangleBVH of all instances. The optional bounce pass gathers the
+ * direct light around every texel with cosine weighted rays.
+ *
+ * Charts are spread over the workers as they finish, every texel is
+ * seeded by its position so the result doesn't depend on the worker
+ * count.
+ */
+class LightmapBaker
+{
+public:
+	LightmapBaker() = default;
+	~LightmapBaker() = default;
+
+	void AddInstance(const LightmapInstance& instance);
+
+	// False if the charts don't fit the atlas even at a low density
+	bool Bake(const Light* lights, unsigned int lightCount, const LightmapSettings& settings);
+
+	// RGB light reaching every texel, alpha 1 where a chart covers it
+	inline const std::vector<DirectX::XMFLOAT4>& GetTexels() const { return texels; }
+	inline unsigned int GetAtlasSize() const { return atlasSize; }
+
+	// Atlas UV of every index of the instance, three per triangle
+	inline const std::vector<DirectX::XMFLOAT2>& GetLightmapUVs(unsigned int instance) const { return instanceUVs[instance]; }
+
+	inline float GetTexelsPerUnit() const { return texelsPerUnit; }
+	inline unsigned int GetCoveredTexelCount() const { return coveredTexels; }
+	inline unsigned int GetWorkerCount() const { return workerCount; }
+	inline double GetChartMs() const { return chartMs; }
+	inline double GetDirectMs() const { return directMs; }
+	inline double GetBounceMs() const { return bounceMs; }
+
+private:
+	// One triangle laid flat in the atlas
+	struct Chart
+	{
+		unsigned int instance;
+		unsigned int x, y;			// atlas texel of the chart's corner
+		unsigned int width, height;	// texels, padding included
+		DirectX::XMFLOAT2 corners[3];	// triangle in chart texels
+		DirectX::XMFLOAT3 positions[3];	// world space
+		DirectX::XMFLOAT3 normals[3];
+		DirectX::XMFLOAT3 faceNormal;	// facing the same way as the vertex normals
+	};
+
+	bool LayoutCharts(float density, unsigned int padding);
+	void RunWorkers(unsigned int itemCount, unsigned int itemsPerTask, void (LightmapBaker::*work)(unsigned int));
+
+	void BakeDirect(unsigned int chart);
+	void BakeBounce(unsigned int chart);
+
+	// World position and interpolated normal at a chart texel
+	void TexelSurface(const Chart& chart, unsigned int x, unsigned int y, DirectX::XMFLOAT3& position, DirectX::XMFLOAT3& normal) const;
+	DirectX::XMFLOAT3 DirectLight(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& normal, const DirectX::XMFLOAT3& faceNormal) const;
+
+	std::vector<LightmapInstance> instances;
+	std::vector<Chart> charts;
+	std::vector<std::vector<DirectX::XMFLOAT2>> instanceUVs;
+	TriangleBVH bvh;
+
+	const Light* lights = nullptr;
+	unsigned int lightCount = 0;
+	LightmapSettings settings;
+
+	unsigned int atlasSize = 0;
+	float texelsPerUnit = 0;
+	unsigned int workerCount = 0;
+	std::vector<DirectX::XMFLOAT3> direct;
+	std::vector<DirectX::XMFLOAT4> texels;
+	unsigned int coveredTexels = 0;
+
+	double chartMs = 0;
+	double directMs = 0;
+	double bounceMs = 0;
+};
@@ -1,6 +1,29 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <cmath>
+
+// Must match ShaderIncludes.hlsli
+#define LIGHT_TYPE_DIR 0
+#define LIGHT_TYPE_POINT 1
+#define LIGHT_TYPE_SPOT 2
+#define LIGHT_TYPE_AMBIENT 3
+
+// lightingMode in the pixel shaders
+#define LIGHTING_MODE_ALL 0
+#define LIGHTING_MODE_CLUSTERED 1
+#define LIGHTING_MODE_PER_OBJECT 2
+
+// Lights a single object can get with LIGHTING_MODE_PER_OBJECT
+#define MAX_OBJECT_LIGHTS 8
+
+// Where an object gets the baked lights from, bakedLighting in the pixel shaders
+#define BAKED_LIGHTING_NONE 0		// evaluates them like any other light
+#define BAKED_LIGHTING_LIGHTMAP 1
+#define BAKED_LIGHTING_PROBES 2
+
+// Coefficients of L2 spherical harmonics
+#define IRRADIANCE_SH_COEFFICIENTS 9
 
 struct Light
 {
@@ -11,5 +34,29 @@ struct Light
 	DirectX::XMFLOAT3 position;
 	int type;
 	float spotFalloff;
-	DirectX::XMFLOAT3 pad;
-};
\ No newline at end of file
+	int baked;		// in the lightmap, lightmapped objects skip it
+	DirectX::XMFLOAT2 pad;
+};
+
+// A spot light's cone ends where pow(cos, spotFalloff) drops below this
+#define LIGHT_SPOT_CUTOFF (1.0f / 256.0f)
+
+// Cosine of the angle where the spot cone ends. pow(saturate(cos), falloff) never reaches past 90 degrees
+inline float SpotCutoffCos(const Light& light)
+{
+	return light.spotFalloff > 0.0f ? powf(LIGHT_SPOT_CUTOFF, 1.0f / light.spotFalloff) : 0.0f;
+}
+
+// The strongest lights for one object, strongest first. Uploaded with the object's constants
+struct ObjectLights
+{
+	Light lights[MAX_OBJECT_LIGHTS];
+	unsigned int count = 0;
+};
+
+// Baked light around an object as spherical harmonics convolved with the cosine lobe (see IrradianceProbes).
+// Uploaded with the object's constants, xyz is RGB
+struct IrradianceSH
+{
+	DirectX::XMFLOAT4 coefficients[IRRADIANCE_SH_COEFFICIENTS] = {};
+};
@@ -1,6 +1,9 @@
 
 #include <Windows.h>
 #include "Game.h"
+#include "Benchmarks.h"
+#include <cstdio>
+#include <cstring>
 
 // --------------------------------------------------------
 // Entry point for a graphical (non-console) Windows application
@@ -18,6 +21,21 @@ int WINAPI WinMain(
 	_CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
 #endif
 
+	// Headless benchmarks run without a window or device, print to
+	// the console that launched us (or a new one) and exit
+	const char* benchArguments = strstr(lpCmdLine, "-bench");
+	if (benchArguments)
+	{
+		if (!AttachConsole(ATTACH_PARENT_PROCESS))
+			AllocConsole();
+
+		FILE* stream;
+		freopen_s(&stream, "CONOUT$", "w", stdout);
+		freopen_s(&stream, "CONOUT$", "w", stderr);
+
+		return Benchmarks::Run(benchArguments + strlen("-bench"));
+	}
+
 	// Create the Game object using
 	// the app handle we got from WinMain
 	Game dxGame(hInstance);
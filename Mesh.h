@@ -1,8 +1,10 @@
 #pragma once
 
 #include <wrl/client.h>
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
 
-struct Vertex;
 struct ID3D11Device;
 struct ID3D11Buffer;
 
@@ -17,13 +19,33 @@ public:
 	struct ID3D11Buffer* GetIndexBuffer() const;
 	int GetIndexCount() const;
 
+	// CPU copies of the geometry for culling and collision queries
+	inline const std::vector<DirectX::XMFLOAT3>& GetPositions() const { return positions; }
+	inline const std::vector<unsigned int>& GetIndices() const { return cpuIndices; }
+	inline const std::vector<Vertex>& GetVertices() const { return cpuVertices; }
+
+	// Sets the lightmap UV of every index corner (LightmapBaker::GetLightmapUVs()) and recreates the vertex buffer.
+	// False if a vertex shared by several corners would need different UVs
+	bool SetLightmapUVs(const std::vector<DirectX::XMFLOAT2>& cornerUVs, struct ID3D11Device* device);
+
+	// Local space bounding box
+	inline const DirectX::XMFLOAT3& GetBoundsMin() const { return boundsMin; }
+	inline const DirectX::XMFLOAT3& GetBoundsMax() const { return boundsMax; }
+
 private:
 
 	void GenerateVertAndIndexBuffers(struct Vertex* vertexData, unsigned int vertexCount, unsigned int* indices, int indexCount, struct ID3D11Device* device);
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+	void StoreCpuGeometry(struct Vertex* vertexData, unsigned int vertexCount, unsigned int* indices, int indexCount);
 
 	Microsoft::WRL::ComPtr<struct ID3D11Buffer> vertexBuffer;
 	Microsoft::WRL::ComPtr<struct ID3D11Buffer> indexBuffer;
 	
 	int indexBufferCount = 0;
+
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<unsigned int> cpuIndices;
+	std::vector<Vertex> cpuVertices;
+	DirectX::XMFLOAT3 boundsMin = DirectX::XMFLOAT3(0, 0, 0);
+	DirectX::XMFLOAT3 boundsMax = DirectX::XMFLOAT3(0, 0, 0);
 };
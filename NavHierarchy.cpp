@@ -0,0 +1,563 @@
+#include "NavHierarchy.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace DirectX;
+
+// Floors this far below a room's bounds still count as inside, the room's floor mesh can sit under the walkable surface
+#define NAV_ROOM_FLOOR_TOLERANCE 0.5f
+
+namespace
+{
+	const float diagonalCost = 1.41421356f;
+}
+
+// --------------------------------------------------------
+// Cluster search
+// --------------------------------------------------------
+
+bool NavClusterSearch::Later(const OpenNode& a, const OpenNode& b)
+{
+	return a.cost > b.cost;
+}
+
+void NavClusterSearch::Visit(unsigned int span, unsigned int from, float cost)
+{
+	if (visited[span] == searchId && costs[span] <= cost)
+		return;
+
+	visited[span] = searchId;
+	costs[span] = cost;
+	parents[span] = from;
+	settled[span] = 0;
+
+	OpenNode node = { cost, span };
+	open.push_back(node);
+	std::push_heap(open.begin(), open.end(), Later);
+}
+
+// --------------------------------------------------------
+// The same moves as NavMeshQuery::FindSpanPath(), only to
+// floors of the start's cluster
+// --------------------------------------------------------
+void NavClusterSearch::Run(const NavMesh& navMesh, const std::vector<unsigned int>& spanClusters, unsigned int start, const unsigned int* targets, unsigned int targetCount)
+{
+	unsigned int spanCount = navMesh.GetSpanCount();
+	if (visited.size() != spanCount || ++searchId == 0)
+	{
+		visited.assign(spanCount, 0);
+		costs.resize(spanCount);
+		parents.resize(spanCount);
+		settled.resize(spanCount);
+		searchId = 1;
+	}
+	open.clear();
+
+	unsigned int cluster = spanClusters[start];
+	unsigned int remaining = targetCount;
+	Visit(start, NAV_NO_SPAN, 0.0f);
+	while (!open.empty())
+	{
+		std::pop_heap(open.begin(), open.end(), Later);
+		OpenNode node = open.back();
+		open.pop_back();
+		if (node.cost > costs[node.span])
+			continue;
+
+		settled[node.span] = 1;
+		for (unsigned int t = 0; t < targetCount; ++t)
+			remaining -= targets[t] == node.span;
+		if (remaining == 0)
+			break;
+
+		for (unsigned int d = 0; d < 4; ++d)
+		{
+			unsigned int side = navMesh.GetNeighbour(node.span, d);
+			if (side == NAV_NO_SPAN)
+				continue;
+			if (spanClusters[side] == cluster)
+				Visit(side, node.span, node.cost + 1.0f);
+
+			unsigned int e = (d + 1) & 3;
+			unsigned int otherSide = navMesh.GetNeighbour(node.span, e);
+			if (otherSide == NAV_NO_SPAN)
+				continue;
+			unsigned int corner = navMesh.GetNeighbour(side, e);
+			if (corner != NAV_NO_SPAN && corner == navMesh.GetNeighbour(otherSide, d) && spanClusters[corner] == cluster)
+				Visit(corner, node.span, node.cost + diagonalCost);
+		}
+	}
+}
+
+void NavClusterSearch::GetPath(unsigned int span, std::vector<unsigned int>& path) const
+{
+	path.clear();
+	for (unsigned int s = span; s != NAV_NO_SPAN; s = parents[s])
+		path.push_back(s);
+	std::reverse(path.begin(), path.end());
+}
+
+// --------------------------------------------------------
+// Hierarchy
+// --------------------------------------------------------
+
+NavHierarchy::NavHierarchy(const NavMesh& navMesh)
+	: navMesh(navMesh)
+{
+}
+
+void NavHierarchy::Clear()
+{
+	roomsMin.clear();
+	roomsMax.clear();
+	spanClusters.clear();
+	clusterFirstNode.clear();
+	clusterNodes.clear();
+	nodes.clear();
+	edges.clear();
+	edgeSpans.clear();
+}
+
+void NavHierarchy::AddRoom(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+{
+	roomsMin.push_back(boundsMin);
+	roomsMax.push_back(boundsMax);
+}
+
+// --------------------------------------------------------
+// Clusters, portals between them, then one search per node
+// within its cluster for the paths to the cluster's other
+// nodes
+// --------------------------------------------------------
+bool NavHierarchy::Build(const NavHierarchySettings& settings)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	spanClusters.clear();
+	clusterFirstNode.assign(1, 0);
+	clusterNodes.clear();
+	nodes.clear();
+	edges.clear();
+	edgeSpans.clear();
+	if (!navMesh.IsBuilt())
+		return false;
+
+	AssignClusters(settings);
+
+	std::vector<std::vector<Edge>> nodeEdges;
+	FindPortals(settings, nodeEdges);
+
+	// nodes by cluster, counting sort
+	unsigned int clusterCount = (unsigned int)clusterFirstNode.size() - 1;
+	std::vector<unsigned int> fill(clusterCount + 1, 0);
+	for (const Node& node : nodes)
+		fill[node.cluster + 1]++;
+	for (unsigned int c = 0; c < clusterCount; ++c)
+		fill[c + 1] += fill[c];
+	clusterFirstNode = fill;
+	clusterNodes.resize(nodes.size());
+	for (unsigned int n = 0; n < nodes.size(); ++n)
+		clusterNodes[fill[nodes[n].cluster]++] = n;
+
+	NavClusterSearch search;
+	std::vector<unsigned int> targets, path;
+	for (unsigned int c = 0; c < clusterCount; ++c)
+	{
+		const unsigned int* clusterFirst = clusterNodes.data() + clusterFirstNode[c];
+		unsigned int count = clusterFirstNode[c + 1] - clusterFirstNode[c];
+		if (count < 2)
+			continue;
+
+		targets.clear();
+		for (unsigned int i = 0; i < count; ++i)
+			targets.push_back(nodes[clusterFirst[i]].span);
+
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			search.Run(navMesh, spanClusters, targets[i], targets.data(), count);
+			for (unsigned int j = 0; j < count; ++j)
+			{
+				if (j == i || !search.IsSettled(targets[j]))
+					continue;
+
+				search.GetPath(targets[j], path);
+				Edge edge = { clusterFirst[j], search.GetCost(targets[j]), (unsigned int)edgeSpans.size(), (unsigned int)path.size() };
+				nodeEdges[clusterFirst[i]].push_back(edge);
+				edgeSpans.insert(edgeSpans.end(), path.begin(), path.end());
+			}
+		}
+	}
+
+	for (unsigned int n = 0; n < nodes.size(); ++n)
+	{
+		nodes[n].firstEdge = (unsigned int)edges.size();
+		nodes[n].edgeCount = (unsigned int)nodeEdges[n].size();
+		edges.insert(edges.end(), nodeEdges[n].begin(), nodeEdges[n].end());
+	}
+
+	buildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return true;
+}
+
+// --------------------------------------------------------
+// Rooms first, in the order added, then a block of columns
+// per cluster for the floors left. The rooms are binned by
+// the same blocks so a floor only tests the rooms near it
+// --------------------------------------------------------
+void NavHierarchy::AssignClusters(const NavHierarchySettings& settings)
+{
+	unsigned int spanCount = navMesh.GetSpanCount();
+	unsigned int clusterColumns = (std::max)(settings.clusterColumns, 1u);
+	unsigned int blocksX = (navMesh.GetWidth() + clusterColumns - 1) / clusterColumns;
+	unsigned int blocksZ = (navMesh.GetDepth() + clusterColumns - 1) / clusterColumns;
+	std::vector<unsigned int> blockClusters(blocksX * blocksZ, NAV_NO_SPAN);
+
+	float blockSize = clusterColumns * navMesh.GetCellSize();
+	const XMFLOAT3& origin = navMesh.GetOrigin();
+	std::vector<std::vector<unsigned int>> blockRooms(blocksX * blocksZ);
+	for (unsigned int room = 0; room < roomsMin.size(); ++room)
+	{
+		int minX = (std::max)((int)floorf((roomsMin[room].x - origin.x) / blockSize), 0);
+		int minZ = (std::max)((int)floorf((roomsMin[room].z - origin.z) / blockSize), 0);
+		int maxX = (std::min)((int)floorf((roomsMax[room].x - origin.x) / blockSize), (int)blocksX - 1);
+		int maxZ = (std::min)((int)floorf((roomsMax[room].z - origin.z) / blockSize), (int)blocksZ - 1);
+		for (int z = minZ; z <= maxZ; ++z)
+		{
+			for (int x = minX; x <= maxX; ++x)
+				blockRooms[z * blocksX + x].push_back(room);
+		}
+	}
+
+	unsigned int clusterCount = (unsigned int)roomsMin.size();
+	spanClusters.assign(spanCount, NAV_NO_SPAN);
+	for (unsigned int span = 0; span < spanCount; ++span)
+	{
+		XMFLOAT3 position = navMesh.GetSpanPosition(span);
+		unsigned int block = navMesh.GetSpanZ(span) / clusterColumns * blocksX + navMesh.GetSpanX(span) / clusterColumns;
+		for (unsigned int room : blockRooms[block])
+		{
+			const XMFLOAT3& low = roomsMin[room];
+			const XMFLOAT3& high = roomsMax[room];
+			if (position.x >= low.x && position.x < high.x && position.z >= low.z && position.z < high.z &&
+				position.y >= low.y - NAV_ROOM_FLOOR_TOLERANCE && position.y <= high.y)
+			{
+				spanClusters[span] = room;
+				break;
+			}
+		}
+		if (spanClusters[span] != NAV_NO_SPAN)
+			continue;
+
+		if (blockClusters[block] == NAV_NO_SPAN)
+			blockClusters[block] = clusterCount++;
+		spanClusters[span] = blockClusters[block];
+	}
+
+	clusterFirstNode.assign(clusterCount + 1, 0);
+}
+
+// --------------------------------------------------------
+// An opening is a run of floors of one cluster linked the
+// same way to floors of another, walked sideways from its
+// first floor. Each run, or each piece of a wide one, gets
+// a node pair across its middle. Openings are only walked
+// from the lower cluster, its links cover both ways
+// --------------------------------------------------------
+void NavHierarchy::FindPortals(const NavHierarchySettings& settings, std::vector<std::vector<Edge>>& nodeEdges)
+{
+	unsigned int spanCount = navMesh.GetSpanCount();
+	std::vector<unsigned int> spanNodes(spanCount, NAV_NO_SPAN);
+	std::vector<unsigned char> walked(spanCount, 0);	// a bit per direction
+	std::vector<unsigned int> run, stack;
+	unsigned int maxPortalColumns = (std::max)(settings.maxPortalColumns, 1u);
+
+	for (unsigned int span = 0; span < spanCount; ++span)
+	{
+		unsigned int cluster = spanClusters[span];
+		for (unsigned int d = 0; d < 4; ++d)
+		{
+			unsigned int across = navMesh.GetNeighbour(span, d);
+			if (across == NAV_NO_SPAN || spanClusters[across] <= cluster || (walked[span] & (1 << d)))
+				continue;
+
+			unsigned int other = spanClusters[across];
+			run.clear();
+			stack.assign(1, span);
+			walked[span] |= 1 << d;
+			while (!stack.empty())
+			{
+				unsigned int s = stack.back();
+				stack.pop_back();
+				run.push_back(s);
+				for (unsigned int e = (d + 1) & 3; ; e = (d + 3) & 3)
+				{
+					unsigned int t = navMesh.GetNeighbour(s, e);
+					if (t != NAV_NO_SPAN && spanClusters[t] == cluster && !(walked[t] & (1 << d)))
+					{
+						unsigned int u = navMesh.GetNeighbour(t, d);
+						if (u != NAV_NO_SPAN && spanClusters[u] == other)
+						{
+							walked[t] |= 1 << d;
+							stack.push_back(t);
+						}
+					}
+					if (e == ((d + 3) & 3))
+						break;
+				}
+			}
+
+			// along the opening: z for links along x, x for links along z
+			bool alongZ = d == 0 || d == 2;
+			std::sort(run.begin(), run.end(), [&](unsigned int a, unsigned int b)
+			{
+				unsigned int keyA = alongZ ? navMesh.GetSpanZ(a) : navMesh.GetSpanX(a);
+				unsigned int keyB = alongZ ? navMesh.GetSpanZ(b) : navMesh.GetSpanX(b);
+				return keyA < keyB || (keyA == keyB && a < b);
+			});
+
+			size_t pieces = (run.size() + maxPortalColumns - 1) / maxPortalColumns;
+			for (size_t p = 0; p < pieces; ++p)
+			{
+				size_t first = run.size() * p / pieces;
+				size_t last = run.size() * (p + 1) / pieces;
+				unsigned int middle = run[(first + last) / 2];
+				unsigned int a = AddNode(middle, spanNodes, nodeEdges);
+				unsigned int b = AddNode(navMesh.GetNeighbour(middle, d), spanNodes, nodeEdges);
+				Edge toB = { b, 1.0f, 0, 0 };
+				Edge toA = { a, 1.0f, 0, 0 };
+				nodeEdges[a].push_back(toB);
+				nodeEdges[b].push_back(toA);
+			}
+		}
+	}
+}
+
+unsigned int NavHierarchy::AddNode(unsigned int span, std::vector<unsigned int>& spanNodes, std::vector<std::vector<Edge>>& nodeEdges)
+{
+	if (spanNodes[span] != NAV_NO_SPAN)
+		return spanNodes[span];
+
+	Node node = { span, spanClusters[span], 0, 0 };
+	spanNodes[span] = (unsigned int)nodes.size();
+	nodes.push_back(node);
+	nodeEdges.emplace_back();
+	return spanNodes[span];
+}
+
+// --------------------------------------------------------
+// Queries
+// --------------------------------------------------------
+
+NavHierarchyQuery::NavHierarchyQuery(const NavHierarchy& hierarchy)
+	: hierarchy(hierarchy), navMesh(hierarchy.GetNavMesh())
+{
+}
+
+bool NavHierarchyQuery::Later(const OpenNode& a, const OpenNode& b)
+{
+	return a.estimate > b.estimate || (a.estimate == b.estimate && a.cost < b.cost);
+}
+
+// Octile distance in cells like NavMeshQuery, every edge costs at least that much
+float NavHierarchyQuery::Heuristic(unsigned int span, unsigned int goal) const
+{
+	float dx = fabsf((float)navMesh.GetSpanX(span) - (float)navMesh.GetSpanX(goal));
+	float dz = fabsf((float)navMesh.GetSpanZ(span) - (float)navMesh.GetSpanZ(goal));
+	return (std::max)(dx, dz) + (diagonalCost - 1.0f) * (std::min)(dx, dz);
+}
+
+void NavHierarchyQuery::Visit(unsigned int node, unsigned int parent, unsigned int edge, float cost, unsigned int goal)
+{
+	if (visited[node] == searchId && costs[node] <= cost)
+		return;
+
+	visited[node] = searchId;
+	costs[node] = cost;
+	parents[node] = parent;
+	parentEdges[node] = edge;
+
+	float estimate = node < hierarchy.nodes.size() ? cost + Heuristic(hierarchy.nodes[node].span, goal) : cost;
+	OpenNode entry = { estimate, cost, node };
+	open.push_back(entry);
+	std::push_heap(open.begin(), open.end(), Later);
+}
+
+// --------------------------------------------------------
+// Start and goal join the abstract graph through searches
+// in their own clusters, the goal as one more node every
+// node of its cluster has an edge to
+// --------------------------------------------------------
+bool NavHierarchyQuery::Search(unsigned int start, unsigned int goal)
+{
+	nodePath.clear();
+	pathEdges.clear();
+	lastExpanded = 0;
+	if (start == NAV_NO_SPAN || goal == NAV_NO_SPAN || navMesh.GetRegion(start) != navMesh.GetRegion(goal))
+		return false;
+
+	const std::vector<NavHierarchy::Node>& nodes = hierarchy.nodes;
+	unsigned int startCluster = hierarchy.spanClusters[start];
+	unsigned int goalCluster = hierarchy.spanClusters[goal];
+	const unsigned int* startNodes = hierarchy.clusterNodes.data() + hierarchy.clusterFirstNode[startCluster];
+	unsigned int startNodeCount = hierarchy.clusterFirstNode[startCluster + 1] - hierarchy.clusterFirstNode[startCluster];
+	const unsigned int* goalNodes = hierarchy.clusterNodes.data() + hierarchy.clusterFirstNode[goalCluster];
+	unsigned int goalNodeCount = hierarchy.clusterFirstNode[goalCluster + 1] - hierarchy.clusterFirstNode[goalCluster];
+
+	// both in one cluster and connected within it: no abstract search
+	targets.clear();
+	for (unsigned int i = 0; i < startNodeCount; ++i)
+		targets.push_back(nodes[startNodes[i]].span);
+	if (startCluster == goalCluster)
+		targets.push_back(goal);
+	startSearch.Run(navMesh, hierarchy.spanClusters, start, targets.data(), (unsigned int)targets.size());
+	if (startCluster == goalCluster && startSearch.IsSettled(goal))
+		return true;
+
+	targets.clear();
+	for (unsigned int i = 0; i < goalNodeCount; ++i)
+		targets.push_back(nodes[goalNodes[i]].span);
+	goalSearch.Run(navMesh, hierarchy.spanClusters, goal, targets.data(), (unsigned int)targets.size());
+
+	unsigned int goalNode = (unsigned int)nodes.size();
+	if (visited.size() != nodes.size() + 1 || ++searchId == 0)
+	{
+		visited.assign(nodes.size() + 1, 0);
+		costs.resize(nodes.size() + 1);
+		parents.resize(nodes.size() + 1);
+		parentEdges.resize(nodes.size() + 1);
+		searchId = 1;
+	}
+	open.clear();
+
+	for (unsigned int i = 0; i < startNodeCount; ++i)
+	{
+		unsigned int node = startNodes[i];
+		if (startSearch.IsSettled(nodes[node].span))
+			Visit(node, NAV_NO_SPAN, NAV_NO_SPAN, startSearch.GetCost(nodes[node].span), goal);
+	}
+
+	while (!open.empty())
+	{
+		std::pop_heap(open.begin(), open.end(), Later);
+		OpenNode current = open.back();
+		open.pop_back();
+		if (current.cost > costs[current.node])
+			continue;
+
+		lastExpanded++;
+		if (current.node == goalNode)
+		{
+			for (unsigned int n = parents[goalNode]; n != NAV_NO_SPAN; n = parents[n])
+				nodePath.push_back(n);
+			std::reverse(nodePath.begin(), nodePath.end());
+			for (size_t i = 1; i < nodePath.size(); ++i)
+				pathEdges.push_back(parentEdges[nodePath[i]]);
+			return true;
+		}
+
+		const NavHierarchy::Node& node = nodes[current.node];
+		if (node.cluster == goalCluster && goalSearch.IsSettled(node.span))
+			Visit(goalNode, current.node, NAV_NO_SPAN, current.cost + goalSearch.GetCost(node.span), goal);
+
+		for (unsigned int e = node.firstEdge; e < node.firstEdge + node.edgeCount; ++e)
+		{
+			const NavHierarchy::Edge& edge = hierarchy.edges[e];
+			Visit(edge.to, current.node, e, current.cost + edge.cost, goal);
+		}
+	}
+	return false;
+}
+
+void NavHierarchyQuery::AppendEdge(size_t i, std::vector<unsigned int>& floors) const
+{
+	const NavHierarchy::Edge& edge = hierarchy.edges[pathEdges[i]];
+	if (edge.spanCount == 0)
+		floors.push_back(hierarchy.nodes[nodePath[i + 1]].span);
+	else
+		floors.insert(floors.end(), hierarchy.edgeSpans.begin() + edge.firstSpan + 1, hierarchy.edgeSpans.begin() + edge.firstSpan + edge.spanCount);
+}
+
+bool NavHierarchyQuery::FindSpanPath(unsigned int start, unsigned int goal, std::vector<unsigned int>& floors)
+{
+	floors.clear();
+	if (!Search(start, goal))
+		return false;
+
+	if (nodePath.empty())
+	{
+		startSearch.GetPath(goal, floors);
+		return true;
+	}
+
+	startSearch.GetPath(hierarchy.nodes[nodePath[0]].span, floors);
+	for (size_t i = 0; i < pathEdges.size(); ++i)
+		AppendEdge(i, floors);
+
+	// the goal's search ran from the goal, its path comes in backwards
+	goalSearch.GetPath(hierarchy.nodes[nodePath.back()].span, legSpans);
+	for (size_t k = legSpans.size() - 1; k-- > 0;)
+		floors.push_back(legSpans[k]);
+	return true;
+}
+
+void NavHierarchyQuery::AppendCorners(const std::vector<unsigned int>& floors, std::vector<XMFLOAT3>& path) const
+{
+	unsigned int anchor = floors[0];
+	for (size_t i = 1; i < floors.size(); ++i)
+	{
+		if (!navMesh.IsLineWalkable(anchor, floors[i]))
+		{
+			anchor = floors[i - 1];
+			path.push_back(navMesh.GetSpanPosition(anchor));
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Corners up to and across the first portal, then the far
+// side of every later portal
+// --------------------------------------------------------
+bool NavHierarchyQuery::FindPath(const XMFLOAT3& start, const XMFLOAT3& goal, std::vector<XMFLOAT3>& path, bool refineAll)
+{
+	path.clear();
+	unsigned int startSpan = navMesh.FindNearestSpan(start);
+	unsigned int goalSpan = navMesh.FindNearestSpan(goal);
+	if (refineAll)
+	{
+		if (!FindSpanPath(startSpan, goalSpan, refinedSpans))
+			return false;
+
+		path.push_back(start);
+		AppendCorners(refinedSpans, path);
+		path.push_back(goal);
+		return true;
+	}
+
+	if (!Search(startSpan, goalSpan))
+		return false;
+
+	path.push_back(start);
+	if (nodePath.empty())
+	{
+		startSearch.GetPath(goalSpan, legSpans);
+		AppendCorners(legSpans, path);
+		path.push_back(goal);
+		return true;
+	}
+
+	startSearch.GetPath(hierarchy.nodes[nodePath[0]].span, legSpans);
+	size_t refined = 0;
+	if (!pathEdges.empty() && hierarchy.edges[pathEdges[0]].spanCount == 0)
+		AppendEdge(refined++, legSpans);
+	AppendCorners(legSpans, path);
+	path.push_back(navMesh.GetSpanPosition(legSpans.back()));
+
+	for (size_t i = refined; i < pathEdges.size(); ++i)
+	{
+		if (hierarchy.edges[pathEdges[i]].spanCount == 0)
+			path.push_back(navMesh.GetSpanPosition(hierarchy.nodes[nodePath[i + 1]].span));
+	}
+	path.push_back(goal);
+	return true;
+}
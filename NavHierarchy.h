@@ -0,0 +1,210 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "NavMesh.h"
+
+struct NavHierarchySettings
+{
+	// Floors outside every room fall into square clusters of this many columns per side
+	unsigned int clusterColumns = 40;
+
+	// Wider openings between two clusters get more than one portal, so paths don't all bend through the middle
+	unsigned int maxPortalColumns = 16;
+};
+
+/**
+ * Dijkstra over the floors of one cluster, with the moves NavMeshQuery
+ * takes, from a floor until a few target floors are settled. Builds the
+ * hierarchy's cached paths and connects queries to their cluster's portals
+ */
+class NavClusterSearch
+{
+public:
+	NavClusterSearch() = default;
+	~NavClusterSearch() = default;
+
+	// Stops once every target is settled, or the cluster's floors run out
+	void Run(const NavMesh& navMesh, const std::vector<unsigned int>& spanClusters, unsigned int start, const unsigned int* targets, unsigned int targetCount);
+
+	// Floors settled by the last Run() have their final cost
+	inline bool IsSettled(unsigned int span) const { return visited[span] == searchId && settled[span]; }
+	inline float GetCost(unsigned int span) const { return costs[span]; }
+
+	// Floors from the start to a settled one, both included
+	void GetPath(unsigned int span, std::vector<unsigned int>& path) const;
+
+private:
+	struct OpenNode
+	{
+		float cost;
+		unsigned int span;
+	};
+
+	static bool Later(const OpenNode& a, const OpenNode& b);
+	void Visit(unsigned int span, unsigned int from, float cost);
+
+	// per floor, only valid while visited[span] == searchId
+	std::vector<unsigned int> visited;
+	std::vector<float> costs;
+	std::vector<unsigned int> parents;
+	std::vector<unsigned char> settled;
+	unsigned int searchId = 0;
+
+	std::vector<OpenNode> open;
+};
+
+/**
+ * Two level navigation graph over a NavMesh for long paths, the way
+ * HPA* does it: the floors are split into clusters, one per room (and
+ * square blocks of columns for floors outside every room), and every
+ * opening between two clusters is a portal. The abstract graph has a node
+ * on each side of every portal, linked across it and to the other nodes
+ * of its cluster by the shortest path within the cluster, found and
+ * cached at build time.
+ *
+ * A query connects its start and goal to the nodes of their clusters with
+ * one search each, inside the cluster only, then runs A* over the
+ * abstract graph: a few hundred nodes instead of every floor on the way.
+ * Paths are close to the shortest, not always the shortest, they go
+ * through the portals' middles.
+ *
+ * Built once, then only read: any number of NavHierarchyQuery can use it
+ * from different threads.
+ */
+class NavHierarchy
+{
+public:
+	explicit NavHierarchy(const NavMesh& navMesh);
+	~NavHierarchy() = default;
+
+	void Clear();
+
+	// Floors within the box are one cluster. Floors in several rooms go to the first one added. Before Build()
+	void AddRoom(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax);
+
+	// Needs the navmesh built. False if it has no floors
+	bool Build(const NavHierarchySettings& settings);
+
+	inline unsigned int GetCluster(unsigned int span) const { return spanClusters[span]; }
+	inline unsigned int GetClusterCount() const { return (unsigned int)(clusterFirstNode.size() - 1); }
+	inline unsigned int GetRoomCount() const { return (unsigned int)roomsMin.size(); }
+	inline unsigned int GetNodeCount() const { return (unsigned int)nodes.size(); }
+	inline unsigned int GetEdgeCount() const { return (unsigned int)edges.size(); }
+	inline unsigned int GetCachedSpanCount() const { return (unsigned int)edgeSpans.size(); }
+	inline bool IsBuilt() const { return !spanClusters.empty(); }
+	inline double GetBuildMs() const { return buildMs; }
+	inline const NavMesh& GetNavMesh() const { return navMesh; }
+
+private:
+	friend class NavHierarchyQuery;
+
+	// A floor on one side of a portal
+	struct Node
+	{
+		unsigned int span;
+		unsigned int cluster;
+		unsigned int firstEdge, edgeCount;
+	};
+
+	// To the node across the portal (no cached floors), or to another node of the cluster along edgeSpans[firstSpan ..]
+	struct Edge
+	{
+		unsigned int to;
+		float cost;
+		unsigned int firstSpan, spanCount;
+	};
+
+	void AssignClusters(const NavHierarchySettings& settings);
+	void FindPortals(const NavHierarchySettings& settings, std::vector<std::vector<Edge>>& nodeEdges);
+	unsigned int AddNode(unsigned int span, std::vector<unsigned int>& spanNodes, std::vector<std::vector<Edge>>& nodeEdges);
+
+	const NavMesh& navMesh;
+
+	std::vector<DirectX::XMFLOAT3> roomsMin, roomsMax;
+
+	// per floor
+	std::vector<unsigned int> spanClusters;
+
+	// nodes of cluster c are clusterNodes[clusterFirstNode[c] .. clusterFirstNode[c + 1])
+	std::vector<unsigned int> clusterFirstNode;
+	std::vector<unsigned int> clusterNodes;
+
+	std::vector<Node> nodes;
+	std::vector<Edge> edges;
+	std::vector<unsigned int> edgeSpans;	// cached paths, both ends included
+
+	double buildMs = 0;
+};
+
+/**
+ * Path queries over a NavHierarchy, with the search state kept between
+ * queries like NavMeshQuery, so one per thread.
+ *
+ * FindPath() only refines the way to the first portal into corners, the
+ * rest of the path is the portals to go through: an agent walking toward
+ * the path's second point queries again long before it gets further.
+ * Paths kept and walked for longer are refined all the way, from the
+ * cached cluster paths.
+ */
+class NavHierarchyQuery
+{
+public:
+	explicit NavHierarchyQuery(const NavHierarchy& hierarchy);
+	~NavHierarchyQuery() = default;
+
+	// Corners to the first portal, then every portal to go through, start and goal included as given. False like NavMeshQuery::FindPath().
+	// refineAll gives the corners all the way instead, like NavMeshQuery::FindPath() along the hierarchy's route
+	bool FindPath(const DirectX::XMFLOAT3& start, const DirectX::XMFLOAT3& goal, std::vector<DirectX::XMFLOAT3>& path, bool refineAll = false);
+
+	// Every floor from start to goal
+	bool FindSpanPath(unsigned int start, unsigned int goal, std::vector<unsigned int>& spanPath);
+
+	// Abstract nodes taken off the open list by the last search, and the nodes of its path (0 within one cluster)
+	inline unsigned int GetLastExpanded() const { return lastExpanded; }
+	inline unsigned int GetLastNodeCount() const { return (unsigned int)nodePath.size(); }
+
+	inline const NavHierarchy& GetHierarchy() const { return hierarchy; }
+
+private:
+	struct OpenNode
+	{
+		float estimate;
+		float cost;
+		unsigned int node;	// nodes.size() for the goal
+	};
+
+	static bool Later(const OpenNode& a, const OpenNode& b);
+
+	// Fills nodePath and pathEdges, or leaves them empty when the goal is reached within the start's cluster
+	bool Search(unsigned int start, unsigned int goal);
+	void Visit(unsigned int node, unsigned int parent, unsigned int edge, float cost, unsigned int goal);
+	float Heuristic(unsigned int span, unsigned int goal) const;
+
+	// Appends the spans of the path's abstract edge i, without its first span
+	void AppendEdge(size_t i, std::vector<unsigned int>& spanPath) const;
+
+	// Corners along the floors, string pulled like NavMeshQuery::FindPath(). The first floor is skipped
+	void AppendCorners(const std::vector<unsigned int>& floors, std::vector<DirectX::XMFLOAT3>& path) const;
+
+	const NavHierarchy& hierarchy;
+	const NavMesh& navMesh;
+
+	NavClusterSearch startSearch;
+	NavClusterSearch goalSearch;
+	std::vector<unsigned int> targets;
+
+	// per abstract node, plus one for the goal, only valid while visited[node] == searchId
+	std::vector<unsigned int> visited;
+	std::vector<float> costs;
+	std::vector<unsigned int> parentEdges;	// edge index, NAV_NO_SPAN from the start
+	std::vector<unsigned int> parents;	// node, NAV_NO_SPAN for the start
+	unsigned int searchId = 0;
+	std::vector<OpenNode> open;
+
+	std::vector<unsigned int> nodePath;
+	std::vector<unsigned int> pathEdges;	// edge from nodePath[i] to nodePath[i + 1]
+	std::vector<unsigned int> legSpans;
+	std::vector<unsigned int> refinedSpans;
+	unsigned int lastExpanded = 0;
+};
@@ -0,0 +1,614 @@
+#include "NavMesh.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+using namespace DirectX;
+
+// Erosion distances are kept in half cells, diagonals cost 3
+#define NAV_ERODE_STEP 2
+#define NAV_ERODE_DIAGONAL 3
+
+// Clipping a triangle to a column's square leaves at most 7 corners
+#define NAV_MAX_CLIP_VERTS 12
+
+namespace
+{
+	const int directionX[4] = { -1, 0, 1, 0 };
+	const int directionZ[4] = { 0, 1, 0, -1 };
+	const float diagonalCost = 1.41421356f;
+
+	inline float Axis(const XMFLOAT3& v, int axis) { return axis == 0 ? v.x : (axis == 1 ? v.y : v.z); }
+
+	// Splits a convex polygon along the plane axis = value, below gets the part with smaller values.
+	// Corners on the plane go to both sides
+	void DividePolygon(const XMFLOAT3* in, int inCount, XMFLOAT3* below, int& belowCount, XMFLOAT3* above, int& aboveCount, float value, int axis)
+	{
+		float d[NAV_MAX_CLIP_VERTS];
+		for (int i = 0; i < inCount; ++i)
+			d[i] = value - Axis(in[i], axis);
+
+		belowCount = 0;
+		aboveCount = 0;
+		for (int i = 0, j = inCount - 1; i < inCount; j = i, ++i)
+		{
+			bool inA = d[j] >= 0;
+			bool inB = d[i] >= 0;
+			if (inA != inB)
+			{
+				float s = d[j] / (d[j] - d[i]);
+				XMFLOAT3 crossing(in[j].x + (in[i].x - in[j].x) * s, in[j].y + (in[i].y - in[j].y) * s, in[j].z + (in[i].z - in[j].z) * s);
+				below[belowCount++] = crossing;
+				above[aboveCount++] = crossing;
+
+				// corners on the plane were just added as the crossing
+				if (d[i] > 0)
+					below[belowCount++] = in[i];
+				else if (d[i] < 0)
+					above[aboveCount++] = in[i];
+			}
+			else
+			{
+				if (d[i] >= 0)
+				{
+					below[belowCount++] = in[i];
+					if (d[i] != 0)
+						continue;
+				}
+				above[aboveCount++] = in[i];
+			}
+		}
+	}
+}
+
+void NavMesh::Clear()
+{
+	corners.clear();
+	columnFirst.clear();
+	spans.clear();
+	width = depth = 0;
+	regionCount = 0;
+}
+
+void NavMesh::AddTriangle(const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+{
+	corners.push_back(a);
+	corners.push_back(b);
+	corners.push_back(c);
+}
+
+// --------------------------------------------------------
+// Voxelize, find the floors, link them, erode them by the
+// agent radius, drop the small regions, then keep the rest
+// as compact spans with their links and regions
+// --------------------------------------------------------
+bool NavMesh::Build(const NavMeshSettings& settings)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	columnFirst.clear();
+	spans.clear();
+	regionCount = 0;
+	if (corners.empty())
+		return false;
+
+	XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+	for (const XMFLOAT3& corner : corners)
+	{
+		boundsMin = XMVectorMin(boundsMin, XMLoadFloat3(&corner));
+		boundsMax = XMVectorMax(boundsMax, XMLoadFloat3(&corner));
+	}
+	XMFLOAT3 extent;
+	XMStoreFloat3(&origin, boundsMin);
+	XMStoreFloat3(&extent, boundsMax - boundsMin);
+
+	cellSize = settings.cellSize;
+	cellHeight = settings.cellHeight;
+	width = (std::max)(1u, (unsigned int)ceilf(extent.x / cellSize));
+	depth = (std::max)(1u, (unsigned int)ceilf(extent.z / cellSize));
+	unsigned int heightLimit = (unsigned int)ceilf(extent.y / cellHeight) + 1;
+	unsigned int climb = (unsigned int)floorf(settings.maxClimb / cellHeight);
+	unsigned int clearance = (unsigned int)ceilf(settings.agentHeight / cellHeight);
+	unsigned int columnCount = width * depth;
+
+	// solid spans, a triangle's top is a floor if it isn't too steep
+	std::vector<HeightSpan> pool;
+	std::vector<unsigned int> columns(columnCount, NAV_NO_SPAN);
+	float walkableNormalY = cosf(XMConvertToRadians(settings.maxSlopeDegrees));
+	for (size_t t = 0; t + 2 < corners.size(); t += 3)
+	{
+		XMVECTOR normal = XMVector3Normalize(XMVector3Cross(XMLoadFloat3(&corners[t + 1]) - XMLoadFloat3(&corners[t]), XMLoadFloat3(&corners[t + 2]) - XMLoadFloat3(&corners[t])));
+		Rasterize(&corners[t], XMVectorGetY(normal) >= walkableNormalY, pool, columns, heightLimit, climb);
+	}
+
+	// walkable tops with room above them
+	std::vector<FloorCandidate> floors;
+	std::vector<unsigned int> floorFirst(columnCount + 1, 0);
+	for (unsigned int column = 0; column < columnCount; ++column)
+	{
+		floorFirst[column] = (unsigned int)floors.size();
+		for (unsigned int s = columns[column]; s != NAV_NO_SPAN; s = pool[s].next)
+		{
+			const HeightSpan& span = pool[s];
+			unsigned int ceiling = span.next != NAV_NO_SPAN ? pool[span.next].bottom : heightLimit + clearance;
+			if (span.walkable && ceiling - span.top >= clearance)
+			{
+				FloorCandidate floor = { span.top, ceiling, { NAV_NO_SPAN, NAV_NO_SPAN, NAV_NO_SPAN, NAV_NO_SPAN } };
+				floors.push_back(floor);
+			}
+		}
+	}
+	floorFirst[columnCount] = (unsigned int)floors.size();
+	LinkColumns(floorFirst, floors, climb, clearance);
+
+	// chamfer distance to the nearest floor missing a link, in half cells
+	std::vector<unsigned char> distance(floors.size(), 0xff);
+	for (size_t f = 0; f < floors.size(); ++f)
+	{
+		for (int d = 0; d < 4; ++d)
+		{
+			if (floors[f].neighbours[d] == NAV_NO_SPAN)
+				distance[f] = 0;
+		}
+	}
+	auto relax = [&](unsigned int f, int d, int diagonal)
+	{
+		unsigned int n = floors[f].neighbours[d];
+		if (n == NAV_NO_SPAN)
+			return;
+		distance[f] = (unsigned char)(std::min)((int)distance[f], distance[n] + NAV_ERODE_STEP);
+		unsigned int nn = floors[n].neighbours[diagonal];
+		if (nn != NAV_NO_SPAN)
+			distance[f] = (unsigned char)(std::min)((int)distance[f], distance[nn] + NAV_ERODE_DIAGONAL);
+	};
+	for (unsigned int f = 0; f < floors.size(); ++f)
+	{
+		relax(f, 0, 3);
+		relax(f, 3, 2);
+	}
+	for (unsigned int f = (unsigned int)floors.size(); f-- > 0;)
+	{
+		relax(f, 2, 1);
+		relax(f, 1, 0);
+	}
+	int minDistance = (int)ceilf(settings.agentRadius / cellSize) * NAV_ERODE_STEP;
+
+	// flood fill what's left into connected regions
+	std::vector<unsigned int> floorRegion(floors.size(), NAV_NO_SPAN);
+	std::vector<unsigned int> regionSize;
+	std::vector<unsigned int> stack;
+	for (unsigned int seed = 0; seed < floors.size(); ++seed)
+	{
+		if (distance[seed] < minDistance || floorRegion[seed] != NAV_NO_SPAN)
+			continue;
+
+		unsigned int region = (unsigned int)regionSize.size();
+		regionSize.push_back(1);
+		floorRegion[seed] = region;
+		stack.push_back(seed);
+		while (!stack.empty())
+		{
+			unsigned int f = stack.back();
+			stack.pop_back();
+			for (int d = 0; d < 4; ++d)
+			{
+				unsigned int n = floors[f].neighbours[d];
+				if (n != NAV_NO_SPAN && distance[n] >= minDistance && floorRegion[n] == NAV_NO_SPAN)
+				{
+					floorRegion[n] = region;
+					regionSize[region]++;
+					stack.push_back(n);
+				}
+			}
+		}
+	}
+
+	// big enough regions are kept and numbered again
+	std::vector<unsigned int> regionRemap(regionSize.size(), NAV_NO_SPAN);
+	for (size_t region = 0; region < regionSize.size(); ++region)
+	{
+		if (regionSize[region] >= settings.minRegionFloors)
+			regionRemap[region] = regionCount++;
+	}
+
+	// their floors become the spans
+	std::vector<unsigned int> remap(floors.size(), NAV_NO_SPAN);
+	columnFirst.assign(columnCount + 1, 0);
+	for (unsigned int column = 0; column < columnCount; ++column)
+	{
+		columnFirst[column] = (unsigned int)spans.size();
+		for (unsigned int f = floorFirst[column]; f < floorFirst[column + 1]; ++f)
+		{
+			if (floorRegion[f] == NAV_NO_SPAN || regionRemap[floorRegion[f]] == NAV_NO_SPAN)
+				continue;
+
+			remap[f] = (unsigned int)spans.size();
+			Span span = { origin.y + floors[f].top * cellHeight, column % width, column / width, regionRemap[floorRegion[f]], {} };
+			spans.push_back(span);
+		}
+	}
+	columnFirst[columnCount] = (unsigned int)spans.size();
+	for (unsigned int f = 0; f < floors.size(); ++f)
+	{
+		if (remap[f] == NAV_NO_SPAN)
+			continue;
+		for (int d = 0; d < 4; ++d)
+			spans[remap[f]].neighbours[d] = floors[f].neighbours[d] == NAV_NO_SPAN ? NAV_NO_SPAN : remap[floors[f].neighbours[d]];
+	}
+
+	buildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return !spans.empty();
+}
+
+// --------------------------------------------------------
+// Clips the triangle to every column row it covers, then
+// to every column in the row, the clipped polygon's height
+// range becomes a solid span in that column
+// --------------------------------------------------------
+void NavMesh::Rasterize(const XMFLOAT3* triangle, bool walkable, std::vector<HeightSpan>& pool, std::vector<unsigned int>& columns, unsigned int heightLimit, unsigned int climb) const
+{
+	float minZ = (std::min)((std::min)(triangle[0].z, triangle[1].z), triangle[2].z);
+	float maxZ = (std::max)((std::max)(triangle[0].z, triangle[1].z), triangle[2].z);
+	int z0 = (std::max)(0, (int)floorf((minZ - origin.z) / cellSize));
+	int z1 = (std::min)((int)depth - 1, (int)floorf((maxZ - origin.z) / cellSize));
+
+	XMFLOAT3 buffers[4][NAV_MAX_CLIP_VERTS];
+	XMFLOAT3* remaining = buffers[0];
+	XMFLOAT3* row = buffers[1];
+	XMFLOAT3* cell = buffers[2];
+	XMFLOAT3* rowRest = buffers[3];
+	int remainingCount = 3;
+	std::copy(triangle, triangle + 3, remaining);
+
+	for (int z = z0; z <= z1; ++z)
+	{
+		int rowCount = 0, restCount = 0;
+		DividePolygon(remaining, remainingCount, row, rowCount, rowRest, restCount, origin.z + (z + 1) * cellSize, 2);
+		std::swap(remaining, rowRest);
+		remainingCount = restCount;
+		if (rowCount < 3)
+			continue;
+
+		float minX = row[0].x, maxX = row[0].x;
+		for (int i = 1; i < rowCount; ++i)
+		{
+			minX = (std::min)(minX, row[i].x);
+			maxX = (std::max)(maxX, row[i].x);
+		}
+		int x0 = (std::max)(0, (int)floorf((minX - origin.x) / cellSize));
+		int x1 = (std::min)((int)width - 1, (int)floorf((maxX - origin.x) / cellSize));
+
+		for (int x = x0; x <= x1; ++x)
+		{
+			int cellCount = 0;
+			DividePolygon(row, rowCount, cell, cellCount, rowRest, restCount, origin.x + (x + 1) * cellSize, 0);
+			std::swap(row, rowRest);
+			rowCount = restCount;
+			if (cellCount < 3)
+				continue;
+
+			float minY = cell[0].y, maxY = cell[0].y;
+			for (int i = 1; i < cellCount; ++i)
+			{
+				minY = (std::min)(minY, cell[i].y);
+				maxY = (std::max)(maxY, cell[i].y);
+			}
+			int bottom = (std::max)(0, (int)floorf((minY - origin.y) / cellHeight));
+			int top = (std::min)((int)heightLimit, (int)ceilf((maxY - origin.y) / cellHeight));
+			top = (std::max)(top, bottom + 1);
+			AddSpan(z * width + x, (unsigned int)bottom, (unsigned int)top, walkable, pool, columns, climb);
+		}
+	}
+}
+
+// Merges the span with every span it touches. The merged top is walkable if the highest
+// surface is, or any surface within a climb of it
+void NavMesh::AddSpan(unsigned int column, unsigned int bottom, unsigned int top, bool walkable, std::vector<HeightSpan>& pool, std::vector<unsigned int>& columns, unsigned int climb) const
+{
+	unsigned int previous = NAV_NO_SPAN;
+	unsigned int current = columns[column];
+	while (current != NAV_NO_SPAN)
+	{
+		const HeightSpan& span = pool[current];
+		if (span.bottom > top)
+			break;
+		if (span.top < bottom)
+		{
+			previous = current;
+			current = span.next;
+			continue;
+		}
+
+		unsigned int difference = span.top > top ? span.top - top : top - span.top;
+		if (difference <= climb)
+			walkable |= span.walkable;
+		else if (span.top > top)
+			walkable = span.walkable;
+		bottom = (std::min)(bottom, span.bottom);
+		top = (std::max)(top, span.top);
+
+		// unlinked, its slot in the pool is left unused
+		current = span.next;
+		if (previous == NAV_NO_SPAN)
+			columns[column] = current;
+		else
+			pool[previous].next = current;
+	}
+
+	HeightSpan merged = { bottom, top, current, walkable };
+	pool.push_back(merged);
+	if (previous == NAV_NO_SPAN)
+		columns[column] = (unsigned int)pool.size() - 1;
+	else
+		pool[previous].next = (unsigned int)pool.size() - 1;
+}
+
+// A floor links to the floor in the next column it can step to with the agent fitting in between
+void NavMesh::LinkColumns(const std::vector<unsigned int>& first, std::vector<FloorCandidate>& floors, unsigned int climb, unsigned int clearance) const
+{
+	for (unsigned int z = 0; z < depth; ++z)
+	{
+		for (unsigned int x = 0; x < width; ++x)
+		{
+			unsigned int column = z * width + x;
+			for (unsigned int f = first[column]; f < first[column + 1]; ++f)
+			{
+				FloorCandidate& floor = floors[f];
+				for (int d = 0; d < 4; ++d)
+				{
+					int nx = (int)x + directionX[d];
+					int nz = (int)z + directionZ[d];
+					if (nx < 0 || nz < 0 || nx >= (int)width || nz >= (int)depth)
+						continue;
+
+					unsigned int neighbourColumn = nz * width + nx;
+					unsigned int bestStep = climb + 1;
+					for (unsigned int n = first[neighbourColumn]; n < first[neighbourColumn + 1]; ++n)
+					{
+						const FloorCandidate& other = floors[n];
+						unsigned int step = other.top > floor.top ? other.top - floor.top : floor.top - other.top;
+						int gap = (int)(std::min)(floor.ceiling, other.ceiling) - (int)(std::max)(floor.top, other.top);
+						if (step < bestStep && gap >= (int)clearance)
+						{
+							floor.neighbours[d] = n;
+							bestStep = step;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+unsigned int NavMesh::FindNearestSpan(const XMFLOAT3& point) const
+{
+	if (spans.empty())
+		return NAV_NO_SPAN;
+
+	int cx = (int)floorf((point.x - origin.x) / cellSize);
+	int cz = (int)floorf((point.z - origin.z) / cellSize);
+	int x0 = (std::max)(cx - NAV_NEAREST_SEARCH_CELLS, 0);
+	int x1 = (std::min)(cx + NAV_NEAREST_SEARCH_CELLS, (int)width - 1);
+	int z0 = (std::max)(cz - NAV_NEAREST_SEARCH_CELLS, 0);
+	int z1 = (std::min)(cz + NAV_NEAREST_SEARCH_CELLS, (int)depth - 1);
+
+	unsigned int nearest = NAV_NO_SPAN;
+	float nearestSq = FLT_MAX;
+	for (int z = z0; z <= z1; ++z)
+	{
+		for (int x = x0; x <= x1; ++x)
+		{
+			unsigned int column = z * width + x;
+			for (unsigned int s = columnFirst[column]; s < columnFirst[column + 1]; ++s)
+			{
+				float dx = origin.x + (x + 0.5f) * cellSize - point.x;
+				float dy = spans[s].y - point.y;
+				float dz = origin.z + (z + 0.5f) * cellSize - point.z;
+				float distanceSq = dx * dx + dy * dy + dz * dz;
+				if (distanceSq < nearestSq)
+				{
+					nearestSq = distanceSq;
+					nearest = s;
+				}
+			}
+		}
+	}
+	return nearest;
+}
+
+unsigned int NavMesh::FindSpan(const XMFLOAT3& point) const
+{
+	int x = (int)floorf((point.x - origin.x) / cellSize);
+	int z = (int)floorf((point.z - origin.z) / cellSize);
+	if (x < 0 || z < 0 || x >= (int)width || z >= (int)depth)
+		return FindNearestSpan(point);
+
+	unsigned int column = z * width + x;
+	unsigned int nearest = NAV_NO_SPAN;
+	float nearestDistance = FLT_MAX;
+	for (unsigned int s = columnFirst[column]; s < columnFirst[column + 1]; ++s)
+	{
+		float distance = fabsf(spans[s].y - point.y);
+		if (distance < nearestDistance)
+		{
+			nearestDistance = distance;
+			nearest = s;
+		}
+	}
+	return nearest != NAV_NO_SPAN ? nearest : FindNearestSpan(point);
+}
+
+// --------------------------------------------------------
+// Walks the columns the line between both centers crosses,
+// following the links. Where the line goes exactly through
+// a corner both ways around it have to be open
+// --------------------------------------------------------
+bool NavMesh::IsLineWalkable(unsigned int from, unsigned int to) const
+{
+	int x0 = (int)spans[from].x, z0 = (int)spans[from].z;
+	int x1 = (int)spans[to].x, z1 = (int)spans[to].z;
+	int dx = abs(x1 - x0), dz = abs(z1 - z0);
+	unsigned int stepX = x1 > x0 ? 2 : 0;
+	unsigned int stepZ = z1 > z0 ? 1 : 3;
+
+	unsigned int current = from;
+	int i = 0, j = 0;
+	while (i < dx || j < dz)
+	{
+		// the line crosses its next x boundary at (2i + 1) / 2dx, the z one at (2j + 1) / 2dz
+		long long crossX = (long long)(2 * i + 1) * dz;
+		long long crossZ = (long long)(2 * j + 1) * dx;
+		if (i < dx && (j >= dz || crossX < crossZ))
+		{
+			current = spans[current].neighbours[stepX];
+			i++;
+		}
+		else if (j < dz && (i >= dx || crossZ < crossX))
+		{
+			current = spans[current].neighbours[stepZ];
+			j++;
+		}
+		else
+		{
+			unsigned int a = spans[current].neighbours[stepX];
+			unsigned int b = spans[current].neighbours[stepZ];
+			if (a == NAV_NO_SPAN || b == NAV_NO_SPAN)
+				return false;
+			current = spans[a].neighbours[stepZ];
+			if (current != spans[b].neighbours[stepX])
+				return false;
+			i++;
+			j++;
+		}
+
+		if (current == NAV_NO_SPAN)
+			return false;
+	}
+	return current == to;
+}
+
+XMFLOAT3 NavMesh::GetSpanPosition(unsigned int span) const
+{
+	return XMFLOAT3(origin.x + (spans[span].x + 0.5f) * cellSize, spans[span].y, origin.z + (spans[span].z + 0.5f) * cellSize);
+}
+
+NavMeshQuery::NavMeshQuery(const NavMesh& navMesh)
+	: navMesh(navMesh)
+{
+}
+
+// New search id, the per span arrays are only cleared when the ids wrap or the navmesh changed size
+void NavMeshQuery::Reset()
+{
+	unsigned int spanCount = navMesh.GetSpanCount();
+	if (visited.size() != spanCount || ++searchId == 0)
+	{
+		visited.assign(spanCount, 0);
+		costs.resize(spanCount);
+		parents.resize(spanCount);
+		searchId = 1;
+	}
+	open.clear();
+	lastExpanded = 0;
+}
+
+bool NavMeshQuery::Later(const OpenNode& a, const OpenNode& b)
+{
+	return a.estimate > b.estimate || (a.estimate == b.estimate && a.cost < b.cost);
+}
+
+// Octile distance in cells, never more than the real cost
+float NavMeshQuery::Heuristic(unsigned int span, unsigned int goal) const
+{
+	float dx = fabsf((float)navMesh.GetSpanX(span) - (float)navMesh.GetSpanX(goal));
+	float dz = fabsf((float)navMesh.GetSpanZ(span) - (float)navMesh.GetSpanZ(goal));
+	return (std::max)(dx, dz) + (diagonalCost - 1.0f) * (std::min)(dx, dz);
+}
+
+void NavMeshQuery::Visit(unsigned int span, unsigned int from, float cost, unsigned int goal)
+{
+	if (visited[span] == searchId && costs[span] <= cost)
+		return;
+
+	visited[span] = searchId;
+	costs[span] = cost;
+	parents[span] = from;
+
+	OpenNode node = { cost + Heuristic(span, goal), cost, span };
+	open.push_back(node);
+	std::push_heap(open.begin(), open.end(), Later);
+}
+
+bool NavMeshQuery::FindSpanPath(unsigned int start, unsigned int goal, std::vector<unsigned int>& path)
+{
+	path.clear();
+	Reset();
+	if (start == NAV_NO_SPAN || goal == NAV_NO_SPAN || navMesh.GetRegion(start) != navMesh.GetRegion(goal))
+		return false;
+
+	Visit(start, NAV_NO_SPAN, 0.0f, goal);
+	while (!open.empty())
+	{
+		std::pop_heap(open.begin(), open.end(), Later);
+		OpenNode node = open.back();
+		open.pop_back();
+
+		// a cheaper way here was found after this one was queued
+		if (node.cost > costs[node.span])
+			continue;
+
+		lastExpanded++;
+		if (node.span == goal)
+		{
+			for (unsigned int s = goal; s != NAV_NO_SPAN; s = parents[s])
+				path.push_back(s);
+			std::reverse(path.begin(), path.end());
+			return true;
+		}
+
+		for (unsigned int d = 0; d < 4; ++d)
+		{
+			unsigned int side = navMesh.GetNeighbour(node.span, d);
+			if (side == NAV_NO_SPAN)
+				continue;
+			Visit(side, node.span, node.cost + 1.0f, goal);
+
+			// diagonal, the same span around both sides of the corner
+			unsigned int e = (d + 1) & 3;
+			unsigned int otherSide = navMesh.GetNeighbour(node.span, e);
+			if (otherSide == NAV_NO_SPAN)
+				continue;
+			unsigned int corner = navMesh.GetNeighbour(side, e);
+			if (corner != NAV_NO_SPAN && corner == navMesh.GetNeighbour(otherSide, d))
+				Visit(corner, node.span, node.cost + diagonalCost, goal);
+		}
+	}
+	return false;
+}
+
+// --------------------------------------------------------
+// String pulling over the floor path: a corner is added
+// wherever the line from the last corner can't reach the
+// next floor of the path anymore
+// --------------------------------------------------------
+bool NavMeshQuery::FindPath(const XMFLOAT3& start, const XMFLOAT3& goal, std::vector<XMFLOAT3>& path)
+{
+	path.clear();
+	if (!FindSpanPath(navMesh.FindNearestSpan(start), navMesh.FindNearestSpan(goal), spanPath))
+		return false;
+
+	path.push_back(start);
+	unsigned int anchor = spanPath[0];
+	for (size_t i = 1; i < spanPath.size(); ++i)
+	{
+		if (!navMesh.IsLineWalkable(anchor, spanPath[i]))
+		{
+			anchor = spanPath[i - 1];
+			path.push_back(navMesh.GetSpanPosition(anchor));
+		}
+	}
+	path.push_back(goal);
+	return true;
+}
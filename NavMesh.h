@@ -0,0 +1,185 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// No span, for missing neighbours and failed lookups
+#define NAV_NO_SPAN 0xffffffff
+
+// Columns searched around a point in every direction for the nearest walkable span
+#define NAV_NEAREST_SEARCH_CELLS 4
+
+struct NavMeshSettings
+{
+	// World units covered by a column, along x and z
+	float cellSize = 0.25f;
+
+	// World units per voxel along y
+	float cellHeight = 0.1f;
+
+	// Free space needed above a floor, and the steepest floor that is still walkable
+	float agentHeight = 2.0f;
+	float maxSlopeDegrees = 45.0f;
+
+	// Highest step between neighbouring floors
+	float maxClimb = 0.5f;
+
+	// Floors closer than this to a wall or a drop are removed
+	float agentRadius = 0.25f;
+
+	// Smaller patches of connected floors are removed, like the tops of walls
+	unsigned int minRegionFloors = 16;
+};
+
+/**
+ * Walkable surface of static triangles, built the way Recast starts:
+ * the triangles are voxelized into a heightfield of solid spans per
+ * column, a span's top is a floor if its top surface isn't too steep and
+ * an agent fits above it, floors link to the floors in the 4 neighbouring
+ * columns they can step to, and the floors are eroded by the agent radius
+ * so paths keep away from walls.
+ *
+ * The floors themselves are the navigation graph, NavMeshQuery runs A*
+ * over them. Connected floors share a region, so unreachable goals are
+ * rejected without a search. Built once, then only read: any number of
+ * NavMeshQuery can use it from different threads.
+ */
+class NavMesh
+{
+public:
+	NavMesh() = default;
+	~NavMesh() = default;
+
+	void Clear();
+	void AddTriangle(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b, const DirectX::XMFLOAT3& c);
+
+	// Needed after adding triangles, before any query. False if nothing is walkable
+	bool Build(const NavMeshSettings& settings);
+
+	// Walkable span closest to the point within NAV_NEAREST_SEARCH_CELLS columns, NAV_NO_SPAN if there is none
+	unsigned int FindNearestSpan(const DirectX::XMFLOAT3& point) const;
+
+	// The span in the point's own column closest in height, FindNearestSpan() if the column has none
+	unsigned int FindSpan(const DirectX::XMFLOAT3& point) const;
+
+	// True if a straight line between both span centers stays on connected floors
+	bool IsLineWalkable(unsigned int from, unsigned int to) const;
+
+	// Center of the span's floor
+	DirectX::XMFLOAT3 GetSpanPosition(unsigned int span) const;
+
+	// Neighbouring span toward -x, +z, +x, -z for direction 0 to 3, NAV_NO_SPAN if there's no link
+	inline unsigned int GetNeighbour(unsigned int span, unsigned int direction) const { return spans[span].neighbours[direction]; }
+	inline unsigned int GetSpanX(unsigned int span) const { return spans[span].x; }
+	inline unsigned int GetSpanZ(unsigned int span) const { return spans[span].z; }
+	inline unsigned int GetRegion(unsigned int span) const { return spans[span].region; }
+
+	inline bool IsBuilt() const { return !spans.empty(); }
+	inline unsigned int GetSpanCount() const { return (unsigned int)spans.size(); }
+	inline unsigned int GetRegionCount() const { return regionCount; }
+	inline unsigned int GetTriangleCount() const { return (unsigned int)(corners.size() / 3); }
+	inline unsigned int GetWidth() const { return width; }
+	inline unsigned int GetDepth() const { return depth; }
+	inline float GetCellSize() const { return cellSize; }
+	inline const DirectX::XMFLOAT3& GetOrigin() const { return origin; }	// min corner of the first column
+	inline double GetBuildMs() const { return buildMs; }
+
+private:
+	// A walkable floor
+	struct Span
+	{
+		float y;
+		unsigned int x, z;
+		unsigned int region;
+		unsigned int neighbours[4];
+	};
+
+	// Solid voxels during the build, linked bottom to top per column
+	struct HeightSpan
+	{
+		unsigned int bottom, top;
+		unsigned int next;
+		bool walkable;
+	};
+
+	// A floor that still has to pass erosion
+	struct FloorCandidate
+	{
+		unsigned int top, ceiling;
+		unsigned int neighbours[4];
+	};
+
+	void Rasterize(const DirectX::XMFLOAT3* triangle, bool walkable, std::vector<HeightSpan>& pool, std::vector<unsigned int>& columns, unsigned int heightLimit, unsigned int climb) const;
+	void AddSpan(unsigned int column, unsigned int bottom, unsigned int top, bool walkable, std::vector<HeightSpan>& pool, std::vector<unsigned int>& columns, unsigned int climb) const;
+	void LinkColumns(const std::vector<unsigned int>& first, std::vector<FloorCandidate>& floors, unsigned int climb, unsigned int clearance) const;
+
+	// Three corners per triangle, in the order they were added
+	std::vector<DirectX::XMFLOAT3> corners;
+
+	DirectX::XMFLOAT3 origin = DirectX::XMFLOAT3(0, 0, 0);	// min corner of the first column, and the lowest voxel
+	float cellSize = 0.25f;
+	float cellHeight = 0.1f;
+	unsigned int width = 0, depth = 0;
+
+	// spans of column x + z * width are columnFirst[column] to columnFirst[column + 1], bottom to top
+	std::vector<unsigned int> columnFirst;
+	std::vector<Span> spans;
+	unsigned int regionCount = 0;
+
+	double buildMs = 0;
+};
+
+/**
+ * A* path queries over a NavMesh's floors. Keeps the per span search
+ * state between queries, so one per thread.
+ *
+ * Floors connect to their 4 neighbours and diagonally where both sides
+ * around the corner are open, the open list is a binary heap ordered by
+ * the octile distance estimate. The floor path is then smoothed by
+ * string pulling: corners are only kept where the straight line to the
+ * next floor leaves the walkable surface.
+ */
+class NavMeshQuery
+{
+public:
+	explicit NavMeshQuery(const NavMesh& navMesh);
+	~NavMeshQuery() = default;
+
+	// Corners from start to goal, both included as given. False if either is off the navmesh or they aren't connected
+	bool FindPath(const DirectX::XMFLOAT3& start, const DirectX::XMFLOAT3& goal, std::vector<DirectX::XMFLOAT3>& path);
+
+	// Same search between two spans, the floor path before smoothing
+	bool FindSpanPath(unsigned int start, unsigned int goal, std::vector<unsigned int>& spanPath);
+
+	// Spans taken off the open list by the last search
+	inline unsigned int GetLastExpanded() const { return lastExpanded; }
+
+	inline const NavMesh& GetNavMesh() const { return navMesh; }
+
+private:
+	struct OpenNode
+	{
+		float estimate;	// cost so far plus the heuristic
+		float cost;
+		unsigned int span;
+	};
+
+	// Heap order: lowest estimate first, the deeper node on ties
+	static bool Later(const OpenNode& a, const OpenNode& b);
+
+	void Reset();
+	float Heuristic(unsigned int span, unsigned int goal) const;
+	void Visit(unsigned int span, unsigned int from, float cost, unsigned int goal);
+
+	const NavMesh& navMesh;
+
+	// per span, only valid while visited[span] == searchId
+	std::vector<unsigned int> visited;
+	std::vector<float> costs;
+	std::vector<unsigned int> parents;
+	unsigned int searchId = 0;
+
+	std::vector<OpenNode> open;
+	std::vector<unsigned int> spanPath;
+	unsigned int lastExpanded = 0;
+};
@@ -2,16 +2,38 @@
 
 cbuffer ExternalData : register(b0) 
 {
-	Light lights[MAX_LIGHTS];
 	int lightCount;
 
 	float3 cameraPosition;
+	int lightingMode;
+
+	float2 clusterTileSize;
+	float clusterDepthScale;
+}
+
+// Uploaded for every draw, the rest only once per frame
+cbuffer ObjectData : register(b1)
+{
+	Light objectLights[MAX_OBJECT_LIGHTS];
+	int objectLightCount;
 	float shininess;
+	int bakedLighting;
+	float4 probeSH[IRRADIANCE_SH_COEFFICIENTS];
 }
 
 Texture2D diffuseTexture:		register(t0);
 Texture2D normalMap:			register(t1);
 
+// Every scene light, only the ones that changed are uploaded
+StructuredBuffer<Light> lights:				register(t3);
+
+// Filled by LightClusters on the CPU every frame
+StructuredBuffer<uint2> clusterRanges:		register(t4);
+StructuredBuffer<uint> clusterLightIndices:	register(t5);
+
+// Baked lights of the static geometry, see LightmapBaker
+Texture2D lightmap:		register(t2);
+
 SamplerState samplerOptions:	register(s0);
 
 float4 main( V2P_NormalMap input ) : SV_TARGET
@@ -39,33 +61,43 @@ float4 main( V2P_NormalMap input ) : SV_TARGET
 	pixelData.worldPos = input.worldPos;
 	pixelData.shininess = shininess;
 
-	for (int i = 0; i < lightCount; i++) 
+	if (lightingMode == LIGHTING_MODE_CLUSTERED)
+	{
+		// only the lights assigned to this pixel's cluster
+		uint2 range = clusterRanges[LightClusterIndex(input.position, clusterTileSize, clusterDepthScale)];
+		for (uint i = 0; i < range.y; i++)
+		{
+			Light light = lights[clusterLightIndices[range.x + i]];
+			if (bakedLighting == BAKED_LIGHTING_NONE || !light.baked)
+				finalLight += EvaluateLight(pixelData, cameraPosition, light);
+		}
+	}
+	else if (lightingMode == LIGHTING_MODE_PER_OBJECT)
+	{
+		// the strongest lights picked for this object on the CPU
+		for (int i = 0; i < objectLightCount; i++)
+		{
+			if (bakedLighting == BAKED_LIGHTING_NONE || !objectLights[i].baked)
+				finalLight += EvaluateLight(pixelData, cameraPosition, objectLights[i]);
+		}
+	}
+	else
 	{
-		// point light diffuse & spec
-		switch(lights[i].type) 
+		for (int i = 0; i < lightCount; i++)
 		{
-		case LIGHT_TYPE_POINT:
-			///
-			finalLight += PointLight(pixelData, cameraPosition, lights[i]);
-			///
-			break;
-		case LIGHT_TYPE_DIR:
-			///
-			finalLight += DirectionLight(pixelData, cameraPosition, lights[i]);
-			///
-			break;
-		case LIGHT_TYPE_SPOT:
-			///
-			finalLight += SpotLight(pixelData, cameraPosition, lights[i]);
-			///
-			break;
-		case LIGHT_TYPE_AMBIENT:
-			///
-			finalLight += AmbientLight(lights[i]);
-			///
-			break;
+			if (bakedLighting == BAKED_LIGHTING_NONE || !lights[i].baked)
+				finalLight += EvaluateLight(pixelData, cameraPosition, lights[i]);
 		}
 	}
 
+	if (bakedLighting == BAKED_LIGHTING_LIGHTMAP)
+	{
+		finalLight += lightmap.Sample(samplerOptions, input.lightmapUV).rgb;
+	}
+	else if (bakedLighting == BAKED_LIGHTING_PROBES)
+	{
+		finalLight += ProbeIrradiance(probeSH, input.normal);
+	}
+
 	return float4(finalLight * (float3)input.color, 1);
 }
\ No newline at end of file
@@ -22,6 +22,7 @@ V2P_NormalMap main( VertexShaderInput input )
 	output.color = colorTint;
 	output.worldPos = mul(world, float4(input.position, 1.0f)).xyz;
 	output.uv = input.uv;
+	output.lightmapUV = input.lightmapUV;
 
 	return output;
 }
\ No newline at end of file
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <vector>
+#include "Vertex.h"
+
+// Reads a triangulated or quad OBJ with positions, UVs and normals into one vertex per
+// index, converted to the left handed space (flipped Z, winding and V). Tangents aren't set.
+// False if the file can't be opened
+bool LoadObj(const char* fileName, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
@@ -0,0 +1,172 @@
+#include "ObjectLightSelector.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+using namespace DirectX;
+
+void ObjectLightSelector::BeginFrame(const Light* lights, unsigned int lightCount)
+{
+	this->lights = lights;
+
+	groups.clear();
+	groupLights.clear();
+	globalLights.clear();
+
+	std::vector<unsigned int> localLights;
+	for (unsigned int i = 0; i < lightCount; ++i)
+	{
+		if (lights[i].type == LIGHT_TYPE_DIR || lights[i].type == LIGHT_TYPE_AMBIENT)
+			globalLights.push_back(i);
+		else if (lights[i].range > 0.0f && lights[i].intensity > 0.0f)
+			localLights.push_back(i);
+	}
+
+	for (size_t first = 0; first < localLights.size(); first += 4)
+	{
+		// padding lanes keep a zero weight and never score
+		float lanes[10][4] = {};
+		uint32_t spot[4] = {};
+		for (unsigned int lane = 0; lane < 4; ++lane)
+		{
+			unsigned int index = first + lane < localLights.size() ? localLights[first + lane] : 0;
+			groupLights.push_back(index);
+			if (first + lane >= localLights.size())
+				continue;
+
+			const Light& light = lights[index];
+			float luminance = light.color.x * 0.299f + light.color.y * 0.587f + light.color.z * 0.114f;
+			float cosAngle = SpotCutoffCos(light);
+
+			lanes[0][lane] = light.position.x;
+			lanes[1][lane] = light.position.y;
+			lanes[2][lane] = light.position.z;
+			lanes[3][lane] = 1.0f / (light.range * light.range);
+			lanes[4][lane] = light.intensity * luminance;
+			lanes[5][lane] = light.direction.x;
+			lanes[6][lane] = light.direction.y;
+			lanes[7][lane] = light.direction.z;
+			lanes[8][lane] = cosAngle;
+			lanes[9][lane] = sqrtf(1.0f - cosAngle * cosAngle);
+			spot[lane] = light.type == LIGHT_TYPE_SPOT ? 0xFFFFFFFF : 0;
+		}
+
+		LightGroup group;
+		group.positionX = XMLoadFloat4((const XMFLOAT4*)lanes[0]);
+		group.positionY = XMLoadFloat4((const XMFLOAT4*)lanes[1]);
+		group.positionZ = XMLoadFloat4((const XMFLOAT4*)lanes[2]);
+		group.inverseRangeSq = XMLoadFloat4((const XMFLOAT4*)lanes[3]);
+		group.weight = XMLoadFloat4((const XMFLOAT4*)lanes[4]);
+		group.directionX = XMLoadFloat4((const XMFLOAT4*)lanes[5]);
+		group.directionY = XMLoadFloat4((const XMFLOAT4*)lanes[6]);
+		group.directionZ = XMLoadFloat4((const XMFLOAT4*)lanes[7]);
+		group.cosAngle = XMLoadFloat4((const XMFLOAT4*)lanes[8]);
+		group.sinAngle = XMLoadFloat4((const XMFLOAT4*)lanes[9]);
+		group.spotMask = XMLoadInt4(spot);
+		groups.push_back(group);
+	}
+}
+
+unsigned int ObjectLightSelector::Select(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax, const XMFLOAT4X4& world, ObjectLights& selection) const
+{
+	// world space box around the transformed local box
+	XMMATRIX worldMatrix = XMLoadFloat4x4(&world);
+	XMVECTOR worldMin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR worldMax = XMVectorReplicate(-FLT_MAX);
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		XMVECTOR point = XMVectorSet(
+			(corner & 1) ? boundsMax.x : boundsMin.x,
+			(corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z,
+			1.0f);
+		point = XMVector3TransformCoord(point, worldMatrix);
+		worldMin = XMVectorMin(worldMin, point);
+		worldMax = XMVectorMax(worldMax, point);
+	}
+
+	XMFLOAT3 boxMin, boxMax, center;
+	XMStoreFloat3(&boxMin, worldMin);
+	XMStoreFloat3(&boxMax, worldMax);
+	XMStoreFloat3(&center, XMVectorScale(XMVectorAdd(worldMin, worldMax), 0.5f));
+	float radius = XMVectorGetX(XMVector3Length(XMVectorScale(XMVectorSubtract(worldMax, worldMin), 0.5f)));
+
+	// kept sorted by score, strongest first
+	float scores[MAX_OBJECT_LIGHTS];
+	unsigned int picked[MAX_OBJECT_LIGHTS];
+	unsigned int count = 0;
+	unsigned int reaching = 0;
+
+	for (unsigned int light : globalLights)
+	{
+		reaching++;
+		if (count < MAX_OBJECT_LIGHTS)
+		{
+			scores[count] = FLT_MAX;
+			picked[count++] = light;
+		}
+	}
+
+	XMVECTOR minX = XMVectorReplicate(boxMin.x), minY = XMVectorReplicate(boxMin.y), minZ = XMVectorReplicate(boxMin.z);
+	XMVECTOR maxX = XMVectorReplicate(boxMax.x), maxY = XMVectorReplicate(boxMax.y), maxZ = XMVectorReplicate(boxMax.z);
+	XMVECTOR centerX = XMVectorReplicate(center.x), centerY = XMVectorReplicate(center.y), centerZ = XMVectorReplicate(center.z);
+	XMVECTOR sphereRadius = XMVectorReplicate(radius);
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR one = XMVectorSplatOne();
+
+	for (size_t g = 0; g < groups.size(); ++g)
+	{
+		const LightGroup& group = groups[g];
+
+		// squared distance from each light to the closest point of the box
+		XMVECTOR dx = XMVectorMax(XMVectorMax(XMVectorSubtract(minX, group.positionX), XMVectorSubtract(group.positionX, maxX)), zero);
+		XMVECTOR dy = XMVectorMax(XMVectorMax(XMVectorSubtract(minY, group.positionY), XMVectorSubtract(group.positionY, maxY)), zero);
+		XMVECTOR dz = XMVectorMax(XMVectorMax(XMVectorSubtract(minZ, group.positionZ), XMVectorSubtract(group.positionZ, maxZ)), zero);
+		XMVECTOR distSq = XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz)));
+
+		// Attenuate() from ShaderIncludes.hlsli
+		XMVECTOR attenuation = XMVectorSaturate(XMVectorSubtract(one, XMVectorMultiply(distSq, group.inverseRangeSq)));
+		XMVECTOR score = XMVectorMultiply(XMVectorMultiply(attenuation, attenuation), group.weight);
+
+		// spot cones against the bounding sphere, range is already covered by the attenuation
+		XMVECTOR vx = XMVectorSubtract(centerX, group.positionX);
+		XMVECTOR vy = XMVectorSubtract(centerY, group.positionY);
+		XMVECTOR vz = XMVectorSubtract(centerZ, group.positionZ);
+		XMVECTOR lengthSq = XMVectorMultiplyAdd(vx, vx, XMVectorMultiplyAdd(vy, vy, XMVectorMultiply(vz, vz)));
+		XMVECTOR alongAxis = XMVectorMultiplyAdd(vx, group.directionX, XMVectorMultiplyAdd(vy, group.directionY, XMVectorMultiply(vz, group.directionZ)));
+		XMVECTOR offAxis = XMVectorSqrt(XMVectorMax(XMVectorSubtract(lengthSq, XMVectorMultiply(alongAxis, alongAxis)), zero));
+		XMVECTOR toCone = XMVectorSubtract(XMVectorMultiply(group.cosAngle, offAxis), XMVectorMultiply(alongAxis, group.sinAngle));
+		XMVECTOR outsideCone = XMVectorOrInt(XMVectorGreater(toCone, sphereRadius), XMVectorLess(alongAxis, XMVectorNegate(sphereRadius)));
+		score = XMVectorSelect(score, zero, XMVectorAndInt(outsideCone, group.spotMask));
+
+		float laneScores[4];
+		XMStoreFloat4((XMFLOAT4*)laneScores, score);
+		for (unsigned int lane = 0; lane < 4; ++lane)
+		{
+			float laneScore = laneScores[lane];
+			if (laneScore <= 0.0f)
+				continue;
+
+			reaching++;
+			if (count == MAX_OBJECT_LIGHTS && laneScore <= scores[count - 1])
+				continue;
+
+			// insertion into the sorted top list, dropping the weakest when full
+			unsigned int slot = count < MAX_OBJECT_LIGHTS ? count++ : count - 1;
+			while (slot > 0 && scores[slot - 1] < laneScore)
+			{
+				scores[slot] = scores[slot - 1];
+				picked[slot] = picked[slot - 1];
+				slot--;
+			}
+			scores[slot] = laneScore;
+			picked[slot] = groupLights[g * 4 + lane];
+		}
+	}
+
+	selection.count = count;
+	for (unsigned int i = 0; i < count; ++i)
+		selection.lights[i] = lights[picked[i]];
+
+	return reaching;
+}
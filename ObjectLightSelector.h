@@ -0,0 +1,51 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Lights.h"
+
+/**
+ * Picks the MAX_OBJECT_LIGHTS strongest lights for an object, the per
+ * object alternative to clustered lighting (LIGHTING_MODE_PER_OBJECT).
+ *
+ * Lights are scored by the same falloff the shaders use, evaluated at the
+ * point of the object's world space box closest to the light and weighted
+ * by intensity and luminance. Spot lights whose cone misses the object's
+ * bounding sphere score zero. Directional and ambient lights reach
+ * everything and are always picked first.
+ *
+ * BeginFrame() repacks the lights into groups of four so every object
+ * scores four lights per step. Select() only reads, so objects can be
+ * processed in parallel.
+ */
+class ObjectLightSelector
+{
+public:
+	ObjectLightSelector() = default;
+	~ObjectLightSelector() = default;
+
+	// The lights are copied into the selections, so they only have to stay valid until the last Select()
+	void BeginFrame(const Light* lights, unsigned int lightCount);
+
+	// Fills the selection for a box in the space of the world matrix.
+	// Returns how many lights reach the box, which can be more than what fits in the selection
+	unsigned int Select(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax, const DirectX::XMFLOAT4X4& world, ObjectLights& selection) const;
+
+private:
+	// Four point/spot lights in SoA form
+	struct LightGroup
+	{
+		DirectX::XMVECTOR positionX, positionY, positionZ;
+		DirectX::XMVECTOR inverseRangeSq;
+		DirectX::XMVECTOR weight;	// intensity * luminance, 0 for padding lanes
+		DirectX::XMVECTOR directionX, directionY, directionZ;
+		DirectX::XMVECTOR cosAngle, sinAngle;
+		DirectX::XMVECTOR spotMask;
+	};
+
+	const Light* lights = nullptr;
+
+	std::vector<LightGroup> groups;
+	std::vector<unsigned int> groupLights;	// light index of every group lane
+	std::vector<unsigned int> globalLights;
+};
@@ -0,0 +1,429 @@
+#include "OcclusionCuller.h"
+#include <cmath>
+#include <utility>
+#include <ppl.h>
+
+using namespace DirectX;
+using namespace Concurrency;
+
+// Triangles smaller than this (in pixels squared) cover no pixel centers worth testing
+#define OCCLUSION_MIN_TRIANGLE_AREA 1e-4f
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height)
+{
+	// round up to whole tiles so no tile has to handle partial rows
+	this->width = ((width + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH) * OCCLUSION_TILE_WIDTH;
+	this->height = ((height + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT) * OCCLUSION_TILE_HEIGHT;
+	tilesX = this->width / OCCLUSION_TILE_WIDTH;
+	tilesY = this->height / OCCLUSION_TILE_HEIGHT;
+	tileBins.resize(tilesX * tilesY);
+
+	tileLevels = 0;
+	while ((OCCLUSION_TILE_WIDTH >> (tileLevels + 1)) >= 1 && (OCCLUSION_TILE_HEIGHT >> (tileLevels + 1)) >= 1)
+		tileLevels++;
+
+	unsigned int levelWidth = this->width;
+	unsigned int levelHeight = this->height;
+	while (true)
+	{
+		levelWidths.push_back(levelWidth);
+		levelHeights.push_back(levelHeight);
+		hiZ.push_back(std::vector<float>(levelWidth * levelHeight, 1.0f));
+
+		if (levelWidth == 1 && levelHeight == 1)
+			break;
+
+		levelWidth = levelWidth > 1 ? (levelWidth + 1) / 2 : 1;
+		levelHeight = levelHeight > 1 ? (levelHeight + 1) / 2 : 1;
+	}
+
+	XMStoreFloat4x4(&viewProj, XMMatrixIdentity());
+}
+
+void OcclusionCuller::BeginFrame(const XMFLOAT4X4& view, const XMFLOAT4X4& proj)
+{
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&proj)));
+
+	triangles.clear();
+	for (std::vector<unsigned int>& bin : tileBins)
+		bin.clear();
+}
+
+void OcclusionCuller::AddOccluder(const XMFLOAT3* positions, const unsigned int* indices, size_t indexCount, const XMFLOAT4X4& world)
+{
+	XMMATRIX worldViewProj = XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&viewProj));
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		XMVECTOR clip[3];
+		for (int v = 0; v < 3; ++v)
+		{
+			XMVECTOR position = XMVectorSetW(XMLoadFloat3(&positions[indices[i + v]]), 1.0f);
+			clip[v] = XMVector4Transform(position, worldViewProj);
+		}
+
+		AddClippedTriangle(clip);
+	}
+}
+
+// --------------------------------------------------------
+// Clips against the near plane (z >= 0 in D3D clip space),
+// which turns the triangle into up to a quad, then projects
+// the pieces to pixels. Triangles completely outside one of
+// the side planes are dropped before any of that.
+// --------------------------------------------------------
+void OcclusionCuller::AddClippedTriangle(const XMVECTOR clip[3])
+{
+	XMFLOAT4 v[3];
+	for (int i = 0; i < 3; ++i)
+		XMStoreFloat4(&v[i], clip[i]);
+
+	if ((v[0].x > v[0].w && v[1].x > v[1].w && v[2].x > v[2].w) ||
+		(v[0].x < -v[0].w && v[1].x < -v[1].w && v[2].x < -v[2].w) ||
+		(v[0].y > v[0].w && v[1].y > v[1].w && v[2].y > v[2].w) ||
+		(v[0].y < -v[0].w && v[1].y < -v[1].w && v[2].y < -v[2].w) ||
+		(v[0].z < 0.0f && v[1].z < 0.0f && v[2].z < 0.0f))
+		return;
+
+	XMVECTOR polygon[4];
+	int polygonCount = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		int next = (i + 1) % 3;
+		float d0 = v[i].z;
+		float d1 = v[next].z;
+
+		if (d0 >= 0.0f)
+			polygon[polygonCount++] = clip[i];
+
+		if ((d0 >= 0.0f) != (d1 >= 0.0f))
+			polygon[polygonCount++] = XMVectorLerp(clip[i], clip[next], d0 / (d0 - d1));
+	}
+
+	XMFLOAT3 projected[4];
+	for (int i = 0; i < polygonCount; ++i)
+	{
+		XMFLOAT4 p;
+		XMStoreFloat4(&p, polygon[i]);
+
+		float invW = 1.0f / p.w;
+		projected[i].x = (p.x * invW * 0.5f + 0.5f) * width;
+		projected[i].y = (0.5f - p.y * invW * 0.5f) * height;
+		projected[i].z = p.z * invW;
+	}
+
+	// fan triangulation of the clipped polygon
+	for (int i = 1; i + 1 < polygonCount; ++i)
+	{
+		ScreenTriangle triangle;
+		const XMFLOAT3* corners[3] = { &projected[0], &projected[i], &projected[i + 1] };
+		for (int c = 0; c < 3; ++c)
+		{
+			triangle.x[c] = corners[c]->x;
+			triangle.y[c] = corners[c]->y;
+			triangle.z[c] = corners[c]->z;
+		}
+
+		BinTriangle(triangle);
+	}
+}
+
+void OcclusionCuller::BinTriangle(const ScreenTriangle& input)
+{
+	ScreenTriangle triangle = input;
+
+	// both facings occlude: flip clockwise triangles so the edge functions are positive inside
+	float area = (triangle.x[2] - triangle.x[1]) * (triangle.y[0] - triangle.y[1]) - (triangle.y[2] - triangle.y[1]) * (triangle.x[0] - triangle.x[1]);
+	if (area < 0.0f)
+	{
+		std::swap(triangle.x[1], triangle.x[2]);
+		std::swap(triangle.y[1], triangle.y[2]);
+		std::swap(triangle.z[1], triangle.z[2]);
+		area = -area;
+	}
+	if (area < OCCLUSION_MIN_TRIANGLE_AREA)
+		return;
+
+	float minX = fminf(triangle.x[0], fminf(triangle.x[1], triangle.x[2]));
+	float maxX = fmaxf(triangle.x[0], fmaxf(triangle.x[1], triangle.x[2]));
+	float minY = fminf(triangle.y[0], fminf(triangle.y[1], triangle.y[2]));
+	float maxY = fmaxf(triangle.y[0], fmaxf(triangle.y[1], triangle.y[2]));
+	if (maxX < 0.0f || maxY < 0.0f || minX >= (float)width || minY >= (float)height)
+		return;
+
+	int tileMinX = (int)fmaxf(minX, 0.0f) / OCCLUSION_TILE_WIDTH;
+	int tileMaxX = (int)fminf(maxX, (float)(width - 1)) / OCCLUSION_TILE_WIDTH;
+	int tileMinY = (int)fmaxf(minY, 0.0f) / OCCLUSION_TILE_HEIGHT;
+	int tileMaxY = (int)fminf(maxY, (float)(height - 1)) / OCCLUSION_TILE_HEIGHT;
+
+	unsigned int index = (unsigned int)triangles.size();
+	triangles.push_back(triangle);
+
+	for (int ty = tileMinY; ty <= tileMaxY; ++ty)
+	{
+		for (int tx = tileMinX; tx <= tileMaxX; ++tx)
+			tileBins[ty * tilesX + tx].push_back(index);
+	}
+}
+
+void OcclusionCuller::Rasterize()
+{
+	// tiles own disjoint pixels at every level they build, so they never share writes
+	parallel_for
+	(
+		size_t(0), tileBins.size(), [&](size_t tile)
+		{
+			RasterizeTile((unsigned int)tile);
+			BuildTileHiZ((unsigned int)tile);
+		},
+		static_partitioner()
+	);
+
+	BuildUpperHiZ();
+}
+
+// --------------------------------------------------------
+// Half-space rasterization, one row of 4 pixel centers per
+// step. Edge functions and depth are planes in screen space
+// (post projection z is linear in x/y), so each lane is just
+// a multiply-add from the row start.
+// --------------------------------------------------------
+void OcclusionCuller::RasterizeTile(unsigned int tile)
+{
+	unsigned int tileMinX = (tile % tilesX) * OCCLUSION_TILE_WIDTH;
+	unsigned int tileMinY = (tile / tilesX) * OCCLUSION_TILE_HEIGHT;
+	unsigned int tileMaxX = tileMinX + OCCLUSION_TILE_WIDTH - 1;
+	unsigned int tileMaxY = tileMinY + OCCLUSION_TILE_HEIGHT - 1;
+
+	float* depth = hiZ[0].data();
+	for (unsigned int y = tileMinY; y <= tileMaxY; ++y)
+	{
+		for (unsigned int x = tileMinX; x <= tileMaxX; ++x)
+			depth[y * width + x] = 1.0f;
+	}
+
+	const XMVECTOR laneOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	const XMVECTOR zero = XMVectorZero();
+
+	for (unsigned int index : tileBins[tile])
+	{
+		const ScreenTriangle& t = triangles[index];
+
+		// E_i(x, y) = a_i * x + b_i * y + c_i for the edge opposite vertex i
+		float a[3], b[3], c[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			int v0 = (i + 1) % 3;
+			int v1 = (i + 2) % 3;
+			a[i] = t.y[v0] - t.y[v1];
+			b[i] = t.x[v1] - t.x[v0];
+			c[i] = t.x[v0] * t.y[v1] - t.y[v0] * t.x[v1];
+		}
+
+		float area = a[0] * t.x[0] + b[0] * t.y[0] + c[0];
+		float invArea = 1.0f / area;
+
+		// depth plane from the barycentric weights E_i / area
+		float zA = (t.z[0] * a[0] + t.z[1] * a[1] + t.z[2] * a[2]) * invArea;
+		float zB = (t.z[0] * b[0] + t.z[1] * b[1] + t.z[2] * b[2]) * invArea;
+		float zC = (t.z[0] * c[0] + t.z[1] * c[1] + t.z[2] * c[2]) * invArea;
+
+		float minX = fminf(t.x[0], fminf(t.x[1], t.x[2]));
+		float maxX = fmaxf(t.x[0], fmaxf(t.x[1], t.x[2]));
+		float minY = fminf(t.y[0], fminf(t.y[1], t.y[2]));
+		float maxY = fmaxf(t.y[0], fmaxf(t.y[1], t.y[2]));
+
+		int startX = (int)fmaxf((float)tileMinX, floorf(minX));
+		int endX = (int)fminf((float)tileMaxX, ceilf(maxX));
+		int startY = (int)fmaxf((float)tileMinY, floorf(minY));
+		int endY = (int)fminf((float)tileMaxY, ceilf(maxY));
+		if (startX > endX || startY > endY)
+			continue;
+
+		// SIMD rows start on a multiple of 4, tiles are 4 aligned so this never leaves the tile
+		startX &= ~3;
+
+		XMVECTOR a0 = XMVectorReplicate(a[0]);
+		XMVECTOR a1 = XMVectorReplicate(a[1]);
+		XMVECTOR a2 = XMVectorReplicate(a[2]);
+		XMVECTOR za = XMVectorReplicate(zA);
+
+		for (int y = startY; y <= endY; ++y)
+		{
+			float py = (float)y + 0.5f;
+			XMVECTOR rowE0 = XMVectorReplicate(b[0] * py + c[0]);
+			XMVECTOR rowE1 = XMVectorReplicate(b[1] * py + c[1]);
+			XMVECTOR rowE2 = XMVectorReplicate(b[2] * py + c[2]);
+			XMVECTOR rowZ = XMVectorReplicate(zB * py + zC);
+
+			float* row = depth + y * width;
+			for (int x = startX; x <= endX; x += 4)
+			{
+				XMVECTOR px = XMVectorAdd(XMVectorReplicate((float)x), laneOffsets);
+
+				XMVECTOR e0 = XMVectorMultiplyAdd(a0, px, rowE0);
+				XMVECTOR e1 = XMVectorMultiplyAdd(a1, px, rowE1);
+				XMVECTOR e2 = XMVectorMultiplyAdd(a2, px, rowE2);
+
+				XMVECTOR inside = XMVectorAndInt(
+					XMVectorAndInt(XMVectorGreaterOrEqual(e0, zero), XMVectorGreaterOrEqual(e1, zero)),
+					XMVectorGreaterOrEqual(e2, zero));
+				if (XMVector4EqualInt(inside, XMVectorFalseInt()))
+					continue;
+
+				XMVECTOR z = XMVectorMultiplyAdd(za, px, rowZ);
+				XMVECTOR current = XMLoadFloat4((const XMFLOAT4*)(row + x));
+				current = XMVectorSelect(current, XMVectorMin(current, z), inside);
+				XMStoreFloat4((XMFLOAT4*)(row + x), current);
+			}
+		}
+	}
+}
+
+void OcclusionCuller::BuildTileHiZ(unsigned int tile)
+{
+	unsigned int tileX = (tile % tilesX) * OCCLUSION_TILE_WIDTH;
+	unsigned int tileY = (tile / tilesX) * OCCLUSION_TILE_HEIGHT;
+
+	for (unsigned int level = 1; level <= tileLevels && level < hiZ.size(); ++level)
+	{
+		const std::vector<float>& source = hiZ[level - 1];
+		std::vector<float>& target = hiZ[level];
+		unsigned int sourceWidth = levelWidths[level - 1];
+		unsigned int targetWidth = levelWidths[level];
+
+		unsigned int minX = tileX >> level;
+		unsigned int minY = tileY >> level;
+		unsigned int maxX = minX + (OCCLUSION_TILE_WIDTH >> level);
+		unsigned int maxY = minY + (OCCLUSION_TILE_HEIGHT >> level);
+
+		for (unsigned int y = minY; y < maxY; ++y)
+		{
+			const float* row0 = &source[(y * 2) * sourceWidth];
+			const float* row1 = row0 + sourceWidth;
+			for (unsigned int x = minX; x < maxX; ++x)
+			{
+				target[y * targetWidth + x] = fmaxf(fmaxf(row0[x * 2], row0[x * 2 + 1]), fmaxf(row1[x * 2], row1[x * 2 + 1]));
+			}
+		}
+	}
+}
+
+void OcclusionCuller::BuildUpperHiZ()
+{
+	for (size_t level = tileLevels + 1; level < hiZ.size(); ++level)
+	{
+		const std::vector<float>& source = hiZ[level - 1];
+		std::vector<float>& target = hiZ[level];
+		unsigned int sourceWidth = levelWidths[level - 1];
+		unsigned int sourceHeight = levelHeights[level - 1];
+
+		for (unsigned int y = 0; y < levelHeights[level]; ++y)
+		{
+			for (unsigned int x = 0; x < levelWidths[level]; ++x)
+			{
+				// odd sized levels clamp to the last row/column
+				unsigned int x0 = x * 2;
+				unsigned int y0 = y * 2;
+				unsigned int x1 = x0 + 1 < sourceWidth ? x0 + 1 : x0;
+				unsigned int y1 = y0 + 1 < sourceHeight ? y0 + 1 : y0;
+
+				target[y * levelWidths[level] + x] = fmaxf(
+					fmaxf(source[y0 * sourceWidth + x0], source[y0 * sourceWidth + x1]),
+					fmaxf(source[y1 * sourceWidth + x0], source[y1 * sourceWidth + x1]));
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Projects the box corners and compares the nearest one
+// against the farthest occluder depth over the box's screen
+// rectangle. The HiZ level is picked so the rectangle spans
+// at most a few texels.
+// --------------------------------------------------------
+bool OcclusionCuller::IsVisible(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax, const XMFLOAT4X4& world) const
+{
+	XMMATRIX worldViewProj = XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&viewProj));
+
+	float minX = 1.0f, maxX = -1.0f, minY = 1.0f, maxY = -1.0f, minZ = 1.0f;
+	bool first = true;
+	int cornersBehindNear = 0;
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		XMVECTOR local = XMVectorSet(
+			(corner & 1) ? boundsMax.x : boundsMin.x,
+			(corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z,
+			1.0f);
+
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector4Transform(local, worldViewProj));
+
+		// corners closer than the near plane have no usable projection
+		if (clip.z < 0.0f)
+		{
+			cornersBehindNear++;
+			continue;
+		}
+
+		float invW = 1.0f / clip.w;
+		float x = clip.x * invW;
+		float y = clip.y * invW;
+		float z = clip.z * invW;
+
+		if (first)
+		{
+			minX = maxX = x;
+			minY = maxY = y;
+			minZ = z;
+			first = false;
+		}
+		else
+		{
+			minX = fminf(minX, x);
+			maxX = fmaxf(maxX, x);
+			minY = fminf(minY, y);
+			maxY = fmaxf(maxY, y);
+			minZ = fminf(minZ, z);
+		}
+	}
+
+	// entirely behind the camera, or crossing the near plane where no screen rectangle exists
+	if (cornersBehindNear == 8)
+		return false;
+	if (cornersBehindNear > 0)
+		return true;
+
+	// outside the frustum entirely
+	if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f || minZ > 1.0f)
+		return false;
+
+	int pixelMinX = (int)floorf((minX * 0.5f + 0.5f) * width);
+	int pixelMaxX = (int)floorf((maxX * 0.5f + 0.5f) * width);
+	int pixelMinY = (int)floorf((0.5f - maxY * 0.5f) * height);
+	int pixelMaxY = (int)floorf((0.5f - minY * 0.5f) * height);
+
+	pixelMinX = pixelMinX < 0 ? 0 : pixelMinX;
+	pixelMinY = pixelMinY < 0 ? 0 : pixelMinY;
+	pixelMaxX = pixelMaxX >= (int)width ? (int)width - 1 : pixelMaxX;
+	pixelMaxY = pixelMaxY >= (int)height ? (int)height - 1 : pixelMaxY;
+
+	int extent = (pixelMaxX - pixelMinX) > (pixelMaxY - pixelMinY) ? (pixelMaxX - pixelMinX) : (pixelMaxY - pixelMinY);
+	unsigned int level = 0;
+	while ((extent >> level) > 2 && level + 1 < hiZ.size())
+		level++;
+
+	const std::vector<float>& depth = hiZ[level];
+	unsigned int levelWidth = levelWidths[level];
+	for (int y = pixelMinY >> level; y <= (pixelMaxY >> level); ++y)
+	{
+		for (int x = pixelMinX >> level; x <= (pixelMaxX >> level); ++x)
+		{
+			if (minZ <= depth[y * levelWidth + x])
+				return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// Default resolution of the software depth buffer, both multiples of the tile size
+#define OCCLUSION_BUFFER_WIDTH 256
+#define OCCLUSION_BUFFER_HEIGHT 128
+
+// Tiles are rasterized in parallel. Width has to be a multiple of 4 (one SIMD row)
+#define OCCLUSION_TILE_WIDTH 32
+#define OCCLUSION_TILE_HEIGHT 32
+
+/**
+ * CPU occlusion culling against a small software depth buffer.
+ *
+ * Each frame a few large occluders (room meshes) are transformed, clipped
+ * against the near plane and binned into screen tiles. Tiles are then
+ * rasterized in parallel, 4 pixels at a time, keeping the closest depth.
+ * A max-depth mip chain (HiZ) is built on top so bounding boxes can be
+ * tested against a handful of texels regardless of their screen size.
+ *
+ * The test is conservative: boxes that cross the near plane or touch any
+ * pixel no occluder covers are always visible.
+ */
+class OcclusionCuller
+{
+public:
+	OcclusionCuller(unsigned int width = OCCLUSION_BUFFER_WIDTH, unsigned int height = OCCLUSION_BUFFER_HEIGHT);
+	~OcclusionCuller() = default;
+
+	// Clears the depth buffer and drops last frame's occluders
+	void BeginFrame(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& proj);
+
+	// Transforms, clips and bins a triangle list. The data is only read during this call
+	void AddOccluder(const DirectX::XMFLOAT3* positions, const unsigned int* indices, size_t indexCount, const DirectX::XMFLOAT4X4& world);
+
+	// Rasterizes every binned triangle and builds the HiZ chain
+	void Rasterize();
+
+	// False if the box (in the space of the world matrix) is hidden behind occluders or outside the view
+	bool IsVisible(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax, const DirectX::XMFLOAT4X4& world) const;
+
+	inline unsigned int GetWidth() const { return width; }
+	inline unsigned int GetHeight() const { return height; }
+	inline size_t GetOccluderTriangleCount() const { return triangles.size(); }
+
+	// Depth after Rasterize(), 0 is the near plane and 1 is the far plane / empty
+	inline const float* GetDepthBuffer() const { return hiZ[0].data(); }
+
+private:
+	// Screen space triangle: pixels for x/y, post projection depth for z
+	struct ScreenTriangle
+	{
+		float x[3];
+		float y[3];
+		float z[3];
+	};
+
+	void AddClippedTriangle(const DirectX::XMVECTOR clip[3]);
+	void BinTriangle(const ScreenTriangle& triangle);
+	void RasterizeTile(unsigned int tile);
+	void BuildTileHiZ(unsigned int tile);
+	void BuildUpperHiZ();
+
+	unsigned int width;
+	unsigned int height;
+	unsigned int tilesX;
+	unsigned int tilesY;
+
+	// Levels of HiZ that fit inside a single tile and are built by the tile's worker
+	unsigned int tileLevels;
+
+	DirectX::XMFLOAT4X4 viewProj;
+
+	std::vector<ScreenTriangle> triangles;
+	std::vector<std::vector<unsigned int>> tileBins;
+
+	// hiZ[0] is the full resolution depth buffer, every other level keeps the max of 2x2 texels
+	std::vector<std::vector<float>> hiZ;
+	std::vector<unsigned int> levelWidths;
+	std::vector<unsigned int> levelHeights;
+};
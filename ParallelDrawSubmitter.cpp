@@ -0,0 +1,69 @@
+#include "ParallelDrawSubmitter.h"
+#include <algorithm>
+#include <ppl.h>
+
+using namespace Concurrency;
+
+ParallelDrawSubmitter::ParallelDrawSubmitter(size_t minItemsPerWorker)
+{
+	this->minItemsPerWorker = minItemsPerWorker > 0 ? minItemsPerWorker : 1;
+}
+
+void ParallelDrawSubmitter::SortDrawList(std::vector<DrawItem>& drawList)
+{
+	std::stable_sort(drawList.begin(), drawList.end(), [](const DrawItem& lhs, const DrawItem& rhs)
+		{
+			return lhs.sortKey < rhs.sortKey;
+		});
+}
+
+// --------------------------------------------------------
+// Contiguous ranges keep the sorted order intact: executing
+// the ranges front to back reproduces the serial draw order.
+// Small lists use fewer workers so each one has enough work
+// to be worth the command list overhead.
+// --------------------------------------------------------
+void ParallelDrawSubmitter::Partition(size_t itemCount, unsigned int workerCount, size_t minItemsPerWorker, std::vector<DrawRange>& outRanges)
+{
+	outRanges.clear();
+	if (itemCount == 0 || workerCount == 0)
+		return;
+
+	size_t maxUsefulWorkers = (itemCount + minItemsPerWorker - 1) / minItemsPerWorker;
+	size_t rangeCount = (std::min)((size_t)workerCount, maxUsefulWorkers);
+
+	size_t baseSize = itemCount / rangeCount;
+	size_t remainder = itemCount % rangeCount;
+
+	size_t begin = 0;
+	for (size_t i = 0; i < rangeCount; ++i)
+	{
+		// spread the remainder over the first ranges
+		size_t size = baseSize + (i < remainder ? 1 : 0);
+		outRanges.push_back({ begin, begin + size });
+		begin += size;
+	}
+}
+
+void ParallelDrawSubmitter::Submit(const std::vector<DrawItem>& sortedDrawList, IDrawRecorder* recorder)
+{
+	Partition(sortedDrawList.size(), recorder->GetWorkerCount(), minItemsPerWorker, ranges);
+	if (ranges.empty())
+		return;
+
+	const DrawItem* items = sortedDrawList.data();
+	parallel_for
+	(
+		size_t(0), ranges.size(), [&](size_t i)
+		{
+			recorder->Record((unsigned int)i, items + ranges[i].begin, ranges[i].end - ranges[i].begin);
+		},
+		static_partitioner()
+	);
+
+	// merge: replay in partition order so the final result matches the serial path
+	for (size_t i = 0; i < ranges.size(); ++i)
+	{
+		recorder->Execute((unsigned int)i);
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class Entity;
+
+// A single opaque draw in the frame's sorted draw list
+struct DrawItem
+{
+	class Entity* entity;
+
+	// Items are sorted by this key so draws sharing shaders/materials end up adjacent
+	unsigned long long sortKey;
+};
+
+// A contiguous slice [begin, end) of the sorted draw list handed to one worker
+struct DrawRange
+{
+	size_t begin;
+	size_t end;
+};
+
+/**
+ * Anything that can record a slice of the draw list on a worker thread
+ * and later replay it on the submitting thread.
+ * The D3D11 implementation records into deferred contexts, but a plain
+ * CPU stand-in can implement this to verify partition/merge ordering.
+ */
+class IDrawRecorder
+{
+public:
+	virtual ~IDrawRecorder() = default;
+
+	// Number of independent recording slots, one per worker thread
+	virtual unsigned int GetWorkerCount() const = 0;
+
+	// Called from a worker thread. Records items[0..count) into the given slot
+	virtual void Record(unsigned int worker, const DrawItem* items, size_t count) = 0;
+
+	// Called from the submitting thread once every worker is done, in partition order
+	virtual void Execute(unsigned int worker) = 0;
+};
+
+class ParallelDrawSubmitter
+{
+public:
+	ParallelDrawSubmitter(size_t minItemsPerWorker = 4);
+	~ParallelDrawSubmitter() = default;
+
+	// Sorts the list by sortKey. Stable, so equal keys keep their submission order
+	static void SortDrawList(std::vector<DrawItem>& drawList);
+
+	// Splits itemCount items into at most workerCount contiguous, balanced ranges
+	static void Partition(size_t itemCount, unsigned int workerCount, size_t minItemsPerWorker, std::vector<DrawRange>& outRanges);
+
+	// Records every range in parallel, then executes the recorded work in list order
+	void Submit(const std::vector<DrawItem>& sortedDrawList, class IDrawRecorder* recorder);
+
+	inline const std::vector<DrawRange>& GetLastRanges() const { return ranges; }
+
+private:
+	size_t minItemsPerWorker;
+	std::vector<DrawRange> ranges;
+};
@@ -0,0 +1,500 @@
+#include "PathRequestService.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "NavHierarchy.h"
+#include "NavMesh.h"
+
+using namespace DirectX;
+
+// Floors further apart in height than this are in different cache cells, a path from one storey isn't one from the other
+#define PATH_CACHE_LEVEL_HEIGHT 2.0f
+
+namespace
+{
+	double MsSince(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+PathRequestService::PathRequestService(const NavMesh& navMesh, const NavHierarchy* hierarchy, const PathRequestSettings& settings)
+	: navMesh(navMesh), hierarchy(hierarchy), settings(settings)
+{
+	this->settings.cacheCellColumns = (std::max)(1u, settings.cacheCellColumns);
+	cellsX = (navMesh.GetWidth() + this->settings.cacheCellColumns - 1) / this->settings.cacheCellColumns;
+	cellsZ = (navMesh.GetDepth() + this->settings.cacheCellColumns - 1) / this->settings.cacheCellColumns;
+
+	latencyMs.resize(PATH_LATENCY_SAMPLES);
+	latencyFrames.resize(PATH_LATENCY_SAMPLES);
+
+	unsigned int workerCount = settings.workerCount;
+	if (workerCount == 0)
+		workerCount = (std::max)(2u, std::thread::hardware_concurrency()) - 1;
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers.push_back(std::thread(&PathRequestService::WorkerLoop, this));
+}
+
+PathRequestService::~PathRequestService()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+
+	// the shared jobs are all in jobs, queued or finished
+	for (Job* job : queued)
+	{
+		if (!job->shared)
+			delete job;
+	}
+	for (Job* job : finished)
+	{
+		if (!job->shared)
+			delete job;
+	}
+	for (auto& job : jobs)
+		delete job.second;
+}
+
+// --------------------------------------------------------
+// One worker: takes the oldest queued search while the
+// frame's budget lasts. Each has its own query, they keep
+// their search state between paths. Tickets that joined a
+// shared search but whose ends don't fit its path are
+// queued again on their own right away, so Flush() still
+// waits for every path
+// --------------------------------------------------------
+void PathRequestService::WorkerLoop()
+{
+	NavMeshQuery flatQuery(navMesh);
+	NavHierarchyQuery* hierarchyQuery = hierarchy ? new NavHierarchyQuery(*hierarchy) : nullptr;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [this]() {
+			return stopping || (!queued.empty() && (flushing || settings.frameBudgetMs <= 0.0 || frameSpentMs < settings.frameBudgetMs));
+		});
+		if (stopping)
+			break;
+
+		Job* job = queued.front();
+		queued.pop_front();
+		running++;
+		lock.unlock();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		if (hierarchyQuery)
+			job->found = hierarchyQuery->FindPath(job->start, job->goal, job->path, true);
+		else
+			job->found = flatQuery.FindPath(job->start, job->goal, job->path);
+		double ms = MsSince(start);
+
+		lock.lock();
+		frameSpentMs += ms;
+		stats.searches++;
+		stats.searchMs += ms;
+		if (!job->found)
+			stats.failed++;
+
+		// the first ticket is the one the search was for
+		for (size_t i = 1; job->shared && i < job->tickets.size();)
+		{
+			auto ticket = tickets.find(job->tickets[i]);
+			if (ticket == tickets.end() || Fits(ticket->second, job->found, job->path))
+			{
+				i++;
+				continue;
+			}
+			QueueOwnSearch(job->tickets[i], ticket->second);
+			stats.coalesced--;
+			job->tickets[i] = job->tickets.back();
+			job->tickets.pop_back();
+		}
+		if (!queued.empty())
+			wake.notify_one();
+
+		job->done = true;
+		finished.push_back(job);
+		running--;
+		idle.notify_all();
+	}
+
+	delete hierarchyQuery;
+}
+
+// --------------------------------------------------------
+// Cache cell of a floor: its column divided down, and its
+// storey
+// --------------------------------------------------------
+unsigned int PathRequestService::CacheCell(unsigned int span) const
+{
+	unsigned int cellX = navMesh.GetSpanX(span) / settings.cacheCellColumns;
+	unsigned int cellZ = navMesh.GetSpanZ(span) / settings.cacheCellColumns;
+	float height = navMesh.GetSpanPosition(span).y - navMesh.GetOrigin().y;
+	unsigned int level = (unsigned int)(std::max)(0.0f, floorf(height / PATH_CACHE_LEVEL_HEIGHT));
+	return (level * cellsZ + cellZ) * cellsX + cellX;
+}
+
+unsigned int PathRequestService::Request(const XMFLOAT3& start, const XMFLOAT3& goal)
+{
+	// read only, no need for the lock yet
+	unsigned int startSpan = navMesh.FindNearestSpan(start);
+	unsigned int goalSpan = navMesh.FindNearestSpan(goal);
+
+	Ticket ticket;
+	ticket.status = PathStatus::PENDING;
+	ticket.start = start;
+	ticket.goal = goal;
+	ticket.startSpan = startSpan;
+	ticket.goalSpan = goalSpan;
+	ticket.requested = std::chrono::high_resolution_clock::now();
+
+	bool queuedJob = false;
+	unsigned int id;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		id = nextTicket++;
+		if (nextTicket == PATH_NO_TICKET)
+			nextTicket++;
+		ticket.frame = frame;
+		stats.requests++;
+
+		if (startSpan == NAV_NO_SPAN || goalSpan == NAV_NO_SPAN)
+		{
+			ticket.status = PathStatus::FAILED;
+			stats.failed++;
+			RecordLatency(ticket);
+		}
+		else
+		{
+			CacheKey key = { CacheCell(startSpan), CacheCell(goalSpan), navMesh.GetRegion(startSpan), navMesh.GetRegion(goalSpan) };
+			auto cached = cache.find(key);
+			auto job = jobs.find(key);
+			if (cached != cache.end() && Fits(ticket, cached->second->found, cached->second->path))
+			{
+				lru.splice(lru.begin(), lru, cached->second);
+				Resolve(ticket, cached->second->found, cached->second->path);
+				stats.cacheHits++;
+				RecordLatency(ticket);
+			}
+			else if (job != jobs.end() && (!job->second->done || Fits(ticket, job->second->found, job->second->path)))
+			{
+				// a search still running is checked once it's done
+				job->second->tickets.push_back(id);
+				stats.coalesced++;
+			}
+			else if (cached != cache.end() || job != jobs.end())
+			{
+				QueueOwnSearch(id, ticket);
+				queuedJob = true;
+			}
+			else
+			{
+				Job* newJob = new Job();
+				newJob->key = key;
+				newJob->start = start;
+				newJob->goal = goal;
+				newJob->tickets.push_back(id);
+				jobs[key] = newJob;
+				queued.push_back(newJob);
+				queuedJob = true;
+			}
+		}
+
+		tickets[id] = std::move(ticket);
+	}
+
+	if (queuedJob)
+		wake.notify_one();
+	return id;
+}
+
+// --------------------------------------------------------
+// Finished searches into the cache and out to their
+// tickets, then a fresh budget for the workers
+// --------------------------------------------------------
+void PathRequestService::Update()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!queued.empty() && settings.frameBudgetMs > 0.0 && frameSpentMs >= settings.frameBudgetMs)
+			stats.budgetFrames++;
+		frame++;
+		frameSpentMs = 0.0;
+
+		for (Job* job : finished)
+		{
+			// every ticket left fits, the worker checked
+			for (unsigned int id : job->tickets)
+			{
+				auto ticket = tickets.find(id);
+				if (ticket == tickets.end())
+					continue;	// cancelled
+				Resolve(ticket->second, job->found, job->path);
+				RecordLatency(ticket->second);
+			}
+
+			if (!job->shared)
+			{
+				delete job;
+				continue;
+			}
+
+			if (settings.cacheCapacity > 0)
+			{
+				auto cached = cache.find(job->key);
+				if (cached != cache.end())
+				{
+					lru.erase(cached->second);
+					cache.erase(cached);
+				}
+				lru.push_front(CacheEntry());
+				lru.front().key = job->key;
+				lru.front().found = job->found;
+				lru.front().path.swap(job->path);
+				cache[job->key] = lru.begin();
+
+				while (lru.size() > settings.cacheCapacity)
+				{
+					cache.erase(lru.back().key);
+					lru.pop_back();
+				}
+			}
+
+			jobs.erase(job->key);
+			delete job;
+		}
+		finished.clear();
+	}
+	wake.notify_all();
+}
+
+// --------------------------------------------------------
+// Whether a straight line from the floor to the point
+// stays on the navmesh
+// --------------------------------------------------------
+bool PathRequestService::Joins(unsigned int span, const XMFLOAT3& point) const
+{
+	unsigned int pointSpan = navMesh.FindSpan(point);
+	return pointSpan != NAV_NO_SPAN && navMesh.IsLineWalkable(span, pointSpan);
+}
+
+// --------------------------------------------------------
+// Whether another request's result holds for the ticket.
+// Each of its ends has to reach the shared path's nearest
+// corner in a straight line on the navmesh, or else the
+// shared path's own end, close by in the same cell. A
+// failure holds if start and goal are in different
+// regions, the search didn't just give up
+// --------------------------------------------------------
+bool PathRequestService::Fits(const Ticket& ticket, bool found, const std::vector<XMFLOAT3>& path) const
+{
+	if (!found)
+		return navMesh.GetRegion(ticket.startSpan) != navMesh.GetRegion(ticket.goalSpan);
+
+	bool sameStart = memcmp(&ticket.start, &path.front(), sizeof(XMFLOAT3)) == 0;
+	bool sameGoal = memcmp(&ticket.goal, &path.back(), sizeof(XMFLOAT3)) == 0;
+	if (path.size() <= 2)
+		return (sameStart && sameGoal) || navMesh.IsLineWalkable(ticket.startSpan, ticket.goalSpan) ||
+			((sameStart || Joins(ticket.startSpan, path.front())) && (sameGoal || Joins(ticket.goalSpan, path.back())));
+
+	return (sameStart || Joins(ticket.startSpan, path[1]) || Joins(ticket.startSpan, path.front())) &&
+		(sameGoal || Joins(ticket.goalSpan, path[path.size() - 2]) || Joins(ticket.goalSpan, path.back()));
+}
+
+// A search for the ticket alone, not shared and not cached
+void PathRequestService::QueueOwnSearch(unsigned int id, const Ticket& ticket)
+{
+	Job* job = new Job();
+	job->shared = false;
+	job->start = ticket.start;
+	job->goal = ticket.goal;
+	job->tickets.push_back(id);
+	queued.push_back(job);
+	stats.refitted++;
+}
+
+// --------------------------------------------------------
+// A path found for another start and goal in the same
+// cells that Fits() the ticket, with the ticket's own
+// ends. An end that can't go straight to the nearest
+// corner goes through the shared path's end first
+// --------------------------------------------------------
+void PathRequestService::Resolve(Ticket& ticket, bool found, const std::vector<XMFLOAT3>& path)
+{
+	ticket.status = found ? PathStatus::READY : PathStatus::FAILED;
+	ticket.path.clear();
+	if (!found)
+		return;
+
+	bool sameStart = memcmp(&ticket.start, &path.front(), sizeof(XMFLOAT3)) == 0;
+	bool sameGoal = memcmp(&ticket.goal, &path.back(), sizeof(XMFLOAT3)) == 0;
+	ticket.path.push_back(ticket.start);
+	if (path.size() <= 2)
+	{
+		if (!(sameStart && sameGoal) && !navMesh.IsLineWalkable(ticket.startSpan, ticket.goalSpan))
+		{
+			if (!sameStart)
+				ticket.path.push_back(path.front());
+			if (!sameGoal)
+				ticket.path.push_back(path.back());
+		}
+	}
+	else
+	{
+		if (!sameStart && !Joins(ticket.startSpan, path[1]))
+			ticket.path.push_back(path.front());
+		ticket.path.insert(ticket.path.end(), path.begin() + 1, path.end() - 1);
+		if (!sameGoal && !Joins(ticket.goalSpan, path[path.size() - 2]))
+			ticket.path.push_back(path.back());
+	}
+	ticket.path.push_back(ticket.goal);
+}
+
+void PathRequestService::RecordLatency(const Ticket& ticket)
+{
+	unsigned int slot = latencyCount++ % PATH_LATENCY_SAMPLES;
+	latencyMs[slot] = MsSince(ticket.requested);
+	latencyFrames[slot] = frame - ticket.frame;
+}
+
+PathStatus PathRequestService::GetStatus(unsigned int ticket) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto found = tickets.find(ticket);
+	return found != tickets.end() ? found->second.status : PathStatus::NONE;
+}
+
+bool PathRequestService::TakePath(unsigned int ticket, std::vector<XMFLOAT3>& path)
+{
+	path.clear();
+	std::lock_guard<std::mutex> lock(mutex);
+	auto found = tickets.find(ticket);
+	if (found == tickets.end() || found->second.status == PathStatus::PENDING)
+		return false;
+
+	bool ready = found->second.status == PathStatus::READY;
+	path.swap(found->second.path);
+	tickets.erase(found);
+	return ready;
+}
+
+void PathRequestService::Cancel(unsigned int ticket)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	tickets.erase(ticket);
+}
+
+void PathRequestService::Flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	flushing = true;
+	wake.notify_all();
+	idle.wait(lock, [this]() { return queued.empty() && running == 0; });
+	flushing = false;
+}
+
+void PathRequestService::ClearCache()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	cache.clear();
+	lru.clear();
+}
+
+PathRequestStats PathRequestService::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+double PathRequestService::GetLatencyMs(float percentile) const
+{
+	std::vector<double> samples;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		samples.assign(latencyMs.begin(), latencyMs.begin() + (std::min)(latencyCount, (unsigned int)PATH_LATENCY_SAMPLES));
+	}
+	if (samples.empty())
+		return 0.0;
+
+	size_t rank = (size_t)((std::min)((std::max)(percentile, 0.0f), 1.0f) * (samples.size() - 1));
+	std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+	return samples[rank];
+}
+
+unsigned int PathRequestService::GetLatencyFrames(float percentile) const
+{
+	std::vector<unsigned int> samples;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		samples.assign(latencyFrames.begin(), latencyFrames.begin() + (std::min)(latencyCount, (unsigned int)PATH_LATENCY_SAMPLES));
+	}
+	if (samples.empty())
+		return 0;
+
+	size_t rank = (size_t)((std::min)((std::max)(percentile, 0.0f), 1.0f) * (samples.size() - 1));
+	std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+	return samples[rank];
+}
+
+unsigned int PathRequestService::GetCacheSize() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return (unsigned int)lru.size();
+}
+
+unsigned int PathRequestService::GetQueuedCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return (unsigned int)queued.size();
+}
+
+// --------------------------------------------------------
+// The path asked for last time, walked corner by corner
+// --------------------------------------------------------
+bool PathFollower::NextCorner(PathRequestService& service, const XMFLOAT3& position, const XMFLOAT3& target,
+	float cornerReachedSq, float targetMovedSq, XMFLOAT3& nextCorner)
+{
+	if (ticket != PATH_NO_TICKET && service.GetStatus(ticket) != PathStatus::PENDING)
+	{
+		// a failed search leaves no path, straight at the target
+		service.TakePath(ticket, path);
+		ticket = PATH_NO_TICKET;
+		corner = 1;
+	}
+	if (ticket == PATH_NO_TICKET)
+	{
+		float dx = path.empty() ? 0.0f : path.back().x - target.x;
+		float dz = path.empty() ? 0.0f : path.back().z - target.z;
+		if (path.empty() || dx * dx + dz * dz > targetMovedSq)
+			ticket = service.Request(position, target);
+	}
+
+	// the last point is where the target was, the target itself is better
+	while (corner + 1 < path.size())
+	{
+		float dx = path[corner].x - position.x;
+		float dz = path[corner].z - position.z;
+		if (dx * dx + dz * dz > cornerReachedSq)
+		{
+			nextCorner = path[corner];
+			return true;
+		}
+		corner++;
+	}
+	return false;
+}
+
+void PathFollower::Reset(PathRequestService* service)
+{
+	if (service && ticket != PATH_NO_TICKET)
+		service->Cancel(ticket);
+	ticket = PATH_NO_TICKET;
+	path.clear();
+	corner = 0;
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class NavMesh;
+class NavHierarchy;
+
+// The ticket of no request, for agents without one out
+#define PATH_NO_TICKET 0
+
+// Latencies kept for the percentiles, the most recent ones
+#define PATH_LATENCY_SAMPLES 4096
+
+enum class PathStatus : unsigned char
+{
+	NONE,		// unknown ticket, taken or cancelled
+	PENDING,
+	READY,
+	FAILED
+};
+
+struct PathRequestSettings
+{
+	// Background threads searching paths, 0 for one per core but the one the game runs on
+	unsigned int workerCount = 1;
+
+	// Paths kept for repeated requests, the least recently used go first. 0 caches nothing
+	unsigned int cacheCapacity = 4096;
+
+	// Columns per side of a cache cell: starts and goals in the same cells share one search
+	unsigned int cacheCellColumns = 4;
+
+	// Search time the workers may take per frame in total, 0 for no limit. A search never stops halfway
+	double frameBudgetMs = 2.0;
+};
+
+struct PathRequestStats
+{
+	unsigned long long requests = 0;
+	unsigned long long cacheHits = 0;
+	unsigned long long coalesced = 0;	// got the path of a search already queued for the same cells
+	unsigned long long refitted = 0;	// cached or shared paths whose new ends left the navmesh, searched again
+	unsigned long long searches = 0;
+	unsigned long long failed = 0;		// searches and requests off the navmesh
+	double searchMs = 0.0;
+	unsigned int budgetFrames = 0;		// frames that ended with searches left over the budget
+};
+
+/**
+ * Path searches off the game thread. Agents Request() a path and get a
+ * ticket, worker threads run the searches (over a NavHierarchy when
+ * there is one, else flat A*) and Update(), once per frame, hands the
+ * finished ones to their tickets. A path is never ready in the frame it
+ * was asked for unless the cache had it.
+ *
+ * Requests are keyed by the cache cells and regions of their start and
+ * goal floors. Paths found stay in an LRU cache under that key, and a
+ * request for a key already being searched waits for that search instead
+ * of queuing another: ghosts around the same spot heading for the same
+ * target cost one search. A cached path starts and ends where its own
+ * request did, the corners in between are shared, but only if the new
+ * start and goal reach them in straight lines on the navmesh, directly
+ * or through the shared path's own ends. A cell can straddle a wall,
+ * requests whose ends don't fit get a search of their own. A failure is
+ * only shared between floors in different regions.
+ *
+ * The budget keeps the workers from taking more than their share of the
+ * frame, searches over it wait for the next Update().
+ */
+class PathRequestService
+{
+public:
+	PathRequestService(const NavMesh& navMesh, const NavHierarchy* hierarchy, const PathRequestSettings& settings = PathRequestSettings());
+	~PathRequestService();
+
+	// Returns the ticket to collect the path with. Cache hits and starts or goals off the navmesh are decided at once
+	unsigned int Request(const DirectX::XMFLOAT3& start, const DirectX::XMFLOAT3& goal);
+
+	// Once per frame, on the thread that requests: finished searches go to their tickets and a new budget starts
+	void Update();
+
+	PathStatus GetStatus(unsigned int ticket) const;
+
+	// Copies a READY ticket's path, start and goal as requested, and forgets the ticket. FAILED tickets are forgotten too
+	bool TakePath(unsigned int ticket, std::vector<DirectX::XMFLOAT3>& path);
+
+	// Forgets the ticket. Its search still runs if it was started, the cache gets the path
+	void Cancel(unsigned int ticket);
+
+	// Waits for every queued search, whatever the budget. The paths still go out with the next Update()
+	void Flush();
+
+	void ClearCache();
+
+	PathRequestStats GetStats() const;
+
+	// Request to result time of the tickets handed out lately, in ms and in Update() calls, for percentile 0 to 1
+	double GetLatencyMs(float percentile) const;
+	unsigned int GetLatencyFrames(float percentile) const;
+
+	unsigned int GetCacheSize() const;
+	unsigned int GetQueuedCount() const;
+	inline unsigned int GetWorkerCount() const { return (unsigned int)workers.size(); }
+
+private:
+	struct CacheKey
+	{
+		unsigned int startCell, goalCell;
+		unsigned int startRegion, goalRegion;
+		bool operator==(const CacheKey& other) const
+		{
+			return startCell == other.startCell && goalCell == other.goalCell && startRegion == other.startRegion && goalRegion == other.goalRegion;
+		}
+	};
+
+	struct CacheKeyHash
+	{
+		size_t operator()(const CacheKey& key) const { return (key.startCell * 0x9E3779B1u ^ key.goalCell) * 0x85EBCA6Bu ^ key.startRegion * 31u ^ key.goalRegion; }
+	};
+
+	struct CacheEntry
+	{
+		CacheKey key;
+		bool found;
+		std::vector<DirectX::XMFLOAT3> path;
+	};
+
+	// One search, and every ticket waiting for it. Jobs of a single ticket whose ends didn't fit
+	// a shared path aren't shared or cached
+	struct Job
+	{
+		CacheKey key;
+		bool shared = true;
+		bool done = false;	// searched, waiting for Update()
+		DirectX::XMFLOAT3 start, goal;
+		std::vector<unsigned int> tickets;
+		bool found = false;
+		std::vector<DirectX::XMFLOAT3> path;
+	};
+
+	struct Ticket
+	{
+		PathStatus status;
+		DirectX::XMFLOAT3 start, goal;
+		unsigned int startSpan, goalSpan;
+		unsigned int frame;
+		std::chrono::high_resolution_clock::time_point requested;
+		std::vector<DirectX::XMFLOAT3> path;
+	};
+
+	void WorkerLoop();
+	unsigned int CacheCell(unsigned int span) const;
+
+	// These need the lock
+	bool Joins(unsigned int span, const DirectX::XMFLOAT3& point) const;
+	bool Fits(const Ticket& ticket, bool found, const std::vector<DirectX::XMFLOAT3>& path) const;
+	void Resolve(Ticket& ticket, bool found, const std::vector<DirectX::XMFLOAT3>& path);
+	void QueueOwnSearch(unsigned int id, const Ticket& ticket);
+	void RecordLatency(const Ticket& ticket);
+
+	const NavMesh& navMesh;
+	const NavHierarchy* hierarchy;
+	PathRequestSettings settings;
+	unsigned int cellsX = 1, cellsZ = 1;
+
+	// everything below is shared with the workers
+	mutable std::mutex mutex;
+	std::condition_variable wake;	// work queued, a new budget or stopping
+	std::condition_variable idle;	// a search finished
+	std::vector<std::thread> workers;
+	bool stopping = false;
+	bool flushing = false;
+	unsigned int running = 0;
+	double frameSpentMs = 0.0;
+	unsigned int frame = 0;
+
+	std::deque<Job*> queued;
+	std::vector<Job*> finished;
+	std::unordered_map<CacheKey, Job*, CacheKeyHash> jobs;	// queued, running and finished ones
+
+	std::unordered_map<unsigned int, Ticket> tickets;
+	unsigned int nextTicket = 1;
+
+	// most recently used first
+	std::list<CacheEntry> lru;
+	std::unordered_map<CacheKey, std::list<CacheEntry>::iterator, CacheKeyHash> cache;
+
+	PathRequestStats stats;
+	std::vector<double> latencyMs;
+	std::vector<unsigned int> latencyFrames;
+	unsigned int latencyCount = 0;
+};
+
+/**
+ * One agent's path from a PathRequestService: the path it walks, the
+ * next corner on it and the ticket out for the next path. The path goes
+ * all the way, a new one is only asked for once the target is off its
+ * end, so agents patrolling between fixed points ask once per leg and
+ * walk the old path while the new one is searched.
+ */
+struct PathFollower
+{
+	std::vector<DirectX::XMFLOAT3> path;
+	size_t corner = 0;
+	unsigned int ticket = PATH_NO_TICKET;
+
+	// Collects the path once it's in and asks for another when the target moved further than targetMovedSq (squared,
+	// in XZ) from its end. Corners closer than cornerReachedSq count as passed. False without a corner to head for
+	bool NextCorner(PathRequestService& service, const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& target,
+		float cornerReachedSq, float targetMovedSq, DirectX::XMFLOAT3& nextCorner);
+
+	// Cancels the ticket out, if any, and forgets the path. Null when the ticket's service is gone
+	void Reset(PathRequestService* service);
+};
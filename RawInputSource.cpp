@@ -0,0 +1,174 @@
+#include "RawInputSource.h"
+#include <cstring>
+
+// Generic desktop usage page, and its keyboard and mouse usages
+#define RAW_INPUT_USAGE_PAGE 0x01
+#define RAW_INPUT_USAGE_MOUSE 0x02
+#define RAW_INPUT_USAGE_KEYBOARD 0x06
+
+namespace Input {
+
+    RawInputSource::RawInputSource(HWND pwindow) :
+        gameWindow(pwindow),
+        sinkWindow(nullptr),
+        wasForeground(false)
+    {
+        memset(held, 0, sizeof(held));
+    };
+
+    // On the input thread: WM_INPUT goes to the thread that created the
+    // target window, so the window has to be made here
+    bool RawInputSource::Open()
+    {
+        HINSTANCE instance = GetModuleHandle(nullptr);
+
+        WNDCLASSEXW windowClass = {};
+        windowClass.cbSize = sizeof(WNDCLASSEXW);
+        windowClass.lpfnWndProc = DefWindowProcW;
+        windowClass.hInstance = instance;
+        windowClass.lpszClassName = L"RawInputSink";
+        if (!RegisterClassExW(&windowClass) && GetLastError() != ERROR_CLASS_ALREADY_EXISTS)
+            return false;
+
+        sinkWindow = CreateWindowExW(0, L"RawInputSink", L"", 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr, instance, nullptr);
+        if (!sinkWindow)
+            return false;
+
+        // INPUTSINK because a message-only window is never in the foreground,
+        // Poll() does the foreground check itself
+        RAWINPUTDEVICE devices[2] =
+        {
+            { RAW_INPUT_USAGE_PAGE, RAW_INPUT_USAGE_KEYBOARD, RIDEV_INPUTSINK, sinkWindow },
+            { RAW_INPUT_USAGE_PAGE, RAW_INPUT_USAGE_MOUSE, RIDEV_INPUTSINK, sinkWindow }
+        };
+        if (!RegisterRawInputDevices(devices, 2, sizeof(RAWINPUTDEVICE)))
+        {
+            DestroyWindow(sinkWindow);
+            sinkWindow = nullptr;
+            return false;
+        }
+
+        wasForeground = false;
+        memset(held, 0, sizeof(held));
+        return true;
+    }
+
+    void RawInputSource::Close()
+    {
+        RAWINPUTDEVICE devices[2] =
+        {
+            { RAW_INPUT_USAGE_PAGE, RAW_INPUT_USAGE_KEYBOARD, RIDEV_REMOVE, nullptr },
+            { RAW_INPUT_USAGE_PAGE, RAW_INPUT_USAGE_MOUSE, RIDEV_REMOVE, nullptr }
+        };
+        RegisterRawInputDevices(devices, 2, sizeof(RAWINPUTDEVICE));
+
+        if (sinkWindow)
+            DestroyWindow(sinkWindow);
+        sinkWindow = nullptr;
+    }
+
+    // Waits for raw input to arrive, then reads every WM_INPUT queued.
+    // DefWindowProc still sees each one, it frees the system's copy.
+    // Input queued before the foreground went away is read as background
+    // input, only its releases go through
+    void RawInputSource::Poll(const unsigned int ptimeoutMs, std::vector<InputEvent>& pevents)
+    {
+        MsgWaitForMultipleObjectsEx(0, nullptr, ptimeoutMs, QS_RAWINPUT, MWMO_INPUTAVAILABLE);
+
+        bool foreground = GetForegroundWindow() == gameWindow;
+        MSG msg;
+        while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE))
+        {
+            if (msg.message == WM_INPUT)
+                ReadRawInput(reinterpret_cast<HRAWINPUT>(msg.lParam), foreground, pevents);
+            DispatchMessageW(&msg);
+        }
+
+        // the other window gets the releases of keys still held now
+        if (wasForeground && !foreground)
+            ReleaseHeldKeys(pevents);
+        wasForeground = foreground;
+    }
+
+    void RawInputSource::ReleaseHeldKeys(std::vector<InputEvent>& pevents)
+    {
+        uint64_t now = InputClockNow();
+        for (unsigned int key = 0; key < 256; ++key)
+        {
+            if (!held[key])
+                continue;
+
+            InputEvent event = { InputEventType::KeyUp, (uint8_t)key, 0, 0, now };
+            pevents.push_back(event);
+            held[key] = false;
+        }
+    }
+
+    void RawInputSource::ReadRawInput(HRAWINPUT pinput, const bool pforeground, std::vector<InputEvent>& pevents)
+    {
+        UINT size = 0;
+        GetRawInputData(pinput, RID_INPUT, nullptr, &size, sizeof(RAWINPUTHEADER));
+        if (size == 0)
+            return;
+        if (rawBuffer.size() < size)
+            rawBuffer.resize(size);
+        if (GetRawInputData(pinput, RID_INPUT, rawBuffer.data(), &size, sizeof(RAWINPUTHEADER)) == (UINT)-1)
+            return;
+
+        const RAWINPUT* raw = reinterpret_cast<const RAWINPUT*>(rawBuffer.data());
+        uint64_t now = InputClockNow();
+
+        if (raw->header.dwType == RIM_TYPEKEYBOARD)
+        {
+            // 0xFF is a key the keyboard couldn't tell apart, not a real one
+            const RAWKEYBOARD& keyboard = raw->data.keyboard;
+            if (keyboard.VKey == 0 || keyboard.VKey >= 0xFF)
+                return;
+
+            // releases of keys never reported down, or already released, are dropped
+            uint8_t keyCode = (uint8_t)keyboard.VKey;
+            bool up = (keyboard.Flags & RI_KEY_BREAK) != 0;
+            if (up ? !held[keyCode] : !pforeground)
+                return;
+
+            InputEvent event = { up ? InputEventType::KeyUp : InputEventType::KeyDown, keyCode, 0, 0, now };
+            pevents.push_back(event);
+            held[keyCode] = !up;
+        }
+        else if (raw->header.dwType == RIM_TYPEMOUSE)
+        {
+            // Buttons are keys, like ::GetKeyboardState() has them
+            static const struct { USHORT down, up; uint8_t keyCode; } buttons[] =
+            {
+                { RI_MOUSE_LEFT_BUTTON_DOWN,   RI_MOUSE_LEFT_BUTTON_UP,   VK_LBUTTON },
+                { RI_MOUSE_RIGHT_BUTTON_DOWN,  RI_MOUSE_RIGHT_BUTTON_UP,  VK_RBUTTON },
+                { RI_MOUSE_MIDDLE_BUTTON_DOWN, RI_MOUSE_MIDDLE_BUTTON_UP, VK_MBUTTON },
+                { RI_MOUSE_BUTTON_4_DOWN,      RI_MOUSE_BUTTON_4_UP,      VK_XBUTTON1 },
+                { RI_MOUSE_BUTTON_5_DOWN,      RI_MOUSE_BUTTON_5_UP,      VK_XBUTTON2 }
+            };
+
+            const RAWMOUSE& mouse = raw->data.mouse;
+            if (pforeground && !(mouse.usFlags & MOUSE_MOVE_ABSOLUTE) && (mouse.lLastX || mouse.lLastY))
+            {
+                InputEvent event = { InputEventType::MouseMove, 0, (int32_t)mouse.lLastX, (int32_t)mouse.lLastY, now };
+                pevents.push_back(event);
+            }
+
+            for (const auto& button : buttons)
+            {
+                if ((mouse.usButtonFlags & button.down) && pforeground)
+                {
+                    InputEvent event = { InputEventType::KeyDown, button.keyCode, 0, 0, now };
+                    pevents.push_back(event);
+                    held[button.keyCode] = true;
+                }
+                if ((mouse.usButtonFlags & button.up) && held[button.keyCode])
+                {
+                    InputEvent event = { InputEventType::KeyUp, button.keyCode, 0, 0, now };
+                    pevents.push_back(event);
+                    held[button.keyCode] = false;
+                }
+            }
+        }
+    }
+}
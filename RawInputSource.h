@@ -0,0 +1,44 @@
+#ifndef RAWINPUTSOURCE_H
+#define RAWINPUTSOURCE_H
+
+#include "InputThread.h"
+#include <Windows.h>
+
+namespace Input {
+
+    // Keyboard and mouse from Windows Raw Input, read on the input thread.
+    // Open() makes a message-only window there for WM_INPUT to go to, so
+    // events arrive as they happen instead of when the game thread pumps
+    // its messages, and Poll() sleeps in the message wait rather than
+    // spinning. Key and button presses and mouse motion are only reported
+    // while pwindow is in the foreground. Releases of what was reported
+    // pressed always are, and losing the foreground releases everything
+    // still held, so no key stays down across an alt-tab
+    class RawInputSource : public InputSource
+    {
+    public:
+        explicit RawInputSource(HWND pwindow);
+
+        bool Open() override;
+        void Close() override;
+        void Poll(const unsigned int ptimeoutMs, std::vector<InputEvent>& pevents) override;
+
+    private:
+        void ReadRawInput(HRAWINPUT pinput, const bool pforeground, std::vector<InputEvent>& pevents);
+
+        // A KeyUp for every key reported down and not up since
+        void ReleaseHeldKeys(std::vector<InputEvent>& pevents);
+
+        HWND gameWindow;
+        HWND sinkWindow;
+        bool wasForeground;
+
+        // Keys and buttons reported down, by virtual key code
+        bool held[256];
+
+        // GetRawInputData() target, grown as needed
+        std::vector<BYTE> rawBuffer;
+    };
+}
+
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+
+// D3D objects are only passed through as opaque handles, so code that
+// talks to IRenderContext never needs d3d11.h (and can run headless)
+struct ID3D11Buffer;
+struct ID3D11InputLayout;
+struct ID3D11VertexShader;
+struct ID3D11PixelShader;
+struct ID3D11ShaderResourceView;
+struct ID3D11SamplerState;
+struct ID3D11BlendState;
+struct ID3D11RenderTargetView;
+struct ID3D11DepthStencilView;
+
+// Number of SRV slots cleared by UnbindShaderResources
+#define RENDER_CONTEXT_SRV_SLOTS 16
+
+enum class ShaderStage
+{
+	Vertex,
+	Pixel,
+	Count
+};
+
+// Counters every backend keeps, reset by the owner (usually once per frame)
+struct RenderStats
+{
+	unsigned int drawCalls = 0;
+	unsigned int stateChanges = 0;
+
+	// Binds that set what was already bound. Only backends that track bindings can tell
+	unsigned int redundantStateChanges = 0;
+
+	unsigned long long bytesUploaded = 0;
+};
+
+/**
+ * The subset of a device context the engine submits draws through.
+ *
+ * Always uses triangle lists, one vertex stream and 32 bit indices,
+ * which is everything the engine currently draws with. D3D specific
+ * setup that has no headless meaning (viewports from the swap chain,
+ * command list execution) still goes to the D3D context directly.
+ */
+class IRenderContext
+{
+public:
+	virtual ~IRenderContext() = default;
+
+	virtual void SetRenderTargets(ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv) = 0;
+	virtual void ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4]) = 0;
+	virtual void ClearDepthStencil(ID3D11DepthStencilView* dsv, float depth, unsigned char stencil) = 0;
+
+	// Also selects triangle list topology, the only one the engine draws with
+	virtual void SetViewport(float width, float height) = 0;
+	virtual void SetBlendState(ID3D11BlendState* blendState) = 0;
+
+	virtual void SetInputLayout(ID3D11InputLayout* inputLayout) = 0;
+	virtual void SetVertexShader(ID3D11VertexShader* shader) = 0;
+	virtual void SetPixelShader(ID3D11PixelShader* shader) = 0;
+	virtual void SetConstantBuffer(ShaderStage stage, unsigned int slot, ID3D11Buffer* buffer) = 0;
+	virtual void SetShaderResource(ShaderStage stage, unsigned int slot, ID3D11ShaderResourceView* srv) = 0;
+	virtual void SetSampler(ShaderStage stage, unsigned int slot, ID3D11SamplerState* sampler) = 0;
+	virtual void UnbindShaderResources(ShaderStage stage) = 0;
+
+	// Copies size bytes into the whole buffer
+	virtual void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size) = 0;
+
+	// Copies size bytes to byteOffset, the rest of the buffer is left alone. Not for constant buffers
+	virtual void UpdateBufferRange(ID3D11Buffer* buffer, unsigned int byteOffset, const void* data, unsigned int size) = 0;
+
+	virtual void SetVertexBuffer(ID3D11Buffer* buffer, unsigned int stride) = 0;
+	virtual void SetIndexBuffer(ID3D11Buffer* buffer) = 0;
+
+	virtual void Draw(unsigned int vertexCount) = 0;
+	virtual void DrawIndexed(unsigned int indexCount) = 0;
+
+	inline const RenderStats& GetStats() const { return stats; }
+	inline void ResetStats() { stats = RenderStats(); }
+
+protected:
+	RenderStats stats;
+};
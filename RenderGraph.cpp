@@ -0,0 +1,377 @@
+#include "RenderGraph.h"
+#include <algorithm>
+#include <queue>
+
+void RenderGraph::Reset()
+{
+	resources.clear();
+	passes.clear();
+	executionOrder.clear();
+	physicalSlots.clear();
+	liveTransientCount = 0;
+	error.clear();
+	compiled = false;
+}
+
+RenderGraphResource RenderGraph::CreateTexture(const std::string& name, const RenderGraphTextureDesc& desc)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.desc = desc;
+	resource.imported = false;
+	resources.push_back(resource);
+
+	compiled = false;
+	return (RenderGraphResource)resources.size() - 1;
+}
+
+RenderGraphResource RenderGraph::ImportTexture(const std::string& name)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.imported = true;
+	resources.push_back(resource);
+
+	compiled = false;
+	return (RenderGraphResource)resources.size() - 1;
+}
+
+int RenderGraph::AddPass(const std::string& name, std::function<void()> execute)
+{
+	Pass pass = {};
+	pass.name = name;
+	pass.execute = execute;
+	pass.sideEffects = false;
+	passes.push_back(pass);
+
+	compiled = false;
+	return (int)passes.size() - 1;
+}
+
+void RenderGraph::Read(int pass, RenderGraphResource resource)
+{
+	if (!IsValidPass(pass))
+		return;
+
+	// invalid handles are kept so Compile() can report them
+	passes[pass].reads.push_back(resource);
+	compiled = false;
+}
+
+void RenderGraph::Write(int pass, RenderGraphResource resource)
+{
+	if (!IsValidPass(pass))
+		return;
+
+	passes[pass].writes.push_back(resource);
+	compiled = false;
+}
+
+void RenderGraph::SetSideEffects(int pass)
+{
+	if (!IsValidPass(pass))
+		return;
+
+	passes[pass].sideEffects = true;
+	compiled = false;
+}
+
+bool RenderGraph::Compile()
+{
+	compiled = false;
+	error.clear();
+	executionOrder.clear();
+	physicalSlots.clear();
+	liveTransientCount = 0;
+
+	if (!BuildDependencies())
+		return false;
+
+	CullPasses();
+
+	if (!OrderPasses())
+		return false;
+
+	AssignPhysicalSlots();
+
+	compiled = true;
+	return true;
+}
+
+void RenderGraph::Execute() const
+{
+	if (!compiled)
+		return;
+
+	for (int pass : executionOrder)
+	{
+		if (passes[pass].execute)
+			passes[pass].execute();
+	}
+}
+
+bool RenderGraph::IsPassCulled(int pass) const
+{
+	return !IsValidPass(pass) || !passes[pass].alive;
+}
+
+const std::string& RenderGraph::GetPassName(int pass) const
+{
+	return passes[pass].name;
+}
+
+int RenderGraph::GetPhysicalSlot(RenderGraphResource resource) const
+{
+	if (!compiled || !IsValidResource(resource))
+		return -1;
+
+	return resources[resource].physicalSlot;
+}
+
+bool RenderGraph::IsValidResource(RenderGraphResource resource) const
+{
+	return resource >= 0 && resource < (RenderGraphResource)resources.size();
+}
+
+bool RenderGraph::IsValidPass(int pass) const
+{
+	return pass >= 0 && pass < (int)passes.size();
+}
+
+// --------------------------------------------------------
+// Every read depends on the closest earlier writer of that
+// resource. Every write depends on the previous writer and
+// on the passes that read the previous contents, so nothing
+// gets overwritten before it has been consumed.
+// --------------------------------------------------------
+bool RenderGraph::BuildDependencies()
+{
+	for (int p = 0; p < (int)passes.size(); ++p)
+	{
+		Pass& pass = passes[p];
+		pass.dependencies.clear();
+		pass.alive = false;
+
+		for (RenderGraphResource read : pass.reads)
+		{
+			if (!IsValidResource(read))
+			{
+				error = "Pass '" + pass.name + "' reads an invalid resource handle";
+				return false;
+			}
+
+			int writer = -1;
+			for (int w = p - 1; w >= 0 && writer < 0; --w)
+			{
+				if (std::find(passes[w].writes.begin(), passes[w].writes.end(), read) != passes[w].writes.end())
+					writer = w;
+			}
+
+			// imported textures may hold data from outside the graph
+			if (writer < 0 && !resources[read].imported)
+			{
+				error = "Pass '" + pass.name + "' reads '" + resources[read].name + "' before any pass writes it";
+				return false;
+			}
+
+			if (writer >= 0)
+				pass.dependencies.push_back(writer);
+		}
+
+		for (RenderGraphResource write : pass.writes)
+		{
+			if (!IsValidResource(write))
+			{
+				error = "Pass '" + pass.name + "' writes an invalid resource handle";
+				return false;
+			}
+
+			for (int w = p - 1; w >= 0; --w)
+			{
+				const Pass& other = passes[w];
+				bool otherReads = std::find(other.reads.begin(), other.reads.end(), write) != other.reads.end();
+				bool otherWrites = std::find(other.writes.begin(), other.writes.end(), write) != other.writes.end();
+
+				if (otherReads || otherWrites)
+					pass.dependencies.push_back(w);
+
+				// anything before the previous writer is already ordered through it
+				if (otherWrites)
+					break;
+			}
+		}
+
+		std::sort(pass.dependencies.begin(), pass.dependencies.end());
+		pass.dependencies.erase(std::unique(pass.dependencies.begin(), pass.dependencies.end()), pass.dependencies.end());
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Passes that write imported resources or have side effects
+// are the roots. Everything they depend on stays, the rest
+// is culled.
+// --------------------------------------------------------
+void RenderGraph::CullPasses()
+{
+	std::vector<int> stack;
+	for (int p = 0; p < (int)passes.size(); ++p)
+	{
+		Pass& pass = passes[p];
+		bool isRoot = pass.sideEffects;
+		for (RenderGraphResource write : pass.writes)
+		{
+			if (resources[write].imported)
+				isRoot = true;
+		}
+
+		if (isRoot)
+		{
+			pass.alive = true;
+			stack.push_back(p);
+		}
+	}
+
+	while (!stack.empty())
+	{
+		int p = stack.back();
+		stack.pop_back();
+
+		for (int dependency : passes[p].dependencies)
+		{
+			if (!passes[dependency].alive)
+			{
+				passes[dependency].alive = true;
+				stack.push_back(dependency);
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Kahn's algorithm over the surviving passes. Ready passes
+// are taken in declaration order so the result is stable.
+// --------------------------------------------------------
+bool RenderGraph::OrderPasses()
+{
+	std::vector<int> pendingDependencies(passes.size(), 0);
+	std::vector<std::vector<int>> dependents(passes.size());
+	size_t aliveCount = 0;
+
+	for (int p = 0; p < (int)passes.size(); ++p)
+	{
+		if (!passes[p].alive)
+			continue;
+
+		aliveCount++;
+		for (int dependency : passes[p].dependencies)
+		{
+			pendingDependencies[p]++;
+			dependents[dependency].push_back(p);
+		}
+	}
+
+	std::priority_queue<int, std::vector<int>, std::greater<int>> ready;
+	for (int p = 0; p < (int)passes.size(); ++p)
+	{
+		if (passes[p].alive && pendingDependencies[p] == 0)
+			ready.push(p);
+	}
+
+	while (!ready.empty())
+	{
+		int p = ready.top();
+		ready.pop();
+		executionOrder.push_back(p);
+
+		for (int dependent : dependents[p])
+		{
+			if (--pendingDependencies[dependent] == 0)
+				ready.push(dependent);
+		}
+	}
+
+	if (executionOrder.size() != aliveCount)
+	{
+		error = "Render graph contains a dependency cycle";
+		executionOrder.clear();
+		return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Greedy interval packing: transients are visited by first
+// use and placed in the first slot with a matching desc that
+// is free again by then.
+// --------------------------------------------------------
+void RenderGraph::AssignPhysicalSlots()
+{
+	for (Resource& resource : resources)
+	{
+		resource.firstUse = -1;
+		resource.lastUse = -1;
+		resource.physicalSlot = -1;
+	}
+
+	for (int i = 0; i < (int)executionOrder.size(); ++i)
+	{
+		const Pass& pass = passes[executionOrder[i]];
+		auto touch = [&](RenderGraphResource r)
+		{
+			Resource& resource = resources[r];
+			if (resource.firstUse < 0)
+				resource.firstUse = i;
+			resource.lastUse = i;
+		};
+
+		for (RenderGraphResource read : pass.reads)
+			touch(read);
+		for (RenderGraphResource write : pass.writes)
+			touch(write);
+	}
+
+	std::vector<int> transients;
+	for (int r = 0; r < (int)resources.size(); ++r)
+	{
+		if (!resources[r].imported && resources[r].firstUse >= 0)
+			transients.push_back(r);
+	}
+	liveTransientCount = transients.size();
+
+	std::stable_sort(transients.begin(), transients.end(), [&](int lhs, int rhs)
+		{
+			return resources[lhs].firstUse < resources[rhs].firstUse;
+		});
+
+	std::vector<int> slotLastUse;
+	for (int r : transients)
+	{
+		Resource& resource = resources[r];
+
+		for (size_t slot = 0; slot < physicalSlots.size(); ++slot)
+		{
+			const RenderGraphTextureDesc& slotDesc = physicalSlots[slot];
+			bool compatible =
+				slotDesc.width == resource.desc.width &&
+				slotDesc.height == resource.desc.height &&
+				slotDesc.format == resource.desc.format;
+
+			if (compatible && slotLastUse[slot] < resource.firstUse)
+			{
+				resource.physicalSlot = (int)slot;
+				slotLastUse[slot] = resource.lastUse;
+				break;
+			}
+		}
+
+		if (resource.physicalSlot < 0)
+		{
+			resource.physicalSlot = (int)physicalSlots.size();
+			physicalSlots.push_back(resource.desc);
+			slotLastUse.push_back(resource.lastUse);
+		}
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Handle to a texture declared in the graph, -1 is invalid
+typedef int RenderGraphResource;
+
+// Stays free of D3D types so graphs can be compiled and validated without a device
+struct RenderGraphTextureDesc
+{
+	unsigned int width;
+	unsigned int height;
+	unsigned int format; // DXGI_FORMAT value
+};
+
+/**
+ * Declarative frame graph.
+ *
+ * Passes declare which textures they read and write. Compile() validates
+ * the declarations, culls passes whose results never reach an imported
+ * resource (back buffer, depth) or a pass marked with side effects, orders
+ * the survivors and aliases transient textures with non-overlapping
+ * lifetimes onto shared physical slots.
+ *
+ * Reads resolve to the closest writer declared before the reading pass,
+ * so declaration order decides between multiple writers of one texture.
+ */
+class RenderGraph
+{
+public:
+	RenderGraph() = default;
+	~RenderGraph() = default;
+
+	// Drops all passes and resources
+	void Reset();
+
+	// Transient texture owned by the graph, may share memory with other transients
+	RenderGraphResource CreateTexture(const std::string& name, const RenderGraphTextureDesc& desc);
+
+	// Externally owned texture (back buffer, depth buffer). Never aliased, writing one keeps the pass alive
+	RenderGraphResource ImportTexture(const std::string& name);
+
+	int AddPass(const std::string& name, std::function<void()> execute);
+	void Read(int pass, RenderGraphResource resource);
+	void Write(int pass, RenderGraphResource resource);
+
+	// Keeps a pass even if nothing consumes its output
+	void SetSideEffects(int pass);
+
+	// Validates, culls, orders and assigns physical slots. Returns false and fills GetError() on failure
+	bool Compile();
+
+	// Runs the execute callback of every surviving pass in order
+	void Execute() const;
+
+	inline bool IsCompiled() const { return compiled; }
+	inline const std::string& GetError() const { return error; }
+
+	inline const std::vector<int>& GetExecutionOrder() const { return executionOrder; }
+	bool IsPassCulled(int pass) const;
+	const std::string& GetPassName(int pass) const;
+	inline size_t GetPassCount() const { return passes.size(); }
+
+	// Physical slot backing a transient resource, -1 for imported or unused resources
+	int GetPhysicalSlot(RenderGraphResource resource) const;
+	inline size_t GetPhysicalSlotCount() const { return physicalSlots.size(); }
+	inline const RenderGraphTextureDesc& GetPhysicalSlotDesc(size_t slot) const { return physicalSlots[slot]; }
+
+	// Number of transient textures that survived culling, compare with GetPhysicalSlotCount() for aliasing savings
+	inline size_t GetLiveTransientCount() const { return liveTransientCount; }
+
+private:
+	struct Resource
+	{
+		std::string name;
+		RenderGraphTextureDesc desc;
+		bool imported;
+
+		// filled by Compile()
+		int firstUse;
+		int lastUse;
+		int physicalSlot;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		std::vector<RenderGraphResource> reads;
+		std::vector<RenderGraphResource> writes;
+		std::function<void()> execute;
+		bool sideEffects;
+
+		// filled by Compile()
+		std::vector<int> dependencies;
+		bool alive;
+	};
+
+	bool IsValidResource(RenderGraphResource resource) const;
+	bool IsValidPass(int pass) const;
+
+	bool BuildDependencies();
+	void CullPasses();
+	bool OrderPasses();
+	void AssignPhysicalSlots();
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+
+	std::vector<int> executionOrder;
+	std::vector<RenderGraphTextureDesc> physicalSlots;
+	size_t liveTransientCount = 0;
+
+	std::string error;
+	bool compiled = false;
+};
@@ -9,6 +9,26 @@
 #define LIGHT_TYPE_SPOT 2
 #define LIGHT_TYPE_AMBIENT 3
 
+// How the pixel shaders pick the lights they evaluate
+#define LIGHTING_MODE_ALL 0
+#define LIGHTING_MODE_CLUSTERED 1
+#define LIGHTING_MODE_PER_OBJECT 2
+
+// Must match Lights.h
+#define MAX_OBJECT_LIGHTS 8
+
+// Where an object gets the baked lights from
+#define BAKED_LIGHTING_NONE 0
+#define BAKED_LIGHTING_LIGHTMAP 1
+#define BAKED_LIGHTING_PROBES 2
+#define IRRADIANCE_SH_COEFFICIENTS 9
+
+// Must match LightClusters.h
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+#define LIGHT_CLUSTER_NEAR_SPLIT 0.5f
+
 struct Light 
 {
 	float3 color;
@@ -21,7 +41,8 @@ struct Light
 	int type;
 
 	float spotFalloff;
-	float3 pad;
+	int baked; // already in the lightmap of lightmapped objects
+	float2 pad;
 };
 
 // Doesn't exist inside constant buffers - thus an be unaligned
@@ -43,6 +64,7 @@ struct VertexShaderInput
 	float2 uv			: TEXCOORD;
 	float3 normal		: NORMAL;
 	float3 tangent		: TANGENT;
+	float2 lightmapUV	: TEXCOORD1;
 };
 
 struct VertexToPixel
@@ -52,6 +74,7 @@ struct VertexToPixel
 	float2 uv			: TEXCOORD;
 	float3 normal		: NORMAL;
 	float3 worldPos		: POSITION;
+	float2 lightmapUV	: TEXCOORD1;
 };
 
 struct V2P_NormalMap
@@ -62,6 +85,7 @@ struct V2P_NormalMap
 	float3 normal		: NORMAL;
 	float3 worldPos		: POSITION;
 	float3 tangent		: TANGENT;
+	float2 lightmapUV	: TEXCOORD1;
 };
 
 // HELPER FUNCTIONS
@@ -144,6 +168,50 @@ float3 SpotLight(PixelData pixelData, float3 cameraPosition, Light light)
 	return PointLight(pixelData, cameraPosition, light) * penumbra;
 }
 
+float3 EvaluateLight(PixelData pixelData, float3 cameraPosition, Light light)
+{
+	switch (light.type)
+	{
+	case LIGHT_TYPE_POINT:
+		return PointLight(pixelData, cameraPosition, light);
+	case LIGHT_TYPE_DIR:
+		return DirectionLight(pixelData, cameraPosition, light);
+	case LIGHT_TYPE_SPOT:
+		return SpotLight(pixelData, cameraPosition, light);
+	case LIGHT_TYPE_AMBIENT:
+		return AmbientLight(light);
+	}
+	return float3(0, 0, 0);
+}
+
+// Index into the cluster ranges for a pixel, same math as LightClusters::FindCluster
+uint LightClusterIndex(float4 screenPosition, float2 tileSize, float depthScale)
+{
+	uint x = min((uint)(screenPosition.x / tileSize.x), LIGHT_CLUSTERS_X - 1);
+	uint y = min((uint)(screenPosition.y / tileSize.y), LIGHT_CLUSTERS_Y - 1);
+
+	// SV_POSITION.w is the view space depth
+	float depth = screenPosition.w;
+	uint z = depth < LIGHT_CLUSTER_NEAR_SPLIT ? 0 : min(1 + (uint)(log(depth / LIGHT_CLUSTER_NEAR_SPLIT) * depthScale), LIGHT_CLUSTERS_Z - 1);
+
+	return (z * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + x;
+}
+
+// Diffuse light from irradiance SH for a unit normal, same as IrradianceProbes::Evaluate
+float3 ProbeIrradiance(float4 sh[IRRADIANCE_SH_COEFFICIENTS], float3 n)
+{
+	float3 result = sh[0].xyz * 0.282095f;
+	result += sh[1].xyz * 0.488603f * n.y;
+	result += sh[2].xyz * 0.488603f * n.z;
+	result += sh[3].xyz * 0.488603f * n.x;
+	result += sh[4].xyz * 1.092548f * n.x * n.y;
+	result += sh[5].xyz * 1.092548f * n.y * n.z;
+	result += sh[6].xyz * 0.315392f * (3.0f * n.z * n.z - 1.0f);
+	result += sh[7].xyz * 1.092548f * n.x * n.z;
+	result += sh[8].xyz * 0.546274f * (n.x * n.x - n.y * n.y);
+	return max(result, 0);
+}
+
 /*
  * Deprecated Function
  * Use only for testing
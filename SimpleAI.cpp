@@ -3,11 +3,18 @@
 #include "Transform.h"
 #include "Entity.h"
 #include "Material.h"
+#include "NavMesh.h"
+#include "FlowField.h"
+#include "TriangleBVH.h"
+#include "PathRequestService.h"
 
 #include <cstdio>
 
 using namespace DirectX;
 
+const XMFLOAT4 SimpleAI::AttackColor = XMFLOAT4(1.f, .1f, .1f, .5f);
+const XMFLOAT4 SimpleAI::PatrolColor = XMFLOAT4(.1f, .1f, 1.f, .5f);
+
 SimpleAI::SimpleAI(class PlayerInterface* pPlayer, class Entity** path, class Entity* pSelf)
 {
 	player = pPlayer;
@@ -15,13 +22,31 @@ SimpleAI::SimpleAI(class PlayerInterface* pPlayer, class Entity** path, class En
 	self = pSelf;
 	maxRouteCount = 4;
 	activeRoute = 0;
-	ghostSpeedBoost = 3.f;
+	ghostSpeedBoost = AI_GHOST_SPEED;
 	state = AI_State::PATROL_PATH;
 }
 
-void SimpleAI::Update(bool inLight, float deltaTime)
+SimpleAI::~SimpleAI()
+{
+	delete navQuery;
+	SetPathService(nullptr);
+}
+
+void SimpleAI::SetNavMesh(const NavMesh* navMesh)
+{
+	delete navQuery;
+	navQuery = navMesh ? new NavMeshQuery(*navMesh) : nullptr;
+}
+
+void SimpleAI::SetPathService(PathRequestService* service)
+{
+	pathFollower.Reset(pathService);
+	pathService = service;
+}
+
+void SimpleAI::Update(float playerVisibility, float deltaTime)
 {
-	UpdateState(inLight);
+	UpdateState(playerVisibility);
 
 	switch(state)
 	{
@@ -42,7 +67,7 @@ void SimpleAI::ExecutePatrolPath(float deltaTime)
 {
 	Transform* ghostTransform = self->GetTransform();
 	Entity* activePath = targetPath[activeRoute];
-	if (ghostTransform->DistanceSquaredTo(activePath->GetTransform()->GetPosition()) > 1.001f)
+	if (ghostTransform->DistanceSquaredTo(activePath->GetTransform()->GetPosition()) > AI_WAYPOINT_REACHED_SQ)
 	{
 		AIMoveTowards(activePath->GetTransform(), deltaTime);
 
@@ -70,24 +95,30 @@ void SimpleAI::ExecuteAttackPlayer(float deltaTime)
 	// @todo check if hit player, if so, send signal to end game
 }
 
-void SimpleAI::UpdateState(bool playerInLight)
+void SimpleAI::UpdateState(float playerVisibility)
 {	
 	// @note: the ghost's visibility range could be implemented as a member, 
 	// but this is only useful if we want to vary the ghost's vision range
-	const float sqLightRange = 9.0f * 9.0f;
-	const float sqDarkRange  = 6.0f * 6.0f;
+	const float lightRange = AI_SIGHT_RANGE_LIT;
+	const float darkRange  = AI_SIGHT_RANGE_DARK;
 
 	// squared distance to player
-	float sqDist = self->GetTransform()->DistanceSquaredTo(player->GetTransform()->GetPosition());
+	XMFLOAT3 playerPosition = player->GetTransform()->GetPosition();
+	float sqDist = self->GetTransform()->DistanceSquaredTo(playerPosition);
 	
-	float range = -1.0f;
-	// Ghosts can see farther if player is in light
-	if (playerInLight)
-		range = sqLightRange;
-	else
-		range = sqDarkRange;
+	// Ghosts can see farther the more the player is lit
+	float range = darkRange + (lightRange - darkRange) * playerVisibility;
+
+	// and not through walls
+	bool inSight = sqDist < range * range;
+	if (inSight && occluders)
+	{
+		XMFLOAT3 eye = self->GetTransform()->GetPosition();
+		eye.y += AI_EYE_HEIGHT;
+		inSight = !occluders->SegmentOccluded(eye, playerPosition);
+	}
 
-	if (sqDist < range) // Player spotted
+	if (inSight) // Player spotted
 	{
 		// State has changed from passive->attacking
 		if (state == AI_State::PATROL_PATH)
@@ -108,11 +139,22 @@ void SimpleAI::UpdateState(bool playerInLight)
 void SimpleAI::AIMoveTowards(Transform* pTarget, float deltaTime)
 {
 	Transform* ghostTransform = self->GetTransform();
-	float speed = 0.1f;
 
 	// Both positions as XMVECTOR
 	XMVECTOR targetPos = XMLoadFloat3(&pTarget->GetPosition());
 	XMVECTOR ghostPos = XMLoadFloat3(&ghostTransform->GetPosition());
+
+	// Head for the next floor toward the player or the first corner around the walls instead, at the ghost's height
+	XMFLOAT3 steer;
+	if (pTarget == player->GetTransform() && flowField && flowField->GetSteerTarget(ghostTransform->GetPosition(), steer))
+		targetPos = XMLoadFloat3(&steer);
+	else if (pathService)
+	{
+		if (pathFollower.NextCorner(*pathService, ghostTransform->GetPosition(), pTarget->GetPosition(), AI_CORNER_REACHED_SQ, AI_WAYPOINT_REACHED_SQ, steer))
+			targetPos = XMVectorSetY(XMLoadFloat3(&steer), XMVectorGetY(ghostPos));
+	}
+	else if (navQuery && navQuery->FindPath(ghostTransform->GetPosition(), pTarget->GetPosition(), navPath) && navPath.size() > 2)
+		targetPos = XMVectorSetY(XMLoadFloat3(&navPath[1]), XMVectorGetY(ghostPos));
 	
 	// SIMD operations
 	XMVECTOR dir = XMVectorSubtract(targetPos, ghostPos);
@@ -127,6 +169,5 @@ void SimpleAI::AIMoveTowards(Transform* pTarget, float deltaTime)
 	ghostTransform->MoveAbsolute(dirFl.x, 0, dirFl.z);
 
 	// Rotate ghost over time
-	ghostTransform->Rotate(0.f, (3.14f / 180) * speed, 0.f);
+	ghostTransform->Rotate(0.f, AI_SPIN_PER_UPDATE, 0.f);
 }
-
@@ -1,10 +1,26 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <vector>
+#include "PathRequestService.h"
 
 class Entity;
 class Transform;
 class PlayerInterface;
+class NavMesh;
+class NavMeshQuery;
+class FlowField;
+class TriangleBVH;
+class PathRequestService;
+
+// Ghost behaviour, shared with AISystem
+#define AI_SIGHT_RANGE_DARK 6.0f		// how far a ghost sees the player in the dark
+#define AI_SIGHT_RANGE_LIT 9.0f			// and fully lit
+#define AI_GHOST_SPEED 3.0f
+#define AI_WAYPOINT_REACHED_SQ 1.001f	// squared distance at which a patrol point counts as reached
+#define AI_SPIN_PER_UPDATE ((3.14f / 180) * 0.1f)	// yaw added every update a ghost moves
+#define AI_EYE_HEIGHT 1.0f				// ghosts look at the player from this far above their position
+#define AI_CORNER_REACHED_SQ 0.09f		// squared XZ distance at which a path corner counts as passed
 
 enum class AI_State: unsigned char
 {
@@ -15,16 +31,32 @@ enum class AI_State: unsigned char
 
 class SimpleAI 
 {
+public:
 	// Color tint constants
-	const DirectX::XMFLOAT4 AttackColor = DirectX::XMFLOAT4(1.f, .1f, .1f, .5f);
-	const DirectX::XMFLOAT4 PatrolColor = DirectX::XMFLOAT4(.1f, .1f, 1.f, .5f);
+	static const DirectX::XMFLOAT4 AttackColor;
+	static const DirectX::XMFLOAT4 PatrolColor;
 
-public:
 	SimpleAI(class PlayerInterface* pPlayer, class Entity** path, class Entity* pSelf);
-	~SimpleAI() = default;
+	~SimpleAI();
 
 	inline void SetState(AI_State pState) {state = pState;}
-	virtual void Update(bool playerInLight, float deltaTime);
+	inline AI_State GetState() const { return state; }
+
+	// Walk around walls along the navmesh's paths, null goes back to straight lines
+	void SetNavMesh(const class NavMesh* navMesh);
+
+	// Paths come from the service a frame or more after asking instead of searching inline, ahead of SetNavMesh().
+	// A path is kept until the target moves off its end, the ghost walks the old one meanwhile. Null searches inline again
+	void SetPathService(class PathRequestService* service);
+
+	// Field toward the player shared by every ghost, used while attacking instead of a path search
+	inline void SetFlowField(const class FlowField* field) { flowField = field; }
+
+	// The player is only spotted if no triangle is in the way, null sees through everything
+	inline void SetOccluders(const class TriangleBVH* bvh) { occluders = bvh; }
+
+	// playerVisibility goes from 0 in the dark to 1 fully lit
+	virtual void Update(float playerVisibility, float deltaTime);
 
 	class Entity* self = nullptr;
 
@@ -33,7 +65,7 @@ private:
 	void ExecuteAttackPlayer(float deltaTime);
 
 	// Updates the internal AI_State based on player distance
-	void UpdateState(bool inLight);
+	void UpdateState(float playerVisibility);
 
 	// Helper method for movement operations towards another transform
 	void AIMoveTowards(Transform* pTarget, float deltaTime);
@@ -46,4 +78,11 @@ private:
 	size_t maxRouteCount;
 
 	float ghostSpeedBoost;
+
+	class NavMeshQuery* navQuery = nullptr;
+	const class FlowField* flowField = nullptr;
+	std::vector<DirectX::XMFLOAT3> navPath;
+	class PathRequestService* pathService = nullptr;
+	PathFollower pathFollower;
+	const class TriangleBVH* occluders = nullptr;
 };
\ No newline at end of file
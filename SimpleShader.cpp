@@ -1,4 +1,5 @@
 #include "SimpleShader.h"
+#include "D3D11RenderContext.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ BASE SIMPLE SHADER --------------------------------------------------
@@ -12,6 +13,8 @@ ISimpleShader::ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context)
 	// Save the device
 	this->device = device;
 	this->deviceContext = context;
+	this->defaultRenderContext = new D3D11RenderContext(context);
+	this->renderContext = defaultRenderContext;
 
 	// Set up fields
 	this->constantBufferCount = 0;
@@ -28,6 +31,19 @@ ISimpleShader::~ISimpleShader()
 	// Derived class destructors will call this class's CleanUp method
 	if(shaderBlob)
 		shaderBlob->Release();
+
+	delete defaultRenderContext;
+}
+
+// --------------------------------------------------------
+// Redirects this shader's binds and constant buffer uploads
+//
+// context - The render context to use, or nullptr for the
+//           D3D11 context passed to the constructor
+// --------------------------------------------------------
+void ISimpleShader::SetRenderContext(IRenderContext* context)
+{
+	renderContext = context ? context : defaultRenderContext;
 }
 
 // --------------------------------------------------------
@@ -116,6 +132,8 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		switch (resourceDesc.Type)
 		{
 		case D3D_SIT_TEXTURE: // A texture resource
+		case D3D_SIT_STRUCTURED: // Read only buffers are bound through SRVs just like textures
+		case D3D_SIT_BYTEADDRESS:
 		{
 			// Create the SRV wrapper
 			SimpleSRV* srv = new SimpleSRV();
@@ -142,15 +160,21 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	}
 
 	// Loop through all constant buffers
-	for (unsigned int b = 0; b < constantBufferCount; b++)
+	constantBufferCount = 0;
+	for (unsigned int c = 0; c < shaderDesc.ConstantBuffers; c++)
 	{
 		// Get this buffer
 		ID3D11ShaderReflectionConstantBuffer* cb =
-			refl->GetConstantBufferByIndex(b);
+			refl->GetConstantBufferByIndex(c);
 		
 		// Get the description of this buffer
 		D3D11_SHADER_BUFFER_DESC bufferDesc;
 		cb->GetDesc(&bufferDesc);
+
+		// Structured buffers are reported here as well, but they are SRVs (see above)
+		if (bufferDesc.Type != D3D_CT_CBUFFER)
+			continue;
+		unsigned int b = constantBufferCount++;
 		
 		// Get the description of the resource binding, so
 		// we know exactly how it's bound in the shader
@@ -280,9 +304,10 @@ void ISimpleShader::CopyAllBufferData()
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
 		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer, 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+		renderContext->UpdateBuffer(
+			constantBuffers[i].ConstantBuffer,
+			constantBuffers[i].LocalDataBuffer,
+			constantBuffers[i].Size);
 	}
 }
 
@@ -311,9 +336,10 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	renderContext->UpdateBuffer(
+		cb->ConstantBuffer,
+		cb->LocalDataBuffer,
+		cb->Size);
 }
 
 // --------------------------------------------------------
@@ -333,9 +359,10 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	renderContext->UpdateBuffer(
+		cb->ConstantBuffer,
+		cb->LocalDataBuffer,
+		cb->Size);
 }
 
 
@@ -765,16 +792,16 @@ void SimpleVertexShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout);
-	deviceContext->VSSetShader(shader, 0, 0);
+	renderContext->SetInputLayout(inputLayout);
+	renderContext->SetVertexShader(shader);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		deviceContext->VSSetConstantBuffers(
+		renderContext->SetConstantBuffer(
+			ShaderStage::Vertex,
 			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+			constantBuffers[i].ConstantBuffer);
 	}
 }
 
@@ -794,7 +821,7 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 		return false;
 
 	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	renderContext->SetShaderResource(ShaderStage::Vertex, srvInfo->BindIndex, srv);
 
 	// Success
 	return true;
@@ -816,7 +843,7 @@ bool SimpleVertexShader::SetSamplerState(std::string name, ID3D11SamplerState* s
 		return false;
 
 	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	renderContext->SetSampler(ShaderStage::Vertex, sampInfo->BindIndex, samplerState);
 
 	// Success
 	return true;
@@ -890,15 +917,15 @@ void SimplePixelShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 	
 	// Set the shader
-	deviceContext->PSSetShader(shader, 0, 0);
+	renderContext->SetPixelShader(shader);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		deviceContext->PSSetConstantBuffers(
+		renderContext->SetConstantBuffer(
+			ShaderStage::Pixel,
 			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+			constantBuffers[i].ConstantBuffer);
 	}
 }
 
@@ -918,7 +945,7 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderReso
 		return false;
 
 	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	renderContext->SetShaderResource(ShaderStage::Pixel, srvInfo->BindIndex, srv);
 
 	// Success
 	return true;
@@ -940,7 +967,7 @@ bool SimplePixelShader::SetSamplerState(std::string name, ID3D11SamplerState* sa
 		return false;
 
 	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	renderContext->SetSampler(ShaderStage::Pixel, sampInfo->BindIndex, samplerState);
 
 	// Success
 	return true;
@@ -10,6 +10,8 @@
 #include <vector>
 #include <string>
 
+#include "RenderBackend.h"
+
 // --------------------------------------------------------
 // Used by simple shaders to store information about
 // specific variables in constant buffers
@@ -66,6 +68,11 @@ public:
 	// Simple helpers
 	bool IsShaderValid() { return shaderValid; }
 
+	// Routes binds and uploads through another render context (e.g. a recording one).
+	// nullptr goes back to the context the shader was created with
+	void SetRenderContext(IRenderContext* context);
+	IRenderContext* GetRenderContext() { return renderContext; }
+
 	// Activating the shader and copying data
 	void SetShader();
 	void CopyAllBufferData();
@@ -117,6 +124,10 @@ protected:
 	ID3D11Device* device;
 	ID3D11DeviceContext* deviceContext;
 
+	// Vertex and pixel stage submission goes through this, the other stages still use deviceContext
+	IRenderContext* renderContext;
+	IRenderContext* defaultRenderContext;
+
 	// Resource counts
 	unsigned int constantBufferCount;
 	
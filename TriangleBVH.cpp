@@ -0,0 +1,498 @@
+#include "TriangleBVH.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	inline XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	inline XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+	inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline float Axis(const XMFLOAT3& v, int axis) { return axis == 0 ? v.x : (axis == 1 ? v.y : v.z); }
+
+	// 1 / d for the slab tests, finite so a ray in the plane of a box face gets 0 instead of 0 * inf = NaN and counts as inside
+	inline float SlabInverse(float d) { return fabsf(d) > 1e-30f ? 1.0f / d : copysignf(1e30f, d); }
+
+	struct Bounds
+	{
+		XMFLOAT3 min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+		void Grow(const XMFLOAT3& p)
+		{
+			min = XMFLOAT3((std::min)(min.x, p.x), (std::min)(min.y, p.y), (std::min)(min.z, p.z));
+			max = XMFLOAT3((std::max)(max.x, p.x), (std::max)(max.y, p.y), (std::max)(max.z, p.z));
+		}
+
+		// an empty b leaves the bounds as they are
+		void Grow(const Bounds& b)
+		{
+			min = XMFLOAT3((std::min)(min.x, b.min.x), (std::min)(min.y, b.min.y), (std::min)(min.z, b.min.z));
+			max = XMFLOAT3((std::max)(max.x, b.max.x), (std::max)(max.y, b.max.y), (std::max)(max.z, b.max.z));
+		}
+
+		float Area() const
+		{
+			if (min.x > max.x)
+				return 0.0f;
+			XMFLOAT3 e = Subtract(max, min);
+			return e.x * e.y + e.y * e.z + e.z * e.x;
+		}
+	};
+}
+
+void TriangleBVH::Clear()
+{
+	corners.clear();
+	nodes.clear();
+	packs.clear();
+	triangleIds.clear();
+}
+
+void TriangleBVH::AddTriangle(const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+{
+	corners.push_back(a);
+	corners.push_back(b);
+	corners.push_back(c);
+}
+
+// --------------------------------------------------------
+// Top down build. Each node's triangles are binned by their
+// centroids along every axis and split at the bin boundary
+// with the lowest surface area cost
+// --------------------------------------------------------
+void TriangleBVH::Build()
+{
+	const unsigned int triangleCount = GetTriangleCount();
+	nodes.clear();
+	packs.clear();
+	triangleIds.resize(triangleCount);
+	if (triangleCount == 0)
+		return;
+
+	std::vector<Bounds> triangleBounds(triangleCount);
+	std::vector<XMFLOAT3> centroids(triangleCount);
+	for (unsigned int i = 0; i < triangleCount; ++i)
+	{
+		const XMFLOAT3* c = &corners[i * 3];
+		triangleBounds[i].Grow(c[0]);
+		triangleBounds[i].Grow(c[1]);
+		triangleBounds[i].Grow(c[2]);
+		centroids[i] = XMFLOAT3((c[0].x + c[1].x + c[2].x) / 3.0f, (c[0].y + c[1].y + c[2].y) / 3.0f, (c[0].z + c[1].z + c[2].z) / 3.0f);
+		triangleIds[i] = i;
+	}
+
+	nodes.reserve(triangleCount * 2);
+	nodes.push_back({});
+	nodes[0].first = 0;
+	nodes[0].count = triangleCount;
+
+	// node index and depth
+	std::vector<std::pair<unsigned int, unsigned int>> pending(1, std::make_pair(0u, 0u));
+	while (!pending.empty())
+	{
+		unsigned int nodeIndex = pending.back().first;
+		unsigned int depth = pending.back().second;
+		pending.pop_back();
+
+		unsigned int first = nodes[nodeIndex].first;
+		unsigned int count = nodes[nodeIndex].count;
+
+		Bounds bounds, centroidBounds;
+		for (unsigned int i = first; i < first + count; ++i)
+		{
+			bounds.Grow(triangleBounds[triangleIds[i]]);
+			centroidBounds.Grow(centroids[triangleIds[i]]);
+		}
+		nodes[nodeIndex].boundsMin = bounds.min;
+		nodes[nodeIndex].boundsMax = bounds.max;
+
+		if (count <= TRIANGLE_BVH_LEAF_SIZE || depth >= TRIANGLE_BVH_MAX_DEPTH)
+			continue;
+
+		// cheapest split over every axis' bins
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		float bestSplit = 0.0f;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float low = Axis(centroidBounds.min, axis);
+			float high = Axis(centroidBounds.max, axis);
+			if (high <= low)
+				continue;
+
+			Bounds binBounds[TRIANGLE_BVH_BINS];
+			unsigned int binCounts[TRIANGLE_BVH_BINS] = {};
+			float scale = TRIANGLE_BVH_BINS / (high - low);
+			for (unsigned int i = first; i < first + count; ++i)
+			{
+				unsigned int id = triangleIds[i];
+				int bin = (std::min)((int)((Axis(centroids[id], axis) - low) * scale), TRIANGLE_BVH_BINS - 1);
+				binBounds[bin].Grow(triangleBounds[id]);
+				binCounts[bin]++;
+			}
+
+			// sweep from the right to get the area and count right of every boundary
+			float rightArea[TRIANGLE_BVH_BINS];
+			unsigned int rightCount[TRIANGLE_BVH_BINS];
+			Bounds right;
+			unsigned int rightSum = 0;
+			for (int bin = TRIANGLE_BVH_BINS - 1; bin > 0; --bin)
+			{
+				right.Grow(binBounds[bin]);
+				rightSum += binCounts[bin];
+				rightArea[bin] = right.Area();
+				rightCount[bin] = rightSum;
+			}
+
+			Bounds left;
+			unsigned int leftSum = 0;
+			for (int bin = 0; bin < TRIANGLE_BVH_BINS - 1; ++bin)
+			{
+				left.Grow(binBounds[bin]);
+				leftSum += binCounts[bin];
+				if (leftSum == 0 || rightCount[bin + 1] == 0)
+					continue;
+
+				float cost = leftSum * left.Area() + rightCount[bin + 1] * rightArea[bin + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = low + (bin + 1) / scale;
+				}
+			}
+		}
+
+		// every centroid in one spot, or splitting costs more than testing all of them
+		if (bestAxis < 0 || bestCost >= count * bounds.Area())
+			continue;
+
+		unsigned int* begin = &triangleIds[first];
+		unsigned int* middle = std::partition(begin, begin + count, [&](unsigned int id) { return Axis(centroids[id], bestAxis) < bestSplit; });
+		unsigned int leftCount = (unsigned int)(middle - begin);
+		if (leftCount == 0 || leftCount == count)
+			continue;
+
+		unsigned int leftChild = (unsigned int)nodes.size();
+		nodes.push_back({});
+		nodes.push_back({});
+		nodes[leftChild].first = first;
+		nodes[leftChild].count = leftCount;
+		nodes[leftChild + 1].first = first + leftCount;
+		nodes[leftChild + 1].count = count - leftCount;
+		nodes[nodeIndex].first = leftChild;
+		nodes[nodeIndex].count = 0;
+
+		pending.push_back(std::make_pair(leftChild, depth + 1));
+		pending.push_back(std::make_pair(leftChild + 1, depth + 1));
+	}
+
+	// every leaf's triangles into its own packs, the last one padded
+	std::vector<unsigned int> leafOrder;
+	leafOrder.swap(triangleIds);
+	for (Node& node : nodes)
+	{
+		if (node.count == 0)
+			continue;
+
+		unsigned int first = node.first;
+		node.first = (unsigned int)packs.size();
+		for (unsigned int i = 0; i < node.count; i += 4)
+		{
+			TrianglePack pack = {};
+			for (unsigned int lane = 0; lane < 4; ++lane)
+			{
+				unsigned int id = i + lane < node.count ? leafOrder[first + i + lane] : UINT_MAX;
+				triangleIds.push_back(id);
+				if (id == UINT_MAX)
+					continue;
+
+				const XMFLOAT3* c = &corners[id * 3];
+				XMFLOAT3 edge1 = Subtract(c[1], c[0]);
+				XMFLOAT3 edge2 = Subtract(c[2], c[0]);
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					(&pack.v0[axis].x)[lane] = Axis(c[0], axis);
+					(&pack.edge1[axis].x)[lane] = Axis(edge1, axis);
+					(&pack.edge2[axis].x)[lane] = Axis(edge2, axis);
+				}
+			}
+			packs.push_back(pack);
+		}
+	}
+}
+
+bool TriangleBVH::Intersect(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, RayHit& hit) const
+{
+	return Trace(origin, direction, maxDistance, false, &hit);
+}
+
+bool TriangleBVH::Occluded(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance) const
+{
+	return Trace(origin, direction, maxDistance, true, nullptr);
+}
+
+bool TriangleBVH::SegmentOccluded(const XMFLOAT3& from, const XMFLOAT3& to) const
+{
+	XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&to), XMLoadFloat3(&from));
+	float length = XMVectorGetX(XMVector3Length(offset));
+	if (length <= 0.0f)
+		return false;
+
+	XMFLOAT3 direction;
+	XMStoreFloat3(&direction, XMVectorScale(offset, 1.0f / length));
+	return Trace(from, direction, length * TRIANGLE_BVH_SEGMENT_END, true, nullptr);
+}
+
+void TriangleBVH::SegmentsOccluded(const XMFLOAT3* from, const XMFLOAT3* to, unsigned int count, unsigned char* occluded) const
+{
+	for (unsigned int first = 0; first < count; first += 4)
+		TracePacket(from + first, to + first, (std::min)(count - first, 4u), occluded + first);
+}
+
+bool TriangleBVH::Trace(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, bool anyHit, RayHit* hit) const
+{
+	if (nodes.empty())
+		return false;
+
+	// slab test against 1 / direction, huge values take care of axis aligned rays
+	const XMFLOAT3 inverse(SlabInverse(direction.x), SlabInverse(direction.y), SlabInverse(direction.z));
+	auto boxDistance = [&](const Node& node)
+	{
+		float tx1 = (node.boundsMin.x - origin.x) * inverse.x, tx2 = (node.boundsMax.x - origin.x) * inverse.x;
+		float ty1 = (node.boundsMin.y - origin.y) * inverse.y, ty2 = (node.boundsMax.y - origin.y) * inverse.y;
+		float tz1 = (node.boundsMin.z - origin.z) * inverse.z, tz2 = (node.boundsMax.z - origin.z) * inverse.z;
+		float tNear = (std::max)((std::max)((std::min)(tx1, tx2), (std::min)(ty1, ty2)), (std::max)((std::min)(tz1, tz2), 0.0f));
+		float tFar = (std::min)((std::min)((std::max)(tx1, tx2), (std::max)(ty1, ty2)), (std::max)(tz1, tz2));
+		return tNear <= tFar && tNear < maxDistance ? tNear : FLT_MAX;
+	};
+
+	const XMVECTOR rayOrigin[3] = { XMVectorReplicate(origin.x), XMVectorReplicate(origin.y), XMVectorReplicate(origin.z) };
+	const XMVECTOR rayDirection[3] = { XMVectorReplicate(direction.x), XMVectorReplicate(direction.y), XMVectorReplicate(direction.z) };
+	float closest = maxDistance;
+	bool found = false;
+
+	unsigned int stack[TRIANGLE_BVH_MAX_DEPTH + 2];
+	unsigned int stackSize = 0;
+	if (boxDistance(nodes[0]) == FLT_MAX)
+		return false;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+		if (node.count > 0)
+		{
+			unsigned int last = node.first + (node.count + 3) / 4;
+			for (unsigned int p = node.first; p < last; ++p)
+			{
+				XMVECTOR u, v, mask;
+				XMVECTOR distances = TestPack(packs[p], rayOrigin, rayDirection, XMVectorReplicate(closest), u, v, mask);
+				if (XMVector4EqualInt(mask, XMVectorZero()))
+					continue;
+
+				if (anyHit)
+					return true;
+
+				// the closest lane, the first one on ties like testing them in order
+				XMFLOAT4 laneDistances, laneU, laneV;
+				uint32_t laneMask[4];
+				XMStoreFloat4(&laneDistances, distances);
+				XMStoreFloat4(&laneU, u);
+				XMStoreFloat4(&laneV, v);
+				XMStoreInt4(laneMask, mask);
+				for (unsigned int lane = 0; lane < 4; ++lane)
+				{
+					float distance = (&laneDistances.x)[lane];
+					if (!laneMask[lane] || distance >= closest)
+						continue;
+
+					closest = distance;
+					found = true;
+					hit->distance = distance;
+					hit->u = (&laneU.x)[lane];
+					hit->v = (&laneV.x)[lane];
+					hit->triangle = triangleIds[p * 4 + lane];
+				}
+			}
+			continue;
+		}
+
+		// nearer child last so it's popped first
+		unsigned int left = node.first;
+		unsigned int right = node.first + 1;
+		float leftDistance = boxDistance(nodes[left]);
+		float rightDistance = boxDistance(nodes[right]);
+		if (leftDistance > rightDistance)
+		{
+			std::swap(left, right);
+			std::swap(leftDistance, rightDistance);
+		}
+		if (rightDistance < closest)
+			stack[stackSize++] = right;
+		if (leftDistance < closest)
+			stack[stackSize++] = left;
+	}
+
+	return found;
+}
+
+// --------------------------------------------------------
+// Moller-Trumbore against four triangles, both sides, the
+// same steps as one triangle at a time with a lane each
+// --------------------------------------------------------
+XMVECTOR TriangleBVH::TestPack(const TrianglePack& pack, const XMVECTOR origin[3], const XMVECTOR direction[3], XMVECTOR maxDistance, XMVECTOR& u, XMVECTOR& v, XMVECTOR& mask)
+{
+	const XMVECTOR e1x = XMLoadFloat4(&pack.edge1[0]), e1y = XMLoadFloat4(&pack.edge1[1]), e1z = XMLoadFloat4(&pack.edge1[2]);
+	const XMVECTOR e2x = XMLoadFloat4(&pack.edge2[0]), e2y = XMLoadFloat4(&pack.edge2[1]), e2z = XMLoadFloat4(&pack.edge2[2]);
+	const XMVECTOR zero = XMVectorZero();
+	const XMVECTOR one = XMVectorSplatOne();
+
+	// p = direction x edge2
+	XMVECTOR px = XMVectorSubtract(XMVectorMultiply(direction[1], e2z), XMVectorMultiply(direction[2], e2y));
+	XMVECTOR py = XMVectorSubtract(XMVectorMultiply(direction[2], e2x), XMVectorMultiply(direction[0], e2z));
+	XMVECTOR pz = XMVectorSubtract(XMVectorMultiply(direction[0], e2y), XMVectorMultiply(direction[1], e2x));
+	XMVECTOR determinant = XMVectorAdd(XMVectorAdd(XMVectorMultiply(e1x, px), XMVectorMultiply(e1y, py)), XMVectorMultiply(e1z, pz));
+	XMVECTOR inverseDeterminant = XMVectorReciprocal(determinant);
+
+	XMVECTOR tx = XMVectorSubtract(origin[0], XMLoadFloat4(&pack.v0[0]));
+	XMVECTOR ty = XMVectorSubtract(origin[1], XMLoadFloat4(&pack.v0[1]));
+	XMVECTOR tz = XMVectorSubtract(origin[2], XMLoadFloat4(&pack.v0[2]));
+	u = XMVectorMultiply(XMVectorAdd(XMVectorAdd(XMVectorMultiply(tx, px), XMVectorMultiply(ty, py)), XMVectorMultiply(tz, pz)), inverseDeterminant);
+
+	// q = t x edge1
+	XMVECTOR qx = XMVectorSubtract(XMVectorMultiply(ty, e1z), XMVectorMultiply(tz, e1y));
+	XMVECTOR qy = XMVectorSubtract(XMVectorMultiply(tz, e1x), XMVectorMultiply(tx, e1z));
+	XMVECTOR qz = XMVectorSubtract(XMVectorMultiply(tx, e1y), XMVectorMultiply(ty, e1x));
+	v = XMVectorMultiply(XMVectorAdd(XMVectorAdd(XMVectorMultiply(direction[0], qx), XMVectorMultiply(direction[1], qy)), XMVectorMultiply(direction[2], qz)), inverseDeterminant);
+	XMVECTOR distance = XMVectorMultiply(XMVectorAdd(XMVectorAdd(XMVectorMultiply(e2x, qx), XMVectorMultiply(e2y, qy)), XMVectorMultiply(e2z, qz)), inverseDeterminant);
+
+	// NaNs from a zero determinant fail every comparison
+	mask = XMVectorGreaterOrEqual(XMVectorAbs(determinant), XMVectorReplicate(1e-12f));
+	mask = XMVectorAndInt(mask, XMVectorAndInt(XMVectorGreaterOrEqual(u, zero), XMVectorLessOrEqual(u, one)));
+	mask = XMVectorAndInt(mask, XMVectorAndInt(XMVectorGreaterOrEqual(v, zero), XMVectorLessOrEqual(XMVectorAdd(u, v), one)));
+	mask = XMVectorAndInt(mask, XMVectorAndInt(XMVectorGreater(distance, zero), XMVectorLess(distance, maxDistance)));
+	return distance;
+}
+
+// --------------------------------------------------------
+// Four segments as four SIMD lanes through the box tests.
+// A lane drops out once it's blocked, a leaf is tested for
+// each lane still open that reaches its box
+// --------------------------------------------------------
+void TriangleBVH::TracePacket(const XMFLOAT3* from, const XMFLOAT3* to, unsigned int count, unsigned char* occluded) const
+{
+	XMFLOAT4 origins[3] = {}, inverses[3] = {}, directions[3] = {};
+	XMFLOAT4 lengths(0, 0, 0, 0);
+	uint32_t open[4] = {};
+	for (unsigned int lane = 0; lane < count; ++lane)
+	{
+		occluded[lane] = 0;
+		XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&to[lane]), XMLoadFloat3(&from[lane]));
+		float length = XMVectorGetX(XMVector3Length(offset));
+		if (length <= 0.0f || nodes.empty())
+			continue;
+
+		XMFLOAT3 direction;
+		XMStoreFloat3(&direction, XMVectorScale(offset, 1.0f / length));
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			(&origins[axis].x)[lane] = Axis(from[lane], axis);
+			(&directions[axis].x)[lane] = Axis(direction, axis);
+			(&inverses[axis].x)[lane] = SlabInverse(Axis(direction, axis));
+		}
+		(&lengths.x)[lane] = length * TRIANGLE_BVH_SEGMENT_END;
+		open[lane] = 0xffffffff;
+	}
+
+	const XMVECTOR ox = XMLoadFloat4(&origins[0]), oy = XMLoadFloat4(&origins[1]), oz = XMLoadFloat4(&origins[2]);
+	const XMVECTOR ix = XMLoadFloat4(&inverses[0]), iy = XMLoadFloat4(&inverses[1]), iz = XMLoadFloat4(&inverses[2]);
+	const XMVECTOR maxDistance = XMLoadFloat4(&lengths);
+	const XMVECTOR zero = XMVectorZero();
+	XMVECTOR active = XMLoadInt4(open);
+
+	// lanes that hit the box, and their entry distances
+	auto boxLanes = [&](const Node& node, XMVECTOR& tNear)
+	{
+		XMVECTOR tx1 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.boundsMin.x), ox), ix);
+		XMVECTOR tx2 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.boundsMax.x), ox), ix);
+		XMVECTOR ty1 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.boundsMin.y), oy), iy);
+		XMVECTOR ty2 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.boundsMax.y), oy), iy);
+		XMVECTOR tz1 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.boundsMin.z), oz), iz);
+		XMVECTOR tz2 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.boundsMax.z), oz), iz);
+		tNear = XMVectorMax(XMVectorMax(XMVectorMin(tx1, tx2), XMVectorMin(ty1, ty2)), XMVectorMax(XMVectorMin(tz1, tz2), zero));
+		XMVECTOR tFar = XMVectorMin(XMVectorMin(XMVectorMax(tx1, tx2), XMVectorMax(ty1, ty2)), XMVectorMax(tz1, tz2));
+		return XMVectorAndInt(active, XMVectorAndInt(XMVectorLessOrEqual(tNear, tFar), XMVectorLess(tNear, maxDistance)));
+	};
+	// the nearest entry of the lanes that hit
+	auto nearest = [&](XMVECTOR lanes, XMVECTOR tNear)
+	{
+		XMFLOAT4 distances;
+		XMStoreFloat4(&distances, XMVectorSelect(XMVectorReplicate(FLT_MAX), tNear, lanes));
+		return (std::min)((std::min)(distances.x, distances.y), (std::min)(distances.z, distances.w));
+	};
+
+	unsigned int stack[TRIANGLE_BVH_MAX_DEPTH + 2];
+	unsigned int stackSize = 0;
+	XMVECTOR tNear;
+	if (nodes.empty() || XMVector4EqualInt(boxLanes(nodes[0], tNear), zero))
+		return;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+		if (node.count > 0)
+		{
+			XMVECTOR lanes = boxLanes(node, tNear);
+			uint32_t laneMask[4];
+			XMStoreInt4(laneMask, lanes);
+			unsigned int last = node.first + (node.count + 3) / 4;
+			for (unsigned int lane = 0; lane < count; ++lane)
+			{
+				if (!laneMask[lane])
+					continue;
+
+				const XMVECTOR origin[3] = { XMVectorReplicate((&origins[0].x)[lane]), XMVectorReplicate((&origins[1].x)[lane]), XMVectorReplicate((&origins[2].x)[lane]) };
+				const XMVECTOR direction[3] = { XMVectorReplicate((&directions[0].x)[lane]), XMVectorReplicate((&directions[1].x)[lane]), XMVectorReplicate((&directions[2].x)[lane]) };
+				const XMVECTOR laneMaxDistance = XMVectorReplicate((&lengths.x)[lane]);
+				for (unsigned int p = node.first; p < last; ++p)
+				{
+					XMVECTOR u, v, mask;
+					TestPack(packs[p], origin, direction, laneMaxDistance, u, v, mask);
+					if (!XMVector4EqualInt(mask, zero))
+					{
+						occluded[lane] = 1;
+						open[lane] = 0;
+						break;
+					}
+				}
+			}
+
+			active = XMLoadInt4(open);
+			if (XMVector4EqualInt(active, zero))
+				return;
+			continue;
+		}
+
+		// children any open lane hits, the nearer one popped first
+		unsigned int left = node.first;
+		unsigned int right = node.first + 1;
+		XMVECTOR leftNear, rightNear;
+		XMVECTOR leftLanes = boxLanes(nodes[left], leftNear);
+		XMVECTOR rightLanes = boxLanes(nodes[right], rightNear);
+		bool hitsLeft = !XMVector4EqualInt(leftLanes, zero);
+		bool hitsRight = !XMVector4EqualInt(rightLanes, zero);
+		if (hitsLeft && hitsRight && nearest(leftLanes, leftNear) > nearest(rightLanes, rightNear))
+			std::swap(left, right);
+
+		if (hitsRight)
+			stack[stackSize++] = right;
+		if (hitsLeft)
+			stack[stackSize++] = left;
+	}
+}
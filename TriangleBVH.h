@@ -0,0 +1,101 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// Leaves are split until they hold at most this many triangles, unless the split can't separate them
+#define TRIANGLE_BVH_LEAF_SIZE 4
+
+// Candidate split planes per axis for the SAH build
+#define TRIANGLE_BVH_BINS 12
+
+// Deeper nodes stay leaves, keeps the traversal stack bounded
+#define TRIANGLE_BVH_MAX_DEPTH 60
+
+// Segments stop short of their end by this fraction of their length, so a hit right at the end doesn't count
+#define TRIANGLE_BVH_SEGMENT_END 0.9999f
+
+// Closest hit along a ray
+struct RayHit
+{
+	float distance;
+	float u, v;				// barycentric weights of the triangle's second and third vertex
+	unsigned int triangle;	// index in the order the triangles were added
+};
+
+/**
+ * Bounding volume hierarchy over world space triangles for ray queries,
+ * like the lightmap baker's shadow and bounce rays and the ghosts' line
+ * of sight.
+ *
+ * Built top down, every node split where the surface area heuristic
+ * over TRIANGLE_BVH_BINS candidate planes is cheapest. Triangles are two
+ * sided and stored in leaf order, four at a time in SoA packs so a ray is
+ * tested against four triangles at once with DirectXMath vectors.
+ *
+ * SegmentsOccluded() walks the tree with packets of four segments at a
+ * time, a node is opened if any segment of the packet still open hits it.
+ * Segments that start and end close to each other (a group of ghosts
+ * looking at the player) share most of their nodes.
+ *
+ * Queries only read, so any number of threads can trace at once.
+ */
+class TriangleBVH
+{
+public:
+	TriangleBVH() = default;
+	~TriangleBVH() = default;
+
+	void Clear();
+	void AddTriangle(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b, const DirectX::XMFLOAT3& c);
+
+	// Needed after adding triangles, before any query
+	void Build();
+
+	// Closest hit closer than maxDistance. The direction has to be normalized
+	bool Intersect(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, RayHit& hit) const;
+
+	// True if anything is hit closer than maxDistance, stops at the first hit
+	bool Occluded(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance) const;
+
+	// True if anything is hit between the two points, e.g. for line of sight. The end point itself doesn't count
+	bool SegmentOccluded(const DirectX::XMFLOAT3& from, const DirectX::XMFLOAT3& to) const;
+
+	// SegmentOccluded() for every from[i] to to[i], occluded[i] is 1 if blocked and 0 if not
+	void SegmentsOccluded(const DirectX::XMFLOAT3* from, const DirectX::XMFLOAT3* to, unsigned int count, unsigned char* occluded) const;
+
+	inline unsigned int GetTriangleCount() const { return (unsigned int)(corners.size() / 3); }
+	inline unsigned int GetNodeCount() const { return (unsigned int)nodes.size(); }
+
+private:
+	struct Node
+	{
+		DirectX::XMFLOAT3 boundsMin;
+		unsigned int first;		// first pack of a leaf, left child of an inner node (the right one follows it)
+		DirectX::XMFLOAT3 boundsMax;
+		unsigned int count;		// triangles of a leaf in (count + 3) / 4 packs, 0 for inner nodes
+	};
+
+	// Four triangles precomputed for the Moller-Trumbore test, one per lane. Padding lanes are degenerate and never hit
+	struct TrianglePack
+	{
+		DirectX::XMFLOAT4 v0[3];
+		DirectX::XMFLOAT4 edge1[3];
+		DirectX::XMFLOAT4 edge2[3];
+	};
+
+	bool Trace(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, bool anyHit, RayHit* hit) const;
+
+	// Up to four segments down the tree together
+	void TracePacket(const DirectX::XMFLOAT3* from, const DirectX::XMFLOAT3* to, unsigned int count, unsigned char* occluded) const;
+
+	// Distance to each of the pack's triangles along the ray, the lanes that hit closer than maxDistance are set in the mask
+	static DirectX::XMVECTOR TestPack(const TrianglePack& pack, const DirectX::XMVECTOR origin[3], const DirectX::XMVECTOR direction[3], DirectX::XMVECTOR maxDistance, DirectX::XMVECTOR& u, DirectX::XMVECTOR& v, DirectX::XMVECTOR& mask);
+
+	// Three corners per triangle, in the order they were added
+	std::vector<DirectX::XMFLOAT3> corners;
+
+	std::vector<Node> nodes;
+	std::vector<TrianglePack> packs;		// leaf order
+	std::vector<unsigned int> triangleIds;	// pack lane (pack * 4 + lane) to added order
+};
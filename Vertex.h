@@ -13,4 +13,5 @@ struct Vertex
 	DirectX::XMFLOAT2 UV;
 	DirectX::XMFLOAT3 Normal;
 	DirectX::XMFLOAT3 Tangent;
+	DirectX::XMFLOAT2 LightmapUV = DirectX::XMFLOAT2(0, 0);	// filled in by Mesh::SetLightmapUVs()
 };
\ No newline at end of file
@@ -28,5 +28,6 @@ VertexToPixel main( VertexShaderInput input )
 	output.color = colorTint;
 	output.worldPos = mul(world, float4(input.position, 1.0f)).xyz;
 	output.uv = input.uv;
+	output.lightmapUV = input.lightmapUV;
 	return output;
 }
\ No newline at end of file